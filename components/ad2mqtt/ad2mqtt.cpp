@@ -32,9 +32,13 @@ static const char *TAG = "MQTT";
 
 // AlarmDecoder std includes
 #include "alarmdecoder_main.h"
+#include <atomic>
 
 // esp component includes
 #include "mqtt_client.h"
+#include "esp_rom_crc.h"
+
+#include "ad2mqtt.h"
 
 // enable verbose debug logging
 //#define MQTT_DEBUG
@@ -47,6 +51,13 @@ static const char *TAG = "MQTT";
 #define MQTT_TPREFIX_SUBCMD "tprefix"
 #define MQTT_DPREFIX_SUBCMD "dprefix"
 #define MQTT_SWITCH_SUBCMD  "switch"
+#define MQTT_DEDUP_SUBCMD   "dedup"
+#define MQTT_IGNORE_SUBCMD  "ignore"
+#define MQTT_ALPHA_SUBCMD   "alpha"
+#define MQTT_COMPACT_SUBCMD "compact"
+#define MQTT_OUTBOX_SUBCMD  "outbox"
+#define MQTT_CBOR_SUBCMD    "cbor"
+#define MQTT_ZONEBATCH_SUBCMD "zonebatch"
 
 #define MQTT_CONFIG_SECTION "mqtt"
 #define MQTT_CONFIG_SWITCH_SUFFIX_DESCRIPTION "description"
@@ -64,44 +75,1156 @@ static const char *TAG = "MQTT";
 #define MQTT_LWT_MESSAGE "offline"
 #define MQTT_COMMANDS_TOPIC "commands"
 #define MQTT_COMMAND_MAX_DATA_LEN 256
+// Commands accepted once every MQTT_COMMAND_RATE_MS with bursts of up to
+// MQTT_COMMAND_BURST. Storage for the code and arg of a command.
+#define MQTT_COMMAND_RATE_MS 500
+#define MQTT_COMMAND_BURST 4
+#define MQTT_COMMAND_CODE_LEN 16
+#define MQTT_COMMAND_ARG_LEN 128
+#define MQTT_HA_STATUS_TOPIC "status"
+#define MQTT_CBOR_TOPIC "cbor"
+// _mqtt_publish_state result when the document did not change.
+#define MQTT_PUBLISH_SUPPRESSED -2
+// Largest topic formatted on the stack for an entity not in the arena.
+#define MQTT_TOPIC_MAX 160
+
+// Discovery configs waiting for a PUBACK at one time.
+#define MQTT_DISCOVERY_WINDOW 8
+// Resend a discovery config not acknowledged in this time.
+#define MQTT_DISCOVERY_ACK_TIMEOUT_MS 30000
+
+// Optional uSD outbox for QoS 1 publishes made while the broker is away.
+// Ring file, its record size and count and replayed records waiting for a
+// PUBACK at one time.
+#define MQTT_OUTBOX_PATH "/" AD2_USD_MOUNT_POINT "/ad2mqtt.obx"
+#define MQTT_OUTBOX_RECORD_SIZE 2048
+#define MQTT_OUTBOX_RECORDS 256
+#define MQTT_OUTBOX_WINDOW 4
+
+// Optional zone change batching. Deltas go to {root}/partitions/N/zones.
+// A zone topic is updated at most once in this time unless set.
+#define MQTT_ZONE_DELTA_TOPIC "zones"
+#define MQTT_ZONE_UPDATE_MS 30000
 
 #define EXAMPLE_BROKER_URI "mqtt://mqtt.eclipseprojects.io"
 
-static esp_mqtt_client_handle_t mqtt_client = nullptr;
+// Swapped out before a restart destroys it. Publish with _mqtt_enqueue().
+static std::atomic<esp_mqtt_client_handle_t> mqtt_client(nullptr);
+// Publishes using the client right now. mqtt_free() waits for them.
+static std::atomic<int> mqtt_client_users(0);
 static std::string mqttclient_UUID;
 static std::string mqttclient_TPREFIX = "";
 static std::string mqttclient_DPREFIX = "";
+static std::string mqttclient_URL = "";
 static std::vector<AD2EventSearch *> mqtt_AD2EventSearches;
 static bool commands_enabled = false;
+// Component started and the [mqtt] enable setting last applied.
+static bool mqtt_started = false;
+static std::atomic<bool> mqtt_enabled(false);
+// Client restarts run on their own task outside the parser lock.
+static std::atomic<bool> mqtt_restart_requested(false);
+static std::atomic<bool> mqtt_restart_running(false);
+// Abbreviated keys and ~ base topic in discovery configs.
+static bool mqtt_compact_discovery = false;
+
+/**
+ * @brief Topic families also published as CBOR under {root}/cbor for
+ * consumers that do not need text. The JSON topics are always published.
+ */
+typedef enum {
+    MQTT_CBOR_PARTITIONS = 1 << 0,
+    MQTT_CBOR_ZONES = 1 << 1,
+    MQTT_CBOR_CID = 1 << 2
+} mqtt_cbor_family_t;
+
+static constexpr struct {
+    const char *name;
+    uint8_t bit;
+} mqtt_cbor_families[] = {
+    { "partitions", MQTT_CBOR_PARTITIONS },
+    { "zones", MQTT_CBOR_ZONES },
+    { "cid", MQTT_CBOR_CID },
+};
+// mqtt_cbor_family_t bits.
+static uint8_t mqtt_cbor = 0;
+
+// Retained state deduplication.
+static bool mqtt_dedup = true;
+static bool mqtt_alpha_topic = false;
+// Keys that do not count as a change on zone and partition topics.
+static std::vector<std::string> mqtt_ignore_keys;
+// mqtt_ignore_keys plus last_alpha_message when it has its own topic.
+static std::vector<std::string> mqtt_partition_ignore_keys;
+// CRC of topic -> hash of the significant content last published on it.
+static std::map<uint32_t, uint32_t> mqtt_published;
+static SemaphoreHandle_t mqtt_published_mutex = nullptr;
+static mqtt_stats_t mqtt_stats = {};
+
+/**
+ * @brief Home Assistant discovery is walked in this order.
+ */
+typedef enum {
+    MQTT_DISCOVERY_FIRMWARE = 0,
+    MQTT_DISCOVERY_PARTITIONS,
+    MQTT_DISCOVERY_ZONES,
+    MQTT_DISCOVERY_SWITCHES,
+    MQTT_DISCOVERY_DONE
+} mqtt_discovery_stage_t;
+
+/**
+ * @brief Result of publishing the discovery entity under the cursor.
+ */
+typedef enum {
+    MQTT_DISCOVERY_SENT = 0,    ///< enqueued and waiting for a PUBACK.
+    MQTT_DISCOVERY_UNCHANGED,   ///< broker has this payload already.
+    MQTT_DISCOVERY_BUSY,        ///< not sent. Try again later.
+    MQTT_DISCOVERY_NEXT_INDEX,  ///< no more entities at this index.
+    MQTT_DISCOVERY_NEXT_STAGE   ///< no more indexes in this stage.
+} mqtt_discovery_result_t;
+
+/**
+ * @brief One key and value of a discovery config.
+ */
+typedef struct mqtt_config_pair {
+    const char *key;
+    std::string value;
+} mqtt_config_pair_t;
+
+/**
+ * @brief Home Assistant abbreviation for a discovery config key.
+ */
+typedef struct mqtt_discovery_key {
+    const char *key;
+    const char *abbr;
+    bool topic;       // value is a topic and can use the ~ base.
+} mqtt_discovery_key_t;
+
+// Keys AD2IoT uses in discovery configs and their Home Assistant
+// abbreviations. Keys not listed are written as is.
+static constexpr mqtt_discovery_key_t mqtt_discovery_keys[] = {
+    { "availability_template", "avty_tpl",    false },
+    { "availability_topic",    "avty_t",      true  },
+    { "command_template",      "cmd_tpl",     false },
+    { "command_topic",         "cmd_t",       true  },
+    { "device_class",          "dev_cla",     false },
+    { "icon",                  "ic",          false },
+    { "object_id",             "obj_id",      false },
+    { "payload_arm_home",      "pl_arm_home", false },
+    { "payload_press",         "pl_prs",      false },
+    { "payload_trigger",       "pl_trig",     false },
+    { "state_topic",           "stat_t",      true  },
+    { "unique_id",             "uniq_id",     false },
+    { "value_template",        "val_tpl",     false },
+};
+
+/**
+ * @brief A discovery config waiting for its PUBACK.
+ */
+typedef struct mqtt_discovery_slot {
+    int msg_id;       // 0 when free.
+    uint32_t tkey;    // CRC of the topic.
+    uint32_t hash;    // CRC of the payload.
+    TickType_t sent;
+} mqtt_discovery_slot_t;
+
+/**
+ * @brief Discovery walk state. Guarded by mqtt_discovery_mutex.
+ */
+static struct {
+    uint8_t stage;
+    uint16_t index;   // partition, zone or switch list index.
+    uint8_t entity;   // entity within the index.
+    bool walking;
+    bool rewalk;      // a PUBACK was lost. Walk again at the end.
+    TickType_t started;
+    mqtt_discovery_slot_t inflight[MQTT_DISCOVERY_WINDOW];
+    // CRC of topic -> CRC of the payload the broker acknowledged.
+    std::map<uint32_t, uint32_t> acked;
+    // switch IDs with a search configured.
+    std::vector<uint8_t> switches;
+    uint32_t sent;
+    uint32_t unchanged;
+    uint32_t last_ms;
+} mqtt_discovery = {};
+static SemaphoreHandle_t mqtt_discovery_mutex = nullptr;
+
+/**
+ * @brief Every topic AD2IoT publishes on, built once for the current
+ * tprefix, dprefix and switches. Topics are NUL terminated strings in one
+ * arena found by offset. Offset 0 is an empty string and means the topic
+ * is not in the arena.
+ */
+typedef struct mqtt_topics {
+    std::string arena;
+    uint16_t root;        // {tprefix}ad2iot/{UUID}
+    uint16_t status;
+    uint16_t info;
+    uint16_t fw_version;
+    uint16_t cid;
+    uint16_t commands;
+    uint16_t ha_status;   // {dprefix}status
+    uint16_t cbor_root;   // {root}/cbor when any CBOR family is on.
+    uint16_t cbor_cid;
+    uint16_t partition[AD2_MAX_PARTITION + 1];
+    uint16_t alpha[AD2_MAX_PARTITION + 1];
+    uint16_t zone_delta[AD2_MAX_PARTITION + 1];  // zone batching only.
+    uint16_t zone[AD2_MAX_ZONES + 1];       // configured [zone N] only.
+    uint16_t sw[AD2_MAX_SWITCHES + 1];      // configured switches only.
+    uint16_t cbor_partition[AD2_MAX_PARTITION + 1];
+    uint16_t cbor_zone[AD2_MAX_ZONES + 1];  // configured [zone N] only.
+    uint16_t cbor_zone_delta[AD2_MAX_PARTITION + 1];
+
+    const char *get(uint16_t off) const
+    {
+        return arena.c_str() + off;
+    }
+
+    /**
+     * @brief Topic of entity n in tab. If it is not in the arena it is
+     * formatted into buf as {root}/{sub}/{n}.
+     */
+    template <size_t N, size_t L>
+    const char *entity(const uint16_t (&tab)[N], int n, const char *sub, char (&buf)[L]) const
+    {
+        if (n >= 0 && n < (int)N && tab[n]) {
+            return get(tab[n]);
+        }
+        snprintf(buf, L, "%s/%s/%d", get(root), sub, n);
+        return buf;
+    }
+} mqtt_topics_t;
+typedef std::shared_ptr<const mqtt_topics_t> mqtt_topics_ptr;
+static mqtt_topics_ptr mqtt_topics;
+static SemaphoreHandle_t mqtt_topics_mutex = nullptr;
+
+/**
+ * @brief uSD outbox record. The file is a header followed by
+ * MQTT_OUTBOX_RECORDS of these. Only the used part of data is written.
+ * A record with seq 0 is free.
+ */
+typedef struct mqtt_outbox_rec {
+    uint32_t magic;
+    uint32_t crc;             // crc32 of everything after crc up to the payload end.
+    uint32_t seq;             // publish order, never 0 while in use.
+    uint32_t tkey;            // CRC of the topic.
+    uint8_t qos;
+    uint8_t retain;
+    uint8_t collapse;         // state. A newer publish on the topic replaces it.
+    uint8_t reserved;
+    uint16_t topic_len;       // topic in data without its NUL.
+    uint16_t length;          // payload after the topic NUL.
+    char data[MQTT_OUTBOX_RECORD_SIZE - 24];
+} __attribute__((packed)) mqtt_outbox_rec_t;
+static_assert(sizeof(mqtt_outbox_rec_t) == MQTT_OUTBOX_RECORD_SIZE, "outbox record size");
+
+typedef struct mqtt_outbox_hdr {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t crc;
+} mqtt_outbox_hdr_t;
+
+/**
+ * @brief In RAM summary of an outbox record so scans do not read the card.
+ */
+typedef struct mqtt_outbox_meta {
+    uint32_t seq;
+    uint32_t tkey;
+    bool collapse;
+    int msg_id;               // replayed and waiting for a PUBACK.
+} mqtt_outbox_meta_t;
+
+#define MQTT_OUTBOX_MAGIC 0x4f324441 // "AD2O"
+
+/**
+ * @brief Outbox state. Guarded by mqtt_outbox_mutex. A publish takes any
+ * free record. Records are replayed in seq order so a state replaced by
+ * a newer one leaves a hole that is used again at once.
+ */
+static struct {
+    FILE *file;
+    mqtt_outbox_rec_t *rec;   // record I/O buffer.
+    std::vector<mqtt_outbox_meta_t> meta;
+    uint32_t cursor;          // where to look for a free record next.
+    uint32_t next_seq;
+    bool connected;
+    uint32_t depth;           // records in use.
+    uint32_t spooled;
+    uint32_t collapsed;
+    uint32_t replayed;
+    uint32_t session;         // replayed since the last connect.
+    uint32_t dropped;
+    uint32_t write_errors;
+} mqtt_outbox = {};
+static SemaphoreHandle_t mqtt_outbox_mutex = nullptr;
+
+/**
+ * @brief A zone change waiting to be published.
+ */
+typedef struct mqtt_zone_change {
+    ad2_json_zone_event_t ev;  // latest change.
+    uint16_t changes;          // changes not yet published.
+    TickType_t published;      // zone topic: last update.
+} mqtt_zone_change_t;
+
+/**
+ * @brief Zone changes of one partition gathered into one delta.
+ */
+typedef struct mqtt_zone_delta {
+    TickType_t opened;         // first change in the window.
+    std::vector<mqtt_zone_change_t> zones;
+} mqtt_zone_delta_t;
+
+/**
+ * @brief Zone batching state. Guarded by mqtt_zone_batch_mutex. Deltas
+ * close at the first parser read that starts window_ms or more after
+ * they opened. Zone topics catch up every update_ms.
+ */
+static struct {
+    int32_t window_ms;        // -1 off.
+    uint32_t update_ms;
+    std::map<uint8_t, mqtt_zone_delta_t> deltas;   // by partition.
+    std::map<uint8_t, mqtt_zone_change_t> zones;   // by zone.
+    uint32_t due;             // zones whose topic is behind.
+} mqtt_zone_batch = { -1, MQTT_ZONE_UPDATE_MS };
+static SemaphoreHandle_t mqtt_zone_batch_mutex = nullptr;
 
 // prefix name lines to identy the source. User can change.
 #define NAME_PREFIX "AD2IoT"
 
-// Default MQTT message settings excluding LWT.
-#define MQTT_DEF_QOS    1 // AT Least Once
-#define MQTT_DEF_RETAIN 1 // Retain
-#define MQTT_DEF_STORE  0 // No local storage
+// Default MQTT message settings excluding LWT.
+#define MQTT_DEF_QOS    1 // AT Least Once
+#define MQTT_DEF_RETAIN 1 // Retain
+#define MQTT_DEF_STORE  0 // No local storage
+
+// LOG settings
+//#define MQTT_EVENT_LOGGING
+
+#if 0
+/**
+ * @brief custom outbox handler
+ *  see: MQTT_CUSTOM_OUTBOX
+ *
+ */
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
+{
+    outbox_item_handle_t item = outbox_get(outbox, msg_id);
+    if (item) {
+        item->pending = pending;
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+#endif
+
+
+/**
+ * @brief Non blocking publish on the current client. The client is held
+ * for the call so a restart on another task can not destroy it under the
+ * publish. No lock is taken as event handlers publish while the client
+ * holds its own.
+ *
+ * @return int msg_id, or -1 if there is no client or its queue is full.
+ */
+static int _mqtt_enqueue(const char *topic, const char *data, int len, int qos, int retain)
+{
+    mqtt_client_users++;
+    esp_mqtt_client_handle_t client = mqtt_client;
+    int msg_id = client ? esp_mqtt_client_enqueue(client, topic, data, len, qos, retain, MQTT_DEF_STORE) : -1;
+    mqtt_client_users--;
+    return msg_id;
+}
+
+/**
+ * @brief Bytes of an outbox record that are written to the card.
+ */
+static size_t _mqtt_outbox_used(const mqtt_outbox_rec_t &rec)
+{
+    return offsetof(mqtt_outbox_rec_t, data) + rec.topic_len + 1 + rec.length;
+}
+
+static uint32_t _mqtt_outbox_crc(const mqtt_outbox_rec_t &rec)
+{
+    const uint8_t *p = (const uint8_t *)&rec + offsetof(mqtt_outbox_rec_t, seq);
+    return esp_rom_crc32_le(0, p, _mqtt_outbox_used(rec) - offsetof(mqtt_outbox_rec_t, seq));
+}
+
+/**
+ * @brief Write the first len bytes of outbox record idx.
+ * Caller holds mqtt_outbox_mutex.
+ *
+ * @param [in]sync bool fsync after writing. Frees are not synced. A free
+ * lost to a power cut only sends that record twice.
+ */
+static bool _mqtt_outbox_write(uint32_t idx, const void *data, size_t len, bool sync)
+{
+    long pos = (long)(sizeof(mqtt_outbox_hdr_t) + idx * sizeof(mqtt_outbox_rec_t));
+    bool ok = fseek(mqtt_outbox.file, pos, SEEK_SET) == 0 &&
+              fwrite(data, 1, len, mqtt_outbox.file) == len &&
+              fflush(mqtt_outbox.file) == 0 &&
+              (!sync || fsync(fileno(mqtt_outbox.file)) == 0);
+    if (!ok) {
+        mqtt_outbox.write_errors++;
+    }
+    return ok;
+}
+
+/**
+ * @brief Read outbox record idx into mqtt_outbox.rec and check it.
+ * Caller holds mqtt_outbox_mutex.
+ *
+ * @return bool false if the record is free or damaged.
+ */
+static bool _mqtt_outbox_read(uint32_t idx)
+{
+    mqtt_outbox_rec_t &rec = *mqtt_outbox.rec;
+    long pos = (long)(sizeof(mqtt_outbox_hdr_t) + idx * sizeof(mqtt_outbox_rec_t));
+    size_t hdr = offsetof(mqtt_outbox_rec_t, data);
+    if (fseek(mqtt_outbox.file, pos, SEEK_SET) != 0 ||
+            fread(&rec, 1, hdr, mqtt_outbox.file) != hdr) {
+        return false;
+    }
+    size_t n = (size_t)rec.topic_len + 1 + rec.length;
+    if (rec.magic != MQTT_OUTBOX_MAGIC || !rec.seq || n > sizeof(rec.data)) {
+        return false;
+    }
+    return fread(rec.data, 1, n, mqtt_outbox.file) == n &&
+           rec.crc == _mqtt_outbox_crc(rec) && rec.data[rec.topic_len] == 0;
+}
+
+/**
+ * @brief Free outbox record idx. Caller holds mqtt_outbox_mutex.
+ */
+static void _mqtt_outbox_free(uint32_t idx)
+{
+    static const uint8_t empty[offsetof(mqtt_outbox_rec_t, data)] = {};
+    mqtt_outbox.meta[idx] = {};
+    _mqtt_outbox_write(idx, empty, sizeof(empty), false);
+    mqtt_outbox.depth--;
+}
+
+/**
+ * @brief Find the oldest record that is not waiting for a PUBACK and is
+ * newer than after. Caller holds mqtt_outbox_mutex.
+ *
+ * @return int index or -1.
+ */
+static int _mqtt_outbox_oldest(uint32_t after)
+{
+    int best = -1;
+    for (uint32_t idx = 0; idx < mqtt_outbox.meta.size(); idx++) {
+        const mqtt_outbox_meta_t &m = mqtt_outbox.meta[idx];
+        if (m.seq > after && !m.msg_id && (best < 0 || m.seq < mqtt_outbox.meta[best].seq)) {
+            best = idx;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Open the outbox file on the uSD card. Records left from before a
+ * restart are kept for replay. Their order comes from the record sequence
+ * numbers so the header is only written when the file is created.
+ */
+static void _mqtt_outbox_open()
+{
+    if (!g_uSD_mounted) {
+        ESP_LOGW(TAG, "MQTT outbox needs a uSD card. Using the client outbox in RAM.");
+        return;
+    }
+    mqtt_outbox.rec = (mqtt_outbox_rec_t *)malloc(sizeof(mqtt_outbox_rec_t));
+    if (!mqtt_outbox.rec) {
+        return;
+    }
+    FILE *file = fopen(MQTT_OUTBOX_PATH, "r+b");
+    if (!file) {
+        file = fopen(MQTT_OUTBOX_PATH, "w+b");
+    }
+    if (!file) {
+        ESP_LOGE(TAG, "MQTT outbox %s open failed.", MQTT_OUTBOX_PATH);
+        free(mqtt_outbox.rec);
+        mqtt_outbox.rec = nullptr;
+        return;
+    }
+    mqtt_outbox.file = file;
+    mqtt_outbox.meta.assign(MQTT_OUTBOX_RECORDS, mqtt_outbox_meta_t());
+
+    mqtt_outbox_hdr_t hdr = {};
+    bool valid = fread(&hdr, 1, sizeof(hdr), file) == sizeof(hdr) &&
+                 hdr.magic == MQTT_OUTBOX_MAGIC && hdr.capacity == MQTT_OUTBOX_RECORDS &&
+                 hdr.crc == esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(mqtt_outbox_hdr_t, crc));
+    if (!valid) {
+        // new or damaged outbox. Allocate the whole ring up front.
+        hdr = { MQTT_OUTBOX_MAGIC, MQTT_OUTBOX_RECORDS, 0 };
+        hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(mqtt_outbox_hdr_t, crc));
+        memset(mqtt_outbox.rec, 0, sizeof(mqtt_outbox_rec_t));
+        fseek(file, 0, SEEK_SET);
+        fwrite(&hdr, 1, sizeof(hdr), file);
+        for (uint32_t idx = 0; idx < MQTT_OUTBOX_RECORDS; idx++) {
+            fwrite(mqtt_outbox.rec, 1, sizeof(mqtt_outbox_rec_t), file);
+        }
+        fflush(file);
+        fsync(fileno(file));
+    }
+
+    uint32_t hi = 0;
+    for (uint32_t idx = 0; valid && idx < MQTT_OUTBOX_RECORDS; idx++) {
+        if (_mqtt_outbox_read(idx)) {
+            const mqtt_outbox_rec_t &rec = *mqtt_outbox.rec;
+            mqtt_outbox.meta[idx] = { rec.seq, rec.tkey, rec.collapse != 0, 0 };
+            mqtt_outbox.depth++;
+            if (rec.seq >= hi) {
+                hi = rec.seq;
+                mqtt_outbox.cursor = (idx + 1) % MQTT_OUTBOX_RECORDS;
+            }
+        }
+    }
+    mqtt_outbox.next_seq = hi + 1;
+    if (mqtt_outbox.depth) {
+        ESP_LOGI(TAG, "MQTT outbox %s has %lu publishes to replay", MQTT_OUTBOX_PATH, (unsigned long)mqtt_outbox.depth);
+    }
+}
+
+/**
+ * @brief Replay outbox records in order until MQTT_OUTBOX_WINDOW are
+ * waiting for a PUBACK. A record is freed when the broker acknowledges it.
+ * A replayed record is only sent again once the client has dropped it,
+ * on MQTT_EVENT_DELETED or when the client is destroyed. Until then the
+ * client resends it itself so no duplicate is made here.
+ */
+static void _mqtt_outbox_pump()
+{
+    if (!mqtt_outbox_mutex) {
+        return;
+    }
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    if (!mqtt_outbox.file || !mqtt_outbox.connected || !mqtt_client) {
+        xSemaphoreGive(mqtt_outbox_mutex);
+        return;
+    }
+
+    int inflight = 0;
+    for (auto &m : mqtt_outbox.meta) {
+        inflight += (m.seq && m.msg_id) ? 1 : 0;
+    }
+
+    uint32_t after = 0;
+    int idx;
+    while (inflight < MQTT_OUTBOX_WINDOW && (idx = _mqtt_outbox_oldest(after)) >= 0) {
+        mqtt_outbox_meta_t &m = mqtt_outbox.meta[idx];
+        after = m.seq;
+        if (!_mqtt_outbox_read(idx) || mqtt_outbox.rec->seq != m.seq) {
+            ESP_LOGW(TAG, "MQTT outbox record %d is damaged. Dropped.", idx);
+            mqtt_outbox.dropped++;
+            _mqtt_outbox_free(idx);
+            continue;
+        }
+        const mqtt_outbox_rec_t &rec = *mqtt_outbox.rec;
+        int msg_id = _mqtt_enqueue(rec.data,
+                                   rec.data + rec.topic_len + 1,
+                                   rec.length,
+                                   rec.qos,
+                                   rec.retain);
+        if (msg_id <= 0) {
+            // Client queue is full. Retry on the next PUBACK.
+            break;
+        }
+        m.msg_id = msg_id;
+        inflight++;
+    }
+    xSemaphoreGive(mqtt_outbox_mutex);
+}
+
+/**
+ * @brief Write a QoS 1 publish to the outbox while the broker is away, or
+ * while older publishes still wait so the order is kept. A state publish
+ * replaces any waiting state on the same topic that is not in flight.
+ *
+ * @param [in]topic const char * topic.
+ * @param [in]data const char * payload.
+ * @param [in]len size_t payload length.
+ * @param [in]qos int.
+ * @param [in]retain int.
+ * @param [in]collapse bool only the latest publish on the topic matters.
+ *
+ * @return bool true if the outbox took the publish.
+ */
+static bool _mqtt_outbox_put(const char *topic, const char *data, size_t len,
+                             int qos, int retain, bool collapse)
+{
+    if (!mqtt_outbox_mutex || !qos) {
+        return false;
+    }
+    size_t topic_len = strlen(topic);
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    if (!mqtt_outbox.file || (mqtt_outbox.connected && !mqtt_outbox.depth) ||
+            topic_len + 1 + len > sizeof(mqtt_outbox.rec->data)) {
+        // Nothing waiting, or too big for a record. Use the client outbox.
+        xSemaphoreGive(mqtt_outbox_mutex);
+        return false;
+    }
+
+    uint32_t tkey = esp_rom_crc32_le(0, (const uint8_t *)topic, topic_len);
+    if (collapse) {
+        for (uint32_t idx = 0; idx < MQTT_OUTBOX_RECORDS; idx++) {
+            const mqtt_outbox_meta_t &m = mqtt_outbox.meta[idx];
+            if (m.seq && m.collapse && !m.msg_id && m.tkey == tkey) {
+                mqtt_outbox.collapsed++;
+                _mqtt_outbox_free(idx);
+            }
+        }
+    }
+    if (mqtt_outbox.depth == MQTT_OUTBOX_RECORDS) {
+        ESP_LOGW(TAG, "MQTT outbox full, dropping the oldest publish");
+        mqtt_outbox.dropped++;
+        int oldest = -1;
+        for (uint32_t idx = 0; idx < MQTT_OUTBOX_RECORDS; idx++) {
+            if (oldest < 0 || mqtt_outbox.meta[idx].seq < mqtt_outbox.meta[oldest].seq) {
+                oldest = idx;
+            }
+        }
+        _mqtt_outbox_free(oldest);
+    }
+
+    // Take the next free record after the last one written.
+    uint32_t idx = mqtt_outbox.cursor;
+    while (mqtt_outbox.meta[idx].seq) {
+        idx = (idx + 1) % MQTT_OUTBOX_RECORDS;
+    }
+    mqtt_outbox_rec_t &rec = *mqtt_outbox.rec;
+    rec.magic = MQTT_OUTBOX_MAGIC;
+    rec.seq = mqtt_outbox.next_seq++;
+    if (!mqtt_outbox.next_seq) {
+        mqtt_outbox.next_seq = 1;
+    }
+    rec.tkey = tkey;
+    rec.qos = qos;
+    rec.retain = retain;
+    rec.collapse = collapse;
+    rec.reserved = 0;
+    rec.topic_len = topic_len;
+    rec.length = len;
+    memcpy(rec.data, topic, topic_len + 1);
+    memcpy(rec.data + topic_len + 1, data, len);
+    rec.crc = _mqtt_outbox_crc(rec);
+    bool ok = _mqtt_outbox_write(idx, &rec, _mqtt_outbox_used(rec), true);
+    if (ok) {
+        mqtt_outbox.meta[idx] = { rec.seq, tkey, collapse, 0 };
+        mqtt_outbox.cursor = (idx + 1) % MQTT_OUTBOX_RECORDS;
+        mqtt_outbox.depth++;
+        mqtt_outbox.spooled++;
+    }
+    bool connected = mqtt_outbox.connected;
+    xSemaphoreGive(mqtt_outbox_mutex);
+
+    if (ok && connected) {
+        _mqtt_outbox_pump();
+    }
+    return ok;
+}
+
+/**
+ * @brief MQTT_EVENT_PUBLISHED. Free an acknowledged replay and send
+ * the next.
+ *
+ * @param [in]msg_id int.
+ */
+static void _mqtt_outbox_ack(int msg_id)
+{
+    if (!mqtt_outbox_mutex || msg_id <= 0) {
+        return;
+    }
+    bool found = false;
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    for (uint32_t idx = 0; idx < mqtt_outbox.meta.size(); idx++) {
+        if (mqtt_outbox.meta[idx].seq && mqtt_outbox.meta[idx].msg_id == msg_id) {
+            _mqtt_outbox_free(idx);
+            mqtt_outbox.replayed++;
+            mqtt_outbox.session++;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(mqtt_outbox_mutex);
+    if (found) {
+        _mqtt_outbox_pump();
+    }
+}
+
+/**
+ * @brief MQTT_EVENT_DELETED. The client outbox expired a replayed record
+ * without a PUBACK. Send it again from the card in its place.
+ *
+ * @param [in]msg_id int.
+ */
+static void _mqtt_outbox_expired(int msg_id)
+{
+    if (!mqtt_outbox_mutex || msg_id <= 0) {
+        return;
+    }
+    bool found = false;
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    for (auto &m : mqtt_outbox.meta) {
+        if (m.seq && m.msg_id == msg_id) {
+            m.msg_id = 0;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(mqtt_outbox_mutex);
+    if (found) {
+        _mqtt_outbox_pump();
+    }
+}
+
+/**
+ * @brief Track the broker connection for the outbox.
+ *
+ * @param [in]connected bool.
+ * @param [in]forget bool the client was destroyed and its msg_ids with it.
+ */
+static void _mqtt_outbox_set_connected(bool connected, bool forget)
+{
+    if (!mqtt_outbox_mutex) {
+        return;
+    }
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    mqtt_outbox.connected = connected;
+    // Otherwise the client sends in flight records again itself on
+    // reconnect. Wait for its PUBACK.
+    if (forget) {
+        for (auto &m : mqtt_outbox.meta) {
+            m.msg_id = 0;
+        }
+    }
+    if (connected) {
+        mqtt_outbox.session = 0;
+    }
+    xSemaphoreGive(mqtt_outbox_mutex);
+}
+
+/**
+ * @brief Publish a QoS 1 document that is not deduplicated. It goes
+ * through the outbox while the outbox is holding publishes.
+ *
+ * @param [in]topic const char * topic.
+ * @param [in]data const char * payload.
+ * @param [in]len size_t payload length.
+ * @param [in]retain int.
+ * @param [in]collapse bool only the latest publish on the topic matters.
+ *
+ * @return bool true if the client or outbox took it.
+ */
+static bool _mqtt_publish_event(const char *topic, const char *data, size_t len,
+                                int retain, bool collapse)
+{
+    if (_mqtt_outbox_put(topic, data, len, MQTT_DEF_QOS, retain, collapse)) {
+        return true;
+    }
+    // Non blocking. We must not block AlarmDecoderParser
+    return _mqtt_enqueue(topic,
+                         data,
+                         len,
+                         MQTT_DEF_QOS,
+                         retain) >= 0;
+}
+
+/**
+ * @brief Publish a state document unless the content that matters has
+ * not changed since it was last published on this topic.
+ *
+ * @param [in]topic const char * topic.
+ * @param [in]data const char * payload.
+ * @param [in]len size_t payload length.
+ * @param [in]qos int.
+ * @param [in]retain int.
+ * @param [in]skip std::vector<std::string> * keys that are not significant.
+ *
+ * @return int msg_id, 0 if spooled, MQTT_PUBLISH_SUPPRESSED if unchanged
+ * or -1 on error.
+ */
+static int _mqtt_publish_state(const char *topic, const char *data, size_t len,
+                               int qos, int retain, const std::vector<std::string> *skip)
+{
+    // Hash under the lock. A settings reload can replace skip.
+    uint32_t tkey = esp_rom_crc32_le(0, (const uint8_t *)topic, strlen(topic));
+    uint32_t hash = 0;
+    bool dedup;
+    xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+    dedup = mqtt_dedup;
+    if (dedup) {
+        hash = ad2_json_hash_members(data, len, skip);
+        auto it = mqtt_published.find(tkey);
+        if (it != mqtt_published.end() && it->second == hash) {
+            mqtt_stats.suppressed++;
+            xSemaphoreGive(mqtt_published_mutex);
+            return MQTT_PUBLISH_SUPPRESSED;
+        }
+    }
+    xSemaphoreGive(mqtt_published_mutex);
+
+    // Broker away. Keep it on the uSD card for replay.
+    int msg_id = 0;
+    bool spooled = _mqtt_outbox_put(topic, data, len, qos, retain, true);
+    if (!spooled) {
+        // Non blocking. We must not block AlarmDecoderParser
+        msg_id = _mqtt_enqueue(topic,
+                               data,
+                               len,
+                               qos,
+                               retain);
+    }
+    if (msg_id >= 0) {
+        xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+        if (dedup) {
+            mqtt_published[tkey] = hash;
+        }
+        if (!spooled) {
+            mqtt_stats.sent++;
+        }
+        xSemaphoreGive(mqtt_published_mutex);
+    }
+    return msg_id;
+}
+
+/**
+ * @brief Publish the CBOR copy of a document. Written by the same schema
+ * as the JSON copy. Call after the JSON copy was published so it follows
+ * the same change detection.
+ *
+ * @param [in]topic const char * topic under {root}/cbor.
+ * @param [in]retain int.
+ * @param [in]collapse bool only the latest publish on the topic matters.
+ * @param [in]fill callable taking AD2JsonWriter &.
+ */
+template <typename F>
+static void _mqtt_publish_cbor(const char *topic, int retain, bool collapse, F fill)
+{
+    AD2JsonBuffer<768> cbor(AD2_JSON_FORMAT_CBOR);
+    const char *data = cbor.render(fill);
+    if (!data) {
+        return;
+    }
+    if (_mqtt_publish_event(topic, data, cbor.length(), retain, collapse)) {
+        xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+        mqtt_stats.cbor_sent++;
+        xSemaphoreGive(mqtt_published_mutex);
+    }
+}
+
+/**
+ * @brief Forget what was published. Everything is sent again once.
+ */
+static void _mqtt_clear_published()
+{
+    if (mqtt_published_mutex) {
+        xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+        mqtt_published.clear();
+        xSemaphoreGive(mqtt_published_mutex);
+    }
+}
+
+/**
+ * @brief Load the [mqtt] state deduplication settings. Takes effect
+ * without a restart.
+ */
+static void _mqtt_load_dedup_settings()
+{
+    bool dedup = true;
+    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_DEDUP_SUBCMD, &dedup);
+    bool alpha = false;
+    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_ALPHA_SUBCMD, &alpha);
+    std::string ignore;
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_IGNORE_SUBCMD, ignore);
+    std::vector<std::string> keys;
+    ad2_tokenize(ignore, ", ", keys);
+
+    if (mqtt_published_mutex) {
+        xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+    }
+    mqtt_dedup = dedup;
+    mqtt_alpha_topic = alpha;
+    mqtt_ignore_keys = keys;
+    mqtt_partition_ignore_keys = keys;
+    if (alpha) {
+        mqtt_partition_ignore_keys.push_back("last_alpha_message");
+    }
+    mqtt_published.clear();
+    if (mqtt_published_mutex) {
+        xSemaphoreGive(mqtt_published_mutex);
+    }
+}
+
+/**
+ * @brief Load the [mqtt] cbor topic families. Rebuild the topics after.
+ */
+static void _mqtt_load_cbor_settings()
+{
+    std::string families;
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_CBOR_SUBCMD, families);
+    std::vector<std::string> names;
+    ad2_tokenize(families, ", ", names);
+    uint8_t bits = 0;
+    for (auto &name : names) {
+        ad2_lcase(name);
+        for (const auto &f : mqtt_cbor_families) {
+            if (name == f.name) {
+                bits |= f.bit;
+            }
+        }
+    }
+    mqtt_cbor = bits;
+}
+
+/**
+ * @brief Load the [mqtt] zonebatch setting '<window ms> [<zone topic ms>]'.
+ * Empty turns zone batching off. Rebuild the topics after.
+ */
+static void _mqtt_load_zone_batch_settings()
+{
+    std::string arg;
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_ZONEBATCH_SUBCMD, arg);
+    std::vector<std::string> args;
+    ad2_tokenize(arg, ", ", args);
+    int32_t window_ms = -1;
+    uint32_t update_ms = MQTT_ZONE_UPDATE_MS;
+    if (args.size() > 0) {
+        window_ms = std::max(0, atoi(args[0].c_str()));
+    }
+    if (args.size() > 1) {
+        update_ms = std::max(0, atoi(args[1].c_str()));
+    }
+
+    if (mqtt_zone_batch_mutex) {
+        xSemaphoreTake(mqtt_zone_batch_mutex, portMAX_DELAY);
+    }
+    mqtt_zone_batch.window_ms = window_ms;
+    mqtt_zone_batch.update_ms = update_ms;
+    if (mqtt_zone_batch_mutex) {
+        xSemaphoreGive(mqtt_zone_batch_mutex);
+    }
+}
+
+/**
+ * @brief Get publish stats.
+ *
+ * @param [out]stats mqtt_stats_t *.
+ */
+void mqtt_get_stats(mqtt_stats_t *stats)
+{
+    if (!mqtt_published_mutex) {
+        *stats = {};
+        return;
+    }
+    xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+    *stats = mqtt_stats;
+    stats->topics = mqtt_published.size();
+    xSemaphoreGive(mqtt_published_mutex);
+
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    stats->discovery_sent = mqtt_discovery.sent;
+    stats->discovery_unchanged = mqtt_discovery.unchanged;
+    stats->discovery_inflight = 0;
+    for (auto &sl : mqtt_discovery.inflight) {
+        if (sl.msg_id) {
+            stats->discovery_inflight++;
+        }
+    }
+    stats->discovery_walking = mqtt_discovery.walking;
+    stats->discovery_ms = mqtt_discovery.last_ms;
+    xSemaphoreGive(mqtt_discovery_mutex);
+
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    stats->outbox_open = mqtt_outbox.file != nullptr;
+    stats->outbox_depth = mqtt_outbox.depth;
+    stats->outbox_capacity = mqtt_outbox.file ? MQTT_OUTBOX_RECORDS : 0;
+    stats->outbox_inflight = 0;
+    for (auto &m : mqtt_outbox.meta) {
+        if (m.seq && m.msg_id) {
+            stats->outbox_inflight++;
+        }
+    }
+    stats->outbox_spooled = mqtt_outbox.spooled;
+    stats->outbox_collapsed = mqtt_outbox.collapsed;
+    stats->outbox_replayed = mqtt_outbox.replayed;
+    stats->outbox_session = mqtt_outbox.session;
+    stats->outbox_dropped = mqtt_outbox.dropped;
+    stats->outbox_write_errors = mqtt_outbox.write_errors;
+    xSemaphoreGive(mqtt_outbox_mutex);
+
+    xSemaphoreTake(mqtt_zone_batch_mutex, portMAX_DELAY);
+    stats->zone_batch = mqtt_zone_batch.window_ms >= 0;
+    xSemaphoreGive(mqtt_zone_batch_mutex);
+}
+
+/**
+ * @brief Enqueue one discovery config unless the broker already
+ * acknowledged the same payload on this topic or it is still in flight.
+ * Call with mqtt_discovery_mutex held.
+ *
+ * @param [in]topic std::string config topic.
+ * @param [in]data const char * payload.
+ * @param [in]len size_t payload length.
+ *
+ * @return mqtt_discovery_result_t
+ */
+static mqtt_discovery_result_t _mqtt_publish_discovery(const std::string &topic, const char *data, size_t len)
+{
+    uint32_t tkey = esp_rom_crc32_le(0, (const uint8_t *)topic.data(), topic.length());
+    uint32_t hash = esp_rom_crc32_le(0, (const uint8_t *)data, len);
+
+    auto it = mqtt_discovery.acked.find(tkey);
+    if (it != mqtt_discovery.acked.end() && it->second == hash) {
+        mqtt_discovery.unchanged++;
+        return MQTT_DISCOVERY_UNCHANGED;
+    }
+
+    mqtt_discovery_slot_t *slot = nullptr;
+    for (auto &sl : mqtt_discovery.inflight) {
+        if (sl.msg_id && sl.tkey == tkey && sl.hash == hash) {
+            // Sent before a reconnect. The client outbox resends it.
+            mqtt_discovery.unchanged++;
+            return MQTT_DISCOVERY_UNCHANGED;
+        }
+        if (!sl.msg_id && !slot) {
+            slot = &sl;
+        }
+    }
+    if (!slot) {
+        return MQTT_DISCOVERY_BUSY;
+    }
 
-// LOG settings
-//#define MQTT_EVENT_LOGGING
+    // non blocking publish
+    int msg_id = _mqtt_enqueue(topic.c_str(),
+                               data,
+                               len,
+                               MQTT_DEF_QOS,
+                               MQTT_DEF_RETAIN);
+    if (msg_id <= 0) {
+        return MQTT_DISCOVERY_BUSY;
+    }
+    slot->msg_id = msg_id;
+    slot->tkey = tkey;
+    slot->hash = hash;
+    slot->sent = xTaskGetTickCount();
+    mqtt_discovery.sent++;
+    return MQTT_DISCOVERY_SENT;
+}
 
-#if 0
 /**
- * @brief custom outbox handler
- *  see: MQTT_CUSTOM_OUTBOX
+ * @brief Get the current topic table. Holding the pointer keeps it
+ * valid across a rebuild.
  *
+ * @return mqtt_topics_ptr or empty if not built yet.
  */
-esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
+static mqtt_topics_ptr _mqtt_get_topics()
 {
-    outbox_item_handle_t item = outbox_get(outbox, msg_id);
-    if (item) {
-        item->pending = pending;
-        return ESP_OK;
+    if (!mqtt_topics_mutex) {
+        return nullptr;
     }
-    return ESP_FAIL;
+    xSemaphoreTake(mqtt_topics_mutex, portMAX_DELAY);
+    mqtt_topics_ptr t = mqtt_topics;
+    xSemaphoreGive(mqtt_topics_mutex);
+    return t;
+}
+
+/**
+ * @brief Build the topic table for the loaded prefixes, switches and
+ * configured zones and make it current.
+ */
+static void _mqtt_build_topics()
+{
+    if (!mqtt_topics_mutex) {
+        return;
+    }
+    std::vector<uint8_t> switches;
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    switches = mqtt_discovery.switches;
+    xSemaphoreGive(mqtt_discovery_mutex);
+
+    std::shared_ptr<mqtt_topics_t> t = std::make_shared<mqtt_topics_t>();
+    *t = {};
+    std::string &a = t->arena;
+    std::string root = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/" + mqttclient_UUID;
+
+    // Offset 0 is the empty string.
+    a.push_back('\0');
+    auto add = [&](const char *fmt, const char *s, int n) -> uint16_t {
+        char buf[MQTT_TOPIC_MAX];
+        int len = snprintf(buf, sizeof(buf), fmt, s, n);
+        if (len <= 0 || len >= (int)sizeof(buf) || a.length() + len + 1 > UINT16_MAX) {
+            return 0;
+        }
+        uint16_t off = a.length();
+        a.append(buf, len + 1);
+        return off;
+    };
+    t->root = add("%s", root.c_str(), 0);
+    t->status = add("%s/status", root.c_str(), 0);
+    t->info = add("%s/info", root.c_str(), 0);
+    t->fw_version = add("%s/fw_version", root.c_str(), 0);
+    t->cid = add("%s/cid", root.c_str(), 0);
+    t->commands = add("%s/" MQTT_COMMANDS_TOPIC, root.c_str(), 0);
+    if (mqttclient_DPREFIX.length()) {
+        t->ha_status = add("%s" MQTT_HA_STATUS_TOPIC, mqttclient_DPREFIX.c_str(), 0);
+    }
+    for (int n = 1; n <= AD2_MAX_PARTITION; n++) {
+        t->partition[n] = add("%s/partitions/%d", root.c_str(), n);
+        t->alpha[n] = add("%s/partitions/%d/alpha", root.c_str(), n);
+        if (mqtt_zone_batch.window_ms >= 0) {
+            t->zone_delta[n] = add("%s/partitions/%d/" MQTT_ZONE_DELTA_TOPIC, root.c_str(), n);
+        }
+    }
+    for (int zn = 1; zn <= AD2_MAX_ZONES; zn++) {
+        std::string tmp;
+        if (AD2Parse.getZoneType(zn, tmp) || AD2Parse.getZoneString(zn, tmp)) {
+            t->zone[zn] = add("%s/zones/%d", root.c_str(), zn);
+        }
+    }
+    for (uint8_t swid : switches) {
+        t->sw[swid] = add("%s/switches/%d", root.c_str(), swid);
+    }
+    if (mqtt_cbor) {
+        t->cbor_root = add("%s/" MQTT_CBOR_TOPIC, root.c_str(), 0);
+    }
+    if (mqtt_cbor & MQTT_CBOR_CID) {
+        t->cbor_cid = add("%s/" MQTT_CBOR_TOPIC "/cid", root.c_str(), 0);
+    }
+    for (int n = 1; (mqtt_cbor & MQTT_CBOR_PARTITIONS) && n <= AD2_MAX_PARTITION; n++) {
+        t->cbor_partition[n] = add("%s/" MQTT_CBOR_TOPIC "/partitions/%d", root.c_str(), n);
+    }
+    for (int zn = 1; (mqtt_cbor & MQTT_CBOR_ZONES) && zn <= AD2_MAX_ZONES; zn++) {
+        if (t->zone[zn]) {
+            t->cbor_zone[zn] = add("%s/" MQTT_CBOR_TOPIC "/zones/%d", root.c_str(), zn);
+        }
+    }
+    for (int n = 1; (mqtt_cbor & MQTT_CBOR_ZONES) && n <= AD2_MAX_PARTITION; n++) {
+        if (t->zone_delta[n]) {
+            t->cbor_zone_delta[n] = add("%s/" MQTT_CBOR_TOPIC "/partitions/%d/" MQTT_ZONE_DELTA_TOPIC, root.c_str(), n);
+        }
+    }
+    a.shrink_to_fit();
+
+    xSemaphoreTake(mqtt_topics_mutex, portMAX_DELAY);
+    mqtt_topics = t;
+    xSemaphoreGive(mqtt_topics_mutex);
 }
-#endif
 
+/**
+ * @brief Find a discovery config key in mqtt_discovery_keys.
+ *
+ * @param [in]key const char * full key name.
+ *
+ * @return const mqtt_discovery_key_t * or nullptr if it has no abbreviation.
+ */
+static const mqtt_discovery_key_t *_mqtt_discovery_key(const char *key)
+{
+    for (const auto &k : mqtt_discovery_keys) {
+        if (strcmp(k.key, key) == 0) {
+            return &k;
+        }
+    }
+    return nullptr;
+}
 
 /**
  * @brief helper to send config json for auto discovery.
@@ -113,15 +1236,16 @@ esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t
  * @param [in]id_append_id - bool - append id to [unique|object]_id fields
  * @param [in]name - const char * - name
  * @param [in]name_append_id - bool - append id to name field
- * @param [in]pairs - std::map<std::string,std::string> - attributes to add to config.
+ * @param [in]pairs - mqtt_config_pair_t list - attributes to add to config
+ * in the order given.
+ *
+ * @return mqtt_discovery_result_t
  */
-void mqtt_publish_device_config(const char *device_type, const char *device_class,
-                                const char *ad2type, uint8_t id, bool id_append_id,
-                                const char* name, bool name_append_id,
-                                std::map<std::string, std::string> pairs)
+mqtt_discovery_result_t mqtt_publish_device_config(const char *device_type, const char *device_class,
+        const char *ad2type, uint8_t id, bool id_append_id,
+        const char* name, bool name_append_id,
+        std::initializer_list<mqtt_config_pair_t> pairs)
 {
-    cJSON *root = cJSON_CreateObject();
-
     // if id > 0 append id else no ID
     std::string szid;
     if (id_append_id) {
@@ -133,7 +1257,7 @@ void mqtt_publish_device_config(const char *device_type, const char *device_clas
     if (name_append_id) {
         value += std::to_string(id);
     }
-    cJSON_AddStringToObject(root, "name", value.c_str());
+    std::string display_name = value;
 
     // unique_id ad2iot_{ad2type}[_{id}]
     // object_id ad2iot_{ad2type}[_{id}]
@@ -147,20 +1271,50 @@ void mqtt_publish_device_config(const char *device_type, const char *device_clas
     // mqttclient_UUID last block 6 hex bytes.
     std::string uuid = mqttclient_UUID.substr(mqttclient_UUID.size() - 12);
     uuid += "-" + value;
-    cJSON_AddStringToObject(root, "unique_id", uuid.c_str());
-    cJSON_AddStringToObject(root, "object_id", value.c_str());
 
-    // set the device class
-    cJSON_AddStringToObject(root, "device_class", device_class);
-
-    // add the name value pairs
-    for (const auto& kv : pairs) {
-        cJSON_AddStringToObject(root, kv.first.c_str(), kv.second.c_str());
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (!t) {
+        return MQTT_DISCOVERY_BUSY;
     }
 
-    // compress json and convert to char *
-    char *szjson = cJSON_Print(root);
-    cJSON_Minify(szjson);
+    // Device base topic. Replaced by ~ in compact configs.
+    const char *base = t->get(t->root);
+    size_t base_len = strlen(base);
+    bool compact = mqtt_compact_discovery;
+
+    // Write one member using the abbreviated key if compact.
+    auto member = [&](AD2JsonWriter &w, const char *key, const std::string &v) {
+        const mqtt_discovery_key_t *k = compact ? _mqtt_discovery_key(key) : nullptr;
+        if (!k) {
+            w.add(key, v);
+        } else if (k->topic && v.compare(0, base_len, base) == 0) {
+            w.add(k->abbr, "~" + v.substr(base_len));
+        } else {
+            w.add(k->abbr, v);
+        }
+    };
+
+    AD2JsonBuffer<768> json;
+    const char *szjson = json.render([&](AD2JsonWriter &w) {
+        w.object();
+        if (compact) {
+            w.add("~", base);
+        }
+        w.add("name", display_name);
+        member(w, "unique_id", uuid);
+        member(w, "object_id", value);
+
+        // set the device class
+        member(w, "device_class", device_class);
+
+        // add the name value pairs
+        for (const auto& kv : pairs) {
+            member(w, kv.key, kv.value);
+        }
+    });
+    if (!szjson) {
+        return MQTT_DISCOVERY_BUSY;
+    }
 
     // set the correct topic for the config document
     std::string topic = "";
@@ -177,91 +1331,85 @@ void mqtt_publish_device_config(const char *device_type, const char *device_clas
     }
     topic += "/config";
 
-    // non blocking publish
-    esp_mqtt_client_enqueue(mqtt_client,
-                            topic.c_str(),
-                            szjson,
-                            0,
-                            MQTT_DEF_QOS,
-                            MQTT_DEF_RETAIN,
-                            MQTT_DEF_STORE);
-
-    // cleanup free memory
-    cJSON_free(szjson);
-    cJSON_Delete(root);
+    return _mqtt_publish_discovery(topic, szjson, json.length());
 }
 
 /**
- * @brief helper to send config json for a given partition.
+ * @brief helper to send one config json for a given partition.
+ *
+ * @param [in]s AD2PartitionState *.
+ * @param [in]entity uint8_t entity 0 to 3 of the partition.
  *
+ * @return mqtt_discovery_result_t MQTT_DISCOVERY_NEXT_INDEX past the last entity.
  */
-void mqtt_send_partition_config(AD2PartitionState *s)
+mqtt_discovery_result_t mqtt_send_partition_config(AD2PartitionState *s, uint8_t entity)
 {
 
-    // Partiting number string.
-    std::string szpid = std::to_string(s->partition);
-
-    // Base topic for device
-    std::string topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (!t) {
+        return MQTT_DISCOVERY_BUSY;
+    }
+    char buf[MQTT_TOPIC_MAX];
 
-    // alarm_control_panel
-    std::string command_template = ad2_string_printf("{ \"partition\": %i, \"action\": \"{{ action }}\", \"code\": \"{{ code }}\"}", s->partition);
     std::string uuid_prefix = NAME_PREFIX;
     uuid_prefix += "(";
     uuid_prefix += mqttclient_UUID.substr(mqttclient_UUID.size() - 4);
     uuid_prefix += ")";
-    std::string tmpstr = uuid_prefix + " Partition #";
-    mqtt_publish_device_config("alarm_control_panel", "alarm_control_panel", "p",
-                               s->partition, true,
-    tmpstr.c_str(), true, {{
-            { "state_topic", topic+"/partitions/"+szpid },
-            { "value_template", "{% if value_json.alarm_sounding == true or value_json.alarm_event_occurred == true %}triggered{% elif value_json.armed_stay == true %}{% if value_json.entry_delay_off == true %}armed_night{% else %}armed_home{% endif %}{% elif value_json.armed_away == true %}{% if value_json.entry_delay_off == true %}armed_vacation{% elif value_json.entry_delay_off == false %}armed_away{% endif %}{% else %}disarmed{% endif %}" },
-            { "command_topic", topic+"/commands"},
-            { "command_template", command_template.c_str()},
-            { "availability_topic", topic+"/status"},
+    std::string tmpstr;
+
+    switch (entity) {
+    case 0: {
+        // alarm_control_panel
+        std::string command_template = ad2_string_printf("{ \"partition\": %i, \"action\": \"{{ action }}\", \"code\": \"{{ code }}\"}", s->partition);
+        tmpstr = uuid_prefix + " Partition #";
+        return mqtt_publish_device_config("alarm_control_panel", "alarm_control_panel", "p",
+                                          s->partition, true,
+        tmpstr.c_str(), true, {
+            { "availability_topic", t->get(t->status)},
             { "code", "REMOTE_CODE"},
+            { "command_template", command_template},
+            { "command_topic", t->get(t->commands)},
+            { "icon", "mdi:shield-home"},
             { "payload_arm_home", "ARM_STAY"},
             { "payload_trigger", "PANIC_ALARM"},
-            { "icon", "mdi:shield-home"},
-            { "sw_version", ad2_firmware_version()}
-        }
-    });
-
-
-    // ac_power
-    tmpstr = uuid_prefix + " AC Power";
-    mqtt_publish_device_config("binary_sensor", "power", "ac_power",
-                               0, false,
-    tmpstr.c_str(), false, {{
-            { "state_topic", topic+"/partitions/"+szpid },
-            { "value_template", "{% if value_json.ac_power == true %}ON{% else %}OFF{% endif %}" },
-            { "availability_topic", topic+"/status"}
-        }
-    });
-
-    // partition fire
-    tmpstr = uuid_prefix + " Fire Partition #";
-    mqtt_publish_device_config("binary_sensor", "smoke", "fire_p",
-                               s->partition, true,
-    tmpstr.c_str(), true, {{
-            { "state_topic", topic+"/partitions/"+szpid },
-            { "value_template", "{% if value_json.fire_alarm == true %}ON{% else %}OFF{% endif %}" },
-            { "availability_topic", topic+"/status"}
-        }
-    });
-
-    // partition chime
-    tmpstr = uuid_prefix + " Chime Mode Partition #";
-    mqtt_publish_device_config("binary_sensor", "running", "chime_p",
-                               s->partition, true,
-    tmpstr.c_str(), true, {{
-            { "state_topic", topic+"/partitions/"+szpid },
-            { "value_template", "{% if value_json.chime_on == true %}ON{% else %}OFF{% endif %}" },
-            { "availability_topic", topic+"/status"}
-        }
-    });
-
+            { "state_topic", t->entity(t->partition, s->partition, "partitions", buf) },
+            { "sw_version", ad2_firmware_version()},
+            { "value_template", "{% if value_json.alarm_sounding == true or value_json.alarm_event_occurred == true %}triggered{% elif value_json.armed_stay == true %}{% if value_json.entry_delay_off == true %}armed_night{% else %}armed_home{% endif %}{% elif value_json.armed_away == true %}{% if value_json.entry_delay_off == true %}armed_vacation{% elif value_json.entry_delay_off == false %}armed_away{% endif %}{% else %}disarmed{% endif %}" }
+        });
+    }
+    case 1:
+        // ac_power
+        tmpstr = uuid_prefix + " AC Power";
+        return mqtt_publish_device_config("binary_sensor", "power", "ac_power",
+                                          0, false,
+        tmpstr.c_str(), false, {
+            { "availability_topic", t->get(t->status)},
+            { "state_topic", t->entity(t->partition, s->partition, "partitions", buf) },
+            { "value_template", "{% if value_json.ac_power == true %}ON{% else %}OFF{% endif %}" }
+        });
+    case 2:
+        // partition fire
+        tmpstr = uuid_prefix + " Fire Partition #";
+        return mqtt_publish_device_config("binary_sensor", "smoke", "fire_p",
+                                          s->partition, true,
+        tmpstr.c_str(), true, {
+            { "availability_topic", t->get(t->status)},
+            { "state_topic", t->entity(t->partition, s->partition, "partitions", buf) },
+            { "value_template", "{% if value_json.fire_alarm == true %}ON{% else %}OFF{% endif %}" }
+        });
+    case 3:
+        // partition chime
+        tmpstr = uuid_prefix + " Chime Mode Partition #";
+        return mqtt_publish_device_config("binary_sensor", "running", "chime_p",
+                                          s->partition, true,
+        tmpstr.c_str(), true, {
+            { "availability_topic", t->get(t->status)},
+            { "state_topic", t->entity(t->partition, s->partition, "partitions", buf) },
+            { "value_template", "{% if value_json.chime_on == true %}ON{% else %}OFF{% endif %}" }
+        });
+    default:
+        return MQTT_DISCOVERY_NEXT_INDEX;
+    }
 }
 
 /**
@@ -270,64 +1418,57 @@ void mqtt_send_partition_config(AD2PartitionState *s)
  */
 void mqtt_send_fw_version(const char *available_version)
 {
-    int msg_id;
-    if (mqtt_client != nullptr) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/fw_version";
-
-        cJSON *root = cJSON_CreateObject();
-        cJSON_AddStringToObject(root, "installed", ad2_firmware_version());
-        cJSON_AddStringToObject(root, "available", available_version);
-
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (mqtt_client != nullptr && t) {
+
+        AD2JsonBuffer<128> json;
+        const char *state = json.render([&](AD2JsonWriter &w) {
+            w.object();
+            w.add("installed", ad2_firmware_version());
+            w.add("available", available_version);
+        });
+        if (!state) {
+            return;
+        }
 
         // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
-
-        cJSON_free(state);
-        cJSON_Delete(root);
+        _mqtt_enqueue(t->get(t->fw_version),
+                      state,
+                      json.length(),
+                      MQTT_DEF_QOS,
+                      MQTT_DEF_RETAIN);
     }
 }
 
 /**
- * @brief helper to send config json for every configured [zone N].
+ * @brief helper to send config json for one configured [zone N].
+ *
+ * @param [in]zn int zone number.
  *
- * TODO: This and other mqtt_client_enqueue calls will stack up
- * a lot of memory for larger systems. This should instead be
- * put into an efficient task list to be processed over time
- * as resources are available. In this design it saves all of the
- * JSON data and more for each enqueue.
+ * @return mqtt_discovery_result_t MQTT_DISCOVERY_NEXT_INDEX if the zone
+ * has no type and alpha configured.
  */
-void mqtt_send_configured_zone_configs()
+mqtt_discovery_result_t mqtt_send_zone_config(int zn)
 {
-    // set base topic for zones sub topic
-    std::string topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
+    std::string _type;
+    std::string _alpha;
+    if ( !AD2Parse.getZoneType(zn, _type) || !AD2Parse.getZoneString(zn, _alpha) ) {
+        return MQTT_DISCOVERY_NEXT_INDEX;
+    }
 
-    for (int zn = 1; zn <= AD2_MAX_ZONES; zn++) {
-        std::string _type;
-        if ( AD2Parse.getZoneType(zn, _type) ) {
-            std::string _alpha;
-            if ( AD2Parse.getZoneString(zn, _alpha) ) {
-                mqtt_publish_device_config("binary_sensor", _type.c_str(), "zone_",
-                                           zn, true,
-                _alpha.c_str(), false, {{
-                        { "state_topic", topic+"/zones/"+std::to_string(zn) },
-                        { "value_template", "{% if value_json.state == 'CLOSE' %}OFF{% else %}ON{% endif %}" },
-                        { "availability_topic", topic+"/status"}
-                    }
-                });
-            }
-        }
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (!t) {
+        return MQTT_DISCOVERY_BUSY;
     }
+    char buf[MQTT_TOPIC_MAX];
+
+    return mqtt_publish_device_config("binary_sensor", _type.c_str(), "zone_",
+                                      zn, true,
+    _alpha.c_str(), false, {
+        { "availability_topic", t->get(t->status)},
+        { "state_topic", t->entity(t->zone, zn, "zones", buf) },
+        { "value_template", "{% if value_json.state == 'CLOSE' %}OFF{% else %}ON{% endif %}" }
+    });
 }
 
 /**
@@ -342,61 +1483,366 @@ void mqtt_send_configured_zone_configs()
 void mqtt_on_ad2cfg(std::string *msg, AD2PartitionState *s, void *arg)
 {
     if (mqtt_client != nullptr) {
+        mqtt_topics_ptr t = _mqtt_get_topics();
+        if (!t) {
+            return;
+        }
+        xSemaphoreTake(mqtt_zone_batch_mutex, portMAX_DELAY);
+        int32_t window_ms = mqtt_zone_batch.window_ms;
+        uint32_t update_ms = mqtt_zone_batch.update_ms;
+        xSemaphoreGive(mqtt_zone_batch_mutex);
         // Publish our device HW/FW info.
-        cJSON *root = ad2_get_ad2iot_device_info_json();
-        std::string topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        topic += mqttclient_UUID;
-        topic += "/info";
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
+        AD2JsonBuffer<512> json;
+        const char *state = json.render([&](AD2JsonWriter &w) {
+            w.object();
+            ad2_json_device_info(w);
+            // Advertise the topic families with a CBOR copy.
+            if (t->cbor_root) {
+                w.object("cbor");
+                w.add("topic", t->get(t->cbor_root));
+                w.array("families");
+                for (const auto &f : mqtt_cbor_families) {
+                    if (mqtt_cbor & f.bit) {
+                        w.add(nullptr, f.name);
+                    }
+                }
+                w.end();
+                w.end();
+            }
+            // Advertise zone batching.
+            if (window_ms >= 0) {
+                char buf[MQTT_TOPIC_MAX];
+                snprintf(buf, sizeof(buf), "%s/partitions/+/" MQTT_ZONE_DELTA_TOPIC, t->get(t->root));
+                w.object("zone_batch");
+                w.add("topic", buf);
+                w.add("window_ms", window_ms);
+                w.add("update_ms", update_ms);
+                w.end();
+            }
+        });
+        if (!state) {
+            return;
+        }
 
         // non blocking.
-        esp_mqtt_client_enqueue(mqtt_client,
-                                topic.c_str(),
-                                state,
-                                0,
-                                MQTT_DEF_QOS,
-                                MQTT_DEF_RETAIN,
-                                MQTT_DEF_STORE);
-        cJSON_free(state);
+        _mqtt_enqueue(t->get(t->info),
+                      state,
+                      json.length(),
+                      MQTT_DEF_QOS,
+                      MQTT_DEF_RETAIN);
+    }
+}
+
+/**
+ * @brief helper to send one firmware config json.
+ *
+ * @param [in]entity uint8_t 0 update sensor, 1 update button.
+ *
+ * @return mqtt_discovery_result_t MQTT_DISCOVERY_NEXT_INDEX past the last entity.
+ */
+mqtt_discovery_result_t mqtt_send_firmware_config(uint8_t entity)
+{
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (!t) {
+        return MQTT_DISCOVERY_BUSY;
+    }
+    std::string uuid_prefix = NAME_PREFIX;
+    uuid_prefix += "(";
+    uuid_prefix += mqttclient_UUID.substr(mqttclient_UUID.size() - 4);
+    uuid_prefix += ")";
+    std::string tmpstr;
+
+    switch (entity) {
+    case 0:
+        tmpstr = uuid_prefix + " Firmware";
+        return mqtt_publish_device_config("binary_sensor", "update", "fw_version",
+                                          0, false,
+        tmpstr.c_str(), false, {
+            { "availability_topic", t->get(t->status)},
+            { "state_topic", t->get(t->fw_version) },
+            { "value_template", "{% if value_json.installed != value_json.available %}ON{% else %}OFF{% endif %}" }
+        });
+    case 1:
+        tmpstr = uuid_prefix + " Start ad2iot firmware update";
+        return mqtt_publish_device_config("button", "update", "fw_update",
+                                          0, false,
+        tmpstr.c_str(), false, {
+            { "availability_template", "{% if value_json.installed != value_json.available %}online{% else %}offline{% endif %}" },
+            { "availability_topic", t->get(t->fw_version) },
+            { "command_topic", t->get(t->commands) },
+            { "payload_press", "{\"action\": \"FW_UPDATE_IOT\"}" }
+        });
+    default:
+        return MQTT_DISCOVERY_NEXT_INDEX;
+    }
+}
+
+/**
+ * @brief helper to send config json for one virtual switch.
+ *
+ * @param [in]swid int virtual switch ID.
+ *
+ * @return mqtt_discovery_result_t
+ */
+mqtt_discovery_result_t mqtt_send_switch_config(int swid)
+{
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (!t) {
+        return MQTT_DISCOVERY_BUSY;
+    }
+    char buf[MQTT_TOPIC_MAX];
+
+    std::string description = "NA";
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION,
+                              MQTT_SWITCH_SUBCMD,
+                              description,
+                              swid,
+                              MQTT_CONFIG_SWITCH_SUFFIX_DESCRIPTION);
+
+    cJSON * root   = cJSON_Parse(description.c_str());
+
+    // default to type door and generic value_template
+    std::string _type = "door";
+    std::string _name = "N/A";
+    std::string _value_template = "{{value_json.state}}";
+
+    if (root) {
+        cJSON *otype = cJSON_GetObjectItemCaseSensitive(root, "type");
+        if ( cJSON_IsString(otype) ) {
+            _type = otype->valuestring;
+        }
+
+        cJSON *oname = cJSON_GetObjectItemCaseSensitive(root, "name");
+        if ( cJSON_IsString(oname) ) {
+            _name = oname->valuestring;
+        }
+
+        cJSON *ovalue_template = cJSON_GetObjectItemCaseSensitive(root, "value_template");
+        if ( cJSON_IsString(ovalue_template) ) {
+            _value_template = ovalue_template->valuestring;
+        }
+
         cJSON_Delete(root);
     }
+
+    return mqtt_publish_device_config(
+               "binary_sensor", _type.c_str(), "switch_",
+               swid, true,
+    _name.c_str(), false, {
+        { "availability_topic", t->get(t->status) },
+        { "state_topic", t->entity(t->sw, swid, "switches", buf) },
+        { "value_template", _value_template }
+    });
+}
+
+/**
+ * @brief Publish the discovery entity under the cursor.
+ *
+ * @return mqtt_discovery_result_t
+ */
+static mqtt_discovery_result_t _mqtt_discovery_entity()
+{
+    uint16_t index = mqtt_discovery.index;
+    switch (mqtt_discovery.stage) {
+    case MQTT_DISCOVERY_FIRMWARE:
+        if (index) {
+            return MQTT_DISCOVERY_NEXT_STAGE;
+        }
+        return mqtt_send_firmware_config(mqtt_discovery.entity);
+    case MQTT_DISCOVERY_PARTITIONS: {
+        // each partition configured with the 'partition' command.
+        if (index >= AD2_MAX_PARTITION) {
+            return MQTT_DISCOVERY_NEXT_STAGE;
+        }
+        AD2PartitionState *s = ad2_get_partition_state(index + 1);
+        if (!s) {
+            return MQTT_DISCOVERY_NEXT_INDEX;
+        }
+        return mqtt_send_partition_config(s, mqtt_discovery.entity);
+    }
+    case MQTT_DISCOVERY_ZONES:
+        if (index >= AD2_MAX_ZONES) {
+            return MQTT_DISCOVERY_NEXT_STAGE;
+        }
+        if (mqtt_discovery.entity) {
+            return MQTT_DISCOVERY_NEXT_INDEX;
+        }
+        return mqtt_send_zone_config(index + 1);
+    case MQTT_DISCOVERY_SWITCHES:
+        if (index >= mqtt_discovery.switches.size()) {
+            return MQTT_DISCOVERY_NEXT_STAGE;
+        }
+        if (mqtt_discovery.entity) {
+            return MQTT_DISCOVERY_NEXT_INDEX;
+        }
+        return mqtt_send_switch_config(mqtt_discovery.switches[index]);
+    default:
+        return MQTT_DISCOVERY_NEXT_STAGE;
+    }
+}
+
+/**
+ * @brief Move the cursor to the first entity. Call with
+ * mqtt_discovery_mutex held.
+ */
+static void _mqtt_discovery_rewind()
+{
+    if (!mqtt_discovery.walking) {
+        mqtt_discovery.started = xTaskGetTickCount();
+    }
+    mqtt_discovery.walking = true;
+    mqtt_discovery.rewalk = false;
+    mqtt_discovery.stage = MQTT_DISCOVERY_FIRMWARE;
+    mqtt_discovery.index = 0;
+    mqtt_discovery.entity = 0;
+}
+
+/**
+ * @brief Publish discovery entities until MQTT_DISCOVERY_WINDOW are
+ * waiting for a PUBACK or the walk is done. Entities the broker already
+ * has are skipped without a publish.
+ */
+static void _mqtt_discovery_pump()
+{
+    if (!mqtt_discovery_mutex) {
+        return;
+    }
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+
+    // Give up on lost PUBACKs. The outbox dropped them so walk again.
+    int inflight = 0;
+    TickType_t now = xTaskGetTickCount();
+    for (auto &sl : mqtt_discovery.inflight) {
+        if (sl.msg_id && (now - sl.sent) >= pdMS_TO_TICKS(MQTT_DISCOVERY_ACK_TIMEOUT_MS)) {
+            sl.msg_id = 0;
+            mqtt_discovery.rewalk = true;
+        }
+        if (sl.msg_id) {
+            inflight++;
+        }
+    }
+
+    while (mqtt_client && mqtt_discovery.walking && inflight < MQTT_DISCOVERY_WINDOW) {
+        if (mqtt_discovery.stage >= MQTT_DISCOVERY_DONE) {
+            if (!mqtt_discovery.rewalk) {
+                break;
+            }
+            _mqtt_discovery_rewind();
+        }
+        mqtt_discovery_result_t res = _mqtt_discovery_entity();
+        if (res == MQTT_DISCOVERY_BUSY) {
+            // Client queue is full. Retry on the next PUBACK.
+            break;
+        } else if (res == MQTT_DISCOVERY_NEXT_STAGE) {
+            mqtt_discovery.stage++;
+            mqtt_discovery.index = 0;
+            mqtt_discovery.entity = 0;
+        } else if (res == MQTT_DISCOVERY_NEXT_INDEX) {
+            mqtt_discovery.index++;
+            mqtt_discovery.entity = 0;
+        } else {
+            if (res == MQTT_DISCOVERY_SENT) {
+                inflight++;
+            }
+            mqtt_discovery.entity++;
+        }
+    }
+
+    // Done once the cursor is at the end and the broker has everything.
+    if (mqtt_discovery.walking && mqtt_discovery.stage >= MQTT_DISCOVERY_DONE &&
+            !mqtt_discovery.rewalk && !inflight) {
+        mqtt_discovery.walking = false;
+        mqtt_discovery.last_ms = (xTaskGetTickCount() - mqtt_discovery.started) * portTICK_PERIOD_MS;
+        ESP_LOGI(TAG, "Discovery done in %lu ms. %lu sent, %lu unchanged.",
+                 mqtt_discovery.last_ms, mqtt_discovery.sent, mqtt_discovery.unchanged);
+    }
+    xSemaphoreGive(mqtt_discovery_mutex);
+}
+
+/**
+ * @brief Start a discovery walk and publish the first window.
+ *
+ * @param [in]forget bool if true resend everything. Used when the broker
+ * or Home Assistant may have lost the retained configs.
+ */
+static void _mqtt_discovery_start(bool forget)
+{
+    if (!mqtt_discovery_mutex) {
+        return;
+    }
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    if (forget) {
+        mqtt_discovery.acked.clear();
+    }
+    _mqtt_discovery_rewind();
+    xSemaphoreGive(mqtt_discovery_mutex);
+    _mqtt_discovery_pump();
+}
+
+/**
+ * @brief MQTT_EVENT_PUBLISHED. Remember what the broker acknowledged
+ * and publish the next discovery entity.
+ *
+ * @param [in]msg_id int.
+ */
+static void _mqtt_discovery_ack(int msg_id)
+{
+    if (!mqtt_discovery_mutex) {
+        return;
+    }
+    bool found = false;
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    for (auto &sl : mqtt_discovery.inflight) {
+        if (sl.msg_id && sl.msg_id == msg_id) {
+            mqtt_discovery.acked[sl.tkey] = sl.hash;
+            sl.msg_id = 0;
+            found = true;
+            break;
+        }
+    }
+    bool walking = mqtt_discovery.walking;
+    xSemaphoreGive(mqtt_discovery_mutex);
+    if (found || walking) {
+        _mqtt_discovery_pump();
+    }
 }
 
 /**
  * @brief Callback for MQTT_EVENT_CONNECTED event.
  * Preform subscribe to commands and initial publish to status and info.
+ * Discovery configs follow a few at a time as the broker acknowledges them.
  *
  * @param [in]client esp_mqtt_client_handle_t
  */
 void mqtt_on_connect(esp_mqtt_client_handle_t client)
 {
-    std::string topic;
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (!t) {
+        return;
+    }
 
     // Subscribe to command inputs for remote control if enabled.
     if (commands_enabled) {
         ESP_LOGI(TAG, "Warning! MQTT commands subscription enabled. This is NOT secure on public servers!");
-        topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        topic += mqttclient_UUID;
-        topic += "/" MQTT_COMMANDS_TOPIC;
         esp_mqtt_client_subscribe(client,
-                                  topic.c_str(),
+                                  t->get(t->commands),
                                   MQTT_DEF_QOS);
     }
 
-    // Publish we are Online
-    topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
-    topic += "/status";
+    // Home Assistant birth message. Resend discovery when it restarts.
+    if (t->ha_status) {
+        esp_mqtt_client_subscribe(client,
+                                  t->get(t->ha_status),
+                                  MQTT_DEF_QOS);
+    }
 
+    // Publish we are Online
     // non blocking.
-    esp_mqtt_client_enqueue(mqtt_client,
-                            topic.c_str(),
-                            "online",
-                            0,
-                            MQTT_DEF_QOS,
-                            MQTT_DEF_RETAIN,
-                            MQTT_DEF_STORE);
+    _mqtt_enqueue(t->get(t->status),
+                  "online",
+                  0,
+                  MQTT_DEF_QOS,
+                  MQTT_DEF_RETAIN);
 
     // Publish our device HW/FW info.
     mqtt_on_ad2cfg(nullptr, nullptr, nullptr);
@@ -404,98 +1850,207 @@ void mqtt_on_connect(esp_mqtt_client_handle_t client)
     // set available version to current for now. Will be updated if new version available.
     mqtt_send_fw_version(ad2_firmware_version());
 
-    // Send firmware_update config
-    topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
+    // Replay publishes the outbox kept while the broker was away.
+    _mqtt_outbox_pump();
 
-    std::string uuid_prefix = NAME_PREFIX;
-    uuid_prefix += "(";
-    uuid_prefix += mqttclient_UUID.substr(mqttclient_UUID.size() - 4);
-    uuid_prefix += ")";
-    std::string tmpstr = uuid_prefix + " Firmware";
+    // Walk the firmware, partition, zone and switch discovery configs.
+    // Entities the broker acknowledged before a reconnect are skipped.
+    _mqtt_discovery_start(false);
+}
 
-    mqtt_publish_device_config("binary_sensor", "update", "fw_version",
-                               0, false,
-    tmpstr.c_str(), false, {{
-            { "state_topic", topic+"/fw_version" },
-            { "value_template", "{% if value_json.installed != value_json.available %}ON{% else %}OFF{% endif %}" },
-            { "availability_topic", topic+"/status"}
-        }
-    });
+/**
+ * @brief Actions accepted on the commands topic.
+ */
+typedef enum {
+    MQTT_ACTION_DISARM = 0,
+    MQTT_ACTION_ARM_STAY,
+    MQTT_ACTION_ARM_AWAY,
+    MQTT_ACTION_EXIT,
+    MQTT_ACTION_CHIME_TOGGLE,
+    MQTT_ACTION_AUX_ALARM,
+    MQTT_ACTION_PANIC_ALARM,
+    MQTT_ACTION_FIRE_ALARM,
+    MQTT_ACTION_BYPASS,
+    MQTT_ACTION_SEND_RAW,
+    MQTT_ACTION_FW_UPDATE_IOT,
+    MQTT_ACTION_FW_UPDATE_AD2,
+    MQTT_ACTION_FW_CONFIG_IOT
+} mqtt_action_t;
+
+static constexpr struct {
+    const char *name;
+    mqtt_action_t action;
+} mqtt_actions[] = {
+    { "DISARM", MQTT_ACTION_DISARM },
+    { "ARM_STAY", MQTT_ACTION_ARM_STAY },
+    { "ARM_AWAY", MQTT_ACTION_ARM_AWAY },
+    { "EXIT", MQTT_ACTION_EXIT },
+    { "CHIME_TOGGLE", MQTT_ACTION_CHIME_TOGGLE },
+    { "AUX_ALARM", MQTT_ACTION_AUX_ALARM },
+    { "PANIC_ALARM", MQTT_ACTION_PANIC_ALARM },
+    { "FIRE_ALARM", MQTT_ACTION_FIRE_ALARM },
+    { "BYPASS", MQTT_ACTION_BYPASS },
+    { "SEND_RAW", MQTT_ACTION_SEND_RAW },
+    { "FW_UPDATE_IOT", MQTT_ACTION_FW_UPDATE_IOT },
+    { "FW_UPDATE_AD2", MQTT_ACTION_FW_UPDATE_AD2 },
+    { "FW_CONFIG_IOT", MQTT_ACTION_FW_CONFIG_IOT },
+};
+
+// Command rate limit. Credit in ms, MQTT_COMMAND_RATE_MS per command.
+// Only the MQTT task uses it.
+static struct {
+    uint32_t credit_ms;
+    TickType_t last;
+} mqtt_command_bucket = { MQTT_COMMAND_RATE_MS * MQTT_COMMAND_BURST, 0 };
+
+/**
+ * @brief Take one command from the rate limit bucket.
+ *
+ * @return false if commands are arriving faster than the limit.
+ */
+static bool _mqtt_command_take()
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t elapsed = (now - mqtt_command_bucket.last) * portTICK_PERIOD_MS;
+    uint32_t full = MQTT_COMMAND_RATE_MS * MQTT_COMMAND_BURST;
+    mqtt_command_bucket.last = now;
+    mqtt_command_bucket.credit_ms = elapsed >= full ? full : std::min(mqtt_command_bucket.credit_ms + elapsed, full);
+    if (mqtt_command_bucket.credit_ms < MQTT_COMMAND_RATE_MS) {
+        return false;
+    }
+    mqtt_command_bucket.credit_ms -= MQTT_COMMAND_RATE_MS;
+    return true;
+}
+
+/**
+ * @brief Handle one message on the commands topic.
+ *
+ * @details The size is checked before anything is copied and the payload
+ * is read in place into fixed storage without a cJSON document. Accepted
+ * commands are formatted onto the AD2_SEND_SRC_MQTT command queue and
+ * written by the AD2 command writer task, so the MQTT task never waits on
+ * the panel. Firmware updates start their own task. Fire, panic and aux
+ * alarms are never rate limited. A command the queue did not take is
+ * counted as dropped.
+ *
+ * @param [in]event esp_mqtt_event_handle_t.
+ */
+static void _mqtt_on_command(esp_mqtt_event_handle_t event)
+{
+    // {
+    //   partition: {{ number partition ID see ```partition``` command. }},
+    //   code: '{{ string code }}',
+    //   action: '{{ string action }}',
+    //   arg: '{{ string argument }}'
+    // }
+    int32_t partId = 1; // default partition
+    char code[MQTT_COMMAND_CODE_LEN] = "";
+    char action[16] = "";
+    char arg[MQTT_COMMAND_ARG_LEN] = "";
+    ad2_json_member_t members[] = {
+        { "partition", AD2_JSON_MEMBER_INT, nullptr, 0, &partId, false },
+        { "code", AD2_JSON_MEMBER_STRING, code, sizeof(code), nullptr, false },
+        { "action", AD2_JSON_MEMBER_STRING, action, sizeof(action), nullptr, false },
+        { "arg", AD2_JSON_MEMBER_STRING, arg, sizeof(arg), nullptr, false },
+    };
+
+    // A payload larger than the client buffer arrives in pieces. Count it
+    // once, on the first piece.
+    if ( event->current_data_offset ) {
+        return;
+    }
 
-    tmpstr = uuid_prefix + " Start ad2iot firmware update";
-    mqtt_publish_device_config("button", "update", "fw_update",
-                               0, false,
-    tmpstr.c_str(), false, {{
-            { "availability_topic", topic+"/fw_version" },
-            { "availability_template", "{% if value_json.installed != value_json.available %}online{% else %}offline{% endif %}" },
-            { "command_topic", topic+"/commands" },
-            { "payload_press", "{\"action\": \"FW_UPDATE_IOT\"}" }
+    int found = -1;
+    uint32_t mqtt_stats_t::*rejected = nullptr;
+    if ( event->retain ) {
+        // We only want fresh messages no recordings.
+        rejected = &mqtt_stats_t::commands_retained;
+    } else if ( event->data_len <= 0 || event->data_len >= MQTT_COMMAND_MAX_DATA_LEN ||
+                event->data_len != event->total_data_len ) {
+        ESP_LOGI(TAG, "invalid data len");
+        rejected = &mqtt_stats_t::commands_bad_size;
+    } else if ( !ad2_json_read_members(event->data, event->data_len, members, ARRAY_SIZE(members)) ) {
+        ESP_LOGI(TAG, "json parse error '%.*s'", event->data_len, event->data);
+        rejected = &mqtt_stats_t::commands_bad_json;
+    } else {
+        for (int n = 0; n < ARRAY_SIZE(mqtt_actions) && found < 0; n++) {
+            if (strcmp(action, mqtt_actions[n].name) == 0) {
+                found = n;
+            }
         }
-    });
-
-    // Publish panel config info for home assistant or others for discovery
-    // for each partition that is configured with 'partition' command.
-    for (int n = 1; n <= AD2_MAX_PARTITION; n++) {
-        AD2PartitionState *s = ad2_get_partition_state(n);
-        if (s) {
-            mqtt_send_partition_config(s);
+        if (found < 0) {
+            ESP_LOGI(TAG, "unknown action '%s'", action);
+            rejected = &mqtt_stats_t::commands_bad_action;
+        } else if (mqtt_actions[found].action != MQTT_ACTION_FIRE_ALARM &&
+                   mqtt_actions[found].action != MQTT_ACTION_PANIC_ALARM &&
+                   mqtt_actions[found].action != MQTT_ACTION_AUX_ALARM && !_mqtt_command_take()) {
+            ESP_LOGD(TAG, "command rate limit. %s dropped", action);
+            rejected = &mqtt_stats_t::commands_rate_limited;
         }
     }
 
-    // Send all [zone N] descriptions
-    mqtt_send_configured_zone_configs();
-
-    // Send virtual switches in mqtt_AD2EventSearches
-    topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
-    for (auto &sw : mqtt_AD2EventSearches) {
-        // Grab the topic using the virtusal switch ID pre saved into INT_ARG
-        std::string description = "NA";
-        std::string key = std::string(MQTT_SWITCH_SUBCMD);
-        ad2_get_config_key_string(MQTT_CONFIG_SECTION,
-                                  MQTT_SWITCH_SUBCMD,
-                                  description,
-                                  sw->INT_ARG,
-                                  MQTT_CONFIG_SWITCH_SUFFIX_DESCRIPTION);
-
-        cJSON * root   = cJSON_Parse(description.c_str());
-
-        // default to type door and generic value_template
-        std::string _type = "door";
-        std::string _name = "N/A";
-        std::string _value_template = "{{value_json.state}}";
-
-        if (root) {
-            cJSON *otype = cJSON_GetObjectItemCaseSensitive(root, "type");
-            if ( cJSON_IsString(otype) ) {
-                _type = otype->valuestring;
-            }
-
-            cJSON *oname = cJSON_GetObjectItemCaseSensitive(root, "name");
-            if ( cJSON_IsString(oname) ) {
-                _name = oname->valuestring;
-            }
-
-            cJSON *ovalue_template = cJSON_GetObjectItemCaseSensitive(root, "value_template");
-            if ( cJSON_IsString(ovalue_template) ) {
-                _value_template = ovalue_template->valuestring;
-            }
+    if (!rejected) {
+        ESP_LOGI(TAG, "partition: %li, code: '%s', action: %s, arg: %s", partId, code, action, arg);
 
-            cJSON_Delete(root);
+        std::string scode = code;
+        bool queued = true;
+        switch (mqtt_actions[found].action) {
+        case MQTT_ACTION_DISARM:
+            queued = ad2_disarm(scode, partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_ARM_STAY:
+            queued = ad2_arm_stay(scode, partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_ARM_AWAY:
+            queued = ad2_arm_away(scode, partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_EXIT:
+            queued = ad2_exit_now(partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_CHIME_TOGGLE:
+            queued = ad2_chime_toggle(scode, partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_AUX_ALARM:
+            queued = ad2_aux_alarm(partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_PANIC_ALARM:
+            queued = ad2_panic_alarm(partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_FIRE_ALARM:
+            queued = ad2_fire_alarm(partId, AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_BYPASS:
+            queued = ad2_bypass_zone(scode, partId, std::atoi(arg), AD2_SEND_SRC_MQTT);
+            break;
+        case MQTT_ACTION_SEND_RAW: {
+            std::string raw = arg;
+            queued = ad2_send(raw, AD2_SEND_SRC_MQTT);
+            break;
+        }
+        case MQTT_ACTION_FW_UPDATE_IOT:
+            hal_do_fwupdate("");
+            break;
+        case MQTT_ACTION_FW_UPDATE_AD2:
+            ad2_fw_update(arg);
+            break;
+        case MQTT_ACTION_FW_CONFIG_IOT:
+            ad2_config_update(arg);
+            break;
+        }
+        if (!queued) {
+            ESP_LOGW(TAG, "command %s was not queued", action);
+            rejected = &mqtt_stats_t::commands_dropped;
         }
-
-        mqtt_publish_device_config(
-            "binary_sensor", _type.c_str(), "switch_",
-            sw->INT_ARG, true,
-        _name.c_str(), false, {{
-                { "state_topic", topic+"/switches/"+std::to_string(sw->INT_ARG) },
-                { "value_template", _value_template.c_str() },
-                { "availability_topic", topic+"/status" }
-            }
-        });
     }
 
+    xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+    mqtt_stats.commands++;
+    if (rejected) {
+        mqtt_stats.*rejected += 1;
+    } else {
+        mqtt_stats.commands_queued++;
+    }
+    xSemaphoreGive(mqtt_published_mutex);
 }
 
 /**
@@ -512,7 +2067,6 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
 
     esp_mqtt_event_handle_t event = (esp_mqtt_event_t*)event_data;
     esp_mqtt_client_handle_t client = event->client;
-    int msg_id;
 
     // your_context_t *context = event->context;
     switch ((esp_mqtt_event_id_t)event_id) {
@@ -520,12 +2074,16 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
 #endif
+        // The broker may have lost retained state while we were away.
+        _mqtt_clear_published();
+        _mqtt_outbox_set_connected(true, false);
         mqtt_on_connect(client);
         break;
     case MQTT_EVENT_DISCONNECTED:
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
 #endif
+        _mqtt_outbox_set_connected(false, false);
         break;
     case MQTT_EVENT_SUBSCRIBED:
 #if defined(MQTT_EVENT_LOGGING)
@@ -541,110 +2099,45 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
 #endif
+        _mqtt_outbox_ack(event->msg_id);
+        _mqtt_discovery_ack(event->msg_id);
         break;
-    case MQTT_EVENT_DATA:
+    case MQTT_EVENT_DELETED:
+#if defined(MQTT_EVENT_LOGGING)
+        ESP_LOGI(TAG, "MQTT_EVENT_DELETED, msg_id=%d", event->msg_id);
+#endif
+        _mqtt_outbox_expired(event->msg_id);
+        break;
+    case MQTT_EVENT_DATA: {
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_DATA");
         printf("TOPIC=%.*s\r\n", event->topic_len, event->topic);
         printf("DATA=%.*s\r\n", event->data_len, event->data);
 #endif
+        mqtt_topics_ptr t = _mqtt_get_topics();
+        if (!t) {
+            break;
+        }
+
+        // Home Assistant birth message. It may have lost the configs.
+        if ( t->ha_status &&
+                strlen(t->get(t->ha_status)) == (size_t)event->topic_len &&
+                strncmp(t->get(t->ha_status), event->topic, event->topic_len) == 0 ) {
+            if ( event->data_len == 6 && strncmp(event->data, "online", 6) == 0 ) {
+                _mqtt_discovery_start(true);
+            }
+            break;
+        }
+
         // test if commands subscription is enabled
         if ( commands_enabled ) {
             // Sanity test topic is the size of ```commands``` topic name.
             // Topic pattern to confirm command
-            std::string topic_path;
-            topic_path = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-            topic_path += mqttclient_UUID;
-            topic_path += "/" MQTT_COMMANDS_TOPIC;
-
-            if ( event->topic_len == topic_path.length() ) {
-                std::string topic( event->topic, event->topic_len );
-                if ( topic.compare(topic_path) == 0 ) {
-
-                    // We only want fresh messages no recordings.
-                    // Check for retain flag skip if true.
-                    if ( event->retain ) {
-                        break;
-                    }
+            const char *topic_path = t->get(t->commands);
 
-                    // sanity check the event_data->data_len
-                    if ( event->data_len < MQTT_COMMAND_MAX_DATA_LEN ) {
-                        std::string command( event->data, event->data_len );
-                        // grab the json buffer
-                        // {
-                        //   partition: {{ number partition ID see ```partition``` command. }},
-                        //   code: '{{ string code }}',
-                        //   action: '{{ string action }}',
-                        //   arg: '{{ string argument }}'
-                        // }
-                        cJSON * root   = cJSON_Parse( command.c_str() );
-                        if (root) {
-                            cJSON *opart = NULL;
-                            cJSON *ocode = NULL;
-                            cJSON *oaction = NULL;
-                            cJSON *oarg = NULL;
-                            opart = cJSON_GetObjectItemCaseSensitive(root, "partition");
-                            ocode = cJSON_GetObjectItemCaseSensitive(root, "code");
-                            oaction = cJSON_GetObjectItemCaseSensitive(root, "action");
-                            oarg = cJSON_GetObjectItemCaseSensitive(root, "arg");
-
-                            int partId = 1; // default partition
-                            std::string code = "";
-                            std::string action = "";
-                            std::string arg = "";
-
-                            if ( cJSON_IsNumber(opart) ) {
-                                partId = opart->valuedouble;
-                            }
-                            if ( cJSON_IsString(ocode) ) {
-                                code = ocode->valuestring;
-                            }
-                            if ( cJSON_IsString(oaction) && (oaction->valuestring != NULL) ) {
-                                action = oaction->valuestring;
-                            }
-                            if ( cJSON_IsString(oarg) && (oarg->valuestring != NULL) ) {
-                                arg = oarg->valuestring;
-                            }
-
-                            ESP_LOGI(TAG, "partition: %i, code: '%s', action: %s, arg: %s", partId, code.c_str(), action.c_str(), arg.c_str());
-
-                            if ( action.compare("DISARM") == 0 ) {
-                                ad2_disarm(code, partId);
-                            } else if ( action.compare("ARM_STAY") == 0 ) {
-                                ad2_arm_stay(code, partId);
-                            } else if ( action.compare("ARM_AWAY") == 0 ) {
-                                ad2_arm_away(code, partId);
-                            } else if ( action.compare("EXIT") == 0 ) {
-                                ad2_exit_now(partId);
-                            } else if ( action.compare("CHIME_TOGGLE") == 0 ) {
-                                ad2_chime_toggle(code, partId);
-                            } else if ( action.compare("AUX_ALARM") == 0 ) {
-                                ad2_aux_alarm(partId);
-                            } else if ( action.compare("PANIC_ALARM") == 0 ) {
-                                ad2_panic_alarm(partId);
-                            } else if ( action.compare("FIRE_ALARM") == 0 ) {
-                                ad2_fire_alarm(partId);
-                            } else if ( action.compare("BYPASS") == 0 ) {
-                                ad2_bypass_zone(code, partId, std::atoi(arg.c_str()));
-                            } else if ( action.compare("SEND_RAW") == 0 ) {
-                                ad2_send(arg);
-                            } else if ( action.compare("FW_UPDATE_IOT") == 0 ) {
-                                hal_do_fwupdate("");
-                            } else if ( action.compare("FW_UPDATE_AD2") == 0 ) {
-                                ad2_fw_update(arg.c_str());
-                            } else if ( action.compare("FW_CONFIG_IOT") == 0 ) {
-                                ad2_config_update(arg.c_str());
-                            } else {
-                                // unknown command
-                            }
-                            cJSON_Delete(root);
-                        } else {
-                            // JSON parse error
-                            ESP_LOGI(TAG, "json parse error '%s'", command.c_str());
-                        }
-                    } else {
-                        ESP_LOGI(TAG, "invalid data len");
-                    }
+            if ( (size_t)event->topic_len == strlen(topic_path) ) {
+                if ( strncmp(event->topic, topic_path, event->topic_len) == 0 ) {
+                    _mqtt_on_command(event);
                 } else {
                     ESP_LOGI(TAG, "invalid topic path");
                 }
@@ -653,6 +2146,7 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
             }
         }
         break;
+    }
     case MQTT_EVENT_ERROR:
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
@@ -677,29 +2171,27 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
  */
 void mqtt_on_lrr(std::string *msg, AD2PartitionState *s, void *arg)
 {
-    int msg_id;
-    if (mqtt_client != nullptr) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/cid";
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (mqtt_client != nullptr && t) {
 
-        cJSON *root = cJSON_CreateObject();
-        cJSON_AddStringToObject(root, "event_message", msg->c_str());
+        AD2JsonBuffer<256> json;
+        const char *state = json.render([&](AD2JsonWriter &w) {
+            w.object();
+            w.add("event_message", *msg);
+        });
+        if (!state) {
+            return;
+        }
 
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
+        // Events are all kept in the outbox, not just the latest.
+        _mqtt_publish_event(t->get(t->cid), state, json.length(), MQTT_DEF_RETAIN, false);
 
-        // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
-
-        cJSON_free(state);
-        cJSON_Delete(root);
+        if (t->cbor_cid) {
+            _mqtt_publish_cbor(t->get(t->cbor_cid), MQTT_DEF_RETAIN, false, [&](AD2JsonWriter &w) {
+                w.object();
+                w.add("event_message", *msg);
+            });
+        }
     }
 }
 
@@ -717,8 +2209,194 @@ void on_new_firmware_cb(std::string *msg, AD2PartitionState *s, void *arg)
     mqtt_send_fw_version(msg->c_str());
 }
 
+/**
+ * @brief Publish the zone topic and its CBOR copy for one zone change.
+ *
+ * @param [in]t mqtt_topics_ptr &.
+ * @param [in]z const ad2_json_zone_event_t &.
+ */
+static void _mqtt_publish_zone(const mqtt_topics_ptr &t, const ad2_json_zone_event_t &z)
+{
+    char buf[MQTT_TOPIC_MAX];
+    const char *topic = t->entity(t->zone, z.zone, "zones", buf);
+
+    AD2JsonBuffer<256> json;
+    const char *state = json.render([&](AD2JsonWriter &w) {
+        w.object();
+        ad2_json_zone_event(w, z);
+    });
+    if (!state) {
+        return;
+    }
+
+    int msg_id = _mqtt_publish_state(topic, state, json.length(),
+                                     MQTT_DEF_QOS, MQTT_DEF_RETAIN, &mqtt_ignore_keys);
+    if (msg_id == MQTT_PUBLISH_SUPPRESSED || msg_id == -1) {
+        return;
+    }
+    xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+    mqtt_stats.zone_updates++;
+    xSemaphoreGive(mqtt_published_mutex);
+    if (mqtt_cbor & MQTT_CBOR_ZONES) {
+        _mqtt_publish_cbor(t->entity(t->cbor_zone, z.zone, MQTT_CBOR_TOPIC "/zones", buf),
+        MQTT_DEF_RETAIN, true, [&](AD2JsonWriter &w) {
+            w.object();
+            ad2_json_zone_event(w, z);
+        });
+    }
+}
+
+/**
+ * @brief Add a zone change to its partition delta and mark its zone
+ * topic behind.
+ *
+ * @param [in]z const ad2_json_zone_event_t &.
+ *
+ * @return bool false if zone batching is off.
+ */
+static bool _mqtt_zone_batch_add(const ad2_json_zone_event_t &z)
+{
+    xSemaphoreTake(mqtt_zone_batch_mutex, portMAX_DELAY);
+    if (mqtt_zone_batch.window_ms < 0) {
+        xSemaphoreGive(mqtt_zone_batch_mutex);
+        return false;
+    }
+    TickType_t now = xTaskGetTickCount();
+
+    // The delta keeps the latest state of each zone and how often it changed.
+    mqtt_zone_delta_t &d = mqtt_zone_batch.deltas[z.partition];
+    if (d.zones.empty()) {
+        d.opened = now;
+    }
+    auto it = std::find_if(d.zones.begin(), d.zones.end(), [&](const mqtt_zone_change_t &c) {
+        return c.ev.zone == z.zone;
+    });
+    if (it == d.zones.end()) {
+        d.zones.push_back({ z, 1, 0 });
+    } else {
+        it->ev = z;
+        it->changes++;
+    }
+
+    // A zone topic not updated for update_ms is due at once.
+    auto zit = mqtt_zone_batch.zones.find(z.zone);
+    if (zit == mqtt_zone_batch.zones.end()) {
+        TickType_t published = now - pdMS_TO_TICKS(mqtt_zone_batch.update_ms);
+        mqtt_zone_batch.zones[z.zone] = { z, 1, published };
+        mqtt_zone_batch.due++;
+    } else {
+        if (!zit->second.changes) {
+            mqtt_zone_batch.due++;
+        }
+        zit->second.ev = z;
+        zit->second.changes++;
+    }
+    xSemaphoreGive(mqtt_zone_batch_mutex);
+    return true;
+}
+
+/**
+ * @brief Publish the partition deltas whose window has ended and the zone
+ * topics that are due. Called when the parser starts a read, so a delta
+ * never splits the zone changes of one parser batch.
+ */
+static void _mqtt_zone_batch_flush()
+{
+    if (!mqtt_zone_batch_mutex) {
+        return;
+    }
+    std::vector<std::pair<uint8_t, std::vector<mqtt_zone_change_t>>> closed;
+    std::vector<ad2_json_zone_event_t> updates;
+
+    xSemaphoreTake(mqtt_zone_batch_mutex, portMAX_DELAY);
+    if (mqtt_zone_batch.deltas.empty() && !mqtt_zone_batch.due) {
+        xSemaphoreGive(mqtt_zone_batch_mutex);
+        return;
+    }
+    TickType_t now = xTaskGetTickCount();
+    // Turned off. Send everything waiting.
+    bool off = mqtt_zone_batch.window_ms < 0;
+    for (auto it = mqtt_zone_batch.deltas.begin(); it != mqtt_zone_batch.deltas.end();) {
+        if (off || (now - it->second.opened) >= pdMS_TO_TICKS(mqtt_zone_batch.window_ms)) {
+            closed.push_back({ it->first, std::move(it->second.zones) });
+            it = mqtt_zone_batch.deltas.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto &e : mqtt_zone_batch.zones) {
+        mqtt_zone_change_t &c = e.second;
+        if (c.changes && (off || (now - c.published) >= pdMS_TO_TICKS(mqtt_zone_batch.update_ms))) {
+            updates.push_back(c.ev);
+            c.changes = 0;
+            c.published = now;
+            mqtt_zone_batch.due--;
+        }
+    }
+    xSemaphoreGive(mqtt_zone_batch_mutex);
+
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (mqtt_client == nullptr || !t) {
+        return;
+    }
+    for (auto &d : closed) {
+        char buf[MQTT_TOPIC_MAX];
+        const char *topic = buf;
+        if (d.first <= AD2_MAX_PARTITION && t->zone_delta[d.first]) {
+            topic = t->get(t->zone_delta[d.first]);
+        } else {
+            snprintf(buf, sizeof(buf), "%s/partitions/%d/" MQTT_ZONE_DELTA_TOPIC, t->get(t->root), d.first);
+        }
+        auto fill = [&](AD2JsonWriter &w) {
+            w.object();
+            w.add("partition", d.first);
+            w.array("zones");
+            for (auto &c : d.second) {
+                w.object();
+                w.add("zone", c.ev.zone);
+                ad2_json_zone_event(w, c.ev);
+                w.add("changes", c.changes);
+                w.end();
+            }
+        };
+        AD2JsonBuffer<768> json;
+        const char *state = json.render(fill);
+        if (!state) {
+            continue;
+        }
+        // Each delta is an event. Not retained and never collapsed.
+        if (!_mqtt_publish_event(topic, state, json.length(), 0, false)) {
+            ESP_LOGE(TAG, "esp_mqtt_client_enqueue failed.");
+            continue;
+        }
+        xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+        mqtt_stats.zone_deltas++;
+        xSemaphoreGive(mqtt_published_mutex);
+        if (d.first <= AD2_MAX_PARTITION && t->cbor_zone_delta[d.first]) {
+            _mqtt_publish_cbor(t->get(t->cbor_zone_delta[d.first]), 0, false, fill);
+        }
+    }
+    for (auto &z : updates) {
+        _mqtt_publish_zone(t, z);
+    }
+}
+
+/**
+ * @brief ON_RAW_RX_DATA callback. The parser is about to start a new
+ * batch so the last one is complete.
+ *
+ * @param [in]buffer uint8_t * data read.
+ * @param [in]len size_t.
+ * @param [in]arg nullptr.
+ */
+void mqtt_on_rx_data(uint8_t *buffer, size_t len, void *arg)
+{
+    _mqtt_zone_batch_flush();
+}
+
 /**
  * @brief ON_ZONE_CHANGE callback for all AlarmDecoder API event subscriptions.
+ * With zone batching the change waits for its partition delta.
  *
  * @param [in]msg std::string panel message.
  * @param [in]s AD2PartitionState *.
@@ -727,39 +2405,18 @@ void on_new_firmware_cb(std::string *msg, AD2PartitionState *s, void *arg)
  */
 void mqtt_on_zone_change(std::string *msg, AD2PartitionState *s, void *arg)
 {
-    int msg_id;
-    if (mqtt_client != nullptr && s) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/zones/";
-
-        // Append the zone to the topic string
-        sTopic+=std::to_string((int)s->zone);
-
-        cJSON *root = cJSON_CreateObject();
-        std::string buf;
-        // grab the verb(FOO) 'ZONE FOO 001'
-        ad2_copy_nth_arg(buf, (char *)s->last_event_message.c_str(), 1);
-        cJSON_AddStringToObject(root, "state", buf.c_str());
-        cJSON_AddNumberToObject(root, "partition", s->partition);
-        cJSON_AddNumberToObject(root, "mask", s->address_mask_filter);
-        cJSON_AddBoolToObject(root, "system", s->zone_states[s->zone].is_system());
-        std::string zalpha;
-        AD2Parse.getZoneString((int)s->zone, zalpha);
-        cJSON_AddStringToObject(root, "name", zalpha.c_str());
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (mqtt_client != nullptr && s && t) {
+        ad2_json_zone_event_t z;
+        ad2_json_get_zone_event(s, &z);
 
-        // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
-        cJSON_free(state);
-        cJSON_Delete(root);
+        xSemaphoreTake(mqtt_published_mutex, portMAX_DELAY);
+        mqtt_stats.zone_changes++;
+        xSemaphoreGive(mqtt_published_mutex);
+
+        if (!_mqtt_zone_batch_add(z)) {
+            _mqtt_publish_zone(t, z);
+        }
     }
 }
 
@@ -774,29 +2431,69 @@ void mqtt_on_zone_change(std::string *msg, AD2PartitionState *s, void *arg)
 void mqtt_on_state_change(std::string *msg, AD2PartitionState *s, void *arg)
 {
     int msg_id;
-    if (mqtt_client != nullptr && s) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/partitions/";
-        sTopic+=std::to_string(s->partition);
-        cJSON *root = ad2_get_partition_state_json(s);
-        cJSON_AddStringToObject(root, "event", AD2Parse.event_str[(int)arg].c_str());
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (mqtt_client != nullptr && s && t) {
+        char buf[MQTT_TOPIC_MAX];
+        const char *topic = t->entity(t->partition, s->partition, "partitions", buf);
+        ad2_json_snapshot_ptr snap = ad2_json_get_snapshot(s);
+        if (!snap) {
+            return;
+        }
+        AD2JsonBuffer<1024> json;
+        const char *state = json.render([&](AD2JsonWriter &w) {
+            w.object();
+            w.members(snap->state(), snap->state_length());
+            w.add("event", AD2Parse.event_str[(intptr_t)arg]);
+        });
+        if (!state) {
+            return;
+        }
 
-        // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
+        msg_id = _mqtt_publish_state(topic, state, json.length(),
+                                     MQTT_DEF_QOS, MQTT_DEF_RETAIN, &mqtt_partition_ignore_keys);
         if (msg_id == -1) {
             ESP_LOGE(TAG, "esp_mqtt_client_enqueue failed.");
+        } else if ((mqtt_cbor & MQTT_CBOR_PARTITIONS) && msg_id != MQTT_PUBLISH_SUPPRESSED) {
+            _mqtt_publish_cbor(t->entity(t->cbor_partition, s->partition, MQTT_CBOR_TOPIC "/partitions", buf),
+            MQTT_DEF_RETAIN, true, [&](AD2JsonWriter &w) {
+                w.object();
+                ad2_json_partition_state(w, s);
+                w.add("event", AD2Parse.event_str[(intptr_t)arg]);
+            });
         }
-        cJSON_free(state);
-        cJSON_Delete(root);
+    }
+}
+
+/**
+ * @brief ON_ALPHA_MESSAGE callback. When ```alpha``` is enabled publish
+ * the keypad text to its own non retained topic each time it changes.
+ *
+ * @param [in]msg std::string panel message.
+ * @param [in]s AD2PartitionState *.
+ * @param [in]arg cast as int for event type (ON_ARM,,,).
+ *
+ */
+void mqtt_on_alpha_message(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (mqtt_client != nullptr && s && mqtt_alpha_topic && t) {
+        char buf[MQTT_TOPIC_MAX];
+        const char *topic = buf;
+        if (s->partition <= AD2_MAX_PARTITION && t->alpha[s->partition]) {
+            topic = t->get(t->alpha[s->partition]);
+        } else {
+            snprintf(buf, sizeof(buf), "%s/partitions/%d/alpha", t->get(t->root), s->partition);
+        }
+        AD2JsonBuffer<128> json;
+        const char *state = json.render([&](AD2JsonWriter &w) {
+            w.object();
+            w.add("last_alpha_message", s->last_alpha_message);
+        });
+        if (!state) {
+            return;
+        }
+        // Keypad text is not state. QoS 0 and not retained.
+        _mqtt_publish_state(topic, state, json.length(), 0, 0, nullptr);
     }
 }
 
@@ -805,11 +2502,26 @@ void mqtt_on_state_change(std::string *msg, AD2PartitionState *s, void *arg)
  */
 void mqtt_free()
 {
-    __attribute__((__unused__)) esp_err_t err;
-    if (mqtt_client) {
-        err = esp_mqtt_client_destroy(mqtt_client);
-        mqtt_client = nullptr;
+    // Take the client away from new publishes and wait out any still
+    // using it before it is destroyed.
+    esp_mqtt_client_handle_t client = mqtt_client.exchange(nullptr);
+    if (client) {
+        while (mqtt_client_users) {
+            vTaskDelay(1);
+        }
+        // stops the client task first if it is running.
+        esp_mqtt_client_destroy(client);
+    }
+
+    // PUBACKs for the old client will never come.
+    if (mqtt_discovery_mutex) {
+        xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+        for (auto &sl : mqtt_discovery.inflight) {
+            sl.msg_id = 0;
+        }
+        xSemaphoreGive(mqtt_discovery_mutex);
     }
+    _mqtt_outbox_set_connected(false, true);
 }
 
 /**
@@ -832,33 +2544,27 @@ void on_search_match_cb_mqtt(std::string *msg, AD2PartitionState *s, void *arg)
     // Grab the topic using the virtual switch ID pre saved into INT_ARG
     // publishing event
     int msg_id;
-    if (mqtt_client != nullptr) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/switches/";
-        sTopic+=std::to_string(es->INT_ARG);
-        cJSON *root = cJSON_CreateObject();
-        cJSON_AddStringToObject(root, "state", es->out_message.c_str());
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (mqtt_client != nullptr && t) {
+        char buf[MQTT_TOPIC_MAX];
+        const char *topic = t->entity(t->sw, es->INT_ARG, "switches", buf);
+        AD2JsonBuffer<256> json;
+        const char *state = json.render([&](AD2JsonWriter &w) {
+            w.object();
+            w.add("state", es->out_message);
+        });
+        if (!state) {
+            return;
+        }
 
-        // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
-
-        if (msg_id) {
+        msg_id = _mqtt_publish_state(topic, state, json.length(),
+                                     MQTT_DEF_QOS, MQTT_DEF_RETAIN, nullptr);
+
+        if (msg_id > 0) {
             ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s'", es->INT_ARG, msg->c_str(), es->out_message.c_str());
-        } else {
+        } else if (msg_id == -1) {
             ESP_LOGE(TAG,"Error adding mqtt message.");
         }
-
-        cJSON_free(state);
-        cJSON_Delete(root);
     }
 
 }
@@ -873,7 +2579,14 @@ enum {
     MQTT_CMDEN_SUBCMD_ID,
     MQTT_TPREFIX_SUBCMD_ID,
     MQTT_DPREFIX_SUBCMD_ID,
-    MQTT_SWITCH_SUBCMD_ID
+    MQTT_SWITCH_SUBCMD_ID,
+    MQTT_DEDUP_SUBCMD_ID,
+    MQTT_IGNORE_SUBCMD_ID,
+    MQTT_ALPHA_SUBCMD_ID,
+    MQTT_COMPACT_SUBCMD_ID,
+    MQTT_OUTBOX_SUBCMD_ID,
+    MQTT_CBOR_SUBCMD_ID,
+    MQTT_ZONEBATCH_SUBCMD_ID
 };
 char * MQTT_SUBCMD [] = {
     (char*)MQTT_ENABLE_SUBCMD,
@@ -882,6 +2595,13 @@ char * MQTT_SUBCMD [] = {
     (char*)MQTT_TPREFIX_SUBCMD,
     (char*)MQTT_DPREFIX_SUBCMD,
     (char*)MQTT_SWITCH_SUBCMD,
+    (char*)MQTT_DEDUP_SUBCMD,
+    (char*)MQTT_IGNORE_SUBCMD,
+    (char*)MQTT_ALPHA_SUBCMD,
+    (char*)MQTT_COMPACT_SUBCMD,
+    (char*)MQTT_OUTBOX_SUBCMD,
+    (char*)MQTT_CBOR_SUBCMD,
+    (char*)MQTT_ZONEBATCH_SUBCMD,
     0 // EOF
 };
 
@@ -1014,68 +2734,207 @@ static void _cli_cmd_mqtt_command_router(const char *string)
                 }
                 break;
 
-            /**
-             * MQTT commands enable / disable
-             */
-            case MQTT_CMDEN_SUBCMD_ID:   // 'commands' sub command
+            /**
+             * MQTT commands enable / disable
+             */
+            case MQTT_CMDEN_SUBCMD_ID:   // 'commands' sub command
+                arg = "";
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    ad2_set_config_key_bool(
+                        MQTT_CONFIG_SECTION,
+                        MQTT_CMDEN_SUBCMD,
+                        (arg[0] == 'Y' || arg[0] ==  'y')
+                    );
+                    if ((arg[0] == 'Y' || arg[0] ==  'y')) {
+                        ad2_printf_host(false, "Warning! Enabling commands on a public sever will allow anyone to send commands to the panel. Be sure this is only enabled on private servers or servers with publish permissions.\r\n");
+                    }
+                    ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
+                }
+
+                // show contents of this setting
+                en = false;
+                ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_CMDEN_SUBCMD, &en);
+                ad2_printf_host(false, "MQTT command subscription is '%s'.\r\n", (en ? "Enabled" : "Disabled"));
+                break;
+
+            /**
+             * MQTT topic tprefix
+             */
+            case MQTT_TPREFIX_SUBCMD_ID:   // 'tprefix' sub command
+                // If arg provided then save.
+                if (ad2_copy_nth_arg(arg, string, 2, true) >= 0) {
+                    ad2_remove_ws(arg);
+                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_TPREFIX_SUBCMD, arg.c_str());
+                    ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
+                } else {
+                    // show contents of this setting
+                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_TPREFIX_SUBCMD, arg);
+                    ad2_printf_host(false, "MQTT topic prefix set to '%s'.\r\n", arg.c_str());
+                }
+                break;
+
+            /**
+             * MQTT auto discovery topic prefix
+             */
+            case MQTT_DPREFIX_SUBCMD_ID:   // 'dprefix' sub command
+                // If arg provided then save.
+                if (ad2_copy_nth_arg(arg, string, 2, true) >= 0) {
+                    ad2_remove_ws(arg);
+                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_DPREFIX_SUBCMD, arg.c_str());
+                    ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
+                } else {
+                    // show contents of this setting
+                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_DPREFIX_SUBCMD, arg);
+                    ad2_printf_host(false, "MQTT discovery topic prefix set to '%s'.\r\n", arg.c_str());
+                }
+                break;
+
+            /**
+             * MQTT Virtual switch command
+             */
+            case MQTT_SWITCH_SUBCMD_ID:
+                _cli_cmd_mqtt_smart_alert_switch(subcmd, string);
+                break;
+
+            /**
+             * MQTT retained state deduplication enable / disable
+             */
+            case MQTT_DEDUP_SUBCMD_ID:   // 'dedup' sub command
+                arg = "";
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    ad2_set_config_key_bool(
+                        MQTT_CONFIG_SECTION, MQTT_DEDUP_SUBCMD,
+                        (arg[0] == 'Y' || arg[0] ==  'y')
+                    );
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                    _mqtt_load_dedup_settings();
+                }
+
+                // show contents of this setting
+                en = true;
+                ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_DEDUP_SUBCMD, &en);
+                ad2_printf_host(false, "MQTT unchanged state suppression is '%s'.\r\n", (en ? "Enabled" : "Disabled"));
+                break;
+
+            /**
+             * MQTT keys that do not count as a change
+             */
+            case MQTT_IGNORE_SUBCMD_ID:   // 'ignore' sub command
+                // If arg provided then save. '-' clears.
+                if (ad2_copy_nth_arg(arg, string, 2, true) >= 0) {
+                    if (arg == "-") {
+                        arg = "";
+                    }
+                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_IGNORE_SUBCMD, arg.c_str());
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                    _mqtt_load_dedup_settings();
+                } else {
+                    // show contents of this setting
+                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_IGNORE_SUBCMD, arg);
+                    ad2_printf_host(false, "MQTT keys ignored for change detection '%s'.\r\n", arg.c_str());
+                }
+                break;
+
+            /**
+             * MQTT keypad text topic enable / disable
+             */
+            case MQTT_ALPHA_SUBCMD_ID:   // 'alpha' sub command
+                arg = "";
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    ad2_set_config_key_bool(
+                        MQTT_CONFIG_SECTION, MQTT_ALPHA_SUBCMD,
+                        (arg[0] == 'Y' || arg[0] ==  'y')
+                    );
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                    _mqtt_load_dedup_settings();
+                }
+
+                // show contents of this setting
+                en = false;
+                ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_ALPHA_SUBCMD, &en);
+                ad2_printf_host(false, "MQTT alpha topic is '%s'.\r\n", (en ? "Enabled" : "Disabled"));
+                break;
+
+            case MQTT_COMPACT_SUBCMD_ID:   // 'compact' sub command
                 arg = "";
                 if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
                     ad2_set_config_key_bool(
-                        MQTT_CONFIG_SECTION,
-                        MQTT_CMDEN_SUBCMD,
+                        MQTT_CONFIG_SECTION, MQTT_COMPACT_SUBCMD,
                         (arg[0] == 'Y' || arg[0] ==  'y')
                     );
-                    if ((arg[0] == 'Y' || arg[0] ==  'y')) {
-                        ad2_printf_host(false, "Warning! Enabling commands on a public sever will allow anyone to send commands to the panel. Be sure this is only enabled on private servers or servers with publish permissions.\r\n");
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                    mqtt_compact_discovery = (arg[0] == 'Y' || arg[0] ==  'y');
+                    // Changed configs are sent again.
+                    if (mqtt_client) {
+                        _mqtt_discovery_start(false);
                     }
+                }
+
+                // show contents of this setting
+                en = false;
+                ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_COMPACT_SUBCMD, &en);
+                ad2_printf_host(false, "MQTT compact discovery is '%s'.\r\n", (en ? "Enabled" : "Disabled"));
+                break;
+
+            case MQTT_OUTBOX_SUBCMD_ID:   // 'outbox' sub command
+                arg = "";
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    ad2_set_config_key_bool(
+                        MQTT_CONFIG_SECTION, MQTT_OUTBOX_SUBCMD,
+                        (arg[0] == 'Y' || arg[0] ==  'y')
+                    );
                     ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
                 }
 
                 // show contents of this setting
                 en = false;
-                ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_CMDEN_SUBCMD, &en);
-                ad2_printf_host(false, "MQTT command subscription is '%s'.\r\n", (en ? "Enabled" : "Disabled"));
+                ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_OUTBOX_SUBCMD, &en);
+                ad2_printf_host(false, "MQTT uSD outbox is '%s'.\r\n", (en ? "Enabled" : "Disabled"));
                 break;
 
             /**
-             * MQTT topic tprefix
+             * MQTT CBOR topic families
              */
-            case MQTT_TPREFIX_SUBCMD_ID:   // 'tprefix' sub command
-                // If arg provided then save.
+            case MQTT_CBOR_SUBCMD_ID:   // 'cbor' sub command
+                // If arg provided then save. '-' clears.
                 if (ad2_copy_nth_arg(arg, string, 2, true) >= 0) {
-                    ad2_remove_ws(arg);
-                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_TPREFIX_SUBCMD, arg.c_str());
-                    ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
+                    if (arg == "-") {
+                        arg = "";
+                    }
+                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_CBOR_SUBCMD, arg.c_str());
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                    _mqtt_load_cbor_settings();
+                    _mqtt_build_topics();
+                    // Advertise the new families.
+                    mqtt_on_ad2cfg(nullptr, nullptr, nullptr);
                 } else {
                     // show contents of this setting
-                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_TPREFIX_SUBCMD, arg);
-                    ad2_printf_host(false, "MQTT topic prefix set to '%s'.\r\n", arg.c_str());
+                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_CBOR_SUBCMD, arg);
+                    ad2_printf_host(false, "MQTT CBOR topic families '%s'.\r\n", arg.c_str());
                 }
                 break;
 
             /**
-             * MQTT auto discovery topic prefix
+             * MQTT zone change batching
              */
-            case MQTT_DPREFIX_SUBCMD_ID:   // 'dprefix' sub command
-                // If arg provided then save.
+            case MQTT_ZONEBATCH_SUBCMD_ID:   // 'zonebatch' sub command
+                // If arg provided then save. '-' clears.
                 if (ad2_copy_nth_arg(arg, string, 2, true) >= 0) {
-                    ad2_remove_ws(arg);
-                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_DPREFIX_SUBCMD, arg.c_str());
-                    ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
+                    if (arg == "-") {
+                        arg = "";
+                    }
+                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_ZONEBATCH_SUBCMD, arg.c_str());
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                    _mqtt_load_zone_batch_settings();
+                    _mqtt_build_topics();
+                    mqtt_on_ad2cfg(nullptr, nullptr, nullptr);
                 } else {
                     // show contents of this setting
-                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_DPREFIX_SUBCMD, arg);
-                    ad2_printf_host(false, "MQTT discovery topic prefix set to '%s'.\r\n", arg.c_str());
+                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_ZONEBATCH_SUBCMD, arg);
+                    ad2_printf_host(false, "MQTT zone batching '%s'.\r\n", arg.length() ? arg.c_str() : "off");
                 }
                 break;
 
-            /**
-             * MQTT Virtual switch command
-             */
-            case MQTT_SWITCH_SUBCMD_ID:
-                _cli_cmd_mqtt_smart_alert_switch(subcmd, string);
-                break;
-
             }
             // all done
             break;
@@ -1090,7 +2949,7 @@ static struct cli_command mqtt_cmd_list[] = {
     {
         // ### MQTT notification component
         (char*)MQTT_COMMAND,(char*)
-        "Usage: mqtt (enable|url|commands|tprefix|dprefix) [<arg>]\r\n"
+        "Usage: mqtt (enable|url|commands|tprefix|dprefix|dedup|ignore|alpha|compact|outbox|cbor|zonebatch) [<arg>]\r\n"
         "Usage: mqtt switch <swid> [delete|-|open|close|trouble] [<arg>]\r\n"
         "\r\n"
         "    Configuration tool for MQTT notification\r\n"
@@ -1100,6 +2959,14 @@ static struct cli_command mqtt_cmd_list[] = {
         "    commands [Y|N]          Remote command enable flag\r\n"
         "    tprefix [path]          Topic prefix\r\n"
         "    dprefix [path]          Discovery prefix\r\n"
+        "    dedup [Y|N]             Skip state publishes with no significant change\r\n"
+        "    ignore [keys|-]         Keys that are not a significant change\r\n"
+        "    alpha [Y|N]             Publish keypad text to partitions/N/alpha\r\n"
+        "    compact [Y|N]           Abbreviated discovery keys and ~ base topic\r\n"
+        "    outbox [Y|N]            Keep QoS 1 publishes on the uSD card while offline\r\n"
+        "    cbor [families|-]       Also publish partitions, zones, cid as CBOR\r\n"
+        "    zonebatch [ms [zms]|-]  Zone changes as partition deltas every ms\r\n"
+        "                            and zone topics at most every zms\r\n"
         "    switch swid SCMD [ARG]  Configure virtual switches\r\n"
         "Sub-Commands:\r\n"
         "    delete | -              Clear switch notification settings\r\n"
@@ -1128,28 +2995,12 @@ void mqtt_register_cmds()
 }
 
 /**
- * @brief daemon startup task
- *
- * @param [in]pvParameters currently not used NULL.
+ * @brief Load the [mqtt] client settings.
  */
-void mqtt_startup_task(void *pvParameters)
+static void _mqtt_load_settings()
 {
-#if defined(MQTT_DEBUG)
-    ESP_LOGI(TAG, "MQTT waiting for network layer to start.");
-#endif
-    while (1) {
-        if (!hal_get_netif_started()) {
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-        } else {
-            break;
-        }
-    }
-    ESP_LOGI(TAG, "Network layer is OK. %s client starting.", TAG);
-
-    // configure and start MQTT client
-    esp_err_t err;
-
     // load topic prefix setting
+    mqttclient_TPREFIX = "";
     ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_TPREFIX_SUBCMD, mqttclient_TPREFIX);
     if (mqttclient_TPREFIX.length()) {
         // add a slash
@@ -1157,6 +3008,7 @@ void mqtt_startup_task(void *pvParameters)
     }
 
     // load discovery topic prefix setting
+    mqttclient_DPREFIX = "";
     ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_DPREFIX_SUBCMD, mqttclient_DPREFIX);
     if (mqttclient_DPREFIX.length()) {
         // add a slash
@@ -1164,95 +3016,143 @@ void mqtt_startup_task(void *pvParameters)
     }
 
     // load and parse the Broker URL if set.
-    std::string brokerURL;
-    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_URL_SUBCMD, brokerURL);
-    if (!brokerURL.length()) {
+    mqttclient_URL = "";
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_URL_SUBCMD, mqttclient_URL);
+    if (!mqttclient_URL.length()) {
         // set default
-        brokerURL = EXAMPLE_BROKER_URI;
+        mqttclient_URL = EXAMPLE_BROKER_URI;
     }
+    // keep the broker resolved for reconnects.
+    ad2_dns_prefetch_clear(MQTT_CONFIG_SECTION);
+    ad2_dns_prefetch(MQTT_CONFIG_SECTION, mqttclient_URL);
+
+    // load commands subscription enable/disable setting
+    commands_enabled = false;
+    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_CMDEN_SUBCMD, &commands_enabled);
+
+    // load compact discovery setting
+    bool compact = false;
+    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_COMPACT_SUBCMD, &compact);
+    mqtt_compact_discovery = compact;
+
+    // load CBOR topic families
+    _mqtt_load_cbor_settings();
+
+    // load zone batching
+    _mqtt_load_zone_batch_settings();
+
+    // Topics depend on tprefix, dprefix, the CBOR families and zone batching.
+    _mqtt_build_topics();
+
+    _mqtt_load_dedup_settings();
+}
+
+/**
+ * @brief Create and start the client from the loaded settings.
+ */
+static void _mqtt_client_start()
+{
+    esp_err_t err;
 
     // Last Will topic
-    std::string LWT_TOPIC = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    LWT_TOPIC+=mqttclient_UUID;
-    LWT_TOPIC+="/status";
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    if (!t) {
+        return;
+    }
 
     // Build mqtt client config
     esp_mqtt_client_config_t mqtt_cfg = {};
-    mqtt_cfg.broker.address.uri = brokerURL.c_str();
+    mqtt_cfg.broker.address.uri = mqttclient_URL.c_str();
     mqtt_cfg.credentials.client_id = mqttclient_UUID.c_str();
-    mqtt_cfg.session.last_will.topic = LWT_TOPIC.c_str();
+    mqtt_cfg.session.last_will.topic = t->get(t->status);
     mqtt_cfg.session.last_will.msg = "offline";
     mqtt_cfg.session.last_will.qos = 1;
     mqtt_cfg.session.last_will.retain = 1;
 
     // Create and start the client.
-    mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqtt_cfg);
+    mqtt_client = client;
 
     // register event callback
-    esp_mqtt_client_register_event(mqtt_client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, ad2_mqtt_event_handler, NULL);
+    esp_mqtt_client_register_event(client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, ad2_mqtt_event_handler, NULL);
 
-    err = esp_mqtt_client_start(mqtt_client);
+    err = esp_mqtt_client_start(client);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_mqtt_client_start return error: %s.", esp_err_to_name(err));
     }
-
-    vTaskDelete(NULL);
 }
 
 /**
- * Initialize queue and SSL
+ * @brief daemon startup task
+ *
+ * @param [in]pvParameters currently not used NULL.
  */
-void mqtt_init()
+void mqtt_startup_task(void *pvParameters)
 {
-    bool en = false;
-    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_ENABLE_SUBCMD, &en);
-
-    // nothing more needs to be done once commands are set if not enabled.
-    if (!en) {
-        ad2_printf_host(true, "%s client disabled.", TAG);
-        return;
-    }
-
-#if 0 // debug logging settings.
-    esp_log_level_set("MQTT_CLIENT", ESP_LOG_VERBOSE);
-    esp_log_level_set("TRANSPORT_TCP", ESP_LOG_VERBOSE);
-    esp_log_level_set("TRANSPORT_SSL", ESP_LOG_VERBOSE);
-    esp_log_level_set("esp-tls", ESP_LOG_VERBOSE);
-    esp_log_level_set("TRANSPORT", ESP_LOG_VERBOSE);
-    esp_log_level_set("OUTBOX", ESP_LOG_VERBOSE);
+#if defined(MQTT_DEBUG)
+    ESP_LOGI(TAG, "MQTT waiting for network layer to start.");
 #endif
+    while (1) {
+        if (!hal_get_netif_started()) {
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+        } else {
+            break;
+        }
+    }
+    ESP_LOGI(TAG, "Network layer is OK. %s client starting.", TAG);
 
-    // load commands subscription enable/disable setting
-    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_CMDEN_SUBCMD, &commands_enabled);
+    _mqtt_load_settings();
+    if (mqtt_enabled && !mqtt_client) {
+        _mqtt_client_start();
+    }
 
-    // generate our client's unique user id. UUID.
-    ad2_genUUID(0x10, mqttclient_UUID);
-    ad2_printf_host(true, "%s: Init UUID: %s", TAG, mqttclient_UUID.c_str());
+    vTaskDelete(NULL);
+}
 
-    // Subscribe standard AlarmDecoder events
-    AD2Parse.subscribeTo(ON_ARM, mqtt_on_state_change, (void *)ON_ARM);
-    AD2Parse.subscribeTo(ON_DISARM, mqtt_on_state_change, (void *)ON_DISARM);
-    AD2Parse.subscribeTo(ON_CHIME_CHANGE, mqtt_on_state_change, (void *)ON_CHIME_CHANGE);
-    AD2Parse.subscribeTo(ON_BEEPS_CHANGE, mqtt_on_state_change, (void *)ON_BEEPS_CHANGE);
-    AD2Parse.subscribeTo(ON_FIRE_CHANGE, mqtt_on_state_change, (void *)ON_FIRE_CHANGE);
-    AD2Parse.subscribeTo(ON_POWER_CHANGE, mqtt_on_state_change, (void *)ON_POWER_CHANGE);
-    AD2Parse.subscribeTo(ON_READY_CHANGE, mqtt_on_state_change, (void *)ON_READY_CHANGE);
-    AD2Parse.subscribeTo(ON_LOW_BATTERY, mqtt_on_state_change, (void *)ON_LOW_BATTERY);
-    AD2Parse.subscribeTo(ON_ALARM_CHANGE, mqtt_on_state_change, (void *)ON_ALARM_CHANGE);
-    AD2Parse.subscribeTo(ON_ZONE_BYPASSED_CHANGE, mqtt_on_state_change, (void *)ON_ZONE_BYPASSED_CHANGE);
-    AD2Parse.subscribeTo(ON_EXIT_CHANGE, mqtt_on_state_change, (void *)ON_EXIT_CHANGE);
-    AD2Parse.subscribeTo(ON_LRR, mqtt_on_lrr, (void *)ON_LRR);
-    AD2Parse.subscribeTo(ON_CFG, mqtt_on_ad2cfg, (void *)ON_CFG);
-    AD2Parse.subscribeTo(ON_VER, mqtt_on_ad2cfg, (void *)ON_VER);
-    // SUbscribe to ON_ZONE_CHANGE events
-    AD2Parse.subscribeTo(ON_ZONE_CHANGE, mqtt_on_zone_change, (void *)ON_ZONE_CHANGE);
+/**
+ * @brief Stop the client and start it again with the loaded settings or
+ * leave it stopped if disabled.
+ *
+ * @param [in]pvParameters currently not used NULL.
+ */
+static void mqtt_restart_task(void *pvParameters)
+{
+    do {
+        while (mqtt_restart_requested.exchange(false)) {
+            mqtt_free();
+            if (mqtt_enabled) {
+                _mqtt_client_start();
+            }
+        }
+        mqtt_restart_running = false;
+        // Run again for a request made while the flag was being cleared.
+    } while (mqtt_restart_requested && !mqtt_restart_running.exchange(true));
+    vTaskDelete(NULL);
+}
 
-    // subscribe to firmware updates available events.
-    AD2Parse.subscribeTo(ON_FIRMWARE_VERSION, on_new_firmware_cb, nullptr);
+/**
+ * @brief Ask for a client restart. The network teardown happens on
+ * mqtt_restart_task so the caller can hold the parser lock.
+ */
+static void _mqtt_client_restart()
+{
+    mqtt_restart_requested = true;
+    if (!mqtt_restart_running.exchange(true)) {
+        xTaskCreate(&mqtt_restart_task, "mqtt restart", 1024*4, NULL, tskIDLE_PRIORITY+1, NULL);
+    }
+}
 
+/**
+ * @brief Build and subscribe the virtual switch searches.
+ *
+ * @return int number of switches subscribed.
+ */
+static int _mqtt_load_switches()
+{
     // Register search based virtual switches if enabled.
     // [switch N]
     int subscribers = 0;
+    std::vector<uint8_t> switches;
     for (int swID = 1; swID < AD2_MAX_SWITCHES; swID++) {
 
         // load switch settings for 'swID' and test if found
@@ -1370,6 +3270,7 @@ void mqtt_init()
 
                 // subscribe to the callback for events.
                 AD2Parse.subscribeTo(on_search_match_cb_mqtt, es1);
+                switches.push_back(swID);
 
                 // keep track of how many for user feedback.
                 subscribers++;
@@ -1387,6 +3288,182 @@ void mqtt_init()
         }
     }
 
+    // The discovery walk reads switch IDs from its own list.
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    mqtt_discovery.switches = switches;
+    xSemaphoreGive(mqtt_discovery_mutex);
+
+    // Intern the switch topics.
+    _mqtt_build_topics();
+
+    return subscribers;
+}
+
+/**
+ * @brief Unsubscribe and free the virtual switch searches.
+ */
+static void _mqtt_free_switches()
+{
+    for (auto *es : mqtt_AD2EventSearches) {
+        AD2Parse.unsubscribeTo(on_search_match_cb_mqtt, es);
+        delete es;
+    }
+    mqtt_AD2EventSearches.clear();
+}
+
+static void _mqtt_start();
+
+/**
+ * @brief Apply [mqtt] and [switch N] changes after a config reload.
+ *
+ * @details Called once per reload with the parser lock held. Switch
+ * searches are only rebuilt when a [switch N] section changed. The client
+ * is restarted on its own task when enable, the broker, a topic prefix or
+ * the command subscription changed. A client disabled at boot is started
+ * here once enabled.
+ *
+ * @param [in]sections changed sections.
+ * @param [in]arg not used.
+ */
+static void _mqtt_config_changed(std::vector<std::string> &sections, void *arg)
+{
+    bool settings_changed = false;
+    bool switches_changed = false;
+    for (auto &section : sections) {
+        if (section == MQTT_CONFIG_SECTION) {
+            settings_changed = true;
+        } else {
+            switches_changed = true;
+        }
+    }
+
+    bool en = false;
+    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_ENABLE_SUBCMD, &en);
+    if (!mqtt_started) {
+        if (en) {
+            _mqtt_start();
+            ad2_printf_host(true, "%s: Reload done. Client enabled.", TAG);
+        }
+        return;
+    }
+
+    int subscribers = -1;
+    if (switches_changed) {
+        _mqtt_free_switches();
+        subscribers = _mqtt_load_switches();
+    }
+
+    bool restart = false;
+    if (settings_changed) {
+        std::string url = mqttclient_URL;
+        std::string tprefix = mqttclient_TPREFIX;
+        std::string dprefix = mqttclient_DPREFIX;
+        bool cmden = commands_enabled;
+        _mqtt_load_settings();
+        restart = en != mqtt_enabled ||
+                  (mqtt_client && (url != mqttclient_URL || tprefix != mqttclient_TPREFIX ||
+                                   dprefix != mqttclient_DPREFIX || cmden != commands_enabled));
+        mqtt_enabled = en;
+        if (!en) {
+            ad2_dns_prefetch_clear(MQTT_CONFIG_SECTION);
+        }
+    }
+    if (restart) {
+        _mqtt_client_restart();
+    } else if (mqtt_client) {
+        // Publish only the discovery configs that changed.
+        _mqtt_discovery_start(false);
+    }
+    if (subscribers >= 0) {
+        ad2_printf_host(true, "%s: Reload done. Configured %i virtual switches.%s", TAG, subscribers,
+                        restart ? " Client restarting." : "");
+    } else {
+        ad2_printf_host(true, "%s: Reload done.%s", TAG,
+                        restart ? (en ? " Client restarting." : " Client stopping.") : "");
+    }
+}
+
+/**
+ * Initialize queue and SSL
+ */
+void mqtt_init()
+{
+    // Apply switch and client changes on config reload. This also starts
+    // the client if a reload enables it.
+    ad2_config_subscribe(MQTT_CONFIG_SECTION "," AD2SWITCH_CONFIG_SECTION, _mqtt_config_changed, nullptr);
+
+    bool en = false;
+    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_ENABLE_SUBCMD, &en);
+
+    // nothing more needs to be done once commands are set if not enabled.
+    if (!en) {
+        ad2_printf_host(true, "%s client disabled.", TAG);
+        return;
+    }
+    _mqtt_start();
+}
+
+/**
+ * @brief Set up the component and start the client startup task.
+ */
+static void _mqtt_start()
+{
+    mqtt_started = true;
+    mqtt_enabled = true;
+
+#if 0 // debug logging settings.
+    esp_log_level_set("MQTT_CLIENT", ESP_LOG_VERBOSE);
+    esp_log_level_set("TRANSPORT_TCP", ESP_LOG_VERBOSE);
+    esp_log_level_set("TRANSPORT_SSL", ESP_LOG_VERBOSE);
+    esp_log_level_set("esp-tls", ESP_LOG_VERBOSE);
+    esp_log_level_set("TRANSPORT", ESP_LOG_VERBOSE);
+    esp_log_level_set("OUTBOX", ESP_LOG_VERBOSE);
+#endif
+
+    mqtt_published_mutex = xSemaphoreCreateMutex();
+    mqtt_discovery_mutex = xSemaphoreCreateMutex();
+    mqtt_topics_mutex = xSemaphoreCreateMutex();
+    mqtt_outbox_mutex = xSemaphoreCreateMutex();
+    mqtt_zone_batch_mutex = xSemaphoreCreateMutex();
+
+    // Optional uSD outbox for publishes made while the broker is away.
+    bool outbox = false;
+    ad2_get_config_key_bool(MQTT_CONFIG_SECTION, MQTT_OUTBOX_SUBCMD, &outbox);
+    if (outbox) {
+        _mqtt_outbox_open();
+    }
+
+    // generate our client's unique user id. UUID.
+    ad2_genUUID(0x10, mqttclient_UUID);
+    ad2_printf_host(true, "%s: Init UUID: %s", TAG, mqttclient_UUID.c_str());
+
+    // Subscribe standard AlarmDecoder events
+    AD2Parse.subscribeTo(ON_ARM, mqtt_on_state_change, (void *)ON_ARM);
+    AD2Parse.subscribeTo(ON_DISARM, mqtt_on_state_change, (void *)ON_DISARM);
+    AD2Parse.subscribeTo(ON_CHIME_CHANGE, mqtt_on_state_change, (void *)ON_CHIME_CHANGE);
+    AD2Parse.subscribeTo(ON_BEEPS_CHANGE, mqtt_on_state_change, (void *)ON_BEEPS_CHANGE);
+    AD2Parse.subscribeTo(ON_FIRE_CHANGE, mqtt_on_state_change, (void *)ON_FIRE_CHANGE);
+    AD2Parse.subscribeTo(ON_POWER_CHANGE, mqtt_on_state_change, (void *)ON_POWER_CHANGE);
+    AD2Parse.subscribeTo(ON_READY_CHANGE, mqtt_on_state_change, (void *)ON_READY_CHANGE);
+    AD2Parse.subscribeTo(ON_LOW_BATTERY, mqtt_on_state_change, (void *)ON_LOW_BATTERY);
+    AD2Parse.subscribeTo(ON_ALARM_CHANGE, mqtt_on_state_change, (void *)ON_ALARM_CHANGE);
+    AD2Parse.subscribeTo(ON_ZONE_BYPASSED_CHANGE, mqtt_on_state_change, (void *)ON_ZONE_BYPASSED_CHANGE);
+    AD2Parse.subscribeTo(ON_EXIT_CHANGE, mqtt_on_state_change, (void *)ON_EXIT_CHANGE);
+    AD2Parse.subscribeTo(ON_LRR, mqtt_on_lrr, (void *)ON_LRR);
+    AD2Parse.subscribeTo(ON_CFG, mqtt_on_ad2cfg, (void *)ON_CFG);
+    AD2Parse.subscribeTo(ON_VER, mqtt_on_ad2cfg, (void *)ON_VER);
+    // SUbscribe to ON_ZONE_CHANGE events
+    AD2Parse.subscribeTo(ON_ZONE_CHANGE, mqtt_on_zone_change, (void *)ON_ZONE_CHANGE);
+    // Keypad text for the optional alpha topic.
+    AD2Parse.subscribeTo(ON_ALPHA_MESSAGE, mqtt_on_alpha_message, (void *)ON_ALPHA_MESSAGE);
+    // Parser batch boundaries close zone deltas.
+    AD2Parse.subscribeTo(mqtt_on_rx_data, nullptr);
+
+    // subscribe to firmware updates available events.
+    AD2Parse.subscribeTo(ON_FIRMWARE_VERSION, on_new_firmware_cb, nullptr);
+
+    int subscribers = _mqtt_load_switches();
+
     ad2_printf_host(true, "%s: Init done. Found and configured %i virtual switches.", TAG, subscribers);
     xTaskCreate(&mqtt_startup_task, "mqtt startup", 1024*4, NULL, tskIDLE_PRIORITY+1, NULL);
 }
@@ -25,8 +25,46 @@
 #define _MQTT_H
 #if CONFIG_AD2IOT_MQTT_CLIENT
 
+/**
+ * @brief MQTT state publish stats for `top`.
+ */
+typedef struct mqtt_stats {
+    uint32_t sent;        ///< state publishes queued to the client.
+    uint32_t suppressed;  ///< state publishes skipped as unchanged.
+    uint32_t topics;      ///< topics with a remembered content hash.
+    uint32_t cbor_sent;   ///< CBOR copies queued to the client or outbox.
+    uint32_t discovery_sent;       ///< discovery configs queued to the client.
+    uint32_t discovery_unchanged;  ///< discovery configs the broker already had.
+    uint32_t discovery_inflight;   ///< discovery configs waiting for a PUBACK.
+    bool discovery_walking;        ///< a discovery walk is in progress.
+    uint32_t discovery_ms;         ///< time the last complete walk took.
+    bool outbox_open;              ///< uSD outbox in use.
+    uint32_t outbox_depth;         ///< publishes waiting in the outbox.
+    uint32_t outbox_capacity;      ///< outbox records.
+    uint32_t outbox_inflight;      ///< replayed publishes waiting for a PUBACK.
+    uint32_t outbox_spooled;       ///< publishes written to the outbox.
+    uint32_t outbox_collapsed;     ///< retained publishes replaced by a newer one on the same topic.
+    uint32_t outbox_replayed;      ///< replayed publishes the broker acknowledged.
+    uint32_t outbox_session;       ///< of those, since the last connect.
+    uint32_t outbox_dropped;       ///< publishes lost to a full outbox or a bad record.
+    uint32_t outbox_write_errors;  ///< failed outbox file writes.
+    bool zone_batch;               ///< zone changes go out as partition deltas.
+    uint32_t zone_changes;         ///< zone changes received from the parser.
+    uint32_t zone_deltas;          ///< partition zone deltas published.
+    uint32_t zone_updates;         ///< per zone topic publishes.
+    uint32_t commands;             ///< messages on the commands topic.
+    uint32_t commands_queued;      ///< commands passed to the AD2 command queue.
+    uint32_t commands_dropped;     ///< accepted but not queued. Queue full or no partition state.
+    uint32_t commands_retained;    ///< retained commands ignored.
+    uint32_t commands_bad_size;    ///< empty, too long or fragmented payloads.
+    uint32_t commands_bad_json;    ///< payloads that are not a valid command object.
+    uint32_t commands_bad_action;  ///< missing or unknown action.
+    uint32_t commands_rate_limited;///< refused over the command rate.
+} mqtt_stats_t;
+
 void mqtt_register_cmds();
 void mqtt_init();
+void mqtt_get_stats(mqtt_stats_t *stats);
 
 #endif /* CONFIG_AD2IOT_MQTT_CLIENT */
 #endif /* _MQTT_H */
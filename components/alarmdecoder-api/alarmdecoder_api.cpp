@@ -381,8 +381,12 @@ void AlarmDecoderParser::notifySubscribers(ad2_event_t ev, std::string &msg, AD2
     }
 
     // save results of human readable event message.
+    // ON_ALPHA_MESSAGE bumps the version only when the keypad message changed.
     if (pstate) {
         pstate->last_event_message = emsg;
+        if (ev != ON_ALPHA_MESSAGE) {
+            pstate->version++;
+        }
     }
 
     // notify any direct subscribers to this event type.
@@ -409,6 +413,26 @@ void AlarmDecoderParser::subscribeTo(AD2SubScriber::AD2ParserCallback_sub_t fn,
     v.push_back(AD2SubScriber(fn, event_search));
 }
 
+/**
+ * @brief Remove a REGEX search subscription.
+ *
+ * @param [in]fn Callback pointer function type AD2ParserCallback_sub_t.
+ * @param [in]event_search search structure given to subscribeTo.
+ *
+ * @note The caller owns event_search and must free it after this returns.
+ */
+void AlarmDecoderParser::unsubscribeTo(AD2SubScriber::AD2ParserCallback_sub_t fn, AD2EventSearch *event_search)
+{
+    subscribers_t& v = AD2Subscribers[ON_SEARCH_MATCH];
+    for ( subscribers_t::iterator i = v.begin(); i != v.end(); ) {
+        if (i->fn == (void *)fn && i->varg == (void *)event_search) {
+            i = v.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
 /**
  * @brief Sequentially call each subscriber function in the list.
  *
@@ -942,6 +966,9 @@ bool AlarmDecoderParser::put(uint8_t *buff, int8_t len)
                         // call ON_ERR callback if enabled.
                         MESSAGE_TYPE = ERR_MESSAGE_TYPE;
                         notifySubscribers(ON_ERR, msg, nostate);
+                    } else if (msg.find("!Sending") == 0) {
+                        // call ON_SENDING_RECEIVED callback if enabled.
+                        notifySubscribers(ON_SENDING_RECEIVED, msg, nostate);
                     } else if (msg.find("!CONFIG>") == 0) {
                         // save the AlarmDecoder firmware configuration string if change.
                         std::string _new = msg.substr(8);
@@ -1253,6 +1280,19 @@ bool AlarmDecoderParser::put(uint8_t *buff, int8_t len)
                                      AD2PStates.size(),ad2ps->partition,amask,ad2ps->ready,ad2ps->armed_away,ad2ps->armed_stay,ad2ps->zone_bypassed,ad2ps->exit_now);
 #endif
 
+                            // New version if the bits, numeric or alpha sections or the
+                            // combined mask changed. The rest of section #3 is skipped.
+                            uint32_t keypad_hash = (2166136261UL ^ ad2ps->address_mask_filter) * 16777619UL;
+                            for (size_t i = 0; i < msg.length(); i++) {
+                                if (i < SECTION_3_START || i >= SECTION_4_START) {
+                                    keypad_hash = (keypad_hash ^ (uint8_t)msg[i]) * 16777619UL;
+                                }
+                            }
+                            if (keypad_hash != ad2ps->keypad_hash) {
+                                ad2ps->keypad_hash = keypad_hash;
+                                ad2ps->version++;
+                            }
+
                             // Call ON_ALPHA_MESSAGE callback if enabled.
                             notifySubscribers(ON_ALPHA_MESSAGE, msg, ad2ps);
 
@@ -343,6 +343,13 @@ public:
 
     // Zone # to AD2ZoneState map
     std::map<uint8_t, AD2ZoneState> zone_states;
+
+    // Bumped by the parser each time this state changes so readers can
+    // tell when anything cached from it is stale.
+    uint32_t version = 0;
+
+    // Hash of the keypad message sections that feed the state above.
+    uint32_t keypad_hash = 0;
 };
 
 /**
@@ -523,6 +530,9 @@ public:
     // Subscibe to ON_RAW_RX_DATA events.
     void subscribeTo(AD2SubScriber::AD2ParserCallbackRawRXData_sub_t fn, void *arg);
 
+    // Remove a search subscription. Does not free the AD2EventSearch.
+    void unsubscribeTo(AD2SubScriber::AD2ParserCallback_sub_t fn, AD2EventSearch *event_search);
+
     // Push data into state machine. Events fire if a complete message is
     // received.
     bool put(uint8_t *buf, int8_t len);
@@ -593,7 +603,7 @@ public:
         {ON_EXP,                "EXPANDER"},
         {ON_LRR,                "CONTACT ID"},
         {ON_RFX,                "RFX"},
-        /*      {ON_SENDING_RECEIVED,   "SEND ACK"}, */
+        {ON_SENDING_RECEIVED,   "SEND ACK"},
         {ON_AUI,                "AUI"},
         {ON_KPM,                "KPM"},
         {ON_KPE,                "KPE"},
@@ -1706,7 +1706,7 @@ int FTPD::waitForFTPClient()
 #if defined(FTPD_DEBUG)
     ESP_LOGI(TAG, "waitForFTPClient() start.");
 #endif
-    struct sockaddr_in clientAddress;
+    struct sockaddr_storage clientAddress = {};
     socklen_t clientAddressLength = sizeof(clientAddress);
     m_clientSocket = accept(m_serverSocket, (struct sockaddr *)&clientAddress, &clientAddressLength);
 
@@ -1717,12 +1717,10 @@ int FTPD::waitForFTPClient()
     // first test for a valid socket
     if (m_clientSocket != -1) {
 
-        // Convert client address to string for ACL testing.
-        std::string IP;
-        hal_get_socket_client_ip(m_clientSocket, IP);
-
         /* preform ACL test */
-        if (!ad2ftpd_acl.find(IP)) {
+        if (!ad2ftpd_acl.find(clientAddress)) {
+            std::string IP;
+            hal_get_socket_client_ip(m_clientSocket, IP);
             ESP_LOGI(TAG, "ACL reject connect from %s", IP.c_str());
             closeConnection();
             return -1;
@@ -348,7 +348,7 @@ static void network_cli_server_task(void *pvParameters)
 
             std::string client_ip;
             hal_get_socket_client_ip(client_socket, client_ip);
-            if (!network_cli_acl.find(client_ip)) {
+            if (!network_cli_acl.find(peer_address)) {
                 ESP_LOGW(TAG, "Rejected connection from '%s'", client_ip.c_str());
                 close(client_socket);
                 continue;
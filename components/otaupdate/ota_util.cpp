@@ -836,6 +836,9 @@ void ota_register_cmds()
  */
 void ota_init()
 {
+    // keep the update server resolved for the version checks.
+    ad2_dns_prefetch("ota", CONFIG_OTA_SERVER_URL);
+
     xTaskCreate(ota_polling_task_func, "AD2 ota check", 1024*4, NULL, tskIDLE_PRIORITY, NULL);
 }
 
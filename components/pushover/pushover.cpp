@@ -33,6 +33,7 @@ static const char *TAG = "PUSHOVER";
 #include "alarmdecoder_main.h"
 
 // specific includes
+#include "esp_rom_crc.h"
 
 //#define DEBUG_PUSHOVER
 #define AD2_DEFAULT_PUSHOVER_SLOT 0
@@ -84,6 +85,9 @@ public:
     esp_http_client_config_t* config_client;
 
     // Application specific
+    int notify_slot;
+    ad2_http_priority_t priority;
+    uint32_t spool_id;
     std::string token;
     std::string userkey;
     std::string message;
@@ -127,10 +131,19 @@ static void _sendQ_ready_handler(esp_http_client_handle_t client, esp_http_clien
 static bool _sendQ_done_handler(esp_err_t res, esp_http_client_handle_t client, esp_http_client_config_t *config)
 {
     request_message *r = (request_message*) config->user_data;
+
+    // Spool failed deliveries for retry. Release delivered retries.
+    bool retry = ad2_http_sendQ_should_retry(res, client);
+    if (retry) {
+        ESP_LOGW(TAG, "Notify slot #%i delivery failed(%i), queued for retry", r->notify_slot, res);
+    }
+    ad2_http_spool_report(AD2_HTTP_SRC_PUSHOVER, r->notify_slot, r->priority, r->message, r->spool_id, retry);
 #if defined(DEBUG_PUSHOVER)
-    ESP_LOGI(TAG, "perform results = %d HTTP Status = %d, response length = %d response = '%s'", res,
-             esp_http_client_get_status_code(client),
-             esp_http_client_get_content_length(client), r->results.c_str());
+    if (client) {
+        ESP_LOGI(TAG, "perform results = %d HTTP Status = %d, response length = %d response = '%s'", res,
+                 esp_http_client_get_status_code(client),
+                 esp_http_client_get_content_length(client), r->results.c_str());
+    }
 #endif
     // free message_data class will also delete the client_config in the distructor.
     delete r;
@@ -172,6 +185,9 @@ esp_err_t _pushover_http_event_handler(esp_http_client_event_t *evt)
 #if defined(DEBUG_PUSHOVER)
         ESP_LOGI(TAG, "HTTP_EVENT_HEADERS_SENT");
 #endif
+        // A new attempt. Drop anything a failed one left behind.
+        r = (request_message *)evt->user_data;
+        r->results.clear();
         break;
     case HTTP_EVENT_ON_FINISH:
 #if defined(DEBUG_PUSHOVER)
@@ -203,6 +219,77 @@ esp_err_t _pushover_http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+/**
+ * @brief Build a Pushover request for a notify slot and add it to the sendQ.
+ *
+ * @param [in]notify_slot uint8_t
+ * @param [in]message std::string & message to send.
+ * @param [in]priority ad2_http_priority_t sendQ lane.
+ * @param [in]spool_id uint32_t spool record being retried or 0.
+ *
+ * @return bool true if queued.
+ */
+static bool _queue_request(uint8_t notify_slot, const std::string &message, ad2_http_priority_t priority, uint32_t spool_id)
+{
+    // Container to store details needed for delivery.
+    request_message *r = new request_message();
+
+    r->notify_slot = notify_slot;
+    r->priority = priority;
+    r->spool_id = spool_id;
+
+    // load our settings for this event type.
+    // get the pushover user key
+    ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_USERKEY_SUBCMD, r->userkey, notify_slot);
+
+    // get the pushover api token
+    ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_TOKEN_SUBCMD, r->token, notify_slot);
+
+    // save the message
+    r->message = message;
+
+    // Settings specific for http_client_config
+    r->config_client->url = PUSHOVER_URL;
+    // set request type
+    r->config_client->method = HTTP_METHOD_POST;
+
+    // optional define an internal event handler
+    r->config_client->event_handler = _pushover_http_event_handler;
+
+    // required save internal class to user_data to be used in callback.
+    r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
+
+    // Fails, but not needed to work.
+    // config_client->use_global_ca_store = true;
+
+    // Add client config to the http_sendQ for processing. Alarms go
+    // ahead of other notifications and a repeat of the same message
+    // to the same slot may be merged when the queue is full.
+    uint32_t key = esp_rom_crc32_le(notify_slot, (const uint8_t *)message.data(), message.length());
+    bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler,
+                                  AD2_HTTP_SRC_PUSHOVER, priority, key ? key : 1);
+    if (!res) {
+        ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
+        // destroy storage class if we fail to add to the sendQ
+        delete r;
+    }
+    return res;
+}
+
+/**
+ * @brief sendQ spool replay callback. Send a notification again that
+ * failed earlier, possibly before a restart.
+ */
+static bool _spool_replay(uint8_t notify_slot, const std::string &message, ad2_http_priority_t priority, uint32_t spool_id)
+{
+    ESP_LOGI(TAG, "Retrying '%s' to acid #%i", message.c_str(), notify_slot);
+    if (!_queue_request(notify_slot, message, priority, spool_id)) {
+        // count it as a failed attempt so it backs off.
+        ad2_http_spool_report(AD2_HTTP_SRC_PUSHOVER, notify_slot, priority, message, spool_id, true);
+    }
+    return true;
+}
+
 /**
  * @brief SmartSwitch match callback.
  * Called when the current message matches a AD2EventSearch test.
@@ -211,7 +298,8 @@ esp_err_t _pushover_http_event_handler(esp_http_client_event_t *evt)
  * @param [in]s nullptr
  * @param [in]arg nullptr.
  *
- * @note No full queue handler
+ * @note Merged with other messages to the slot inside the notify window.
+ * A full queue evicts or coalesces. Failed requests are spooled.
  */
 void on_search_match_cb_pushover(std::string *msg, AD2PartitionState *s, void *arg)
 {
@@ -221,43 +309,9 @@ void on_search_match_cb_pushover(std::string *msg, AD2PartitionState *s, void *a
     // es->PTR_ARG is the notification slots std::list for this notification.
     std::list<uint8_t> *notify_list = (std::list<uint8_t>*)es->PTR_ARG;
     for (uint8_t const& notify_slot : *notify_list) {
-
-        // Container to store details needed for delivery.
-        request_message *r = new request_message();
-
-        // load our settings for this event type.
-        // get the pushover user key
-        ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_USERKEY_SUBCMD, r->userkey, notify_slot);
-
-        // get the pushover api token
-        ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_TOKEN_SUBCMD, r->token, notify_slot);
-
-        // save the message
-        r->message = es->out_message;
-
-        // Settings specific for http_client_config
-        r->config_client->url = PUSHOVER_URL;
-        // set request type
-        r->config_client->method = HTTP_METHOD_POST;
-
-        // optional define an internal event handler
-        r->config_client->event_handler = _pushover_http_event_handler;
-
-        // required save internal class to user_data to be used in callback.
-        r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
-
-        // Fails, but not needed to work.
-        // config_client->use_global_ca_store = true;
-
-        // Add client config to the http_sendQ for processing.
-        bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler);
-        if (res) {
-            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), es->out_message.c_str(), notify_slot);
-        } else {
-            ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
-            // destroy storage class if we fail to add to the sendQ
-            delete r;
-        }
+        // Messages to the same slot close together are sent as one.
+        ad2_http_notify(AD2_HTTP_SRC_PUSHOVER, notify_slot, es->out_message, ad2_http_sendQ_priority(msg), _queue_request);
+        ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), es->out_message.c_str(), notify_slot);
     }
 }
 
@@ -461,11 +515,12 @@ void pushover_register_cmds()
 }
 
 /**
- * Initialize component
+ * @brief Build and subscribe the virtual switch searches.
+ *
+ * @return int number of switches subscribed.
  */
-void pushover_init()
+static int _pushover_load_switches()
 {
-
     // Register search based virtual switches if enabled.
     // [switch N]
     int subscribers = 0;
@@ -617,6 +672,57 @@ void pushover_init()
         }
     }
 
+    return subscribers;
+}
+
+/**
+ * @brief Unsubscribe and free the virtual switch searches.
+ */
+static void _pushover_free_switches()
+{
+    for (auto *es : pushover_AD2EventSearches) {
+        AD2Parse.unsubscribeTo(on_search_match_cb_pushover, es);
+        delete (std::list<uint8_t> *)es->PTR_ARG;
+        delete es;
+    }
+    pushover_AD2EventSearches.clear();
+}
+
+/**
+ * @brief Rebuild the virtual switches after a config reload.
+ *
+ * @param [in]sections changed sections.
+ * @param [in]arg not used.
+ */
+static void _pushover_config_changed(std::vector<std::string> &sections, void *arg)
+{
+    _pushover_free_switches();
+    int subscribers = _pushover_load_switches();
+    ad2_dns_prefetch_clear(PUSHOVER_CONFIG_SECTION);
+    if (subscribers) {
+        ad2_dns_prefetch(PUSHOVER_CONFIG_SECTION, PUSHOVER_URL);
+    }
+    ad2_printf_host(true, "%s: Reload done. Configured %i virtual switches.", TAG, subscribers);
+}
+
+/**
+ * Initialize component
+ */
+void pushover_init()
+{
+    int subscribers = _pushover_load_switches();
+
+    // Failed notifications come back here from the sendQ spool.
+    ad2_http_spool_register(AD2_HTTP_SRC_PUSHOVER, _spool_replay);
+
+    // keep the API host resolved if anything will notify.
+    if (subscribers) {
+        ad2_dns_prefetch(PUSHOVER_CONFIG_SECTION, PUSHOVER_URL);
+    }
+
+    // Apply switch changes on config reload.
+    ad2_config_subscribe(PUSHOVER_CONFIG_SECTION "," AD2SWITCH_CONFIG_SECTION, _pushover_config_changed, nullptr);
+
     ad2_printf_host(true, "%s: Init done. Found and configured %i virtual switches.", TAG, subscribers);
 
 }
@@ -626,6 +732,7 @@ void pushover_init()
  */
 void pushover_free()
 {
+    _pushover_free_switches();
 }
 
 #endif /*  CONFIG_AD2IOT_PUSHOVER_CLIENT */
@@ -680,9 +680,9 @@ static bool _poll_read_fdset(fd_set *read_fdset)
             if (fd_type == LISTEN_SOCKET) {
                 /* clear our state vars */
                 newsockfd = -1;
+                struct sockaddr_storage peer_addr = {};
                 {
                     socklen_t addr_len;
-                    struct sockaddr_storage peer_addr = {};
                     addr_len = sizeof(peer_addr);
                     newsockfd = accept(fd, (struct sockaddr *) &peer_addr, &addr_len);
                 }
@@ -690,12 +690,12 @@ static bool _poll_read_fdset(fd_set *read_fdset)
                     /* reset our added id to a bad state */
                     added_slot = -2;
 
-                    // Convert client address to string for ACL testing.
+                    // Client address string for logging.
                     std::string IP;
-                    hal_get_socket_client_ip(newsockfd, IP);
 
                     /* ACL test */
-                    if (!ser2sock_acl.find(IP)) {
+                    if (!ser2sock_acl.find(peer_addr)) {
+                        hal_get_socket_client_ip(newsockfd, IP);
                         struct linger lo = { 1, 0 };
                         setsockopt(newsockfd, SOL_SOCKET, SO_LINGER, &lo, sizeof(lo));
                         close(newsockfd);
@@ -704,6 +704,7 @@ static bool _poll_read_fdset(fd_set *read_fdset)
                         added_slot = _add_fd(newsockfd, CLIENT_SOCKET);
                         if (added_slot >= 0) {
 #if defined(S2SD_DEBUG)
+                            hal_get_socket_client_ip(newsockfd, IP);
                             ESP_LOGI(TAG, "Socket connected slot %i from %s", added_slot, IP.c_str());
 #endif
                             did_work = true;
@@ -752,7 +753,7 @@ static bool _poll_read_fdset(fd_set *read_fdset)
 #endif
                         // FIXME: overide to send raw pointer and not buffer.
                         std::string tmp(buffer, received);
-                        ad2_send(tmp);
+                        ad2_send(tmp, AD2_SEND_SRC_SER2SOCK);
                     }
                 }
             }
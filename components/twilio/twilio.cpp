@@ -33,7 +33,10 @@ static const char *TAG = "TWILIO";
 #include "alarmdecoder_main.h"
 
 // specific includes
+#include "esp_rom_crc.h"
 #include <fmt/core.h>
+#include <fmt/format.h>
+#include <memory>
 
 //#define DEBUG_TWILIO
 
@@ -79,6 +82,35 @@ enum {
     TWILIO_NEXT_STATE_GET,
 };
 
+/**
+ * @brief Parts of a notify slot request that do not change per message.
+ * Rendered once when the config is loaded. A request holds a reference
+ * so a reload does not free it while the request is in the sendQ.
+ */
+struct tw_slot_render {
+    // TWILIO_NOTIFY_* type or 0 if not set.
+    char type = 0;
+    // slot disabled.
+    bool disabled = false;
+    // API URL for the first POST.
+    std::string url;
+    // Authorization header value.
+    std::string auth_header;
+    // Body before the message. Encoded To/From and the message key.
+    std::string head;
+    // SendGrid body between the subject and the content message.
+    std::string mid;
+    // Body after the message.
+    std::string tail;
+    // Twiml format template for calls.
+    std::string format;
+};
+typedef std::shared_ptr<const tw_slot_render> tw_slot_ptr;
+
+// notify slot -> rendered parts.
+static std::map<uint8_t, tw_slot_ptr> _tw_slots;
+static SemaphoreHandle_t _tw_slots_mutex = nullptr;
+
 /**
  * @brief class that will be stored in the sendQ for each request.
  */
@@ -89,6 +121,7 @@ public:
     {
         config_client = (esp_http_client_config_t *)calloc(1, sizeof(esp_http_client_config_t));
         state = TWILIO_NEXT_STATE_DONE;
+        reported = false;
     }
     ~tw_request_message()
     {
@@ -102,6 +135,10 @@ public:
 
     // Application specific
     int notify_slot;
+    tw_slot_ptr slot;
+    ad2_http_priority_t priority;
+    uint32_t spool_id;
+    bool reported;
     std::string message;
     std::string url;
     std::string post;
@@ -110,165 +147,173 @@ public:
 };
 
 /**
- * Build the json POST body for a twilio Call API call
- *   https://www.twilio.com/docs/sms/api/message-resource
- *   https://stackoverflow.com/questions/48898162/interactive-voice-menu-on-twilio-twiml
+ * @brief Render the static parts of a notify slot request from config.
+ *
+ * @param [in]notify_slot uint8_t
+ *
+ * @return tw_slot_ptr
  */
-static void _build_twilio_message_post(esp_http_client_handle_t client, tw_request_message *r)
+static tw_slot_ptr _render_slot(uint8_t notify_slot)
 {
-    esp_err_t err;
-    std::string auth_header;
-
-    // get token for this notification slot from config.
-    std::string sidString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, r->notify_slot);
+    tw_slot_render *sr = new tw_slot_render();
 
-    // get sid for this notification slot from config.
-    std::string tokenString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, r->notify_slot);
+    ad2_get_config_key_bool(TWILIO_CONFIG_SECTION, TWILIO_DISABLE_SUBCMD, &sr->disabled, notify_slot);
 
-    // Set the Authorization header
-    auth_header = "Basic " + ad2_make_basic_auth_string(sidString, tokenString);
-    esp_http_client_set_header(client, "Authorization", auth_header.c_str());
+    // get twilio [type] : Used to determine delivery settings using SendGrid or twilio servers.
+    std::string type;
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TYPE_SUBCMD, type, notify_slot);
+    sr->type = type.length() ? type[0] : 0;
 
-    // get from for this notification slot from config.
+    std::string sidString;
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, notify_slot);
+    std::string tokenString;
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, notify_slot);
     std::string fromString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, fromString, r->notify_slot);
-
-    // get to for this notification slot from config.
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, fromString, notify_slot);
     std::string toString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, toString, r->notify_slot);
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, toString, notify_slot);
+
+    switch(sr->type) {
+
+    // Twilio Call api
+    //     https://www.twilio.com/docs/voice/api/sip-making-calls
+    //     https://stackoverflow.com/questions/48898162/interactive-voice-menu-on-twilio-twiml
+    case TWILIO_NOTIFY_CALL[0]:
+    // Twilio Messages api
+    //     https://www.twilio.com/docs/sms/api/message-resource
+    case TWILIO_NOTIFY_MESSAGE[0]:
+        sr->url = ad2_string_printf(TWILIO_URL_FMT, sidString.c_str(),
+                                    sr->type == TWILIO_NOTIFY_CALL[0] ? "Calls.json" : "Messages.json");
+        sr->auth_header = "Basic " + ad2_make_basic_auth_string(sidString, tokenString);
+        sr->head = "To=";
+        ad2_urlencode_append(sr->head, toString.data(), toString.length());
+        sr->head += "&From=";
+        ad2_urlencode_append(sr->head, fromString.data(), fromString.length());
+        sr->head += sr->type == TWILIO_NOTIFY_CALL[0] ? "&Twiml=" : "&Body=";
+        if (sr->type == TWILIO_NOTIFY_CALL[0]) {
+            // TODO: Multiple args by splitting the message using , or |
+            ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FORMAT_SUBCMD, sr->format, notify_slot);
+        }
+        break;
 
-    // Set post body
-    r->post = "To=" + ad2_urlencode(toString) + "&From=" + ad2_urlencode(fromString) + \
-              "&Body=" + ad2_urlencode(r->message);
+    // SendGrid Email api.
+    //     https://docs.sendgrid.com/api-reference/mail-send/mail-send
+    case TWILIO_NOTIFY_EMAIL[0]: {
+        sr->url = SENDGRID_URL;
+        sr->auth_header = "Bearer " + tokenString;
+
+        // {"personalizations":[{"to":[{"email":"A"}]},...],"from":{"email":"F"},
+        //  "subject":"AD2 ALERT 'M'","content":[{"type":"text/plain","value":"M"}]}
+        sr->head = "{\"personalizations\":[";
+        std::vector<std::string> to_list;
+        ad2_tokenize(toString, ", ", to_list);
+        bool first = true;
+        for (auto &szto : to_list) {
+            sr->head += first ? "" : ",";
+            sr->head += "{\"to\":[{\"email\":\"";
+            ad2_json_escape_append(sr->head, szto.data(), szto.length());
+            sr->head += "\"}]}";
+            first = false;
+        }
+        sr->head += "],\"from\":{\"email\":\"";
+        ad2_json_escape_append(sr->head, fromString.data(), fromString.length());
+        sr->head += "\"},\"subject\":\"AD2 ALERT '";
+        sr->mid = "'\",\"content\":[{\"type\":\"text/plain\",\"value\":\"";
+        sr->tail = "\"}]}";
+        break;
+    }
 
-    // does not copy data just a pointer so we have to maintain memory.
-    err = esp_http_client_set_post_field(client, r->post.c_str(), r->post.length());
+    // Unknown. Reported when a message is queued.
+    default:
+        break;
+    }
+
+    // keep the API host resolved.
+    if (sr->url.length() && !sr->disabled) {
+        ad2_dns_prefetch(TWILIO_CONFIG_SECTION, sr->url);
+    }
+
+    return tw_slot_ptr(sr);
 }
 
 /**
- * Build the json POST body for a twilio Message API call
- *   https://www.twilio.com/docs/voice/api/sip-making-calls
+ * @brief Get the rendered parts for a notify slot. Rendered on first use
+ * after a config load.
+ *
+ * @param [in]notify_slot uint8_t
+ *
+ * @return tw_slot_ptr
  */
-static void _build_twilio_call_post(esp_http_client_handle_t client, tw_request_message *r)
+static tw_slot_ptr _get_slot(uint8_t notify_slot)
 {
-    esp_err_t err;
-    std::string auth_header;
-
-    // get sid for this notification slot from config.
-    std::string sidString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, r->notify_slot);
-
-    // get token for this notification slot from config.
-    std::string tokenString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, r->notify_slot);
-
-    // Set the Authorization header
-    auth_header = "Basic " + ad2_make_basic_auth_string(sidString, tokenString);
-    esp_http_client_set_header(client, "Authorization", auth_header.c_str());
-
-    // Build the Twiml message using the format and message as the arg
-    // TODO: Multiple args by splitting r->message using , or |
-
-    // get format template string for this notification slot from config.
-    std::string formatString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FORMAT_SUBCMD, formatString, r->notify_slot);
-
-    // get from for this notification slot from config.
-    std::string fromString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, fromString, r->notify_slot);
-
-    // get to for this notification slot from config.
-    std::string toString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, toString, r->notify_slot);
-
-    std::string twiml = fmt::format(fmt::runtime(formatString), r->message);
-#if defined(DEBUG_TWILIO)
-    ESP_LOGI(TAG, "Sending Twiml message: %s", twiml.c_str());
-#endif
-
-    // Set post body
-    r->post = "To=" + ad2_urlencode(toString) + "&From=" + ad2_urlencode(fromString) + \
-              "&Twiml=" + ad2_urlencode(twiml);
-
-    // does not copy data just a pointer so we have to maintain memory.
-    err = esp_http_client_set_post_field(client, r->post.c_str(), r->post.length());
+    tw_slot_ptr sp;
+    xSemaphoreTake(_tw_slots_mutex, portMAX_DELAY);
+    auto it = _tw_slots.find(notify_slot);
+    if (it != _tw_slots.end()) {
+        sp = it->second;
+    }
+    xSemaphoreGive(_tw_slots_mutex);
+
+    if (!sp) {
+        // config reads are done outside of the lock.
+        sp = _render_slot(notify_slot);
+        xSemaphoreTake(_tw_slots_mutex, portMAX_DELAY);
+        _tw_slots[notify_slot] = sp;
+        xSemaphoreGive(_tw_slots_mutex);
+    }
+    return sp;
 }
 
 /**
- * Build the json POST body for a sendgrid message API call
+ * @brief Drop all rendered slots. They are rendered again on next use.
+ * Requests in the sendQ keep their own reference.
  */
-static void _build_sendgrid_post(esp_http_client_handle_t client, tw_request_message *r)
+static void _clear_slots()
 {
-    esp_err_t err;
-
-    // get sid for this notification slot from config.
-    std::string tokenString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, r->notify_slot);
-
-    // Set the Authorization header
-    std::string auth_header = "Bearer " + tokenString;
-    esp_http_client_set_header(client, "Authorization", auth_header.c_str());
-
-    // object: root
-    cJSON *_root = cJSON_CreateObject();
-
-    // array: personalizations
-    cJSON *_personalizations = cJSON_CreateArray();
+    xSemaphoreTake(_tw_slots_mutex, portMAX_DELAY);
+    _tw_slots.clear();
+    xSemaphoreGive(_tw_slots_mutex);
+}
 
-    // get from for this notification slot from config.
-    std::string fromString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, fromString, r->notify_slot);
-
-    // object: from
-    cJSON *_from = cJSON_CreateObject();
-    cJSON_AddStringToObject(_from, "email", fromString.c_str());
-
-    // array: content
-    cJSON *_content = cJSON_CreateArray();
-    cJSON *_text = cJSON_CreateObject();
-    cJSON_AddItemToArray(_content, _text);
-    cJSON_AddStringToObject(_text, "type", "text/plain");
-    cJSON_AddStringToObject(_text, "value", r->message.c_str());
-
-    // add top level items to root
-    cJSON_AddStringToObject(_root, "subject", ad2_string_printf("AD2 ALERT '%s'", r->message.c_str()).c_str());
-    cJSON_AddItemToObject(_root, "from", _from);
-    cJSON_AddItemToObject(_root, "personalizations", _personalizations);
-    cJSON_AddItemToObject(_root, "content", _content);
-
-    // get from for this notification slot from config.
-    std::string toString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, toString, r->notify_slot);
-
-    // _personalizations -> to[]
-    std::vector<std::string> to_list;
-    ad2_tokenize(toString, ", ", to_list);
-    for (auto &szto : to_list) {
-        cJSON *_to = cJSON_CreateArray();
-        cJSON *_pitem = cJSON_CreateObject();
-        cJSON_AddItemToArray(_personalizations, _pitem);
-        cJSON_AddItemToObject(_pitem, "to", _to);
-        cJSON *_email = cJSON_CreateObject();
-        cJSON_AddItemToArray(_to, _email);
-        cJSON_AddStringToObject(_email, "email", szto.c_str());
+/**
+ * @brief Render the POST body for a request in one pass into a buffer
+ * sized for the worst case.
+ *
+ * @param [in]r tw_request_message *
+ */
+static void _render_post(tw_request_message *r)
+{
+    const tw_slot_render &sr = *r->slot;
+    const std::string &m = r->message;
+
+    switch(sr.type) {
+    case TWILIO_NOTIFY_CALL[0]: {
+        // Twiml from the slot format. Small results stay on the stack.
+        fmt::memory_buffer twiml;
+        fmt::format_to(std::back_inserter(twiml), fmt::runtime(sr.format), m);
+#if defined(DEBUG_TWILIO)
+        ESP_LOGI(TAG, "Sending Twiml message: %.*s", (int)twiml.size(), twiml.data());
+#endif
+        r->post.reserve(sr.head.length() + twiml.size() * 3);
+        r->post = sr.head;
+        ad2_urlencode_append(r->post, twiml.data(), twiml.size());
+        break;
+    }
+    case TWILIO_NOTIFY_MESSAGE[0]:
+        r->post.reserve(sr.head.length() + m.length() * 3);
+        r->post = sr.head;
+        ad2_urlencode_append(r->post, m.data(), m.length());
+        break;
+    case TWILIO_NOTIFY_EMAIL[0]:
+        // only control characters escape to more than 2 bytes.
+        r->post.reserve(sr.head.length() + sr.mid.length() + sr.tail.length() + m.length() * 4);
+        r->post = sr.head;
+        ad2_json_escape_append(r->post, m.data(), m.length());
+        r->post += sr.mid;
+        ad2_json_escape_append(r->post, m.data(), m.length());
+        r->post += sr.tail;
+        break;
     }
-
-    // Build and save final json string and cleanup
-    char *json = NULL;
-    json = cJSON_Print(_root);
-    r->post = json;
-
-    // does not copy data just a pointer so we have to maintain memory.
-    err = esp_http_client_set_post_field(client, r->post.c_str(), r->post.length());
-
-    // set content type to json
-    esp_http_client_set_header(client, "Content-Type", "application/json; charset=utf-8");
-
-    cJSON_free(json);
-    cJSON_Delete(_root);
-
 }
 
 /**
@@ -282,33 +327,18 @@ static void _sendQ_ready_handler(esp_http_client_handle_t client, esp_http_clien
     if (client) {
         tw_request_message *r = (tw_request_message*) config->user_data;
 
-        // get twilio [type] : Used to determine delivery settings using SendGrid or twilio servers.
-        std::string type;
-        ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TYPE_SUBCMD, type, r->notify_slot);
-        type.resize(1);
-
-        // Build POST based upon notification type
-        switch(type[0]) {
-
-        // Twilio Call api
-        //     https://www.twilio.com/docs/voice/api/sip-making-calls
-        case TWILIO_NOTIFY_CALL[0]:
-            _build_twilio_call_post(client, r);
-            break;
-
-        // Twilio Messages api
-        //     https://www.twilio.com/docs/sms/api/message-resource
-        case TWILIO_NOTIFY_MESSAGE[0]:
-            _build_twilio_message_post(client, r);
-            break;
-
-        // SendGrid Email api.
-        //     https://docs.sendgrid.com/api-reference/mail-send/mail-send
-        case TWILIO_NOTIFY_EMAIL[0]:
-            _build_sendgrid_post(client, r);
-            break;
+        // Set the Authorization header
+        esp_http_client_set_header(client, "Authorization", r->slot->auth_header.c_str());
 
+        // set content type to json
+        if (r->slot->type == TWILIO_NOTIFY_EMAIL[0]) {
+            esp_http_client_set_header(client, "Content-Type", "application/json; charset=utf-8");
         }
+
+        // Render the body and set it. Does not copy data just a pointer
+        // so we have to maintain memory.
+        _render_post(r);
+        esp_http_client_set_post_field(client, r->post.c_str(), r->post.length());
     }
 }
 
@@ -326,10 +356,23 @@ static void _sendQ_ready_handler(esp_http_client_handle_t client, esp_http_clien
 static bool _sendQ_done_handler(esp_err_t res, esp_http_client_handle_t client, esp_http_client_config_t *config)
 {
     tw_request_message *r = (tw_request_message*) config->user_data;
+
+    // Spool a failed POST for retry. Release a delivered retry. A later
+    // status GET does not change the outcome.
+    if (!r->reported) {
+        r->reported = true;
+        bool retry = ad2_http_sendQ_should_retry(res, client);
+        if (retry) {
+            ESP_LOGW(TAG, "Notify slot #%i delivery failed(%i), queued for retry", r->notify_slot, res);
+        }
+        ad2_http_spool_report(AD2_HTTP_SRC_TWILIO, r->notify_slot, r->priority, r->message, r->spool_id, retry);
+    }
 #if defined(DEBUG_TWILIO)
-    ESP_LOGI(TAG, "perform results = %d HTTP Status = %d, response length = %d response = '%s'", res,
-             esp_http_client_get_status_code(client),
-             esp_http_client_get_content_length(client), r->results.c_str());
+    if (client) {
+        ESP_LOGI(TAG, "perform results = %d HTTP Status = %d, response length = %d response = '%s'", res,
+                 esp_http_client_get_status_code(client),
+                 esp_http_client_get_content_length(client), r->results.c_str());
+    }
 #endif
 
     // parse some data from json response if one exists.
@@ -398,10 +441,10 @@ static bool _sendQ_done_handler(esp_err_t res, esp_http_client_handle_t client,
         cJSON_Delete(root);
     }
 
-    ESP_LOGI(TAG,"Notify slot #%i response code: '%i' status: '%s' message: '%s'", r->notify_slot, esp_http_client_get_status_code(client), szStatus.c_str(), szMessage.c_str());
+    ESP_LOGI(TAG,"Notify slot #%i response code: '%i' status: '%s' message: '%s'", r->notify_slot, client ? esp_http_client_get_status_code(client) : 0, szStatus.c_str(), szMessage.c_str());
 
     // If first request was OK and we are scheduled to make GET for details.
-    if (res == ESP_OK && r->state == TWILIO_NEXT_STATE_GET) {
+    if (client && res == ESP_OK && r->state == TWILIO_NEXT_STATE_GET) {
 
         // Last thing we will do and we are done.
         r->state = TWILIO_NEXT_STATE_DONE;
@@ -459,6 +502,9 @@ esp_err_t _twilio_http_event_handler(esp_http_client_event_t *evt)
 #if defined(DEBUG_TWILIO)
         ESP_LOGI(TAG, "HTTP_EVENT_HEADERS_SENT");
 #endif
+        // A new attempt. Drop anything a failed one left behind.
+        r = (tw_request_message *)evt->user_data;
+        r->results.clear();
         break;
     case HTTP_EVENT_ON_FINISH:
 #if defined(DEBUG_TWILIO)
@@ -490,6 +536,100 @@ esp_err_t _twilio_http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+/**
+ * @brief Build a Twilio or SendGrid request for a notify slot and add it to the sendQ.
+ *
+ * @param [in]notify_slot uint8_t
+ * @param [in]message std::string & message to send.
+ * @param [in]priority ad2_http_priority_t sendQ lane.
+ * @param [in]spool_id uint32_t spool record being retried or 0.
+ *
+ * @return bool true if queued.
+ */
+static bool _queue_request(uint8_t notify_slot, const std::string &message, ad2_http_priority_t priority, uint32_t spool_id)
+{
+    // Container to store details needed for delivery.
+    tw_request_message *r = new tw_request_message();
+
+    // save the Account storage ID for the notification.
+    r->notify_slot = notify_slot;
+    r->priority = priority;
+    r->spool_id = spool_id;
+
+    // save the message
+    r->message = message;
+
+    // static parts of the request rendered at config load.
+    r->slot = _get_slot(notify_slot);
+
+    // Configure the URL based upon the request type.
+    switch(r->slot->type) {
+
+    // Twilio Call api. POST and parse resutls for url to query.
+    case TWILIO_NOTIFY_CALL[0]:
+        r->state = TWILIO_NEXT_STATE_GET;
+        break;
+
+    // Twilio Messages api and SendGrid Email api. Single POST request then done
+    case TWILIO_NOTIFY_MESSAGE[0]:
+    case TWILIO_NOTIFY_EMAIL[0]:
+        r->state = TWILIO_NEXT_STATE_DONE;
+        break;
+
+    // Unknown.
+    default:
+        ESP_LOGW(TAG, "Unknown message type '%c' aborting adding to sendQ.", r->slot->type);
+        // destroy storage class if we fail to add to the sendQ
+        delete r;
+        return false;
+    }
+
+    // set pointer to the slot URL. Held by r->slot.
+    r->config_client->url = r->slot->url.c_str();
+
+    // set request type
+    r->config_client->method = HTTP_METHOD_POST;
+
+    // optional define an internal event handler
+    r->config_client->event_handler = _twilio_http_event_handler;
+
+    // required save internal class to user_data to be used in callback.
+    r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
+
+    // Add client config to the http_sendQ for processing. Alarms go
+    // ahead of other notifications and a repeat of the same message
+    // to the same slot may be merged when the queue is full.
+    uint32_t key = esp_rom_crc32_le(notify_slot, (const uint8_t *)message.data(), message.length());
+    bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler,
+                                  AD2_HTTP_SRC_TWILIO, priority, key ? key : 1);
+    if (!res) {
+        ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
+        // destroy storage class if we fail to add to the sendQ
+        delete r;
+    }
+    return res;
+}
+
+/**
+ * @brief sendQ spool replay callback. Send a notification again that
+ * failed earlier, possibly before a restart.
+ */
+static bool _spool_replay(uint8_t notify_slot, const std::string &message, ad2_http_priority_t priority, uint32_t spool_id)
+{
+    // slot disabled since it failed. Drop it.
+    if (_get_slot(notify_slot)->disabled) {
+        ad2_http_spool_report(AD2_HTTP_SRC_TWILIO, notify_slot, priority, message, spool_id, false);
+        return true;
+    }
+
+    ESP_LOGI(TAG, "Retrying '%s' to acid #%i", message.c_str(), notify_slot);
+    if (!_queue_request(notify_slot, message, priority, spool_id)) {
+        // count it as a failed attempt so it backs off.
+        ad2_http_spool_report(AD2_HTTP_SRC_TWILIO, notify_slot, priority, message, spool_id, true);
+    }
+    return true;
+}
+
 /**
  * @brief SmartSwitch match callback.
  * Called when the current message matches a AD2EventSearch test.
@@ -498,7 +638,8 @@ esp_err_t _twilio_http_event_handler(esp_http_client_event_t *evt)
  * @param [in]s nullptr
  * @param [in]arg nullptr.
  *
- * @note No full queue handler
+ * @note Merged with other messages to the slot inside the notify window.
+ * A full queue evicts or coalesces. Failed requests are spooled.
  */
 void on_search_match_cb_tw(std::string *msg, AD2PartitionState *s, void *arg)
 {
@@ -513,90 +654,13 @@ void on_search_match_cb_tw(std::string *msg, AD2PartitionState *s, void *arg)
 
         // skip if this notification slot if disabled.
         // cli example: twilio disable 1 true
-        bool bDiabled = false;
-        ad2_get_config_key_bool(TWILIO_CONFIG_SECTION, TWILIO_DISABLE_SUBCMD, &bDiabled, notify_slot);
-        if (bDiabled) {
+        if (_get_slot(notify_slot)->disabled) {
             continue;
         }
 
-        // Container to store details needed for delivery.
-        tw_request_message *r = new tw_request_message();
-
-        // save the Account storage ID for the notification.
-        r->notify_slot = notify_slot;
-
-        // save the message
-        r->message = es->out_message;
-
-        // get sid for this notification slot from config.
-        std::string sidString;
-        ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, r->notify_slot);
-
-        // get twilio [type] : Used to determine delivery settings using SendGrid or twilio servers.
-        std::string type;
-        ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TYPE_SUBCMD, type, notify_slot);
-        type.resize(1);
-
-        // Settings specific for http_client_config
-
-        // Configure the URL based upon the request type.
-        switch(type[0]) {
-
-        // Twilio Call api
-        //     https://www.twilio.com/docs/voice/api/sip-making-calls
-        case TWILIO_NOTIFY_CALL[0]:
-            // Build dynamic URL and set pointer to config_client->url;
-            r->url = ad2_string_printf(TWILIO_URL_FMT, sidString.c_str(), "Calls.json");
-            r->config_client->url = r->url.c_str();
-            // POST and parse resutls for url to query.
-            r->state = TWILIO_NEXT_STATE_GET;
-            break;
-
-        // Twilio Messages api
-        //     https://www.twilio.com/docs/sms/api/message-resource
-        case TWILIO_NOTIFY_MESSAGE[0]:
-            // Build dynamic URL and set pointer to config_client->url;
-            r->url = ad2_string_printf(TWILIO_URL_FMT, sidString.c_str(), "Messages.json");
-            r->config_client->url = r->url.c_str();
-            // Single POST request then done
-            r->state = TWILIO_NEXT_STATE_DONE;
-            break;
-
-        // SendGrid Email api.
-        //     https://docs.sendgrid.com/api-reference/mail-send/mail-send
-        case TWILIO_NOTIFY_EMAIL[0]:
-            // constant URL just set pointer to string.
-            r->config_client->url = SENDGRID_URL;
-            // Single POST request then done
-            r->state = TWILIO_NEXT_STATE_DONE;
-            break;
-
-        // Unknown.
-        default:
-            ESP_LOGW(TAG, "Unknown message type '%c' aborting adding to sendQ.", type[0]);
-            // destroy storage class if we fail to add to the sendQ
-            delete r;
-            return;
-        }
-
-        // set request type
-        r->config_client->method = HTTP_METHOD_POST;
-
-        // optional define an internal event handler
-        r->config_client->event_handler = _twilio_http_event_handler;
-
-        // required save internal class to user_data to be used in callback.
-        r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
-
-        // Add client config to the http_sendQ for processing.
-        bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler);
-        if (res) {
-            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), es->out_message.c_str(), notify_slot);
-        } else {
-            ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
-            // destroy storage class if we fail to add to the sendQ
-            delete r;
-        }
+        // Messages to the same slot close together are sent as one.
+        ad2_http_notify(AD2_HTTP_SRC_TWILIO, notify_slot, es->out_message, ad2_http_sendQ_priority(msg), _queue_request);
+        ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), es->out_message.c_str(), notify_slot);
     }
 }
 
@@ -659,6 +723,8 @@ static void _cli_cmd_twilio_event_generic(std::string &subcmd, const char *strin
             } else {
                 ad2_set_config_key_string(TWILIO_CONFIG_SECTION, subcmd.c_str(), buf.c_str(), accountId);
             }
+            // render the slot again on next use.
+            _clear_slots();
             ad2_printf_host(false, "Setting '%s' value '%s' finished.\r\n", subcmd.c_str(), buf.c_str());
         } else {
             buf = "";
@@ -838,11 +904,12 @@ void twilio_register_cmds()
 }
 
 /**
- * Initialize component
+ * @brief Build and subscribe the virtual switch searches.
+ *
+ * @return int number of switches subscribed.
  */
-void twilio_init()
+static int _twilio_load_switches()
 {
-
     // Register search based virtual switches if enabled.
     // [switch N]
     int subscribers = 0;
@@ -911,6 +978,8 @@ void twilio_init()
             for (auto &slotstring : vres) {
                 uint8_t s = std::atoi(slotstring.c_str());
                 pslots->push_front((uint8_t)s & 0xff);
+                // render the slot now rather than on the first alarm.
+                _get_slot(s);
             }
             es1->PTR_ARG = pslots;
 
@@ -994,6 +1063,60 @@ void twilio_init()
         }
     }
 
+    return subscribers;
+}
+
+/**
+ * @brief Unsubscribe and free the virtual switch searches.
+ */
+static void _twilio_free_switches()
+{
+    for (auto *es : twilio_AD2EventSearches) {
+        AD2Parse.unsubscribeTo(on_search_match_cb_tw, es);
+        delete (std::list<uint8_t> *)es->PTR_ARG;
+        delete es;
+    }
+    twilio_AD2EventSearches.clear();
+}
+
+/**
+ * @brief Rebuild the virtual switches after a config reload.
+ *
+ * @details Called once per reload. The cached slots are only dropped when
+ * [twilio] itself changed.
+ *
+ * @param [in]sections changed sections.
+ * @param [in]arg not used.
+ */
+static void _twilio_config_changed(std::vector<std::string> &sections, void *arg)
+{
+    for (auto &section : sections) {
+        if (section == TWILIO_CONFIG_SECTION) {
+            // slots and their API hosts are rendered again on next use.
+            _clear_slots();
+            ad2_dns_prefetch_clear(TWILIO_CONFIG_SECTION);
+        }
+    }
+    _twilio_free_switches();
+    int subscribers = _twilio_load_switches();
+    ad2_printf_host(true, "%s: Reload done. Configured %i virtual switches.", TAG, subscribers);
+}
+
+/**
+ * Initialize component
+ */
+void twilio_init()
+{
+    _tw_slots_mutex = xSemaphoreCreateMutex();
+
+    int subscribers = _twilio_load_switches();
+
+    // Failed notifications come back here from the sendQ spool.
+    ad2_http_spool_register(AD2_HTTP_SRC_TWILIO, _spool_replay);
+
+    // Apply switch and slot changes on config reload.
+    ad2_config_subscribe(TWILIO_CONFIG_SECTION "," AD2SWITCH_CONFIG_SECTION, _twilio_config_changed, nullptr);
+
     ad2_printf_host(true, "%s: Init done. Found and configured %i virtual switches.", TAG, subscribers);
 
 }
@@ -1003,6 +1126,8 @@ void twilio_init()
  */
 void twilio_free()
 {
+    _twilio_free_switches();
+    _clear_slots();
 }
 
 #endif /*  CONFIG_AD2IOT_TWILIO_CLIENT */
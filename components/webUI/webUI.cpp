@@ -77,6 +77,7 @@ static const char *TAG = "WEBUI";
 #define WEBUI_AUTH_HEADER_MAX 160
 #define WEBUI_COOKIE_HEADER_MAX 512
 #define WEBUI_SESSION_COOKIE "AD2IOT_SESSION"
+#define WEBUI_SESSION_COOKIE_MAX 128
 
 /* Max length a file path can have on storage */
 #define FILE_PATH_MAX (255)
@@ -93,13 +94,22 @@ static std::string webui_tls_cert_setting = WEBUI_DEFAULT_SSL_CERT;
 static std::string webui_tls_key_setting = WEBUI_DEFAULT_SSL_KEY;
 static unsigned webui_tls_sessions = 0;
 static size_t webui_tls_start_free_heap = 0;
-static std::string webui_basic_authorization;
-static std::string webui_session_token;
-static std::string webui_session_cookie_http;
-static std::string webui_session_cookie_https;
 
-/* ACL control */
-ad2_acl_check webui_acl;
+/* ACL control and credentials. Built as a whole and published through a
+ * shared pointer so each request checks one consistent copy while the CLI
+ * or a config reload swaps in the next one. */
+typedef struct webui_auth {
+    ad2_acl_check webui_acl;
+    // Bumped when the ACL changes so cached session results are retested.
+    uint32_t webui_acl_generation;
+    std::string webui_basic_authorization;
+    std::string webui_session_token;
+    std::string webui_session_cookie_http;
+    std::string webui_session_cookie_https;
+} webui_auth_t;
+typedef std::shared_ptr<const webui_auth_t> webui_auth_ptr;
+static webui_auth_ptr webui_auth;
+static SemaphoreHandle_t webui_auth_mutex = nullptr;
 
 /**
  * WebUI command list and enum.
@@ -133,6 +143,10 @@ struct ws_session_storage {
     int codeID;
     bool authenticated;
     bool synced;
+    uint32_t acl_generation;
+    bool acl_allowed;
+    // Set-Cookie value. httpd keeps the pointer until the body is sent.
+    char cookie[WEBUI_SESSION_COOKIE_MAX];
 };
 
 /**
@@ -170,18 +184,46 @@ static bool has_file_extension(const char *filename, const char *extension)
            strcasecmp(filename + filename_len - extension_len, extension) == 0;
 }
 
-static cJSON *webui_state_json(AD2PartitionState *s, const char *event)
+/**
+ * @brief Write the web state document. The partition parts are copied
+ * from the shared snapshot when there is one.
+ */
+static void webui_state_write(AD2JsonWriter &w, AD2PartitionState *s,
+                              const ad2_json_snapshot_t *snap, const char *event)
 {
-    cJSON *root = ad2_get_partition_state_json(s);
-    cJSON_AddStringToObject(root, "event", event);
-    cJSON_AddNumberToObject(root, "uptime_ms", (double)(hal_uptime_us() / 1000));
-    if (s) {
-        cJSON_AddNumberToObject(root, "partition", s->partition);
-        cJSON_AddNumberToObject(root, "zone", s->zone);
+    w.object();
+    if (snap) {
+        w.members(snap->state(), snap->state_length());
+    } else {
+        ad2_json_partition_state(w, s);
     }
-    cJSON_AddItemToObject(root, "zone_alerts", ad2_get_partition_zone_alerts_json(s));
-    return root;
+    w.add("event", event);
+    w.add("uptime_ms", hal_uptime_us() / 1000);
+    if (snap) {
+        w.members(snap->extra(), snap->extra_length());
+    } else {
+        if (s) {
+            w.add("partition", s->partition);
+            w.add("zone", s->zone);
+        }
+        ad2_json_zone_alerts(w, "zone_alerts", s);
+    }
+}
+
+#if CONFIG_HTTPD_WS_SUPPORT
+/**
+ * @brief Send a rendered state document as a text frame to one web socket client.
+ */
+static void webui_ws_send_text_async(int fd, const char *text, size_t length)
+{
+    httpd_ws_frame_t ws_pkt;
+    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+    ws_pkt.payload = (uint8_t*)text;
+    ws_pkt.len = length;
+    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+    httpd_ws_send_frame_async(server, fd, &ws_pkt);
 }
+#endif
 
 static void webui_add_history(AD2PartitionState *s, int event_id)
 {
@@ -352,13 +394,82 @@ void free_ws_session_storage(void *ctx)
     }
 }
 
-static bool webui_request_allowed(httpd_req_t *req)
+/**
+ * @brief Get or create the session context for a request.
+ *
+ * @param [in]httpd_req_t *
+ *
+ * @return ws_session_storage * or NULL if out of memory.
+ */
+static ws_session_storage *webui_session_storage(httpd_req_t *req)
 {
-    std::string ip;
-    hal_get_socket_client_ip(httpd_req_to_sockfd(req), ip);
-    if (webui_acl.find(ip)) {
+    if (!req->sess_ctx) {
+        req->sess_ctx = calloc(1, sizeof(ws_session_storage));
+        req->free_ctx = free_ws_session_storage;
+    }
+    return (ws_session_storage *)req->sess_ctx;
+}
+
+/**
+ * @brief Get the current ACL and credentials. Holding the pointer keeps
+ * them valid across a reload.
+ *
+ * @return webui_auth_ptr or empty if not loaded yet.
+ */
+static webui_auth_ptr webui_get_auth()
+{
+    if (!webui_auth_mutex) {
+        return nullptr;
+    }
+    xSemaphoreTake(webui_auth_mutex, portMAX_DELAY);
+    webui_auth_ptr auth = webui_auth;
+    xSemaphoreGive(webui_auth_mutex);
+    return auth;
+}
+
+/**
+ * @brief Make a new ACL and credentials copy current.
+ */
+static void webui_set_auth(const std::shared_ptr<webui_auth_t> &next)
+{
+    webui_auth_ptr old;
+    xSemaphoreTake(webui_auth_mutex, portMAX_DELAY);
+    old = webui_auth;
+    next->webui_acl_generation = old ? old->webui_acl_generation + 1 : 1;
+    webui_auth = next;
+    xSemaphoreGive(webui_auth_mutex);
+}
+
+/**
+ * @brief Start a new copy of the current ACL and credentials.
+ */
+static std::shared_ptr<webui_auth_t> webui_copy_auth()
+{
+    webui_auth_ptr cur = webui_get_auth();
+    return cur ? std::make_shared<webui_auth_t>(*cur) : std::make_shared<webui_auth_t>();
+}
+
+static bool webui_request_allowed(httpd_req_t *req, const webui_auth_ptr &auth)
+{
+    // The peer can not change during a session so websocket and cookie
+    // sessions cache the ACL result until the ACL itself changes. A plain
+    // request is not given session storage just for this. The compiled
+    // ACL lookup is cheap.
+    ws_session_storage *session = (ws_session_storage *)req->sess_ctx;
+    if (session && session->acl_generation == auth->webui_acl_generation && session->acl_allowed) {
         return true;
     }
+    struct sockaddr_storage peer;
+    bool allowed = hal_get_socket_client_addr(httpd_req_to_sockfd(req), peer) && auth->webui_acl.find(peer);
+    if (session) {
+        session->acl_generation = auth->webui_acl_generation;
+        session->acl_allowed = allowed;
+    }
+    if (allowed) {
+        return true;
+    }
+    std::string ip;
+    hal_get_socket_client_ip(httpd_req_to_sockfd(req), ip);
     ESP_LOGW(TAG, "Rejecting request from '%s'", ip.c_str());
     httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Access denied by Web UI ACL");
     return false;
@@ -398,7 +509,15 @@ static bool webui_valid_credentials(const std::string &user, const std::string &
     return true;
 }
 
-static bool webui_load_credentials()
+/**
+ * @brief Load the credentials from config into an ACL and credentials copy
+ * and start a new session token.
+ *
+ * @param [in]auth copy to fill.
+ *
+ * @return bool false if the credentials are missing or invalid.
+ */
+static bool webui_fill_credentials(webui_auth_t &auth)
 {
     std::string user;
     std::string password;
@@ -407,7 +526,7 @@ static bool webui_load_credentials()
     if (!webui_valid_credentials(user, password)) {
         return false;
     }
-    webui_basic_authorization = "Basic " + ad2_make_basic_auth_string(user, password);
+    auth.webui_basic_authorization = "Basic " + ad2_make_basic_auth_string(user, password);
 
     uint8_t random_bytes[16];
     esp_fill_random(random_bytes, sizeof(random_bytes));
@@ -416,13 +535,64 @@ static bool webui_load_credentials()
         snprintf(token + (index * 2), 3, "%02x", random_bytes[index]);
     }
     token[sizeof(token) - 1] = '\0';
-    webui_session_token = token;
-    webui_session_cookie_http = std::string(WEBUI_SESSION_COOKIE) + "=" + webui_session_token +
-                                "; Path=/; HttpOnly; SameSite=Strict";
-    webui_session_cookie_https = webui_session_cookie_http + "; Secure";
+    auth.webui_session_token = token;
+    auth.webui_session_cookie_http = std::string(WEBUI_SESSION_COOKIE) + "=" + auth.webui_session_token +
+                                     "; Path=/; HttpOnly; SameSite=Strict";
+    auth.webui_session_cookie_https = auth.webui_session_cookie_http + "; Secure";
     return true;
 }
 
+/**
+ * @brief Load the credentials from config and make them current.
+ *
+ * @return bool false if the credentials are missing or invalid.
+ */
+static bool webui_load_credentials()
+{
+    std::shared_ptr<webui_auth_t> next = webui_copy_auth();
+    if (!webui_fill_credentials(*next)) {
+        return false;
+    }
+    webui_set_auth(next);
+    return true;
+}
+
+/**
+ * @brief Apply [webui] changes after a config reload.
+ *
+ * @details The ACL and credentials are built into a new copy that is
+ * swapped in as a whole. The ACL is replaced only if it is valid.
+ * Credentials are only reloaded if they changed so existing sessions stay
+ * logged in. Port, SSL and enable changes need a restart.
+ *
+ * @param [in]sections changed sections.
+ * @param [in]arg not used.
+ */
+static void webui_config_changed(std::vector<std::string> &sections, void *arg)
+{
+    std::string acl = WEBUI_DEFAULT_ACL;
+    ad2_get_config_key_string(WEBUI_CONFIG_SECTION, WEBUI_SUBCMD_ACL, acl);
+    std::shared_ptr<webui_auth_t> next = webui_copy_auth();
+    ad2_acl_check next_acl;
+    if (!acl.empty() && next_acl.add(acl) == next_acl.ACL_FORMAT_OK) {
+        next->webui_acl = next_acl;
+    } else {
+        ESP_LOGE(TAG, "ACL parse error for '%s'; keeping running ACL", acl.c_str());
+    }
+
+    std::string user;
+    std::string password;
+    ad2_get_config_key_string(WEBUI_CONFIG_SECTION, WEBUI_SUBCMD_USER, user);
+    ad2_get_config_key_string(WEBUI_CONFIG_SECTION, WEBUI_SUBCMD_PASSWORD, password);
+    if (!webui_valid_credentials(user, password)) {
+        ESP_LOGE(TAG, "Web UI credentials are invalid; keeping running credentials");
+    } else if (next->webui_basic_authorization != "Basic " + ad2_make_basic_auth_string(user, password)) {
+        webui_fill_credentials(*next);
+    }
+    webui_set_auth(next);
+    ad2_printf_host(true, "%s: Reload done.", TAG);
+}
+
 static bool webui_get_header(httpd_req_t *req, const char *name, size_t maximum,
                              std::string &value)
 {
@@ -438,7 +608,7 @@ static bool webui_get_header(httpd_req_t *req, const char *name, size_t maximum,
     return true;
 }
 
-static bool webui_session_cookie_valid(httpd_req_t *req)
+static bool webui_session_cookie_valid(httpd_req_t *req, const webui_auth_ptr &auth)
 {
     std::string cookies;
     if (!webui_get_header(req, "Cookie", WEBUI_COOKIE_HEADER_MAX, cookies)) {
@@ -456,7 +626,7 @@ static bool webui_session_cookie_valid(httpd_req_t *req)
         }
         const std::string item = cookies.substr(cursor, end - cursor);
         if (item.rfind(marker, 0) == 0 &&
-                webui_secure_equal(item.substr(marker.length()), webui_session_token)) {
+                webui_secure_equal(item.substr(marker.length()), auth->webui_session_token)) {
             return true;
         }
         cursor = end + 1;
@@ -464,25 +634,31 @@ static bool webui_session_cookie_valid(httpd_req_t *req)
     return false;
 }
 
-static void webui_set_session_cookie(httpd_req_t *req)
+static void webui_set_session_cookie(httpd_req_t *req, const webui_auth_ptr &auth)
 {
-    // ESP-IDF stores the header value pointer until the response body begins,
-    // so this must refer to process-lifetime storage rather than a local string.
+    // ESP-IDF stores the header value pointer until the response body begins
+    // and a reload may free the credentials copy first, so the value is kept
+    // in the session storage that lives as long as the socket.
+    ws_session_storage *session = webui_session_storage(req);
     const std::string &cookie = webui_server_uses_tls ?
-                                webui_session_cookie_https : webui_session_cookie_http;
-    httpd_resp_set_hdr(req, "Set-Cookie", cookie.c_str());
+                                auth->webui_session_cookie_https : auth->webui_session_cookie_http;
+    if (!session || cookie.length() >= sizeof(session->cookie)) {
+        return;
+    }
+    strcpy(session->cookie, cookie.c_str());
+    httpd_resp_set_hdr(req, "Set-Cookie", session->cookie);
 }
 
-static bool webui_authenticate_request(httpd_req_t *req)
+static bool webui_authenticate_request(httpd_req_t *req, const webui_auth_ptr &auth)
 {
-    if (webui_session_cookie_valid(req)) {
+    if (webui_session_cookie_valid(req, auth)) {
         return true;
     }
 
     std::string authorization;
     if (webui_get_header(req, "Authorization", WEBUI_AUTH_HEADER_MAX, authorization) &&
-            webui_secure_equal(authorization, webui_basic_authorization)) {
-        webui_set_session_cookie(req);
+            webui_secure_equal(authorization, auth->webui_basic_authorization)) {
+        webui_set_session_cookie(req, auth);
         return true;
     }
 
@@ -499,7 +675,13 @@ static bool webui_authenticate_request(httpd_req_t *req)
 
 static bool webui_authorize_request(httpd_req_t *req)
 {
-    return webui_request_allowed(req) && webui_authenticate_request(req);
+    // one copy for the whole check.
+    webui_auth_ptr auth = webui_get_auth();
+    if (!auth) {
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Access denied by Web UI ACL");
+        return false;
+    }
+    return webui_request_allowed(req, auth) && webui_authenticate_request(req, auth);
 }
 
 static bool webui_origin_allowed(httpd_req_t *req)
@@ -543,18 +725,14 @@ static void ws_alarmstate_async_send(void *arg)
                 // get the partition state based upon the partition ID on the AD2IoT firmware.
                 AD2PartitionState *s = ad2_get_partition_state(sess->partID);
                 if (s) {
-                    cJSON *root = webui_state_json(s, "SYNC");
-                    char *sys_info = cJSON_PrintUnformatted(root);
+                    ad2_json_snapshot_ptr snap = ad2_json_get_snapshot(s);
+                    AD2JsonBuffer<1024> json;
+                    const char *sys_info = json.render([&](AD2JsonWriter &w) {
+                        webui_state_write(w, s, snap.get(), "SYNC");
+                    });
                     if (sys_info) {
-                        httpd_ws_frame_t ws_pkt;
-                        memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-                        ws_pkt.payload = (uint8_t*)sys_info;
-                        ws_pkt.len = strlen(sys_info);
-                        ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-                        httpd_ws_send_frame_async(server, wsfd, &ws_pkt);
-                        cJSON_free(sys_info);
+                        webui_ws_send_text_async(wsfd, sys_info, json.length());
                     }
-                    cJSON_Delete(root);
                 }
             }
         }
@@ -595,17 +773,17 @@ esp_err_t ad2ws_handler(httpd_req_t *req)
         if (!webui_authorize_request(req) || !webui_origin_allowed(req)) {
             return ESP_FAIL;
         }
-        req->sess_ctx = calloc(1, sizeof(ws_session_storage));
-        req->free_ctx = free_ws_session_storage;
-        if (!req->sess_ctx) {
+        ws_session_storage *session = webui_session_storage(req);
+        if (!session) {
             return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
                                        "Unable to allocate WebSocket session");
         }
-        ((ws_session_storage *)req->sess_ctx)->authenticated = true;
+        session->authenticated = true;
         return ESP_OK;
     }
 
-    if (!webui_request_allowed(req)) {
+    webui_auth_ptr auth = webui_get_auth();
+    if (!auth || !webui_request_allowed(req, auth)) {
         return ESP_FAIL;
     }
     ws_session_storage *session = (ws_session_storage *)req->sess_ctx;
@@ -788,6 +966,14 @@ static esp_err_t webui_send_json_response(httpd_req_t *req, cJSON *root)
     return result;
 }
 
+/**
+ * @brief AD2JsonWriter sink that sends each full buffer as a chunk.
+ */
+static bool webui_json_chunk_sink(const char *data, size_t len, void *arg)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)arg, data, len) == ESP_OK;
+}
+
 static const char *webui_reset_reason_name(esp_reset_reason_t reason)
 {
     switch (reason) {
@@ -835,10 +1021,38 @@ static esp_err_t webui_state_handler(httpd_req_t *req)
         return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid partition slot");
     }
     AD2PartitionState *s = ad2_get_partition_state(partID);
-    return webui_send_json_response(req, webui_state_json(s, "SYNC"));
+
+    // The ETag is the partition version. A client that already has it
+    // gets 304 and no body.
+    ad2_json_snapshot_ptr snap = ad2_json_get_snapshot(s);
+    if (snap) {
+        httpd_resp_set_hdr(req, "ETag", snap->etag);
+        std::string inm;
+        if (webui_get_header(req, "If-None-Match", 64, inm) && inm == snap->etag) {
+            httpd_resp_set_status(req, "304 Not Modified");
+            httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+            return httpd_resp_send(req, NULL, 0);
+        }
+    }
+
+    // Stream the document through a small buffer, one chunk per fill.
+    char chunk[512];
+    AD2JsonWriter w(chunk, sizeof(chunk), webui_json_chunk_sink, req);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", snap ? "no-cache" : "no-store");
+    webui_state_write(w, s, snap.get(), "SYNC");
+    if (!w.finish()) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
 }
 
-/** Reboot-scoped activity API: GET /api/history?limit=64&partition=1 */
+/**
+ * Reboot-scoped activity API: GET /api/history?limit=64&partition=1
+ * Persistent uSD journal pages when any of cursor, from, to, zone or event
+ * is given: GET /api/history?cursor=0&limit=64&from=<epoch>&to=<epoch>&zone=5&event=ALARM
+ * Pass next_cursor from the response as cursor for the next older page.
+ */
 static esp_err_t webui_history_handler(httpd_req_t *req)
 {
     if (!webui_authorize_request(req)) {
@@ -849,7 +1063,45 @@ static esp_err_t webui_history_handler(httpd_req_t *req)
     if (limit < 1 || limit > WEBUI_HISTORY_SIZE) {
         return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Limit must be between 1 and 64");
     }
-    return webui_send_json_response(req, webui_history_json((size_t)limit, partition));
+
+    ad2_journal_query_t q = {};
+    int cursor = webui_query_int(req, "cursor", -1);
+    int from = webui_query_int(req, "from", -1);
+    int to = webui_query_int(req, "to", -1);
+    q.zone = webui_query_int(req, "zone", -1);
+    q.event = -1;
+    std::string event;
+    if (webui_query_value(req, "event", event)) {
+        char *end = nullptr;
+        long id = strtol(event.c_str(), &end, 10);
+        if (end && *end == '\0' && !event.empty()) {
+            q.event = (int)id;
+        } else {
+            std::replace(event.begin(), event.end(), '+', ' ');
+            std::replace(event.begin(), event.end(), '_', ' ');
+            for (auto &name : AD2Parse.event_str) {
+                if (strcasecmp(name.second.c_str(), event.c_str()) == 0) {
+                    q.event = name.first;
+                    break;
+                }
+            }
+            if (q.event < 0) {
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown event type");
+            }
+        }
+    }
+    if (cursor < 0 && from < 0 && to < 0 && q.zone < 0 && q.event < 0) {
+        return webui_send_json_response(req, webui_history_json((size_t)limit, partition));
+    }
+    if (!g_uSD_mounted) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Event journal is not available");
+    }
+    q.cursor = cursor > 0 ? cursor : 0;
+    q.from_s = from > 0 ? from : 0;
+    q.to_s = to > 0 ? to : 0;
+    q.partition = partition;
+    q.limit = limit;
+    return webui_send_json_response(req, ad2_journal_query_json(q));
 }
 
 static void webui_add_file_status(cJSON *parent, const char *name, const char *path)
@@ -901,8 +1153,6 @@ static esp_err_t webui_system_handler(httpd_req_t *req)
     cJSON_AddNumberToObject(sd, "total_bytes", sd_info_ok ? (double)sd_total : 0);
     cJSON_AddNumberToObject(sd, "free_bytes", sd_info_ok ? (double)sd_free : 0);
     webui_add_file_status(sd, "config", "/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
-    webui_add_file_status(sd, "diagnostic_log", AD2_SD_LOG_PATH);
-    webui_add_file_status(sd, "diagnostic_log_rotated", AD2_SD_LOG_OLD_PATH);
     bool sd_log_enabled = false;
     bool sd_log_active = false;
     uint32_t sd_log_dropped = 0;
@@ -913,6 +1163,19 @@ static esp_err_t webui_system_handler(httpd_req_t *req)
     cJSON_AddBoolToObject(sd, "logging_active", sd_log_active);
     cJSON_AddNumberToObject(sd, "logging_dropped", sd_log_dropped);
     cJSON_AddNumberToObject(sd, "logging_write_errors", sd_log_write_errors);
+    ad2_sd_log_stats_t sd_log_stats;
+    ad2_get_sd_logging_stats(&sd_log_stats);
+    cJSON_AddNumberToObject(sd, "logging_writes", sd_log_stats.writes);
+    cJSON_AddNumberToObject(sd, "logging_lines", sd_log_stats.lines);
+    cJSON_AddNumberToObject(sd, "logging_bytes_per_write",
+                            sd_log_stats.writes ? sd_log_stats.bytes / sd_log_stats.writes : 0);
+    cJSON_AddNumberToObject(sd, "logging_avg_flush_us", sd_log_stats.avg_flush_us);
+    cJSON_AddNumberToObject(sd, "logging_max_flush_us", sd_log_stats.max_flush_us);
+    cJSON_AddNumberToObject(sd, "logging_raw_bytes", sd_log_stats.raw_bytes);
+    cJSON_AddNumberToObject(sd, "logging_written_bytes", sd_log_stats.bytes);
+    cJSON_AddNumberToObject(sd, "logging_segments", sd_log_stats.segments);
+    cJSON_AddNumberToObject(sd, "logging_stored_bytes", (double)sd_log_stats.stored_bytes);
+    cJSON_AddNumberToObject(sd, "logging_retention_bytes", (double)sd_log_stats.retention_bytes);
     cJSON_AddItemToObject(storage, "sd_card", sd);
 
     cJSON *spiffs = cJSON_CreateObject();
@@ -1400,12 +1663,61 @@ static esp_err_t webui_config_handler(httpd_req_t *req)
     return webui_send_redacted_config_file(req, config_path, source_name);
 }
 
-/** Bounded reboot-scoped device log: GET /api/logs?limit=64 */
+/** Stream redacted uSD log lines for a time range as chunked text. */
+struct webui_log_range_ctx {
+    httpd_req_t *req;
+    esp_err_t result;
+    int remaining;
+};
+
+static bool webui_send_log_line(const char *line, size_t len, void *arg)
+{
+    webui_log_range_ctx *ctx = (webui_log_range_ctx *)arg;
+    std::string redacted(line, len);
+    webui_redact_config(redacted);
+    redacted += "\n";
+    ctx->result = httpd_resp_send_chunk(ctx->req, redacted.c_str(), redacted.length());
+    return ctx->result == ESP_OK && --ctx->remaining > 0;
+}
+
+static esp_err_t webui_send_log_range(httpd_req_t *req, int64_t from_ms, int64_t to_ms, bool wall_clock)
+{
+    if (!g_uSD_mounted) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "uSD logs are not available");
+    }
+    if (to_ms < from_ms) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Range end is before its start");
+    }
+    httpd_resp_set_type(req, "text/plain; charset=utf-8");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    webui_log_range_ctx ctx = { req, ESP_OK, AD2_SD_LOG_QUERY_MAX_LINES };
+    ad2_sd_log_query(from_ms, to_ms, wall_clock, webui_send_log_line, &ctx);
+    if (ctx.result != ESP_OK) {
+        return ctx.result;
+    }
+    return httpd_resp_send_chunk(req, nullptr, 0);
+}
+
+/**
+ * Bounded reboot-scoped device log: GET /api/logs?limit=64
+ * uSD log range by wall clock: GET /api/logs?from=<epoch>&to=<epoch>
+ * uSD log range this boot: GET /api/logs?uptime_from=<s>&uptime_to=<s>
+ */
 static esp_err_t webui_logs_handler(httpd_req_t *req)
 {
     if (!webui_authorize_request(req)) {
         return ESP_OK;
     }
+    int from = webui_query_int(req, "from", -1);
+    if (from >= 0) {
+        int to = webui_query_int(req, "to", from + 600);
+        return webui_send_log_range(req, (int64_t)from * 1000, (int64_t)to * 1000 + 999, true);
+    }
+    int uptime_from = webui_query_int(req, "uptime_from", -1);
+    if (uptime_from >= 0) {
+        int uptime_to = webui_query_int(req, "uptime_to", uptime_from + 600);
+        return webui_send_log_range(req, (int64_t)uptime_from * 1000, (int64_t)uptime_to * 1000 + 999, false);
+    }
     int limit = webui_query_int(req, "limit", 64);
     if (limit < 1 || limit > 64) {
         return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Limit must be between 1 and 64");
@@ -1632,6 +1944,10 @@ void webui_on_state_change(std::string *msg, AD2PartitionState *s, void *arg)
     size_t fds = server_config.max_open_sockets;
     int client_fds[fds];
     if (server && hal_get_network_connected()) {
+        // Render once for every client watching this partition.
+        ad2_json_snapshot_ptr snap;
+        AD2JsonBuffer<1024> json;
+        const char *sys_info = nullptr;
         httpd_get_client_list(server, &fds, client_fds);
         for (int i=0; i<fds; i++) {
             if (httpd_ws_get_fd_info(server, client_fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
@@ -1640,18 +1956,15 @@ void webui_on_state_change(std::string *msg, AD2PartitionState *s, void *arg)
                     // get the partition state based upon the partition requested.
                     AD2PartitionState *temps = ad2_get_partition_state(sess->partID);
                     if (temps && s->partition == temps->partition) {
-                        cJSON *root = webui_state_json(s, AD2Parse.event_str[(int)arg].c_str());
-                        char *sys_info = cJSON_PrintUnformatted(root);
+                        if (!sys_info) {
+                            snap = ad2_json_get_snapshot(s);
+                            sys_info = json.render([&](AD2JsonWriter &w) {
+                                webui_state_write(w, s, snap.get(), AD2Parse.event_str[(int)arg].c_str());
+                            });
+                        }
                         if (sys_info) {
-                            httpd_ws_frame_t ws_pkt;
-                            memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-                            ws_pkt.payload = (uint8_t*)sys_info;
-                            ws_pkt.len = strlen(sys_info);
-                            ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-                            httpd_ws_send_frame_async(server, client_fds[i], &ws_pkt);
-                            cJSON_free(sys_info);
+                            webui_ws_send_text_async(client_fds[i], sys_info, json.length());
                         }
-                        cJSON_Delete(root);
                     }
                 }
             }
@@ -1929,9 +2242,11 @@ static void _cli_cmd_webui_event(const char *string)
             case WEBUI_SUBCMD_ACL_ID:
                 // If no arg then return ACL list
                 if (ad2_copy_nth_arg(arg, string, 2, true) >= 0) {
-                    webui_acl.clear();
-                    int res = webui_acl.add(arg);
-                    if (res == webui_acl.ACL_FORMAT_OK) {
+                    std::shared_ptr<webui_auth_t> next = webui_copy_auth();
+                    next->webui_acl.clear();
+                    int res = next->webui_acl.add(arg);
+                    if (res == next->webui_acl.ACL_FORMAT_OK) {
+                        webui_set_auth(next);
                         ad2_set_config_key_string(WEBUI_CONFIG_SECTION, WEBUI_SUBCMD_ACL, arg.c_str());
                     } else {
                         ad2_printf_host(false, "Error parsing ACL string. Check ACL format. Not saved.\r\n");
@@ -2061,6 +2376,8 @@ static struct cli_command webui_cmd_list[] = {
  */
 void webui_register_cmds()
 {
+    webui_auth_mutex = xSemaphoreCreateMutex();
+
     // Register webui CLI commands
     for (int i = 0; i < ARRAY_SIZE(webui_cmd_list); i++) {
         cli_register_command(&webui_cmd_list[i]);
@@ -2101,11 +2418,14 @@ void webui_init(void)
         ESP_LOGE(TAG, "Web UI ACL is empty; refusing to start");
         return;
     }
-    int acl_result = webui_acl.add(acl);
-    if (acl_result != webui_acl.ACL_FORMAT_OK) {
+    std::shared_ptr<webui_auth_t> auth = webui_copy_auth();
+    auth->webui_acl.clear();
+    int acl_result = auth->webui_acl.add(acl);
+    if (acl_result != auth->webui_acl.ACL_FORMAT_OK) {
         ESP_LOGE(TAG, "ACL parse error %i for '%s'; refusing to start", acl_result, acl.c_str());
         return;
     }
+    webui_set_auth(auth);
 
     webui_history_mutex = xSemaphoreCreateMutex();
     if (!webui_history_mutex) {
@@ -2132,6 +2452,9 @@ void webui_init(void)
     // Subscribe to ON_ZONE_CHANGE events
     AD2Parse.subscribeTo(ON_ZONE_CHANGE, webui_on_state_change, (void *)ON_ZONE_CHANGE);
 
+    // Apply ACL and credential changes on config reload.
+    ad2_config_subscribe(WEBUI_CONFIG_SECTION, webui_config_changed, nullptr);
+
     ad2_printf_host(true, "%s: Init done, daemon starting.", TAG);
     xTaskCreate(&webui_server_task, "AD2 webUI", 1024*5, NULL, tskIDLE_PRIORITY+1, NULL);
 }
@@ -363,7 +363,7 @@ static void _cli_cmd_ad2term_event(const char *string)
             // null terminate and send the message to the AD2*
             rx_buffer[len] = 0;
             std::string temp = (char *)rx_buffer;
-            ad2_send(temp);
+            ad2_send(temp, AD2_SEND_SRC_TERM);
         }
 
         vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -390,6 +390,19 @@ static void _cli_cmd_restart_event(const char *string)
     hal_restart();
 }
 
+/**
+ * @brief event handler for reload command
+ *
+ * @param [in]string command buffer pointer.
+ *
+ */
+static void _cli_cmd_reload_event(const char *string)
+{
+    if (ad2_reload_persistent_config() < 0) {
+        ad2_printf_host(false, "Config reload failed. Use '" AD2_CMD_REBOOT "' to apply changes.\r\n");
+    }
+}
+
 /**
  * @brief event handler for factory-reset command
  *
@@ -507,7 +520,17 @@ static void _cli_cmd_logs_event(const char *string)
         bool setting_changed = false;
         if (normalized == "sd" && ad2_copy_nth_arg(value, string, 2) >= 0) {
             ad2_ucase(value);
-            if (value == "Y" || value == "YES" || value == "ON" || value == "1") {
+            if (value == "KEEP") {
+                std::string megabytes;
+                ad2_copy_nth_arg(megabytes, string, 3);
+                int keep = atoi(megabytes.c_str());
+                if (keep < 1) {
+                    ad2_printf_host(false, "Invalid uSD log retention; use a size in MiB.\r\n");
+                    return;
+                }
+                ad2_set_config_key_int(AD2MAIN_CONFIG_SECTION, SDLOGKEEP_CONFIG_KEY, keep);
+                ad2_set_sd_logging_retention(keep);
+            } else if (value == "Y" || value == "YES" || value == "ON" || value == "1") {
                 ad2_set_config_key_bool(AD2MAIN_CONFIG_SECTION, SDLOG_CONFIG_KEY, true);
                 setting_changed = true;
                 if (!ad2_set_sd_logging_enabled(true)) {
@@ -528,19 +551,105 @@ static void _cli_cmd_logs_event(const char *string)
         uint32_t dropped = 0;
         uint32_t write_errors = 0;
         ad2_get_sd_logging_status(&enabled, &active, &dropped, &write_errors);
+        ad2_sd_log_stats_t stats;
+        ad2_get_sd_logging_stats(&stats);
         ad2_printf_host(false,
-                        "uSD logging configured=%s active=%s path=%s max=512KiB rotated=%s dropped=%lu write_errors=%lu%s\r\n",
-                        enabled ? "Y" : "N", active ? "Y" : "N",
-                        AD2_SD_LOG_PATH, AD2_SD_LOG_OLD_PATH,
+                        "uSD logging configured=%s active=%s path=%s segments=%lu stored=%lluKiB keep=%lluMiB dropped=%lu write_errors=%lu%s\r\n",
+                        enabled ? "Y" : "N", active ? "Y" : "N", AD2_SD_LOG_DIR,
+                        (unsigned long)stats.segments, (unsigned long long)(stats.stored_bytes / 1024),
+                        (unsigned long long)(stats.retention_bytes / (1024 * 1024)),
                         (unsigned long)dropped, (unsigned long)write_errors,
                         setting_changed ? " (saved on restart)" : "");
+        uint64_t elapsed_ms = stats.since_ms ? (hal_uptime_us() / 1000) - stats.since_ms : 0;
+        ad2_printf_host(false,
+                        "uSD log writes=%lu (%.2f/s) lines=%lu bytes/write=%lu flush avg=%lums max=%lums dropped=%lu\r\n",
+                        (unsigned long)stats.writes,
+                        elapsed_ms ? stats.writes * 1000.0 / elapsed_ms : 0.0,
+                        (unsigned long)stats.lines,
+                        (unsigned long)(stats.writes ? stats.bytes / stats.writes : 0),
+                        (unsigned long)(stats.avg_flush_us / 1000), (unsigned long)(stats.max_flush_us / 1000),
+                        (unsigned long)stats.dropped);
+        uint32_t journal_next = 0, journal_blocks = 0, journal_dropped = 0, journal_errors = 0;
+        ad2_get_journal_status(&journal_next, &journal_blocks, &journal_dropped, &journal_errors);
+        ad2_printf_host(false, "Event journal path=%s records=%lu blocks=%lu dropped=%lu write_errors=%lu\r\n",
+                        AD2_JOURNAL_PATH, (unsigned long)(journal_next - 1), (unsigned long)journal_blocks,
+                        (unsigned long)journal_dropped, (unsigned long)journal_errors);
+        if (stats.bytes) {
+            ad2_printf_host(false, "uSD log compression %lu -> %lu bytes (%.1fx)\r\n",
+                            (unsigned long)stats.raw_bytes, (unsigned long)stats.bytes,
+                            (double)stats.raw_bytes / stats.bytes);
+        }
+        return;
+    }
+
+    if (normalized == "at" || normalized == "uptime") {
+        // logs at <HH:MM | YYYY-MM-DD HH:MM | epoch> [minutes]
+        // logs uptime <seconds> [seconds]
+        bool wall_clock = normalized == "at";
+        std::string when, span;
+        ad2_copy_nth_arg(when, string, 2);
+        int span_arg = 3;
+        int64_t from_ms = -1;
+        if (wall_clock) {
+            struct tm tm;
+            time_t now = time(NULL);
+            localtime_r(&now, &tm);
+            int year, month, day, hour, minute;
+            std::string clock;
+            if (sscanf(when.c_str(), "%d-%d-%d", &year, &month, &day) == 3 &&
+                    ad2_copy_nth_arg(clock, string, 3) >= 0 &&
+                    sscanf(clock.c_str(), "%d:%d", &hour, &minute) == 2) {
+                tm.tm_year = year - 1900;
+                tm.tm_mon = month - 1;
+                tm.tm_mday = day;
+                tm.tm_hour = hour;
+                tm.tm_min = minute;
+                tm.tm_sec = 0;
+                tm.tm_isdst = -1;
+                from_ms = (int64_t)mktime(&tm) * 1000;
+                span_arg = 4;
+            } else if (sscanf(when.c_str(), "%d:%d", &hour, &minute) == 2) {
+                // most recent past occurrence.
+                tm.tm_hour = hour;
+                tm.tm_min = minute;
+                tm.tm_sec = 0;
+                tm.tm_isdst = -1;
+                time_t at = mktime(&tm);
+                if (at > now) {
+                    at -= 24 * 60 * 60;
+                }
+                from_ms = (int64_t)at * 1000;
+            } else if (!when.empty() && strspn(when.c_str(), "0123456789") == when.length()) {
+                from_ms = strtoll(when.c_str(), NULL, 10) * 1000;
+            }
+        } else if (!when.empty() && strspn(when.c_str(), "0123456789") == when.length()) {
+            from_ms = strtoll(when.c_str(), NULL, 10) * 1000;
+        }
+        if (from_ms < 0) {
+            ad2_printf_host(false, "Invalid time; use logs at <HH:MM | YYYY-MM-DD HH:MM | epoch> [minutes] or logs uptime <seconds> [seconds].\r\n");
+            return;
+        }
+        ad2_copy_nth_arg(span, string, span_arg);
+        int64_t span_ms = atoi(span.c_str());
+        if (span_ms < 1) {
+            span_ms = wall_clock ? 10 : 600;
+        }
+        span_ms *= wall_clock ? 60 * 1000 : 1000;
+        int remaining = AD2_SD_LOG_QUERY_MAX_LINES;
+        size_t found = ad2_sd_log_query(from_ms, from_ms + span_ms, wall_clock,
+        [](const char *line, size_t len, void *arg) {
+            int *remaining = (int *)arg;
+            ad2_printf_host(false, "%.*s\r\n", (int)len, line);
+            return --(*remaining) > 0;
+        }, &remaining);
+        ad2_printf_host(false, "%u uSD log lines shown.\r\n", (unsigned int)found);
         return;
     }
 
     char *end = NULL;
     long requested = strtol(command.c_str(), &end, 10);
     if (!end || *end != '\0' || requested < 1 || requested > AD2_LOG_HISTORY_SIZE) {
-        ad2_printf_host(false, "Invalid log count; use 1-%d, status, or sd [Y|N].\r\n",
+        ad2_printf_host(false, "Invalid log count; use 1-%d, status, sd [Y|N|keep], at or uptime.\r\n",
                         AD2_LOG_HISTORY_SIZE);
         return;
     }
@@ -734,6 +843,15 @@ static struct cli_command cmd_list[] = {
         "    Save config changes and restart the device\r\n"
         , _cli_cmd_restart_event
     },
+    {
+        (char*)AD2_CMD_RELOAD,(char*)
+        "Usage: reload"
+        "\r\n"
+        "    Save config changes and apply them without a restart\r\n"
+        "    Only settings whose section changed are reloaded. Network\r\n"
+        "    and ad2source settings still require a restart\r\n"
+        , _cli_cmd_reload_event
+    },
     {
         (char*)AD2_CMD_NETMODE,(char*)
         "Usage: netmode [(N | W | E)] [<arg>]\r\n"
@@ -911,10 +1029,14 @@ static struct cli_command cmd_list[] = {
     },
     {
         (char*)AD2_CMD_LOGS,(char*)
-        "Usage: logs [1-64 | status | sd [Y|N]]\r\n"
+        "Usage: logs [1-64 | status | sd [Y|N|keep <MiB>] | at <time> [minutes] | uptime <seconds> [seconds]]\r\n"
         "    Show the reboot-scoped log history on serial or network CLI.\r\n"
-        "    'logs sd Y' also writes logs asynchronously to /sdcard/ad2iot.log.\r\n"
-        "    The file rotates at 512 KiB to /sdcard/ad2iot.log.1.\r\n"
+        "    'logs sd Y' also writes logs asynchronously to compressed segments\r\n"
+        "    in /sdcard/ad2log. The oldest segments are removed past the\r\n"
+        "    retention budget set with 'logs sd keep <MiB>' (default 64).\r\n"
+        "    'logs at 02:13 5' shows uSD log lines from 02:13 to 02:18 when\r\n"
+        "    the clock is set. <time> is HH:MM, YYYY-MM-DD HH:MM or epoch seconds.\r\n"
+        "    'logs uptime 3600 60' shows lines from the current boot by uptime.\r\n"
         , _cli_cmd_logs_event
     },
     {
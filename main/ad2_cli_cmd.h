@@ -25,6 +25,7 @@
 #define _AD2_CLI_CMD_H_
 
 #define AD2_CMD_REBOOT   "restart"
+#define AD2_CMD_RELOAD   "reload"
 #define AD2_CMD_NETMODE  "netmode"
 #define AD2_CMD_SWITCH   "switch"
 #define AD2_CMD_ZONE     "zone"
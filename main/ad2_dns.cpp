@@ -0,0 +1,538 @@
+/**
+ *  @file    ad2_dns.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Shared DNS cache with TTL, prefetch and stale fallback for outbound connections.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "AD2DNS";
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// esp includes
+#include "esp_random.h"
+#include "lwip/dns.h"
+#include "lwip/api.h"
+#include <lwip/sockets.h>
+#include <unistd.h>
+
+/* Shared DNS cache for outbound connections.
+ * Pushover, Twilio, SendGrid, the MQTT broker and OTA connect by hostname
+ * through lwIP getaddrinfo. The lwIP external resolve hook sends those
+ * lookups here. Answers are cached by their TTL. Configured service hosts
+ * are refreshed by a small task before they expire. If DNS fails, the last
+ * good address is served as stale so an alarm notification does not wait
+ * on a dead DNS server. Only IPv4 A records are cached. Other lookups fall
+ * through to lwIP.
+ */
+typedef struct {
+    char host[AD2_DNS_HOST_MAX];
+    uint32_t addr;           // network order
+    uint32_t resolve_ms;     // time the last good query took.
+    uint64_t resolved_ms;    // uptime of the last good answer.
+    uint64_t expires_ms;     // uptime the answer expires.
+    uint64_t failed_ms;      // uptime of the last failed query or 0.
+    uint64_t used_ms;        // uptime of the last lookup.
+} ad2_dns_entry_t;
+
+typedef struct {
+    char owner[16];          // config section that asked for the host.
+    char host[AD2_DNS_HOST_MAX];
+} ad2_dns_prefetch_t;
+
+static ad2_dns_entry_t _ad2_dns_cache[AD2_DNS_CACHE_SIZE];
+static ad2_dns_prefetch_t _ad2_dns_prefetch_hosts[AD2_DNS_PREFETCH_HOSTS];
+// uptime no DNS server last answered or 0 once one does.
+static uint64_t _ad2_dns_down_ms = 0;
+static SemaphoreHandle_t _ad2_dns_mutex = nullptr;
+static TaskHandle_t _ad2_dns_task = nullptr;
+static ad2_dns_stats_t _ad2_dns_stats = {};
+
+/**
+ * @brief Send one A query to a DNS server and wait for the answer.
+ *
+ * @param [in]host const char * name to resolve.
+ * @param [in]server uint32_t IPv4 DNS server in network order.
+ * @param [out]addr uint32_t * first A record in network order.
+ * @param [out]ttl uint32_t * lowest TTL along the answer chain.
+ *
+ * @return int 0 found, 1 name does not exist, -1 no answer or error.
+ */
+static int _ad2_dns_query(const char *host, uint32_t server, uint32_t *addr, uint32_t *ttl)
+{
+    uint8_t buf[512];
+    uint16_t id = (uint16_t)esp_random();
+
+    // header: id, RD, one question.
+    memset(buf, 0, 12);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xff;
+    buf[2] = 0x01;
+    buf[5] = 1;
+
+    // qname as length prefixed labels.
+    size_t len = 12;
+    const char *p = host;
+    while (*p) {
+        const char *dot = strchr(p, '.');
+        size_t l = dot ? (size_t)(dot - p) : strlen(p);
+        if (l == 0 || l > 63 || len + l + 6 > sizeof(buf)) {
+            return -1;
+        }
+        buf[len++] = (uint8_t)l;
+        memcpy(buf + len, p, l);
+        len += l;
+        p += l;
+        if (*p == '.') {
+            p++;
+        }
+    }
+    buf[len++] = 0;
+    // qtype A, qclass IN
+    buf[len++] = 0;
+    buf[len++] = 1;
+    buf[len++] = 0;
+    buf[len++] = 1;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return -1;
+    }
+    struct timeval tv;
+    tv.tv_sec = AD2_DNS_TIMEOUT_MS / 1000;
+    tv.tv_usec = (AD2_DNS_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(AD2_DNS_PORT);
+    to.sin_addr.s_addr = server;
+
+    int res = -1;
+    if (sendto(sock, buf, len, 0, (struct sockaddr *)&to, sizeof(to)) == (int)len) {
+        // skip stray answers to an earlier query and datagrams that did
+        // not come from the server the query went to.
+        for (int tries = 0; tries < 3; tries++) {
+            struct sockaddr_in from = {};
+            socklen_t fromlen = sizeof(from);
+            int n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen);
+            if (n < 0) {
+                break;
+            }
+            if (fromlen < sizeof(from) || from.sin_family != AF_INET || from.sin_addr.s_addr != server ||
+                    from.sin_port != to.sin_port) {
+                continue;
+            }
+            if (n < 12 || ((buf[0] << 8) | buf[1]) != id || !(buf[2] & 0x80)) {
+                continue;
+            }
+            int rcode = buf[3] & 0x0f;
+            if (rcode == 3) {
+                res = 1;
+                break;
+            }
+            if (rcode != 0) {
+                break;
+            }
+            int qd = (buf[4] << 8) | buf[5];
+            int an = (buf[6] << 8) | buf[7];
+            size_t pos = 12;
+            uint32_t min_ttl = UINT32_MAX;
+            // walk questions then answers. Names may be compressed.
+            for (int r = 0; r < qd + an && pos < (size_t)n; r++) {
+                while (pos < (size_t)n) {
+                    uint8_t b = buf[pos];
+                    if ((b & 0xc0) == 0xc0) {
+                        pos += 2;
+                        break;
+                    }
+                    pos += 1 + b;
+                    if (b == 0) {
+                        break;
+                    }
+                }
+                if (r < qd) {
+                    pos += 4;
+                    continue;
+                }
+                if (pos + 10 > (size_t)n) {
+                    break;
+                }
+                uint16_t type = (buf[pos] << 8) | buf[pos + 1];
+                uint16_t cls = (buf[pos + 2] << 8) | buf[pos + 3];
+                uint32_t rttl = ((uint32_t)buf[pos + 4] << 24) | ((uint32_t)buf[pos + 5] << 16) |
+                                ((uint32_t)buf[pos + 6] << 8) | buf[pos + 7];
+                uint16_t rdlen = (buf[pos + 8] << 8) | buf[pos + 9];
+                pos += 10;
+                if (pos + rdlen > (size_t)n) {
+                    break;
+                }
+                if (cls == 1 && rttl < min_ttl) {
+                    min_ttl = rttl;
+                }
+                if (type == 1 && cls == 1 && rdlen == 4) {
+                    memcpy(addr, buf + pos, 4);
+                    *ttl = min_ttl;
+                    res = 0;
+                    break;
+                }
+                pos += rdlen;
+            }
+            break;
+        }
+    }
+    close(sock);
+    return res;
+}
+
+/**
+ * @brief Find a host in the cache. Call with the cache locked.
+ */
+static ad2_dns_entry_t *_ad2_dns_find(const char *host)
+{
+    for (auto &e : _ad2_dns_cache) {
+        if (e.host[0] && strcasecmp(e.host, host) == 0) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Resolve a host with the configured DNS servers and update the cache.
+ *
+ * @param [in]host const char *
+ * @param [out]addr uint32_t * address in network order. Last good if stale.
+ * @param [out]stale bool * set if a cached address is served after DNS failed.
+ *
+ * @return int 0 found, 1 name does not exist, -1 no answer.
+ */
+static int _ad2_dns_refresh(const char *host, uint32_t *addr, bool *stale)
+{
+    uint64_t start_ms = hal_uptime_us() / 1000;
+    uint32_t ttl = 0;
+    int res = -1;
+    for (int i = 0; i < DNS_MAX_SERVERS && res < 0; i++) {
+        const ip_addr_t *srv = dns_getserver(i);
+        if (!IP_IS_V4(srv) || ip_addr_isany(srv)) {
+            continue;
+        }
+        res = _ad2_dns_query(host, ip_addr_get_ip4_u32(srv), addr, &ttl);
+    }
+    uint64_t now_ms = hal_uptime_us() / 1000;
+
+    *stale = false;
+    xSemaphoreTake(_ad2_dns_mutex, portMAX_DELAY);
+    ad2_dns_entry_t *e = _ad2_dns_find(host);
+    if (res == 0) {
+        if (!e) {
+            // replace an empty or the least recently used entry.
+            e = &_ad2_dns_cache[0];
+            for (auto &c : _ad2_dns_cache) {
+                if (!c.host[0]) {
+                    e = &c;
+                    break;
+                }
+                if (c.used_ms < e->used_ms) {
+                    e = &c;
+                }
+            }
+            memset(e, 0, sizeof(*e));
+            strlcpy(e->host, host, sizeof(e->host));
+            e->used_ms = now_ms;
+        }
+        ttl = std::min(std::max(ttl, (uint32_t)AD2_DNS_TTL_MIN_S), (uint32_t)AD2_DNS_TTL_MAX_S);
+        e->addr = *addr;
+        e->resolve_ms = (uint32_t)(now_ms - start_ms);
+        e->resolved_ms = now_ms;
+        e->expires_ms = now_ms + ttl * 1000ULL;
+        e->failed_ms = 0;
+        _ad2_dns_down_ms = 0;
+    } else {
+        _ad2_dns_stats.failures++;
+        if (res < 0) {
+            _ad2_dns_down_ms = now_ms;
+        } else {
+            // the server answered. It is only the name that is missing.
+            _ad2_dns_down_ms = 0;
+        }
+        if (e) {
+            e->failed_ms = now_ms;
+            if (res < 0 && now_ms - e->resolved_ms < AD2_DNS_STALE_MAX_S * 1000ULL) {
+                // DNS is down. Serve the last good address.
+                *addr = e->addr;
+                *stale = true;
+                res = 0;
+                _ad2_dns_stats.stale++;
+            }
+        }
+    }
+    xSemaphoreGive(_ad2_dns_mutex);
+    return res;
+}
+
+/**
+ * @brief Look up a host in the shared DNS cache, resolving on a miss.
+ *
+ * @param [in]host const char *
+ * @param [out]addr uint32_t * IPv4 address in network order.
+ * @param [out]stale bool * optional. Set if a cached address is served
+ * because DNS failed.
+ *
+ * @return int 0 found, 1 name does not exist, -1 no answer and nothing
+ * cached. A miss while DNS is down returns -1 at once without a query so
+ * the caller's own resolver is not held up behind a second timeout.
+ */
+int ad2_dns_lookup(const char *host, uint32_t *addr, bool *stale)
+{
+    bool _stale = false;
+    if (!stale) {
+        stale = &_stale;
+    }
+    *stale = false;
+    if (!_ad2_dns_mutex || !host || strlen(host) >= AD2_DNS_HOST_MAX) {
+        return -1;
+    }
+
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    xSemaphoreTake(_ad2_dns_mutex, portMAX_DELAY);
+    ad2_dns_entry_t *e = _ad2_dns_find(host);
+    if (e) {
+        e->used_ms = now_ms;
+        bool fresh = now_ms < e->expires_ms;
+        // DNS failed recently so do not wait on it again.
+        bool down = !fresh && e->failed_ms && now_ms - e->failed_ms < AD2_DNS_RETRY_S * 1000ULL &&
+                    now_ms - e->resolved_ms < AD2_DNS_STALE_MAX_S * 1000ULL;
+        if (fresh || down) {
+            *addr = e->addr;
+            *stale = down;
+            if (down) {
+                _ad2_dns_stats.stale++;
+            } else {
+                _ad2_dns_stats.hits++;
+                _ad2_dns_stats.saved_ms += e->resolve_ms;
+            }
+            xSemaphoreGive(_ad2_dns_mutex);
+            return 0;
+        }
+    }
+    _ad2_dns_stats.misses++;
+    if (_ad2_dns_down_ms && now_ms - _ad2_dns_down_ms < AD2_DNS_RETRY_S * 1000ULL) {
+        _ad2_dns_stats.bypassed++;
+        xSemaphoreGive(_ad2_dns_mutex);
+        return -1;
+    }
+    xSemaphoreGive(_ad2_dns_mutex);
+
+    return _ad2_dns_refresh(host, addr, stale);
+}
+
+/**
+ * @brief Keep a service host resolved. Looked up at once and refreshed
+ * before its TTL runs out.
+ *
+ * @param [in]owner const char * config section the host belongs to. Its
+ * hosts are dropped with ad2_dns_prefetch_clear() when it is reloaded.
+ * @param [in]url const std::string & URL or bare host name. IP
+ * addresses are ignored.
+ */
+void ad2_dns_prefetch(const char *owner, const std::string &url)
+{
+    // scheme://[user@]host[:port][/path]
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    size_t end = url.find_first_of("/?#", start);
+    std::string host = url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    size_t at = host.rfind('@');
+    if (at != std::string::npos) {
+        host.erase(0, at + 1);
+    }
+    size_t colon = host.find(':');
+    if (colon != std::string::npos) {
+        host.erase(colon);
+    }
+    struct in_addr ina;
+    if (!_ad2_dns_mutex || host.empty() || host.length() >= AD2_DNS_HOST_MAX ||
+            inet_aton(host.c_str(), &ina) || host.find('.') == std::string::npos) {
+        return;
+    }
+
+    ad2_dns_prefetch_t *slot = nullptr;
+    bool found = false;
+    xSemaphoreTake(_ad2_dns_mutex, portMAX_DELAY);
+    for (auto &h : _ad2_dns_prefetch_hosts) {
+        if (h.host[0] && strcmp(h.owner, owner) == 0 && strcasecmp(h.host, host.c_str()) == 0) {
+            found = true;
+            break;
+        }
+        if (!h.host[0] && !slot) {
+            slot = &h;
+        }
+    }
+    if (!found && slot) {
+        strlcpy(slot->owner, owner, sizeof(slot->owner));
+        strlcpy(slot->host, host.c_str(), sizeof(slot->host));
+    }
+    xSemaphoreGive(_ad2_dns_mutex);
+    if (!found) {
+        if (slot) {
+            xTaskNotifyGive(_ad2_dns_task);
+        } else {
+            ESP_LOGW(TAG, "DNS prefetch list full. Not keeping '%s' resolved.", host.c_str());
+        }
+    }
+}
+
+/**
+ * @brief Stop prefetching the hosts of a config section. Called when the
+ * section is reloaded before its current hosts are added again.
+ *
+ * @param [in]owner const char * config section.
+ */
+void ad2_dns_prefetch_clear(const char *owner)
+{
+    if (!_ad2_dns_mutex) {
+        return;
+    }
+    xSemaphoreTake(_ad2_dns_mutex, portMAX_DELAY);
+    for (auto &h : _ad2_dns_prefetch_hosts) {
+        if (strcmp(h.owner, owner) == 0) {
+            memset(&h, 0, sizeof(h));
+        }
+    }
+    xSemaphoreGive(_ad2_dns_mutex);
+}
+
+/**
+ * @brief Refresh prefetch hosts that are missing or close to expiry.
+ */
+static void _ad2_dns_prefetch_pass()
+{
+    for (int i = 0; i < AD2_DNS_PREFETCH_HOSTS; i++) {
+        char host[AD2_DNS_HOST_MAX];
+        bool due = false;
+        uint64_t now_ms = hal_uptime_us() / 1000;
+        xSemaphoreTake(_ad2_dns_mutex, portMAX_DELAY);
+        strlcpy(host, _ad2_dns_prefetch_hosts[i].host, sizeof(host));
+        if (host[0]) {
+            ad2_dns_entry_t *e = _ad2_dns_find(host);
+            due = !e || (now_ms + AD2_DNS_PREFETCH_S * 1000ULL >= e->expires_ms &&
+                         (!e->failed_ms || now_ms - e->failed_ms >= AD2_DNS_RETRY_S * 1000ULL));
+            if (e && due) {
+                // keep prefetch hosts ahead of one off lookups in the LRU.
+                e->used_ms = now_ms;
+            }
+        }
+        _ad2_dns_stats.prefetches += due ? 1 : 0;
+        xSemaphoreGive(_ad2_dns_mutex);
+        if (due) {
+            uint32_t addr;
+            bool stale;
+            _ad2_dns_refresh(host, &addr, &stale);
+        }
+    }
+}
+
+/**
+ * @brief DNS prefetch task. Wakes on a new prefetch host or once a second.
+ */
+static void _ad2_dns_task_func(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        if (hal_get_network_connected()) {
+            _ad2_dns_prefetch_pass();
+        }
+    }
+}
+
+/**
+ * @brief Initialize the shared DNS cache and its prefetch task.
+ */
+void ad2_init_dns_cache()
+{
+    _ad2_dns_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(_ad2_dns_task_func, "AD2 dns", 1024 * 3, NULL, tskIDLE_PRIORITY + 1, &_ad2_dns_task);
+}
+
+/**
+ * @brief Get the DNS cache counters.
+ *
+ * @param [out]stats ad2_dns_stats_t *
+ */
+void ad2_get_dns_stats(ad2_dns_stats_t *stats)
+{
+    if (!_ad2_dns_mutex) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(_ad2_dns_mutex, portMAX_DELAY);
+    *stats = _ad2_dns_stats;
+    stats->entries = 0;
+    for (auto &e : _ad2_dns_cache) {
+        stats->entries += e.host[0] ? 1 : 0;
+    }
+    xSemaphoreGive(_ad2_dns_mutex);
+}
+
+#if CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM
+/**
+ * @brief lwIP netconn external resolve hook. Called by getaddrinfo and
+ * netconn_gethostbyname in the calling task before lwIP DNS is used.
+ *
+ * @return int 1 if handled here with the result in err, 0 to let lwIP resolve.
+ */
+extern "C" int lwip_hook_netconn_external_resolve(const char *name, ip_addr_t *addr, u8_t addrtype, err_t *err)
+{
+#if LWIP_IPV6
+    if (addrtype == NETCONN_DNS_IPV6) {
+        return 0;
+    }
+#endif
+    // IP literals, single label and mDNS names go to lwIP.
+    size_t len = strlen(name);
+    struct in_addr ina;
+    if (inet_aton(name, &ina) || !strchr(name, '.') ||
+            (len > 6 && strcasecmp(name + len - 6, ".local") == 0)) {
+        return 0;
+    }
+
+    uint32_t a;
+    bool stale;
+    int res = ad2_dns_lookup(name, &a, &stale);
+    if (res < 0) {
+        // nothing cached and no answer. Let lwIP try.
+        return 0;
+    }
+    if (res > 0) {
+        *err = ERR_VAL;
+        return 1;
+    }
+    if (stale) {
+        ESP_LOGW(TAG, "DNS failed for '%s' using last known address", name);
+    }
+    ip_addr_set_ip4_u32(addr, a);
+    *err = ERR_OK;
+    return 1;
+}
+#endif
@@ -0,0 +1,44 @@
+/**
+ *  @file    ad2_dns.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Shared DNS cache with TTL, prefetch and stale fallback for outbound connections.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_DNS_H
+#define _AD2_DNS_H
+
+/// Shared DNS cache counters.
+typedef struct {
+    uint32_t entries;        ///< hosts cached.
+    uint32_t hits;           ///< lookups answered from the cache.
+    uint32_t misses;         ///< lookups that needed a DNS query.
+    uint32_t stale;          ///< last known addresses served after DNS failed.
+    uint32_t failures;       ///< DNS queries with no usable answer.
+    uint32_t bypassed;       ///< misses left to lwIP while DNS was down.
+    uint32_t prefetches;     ///< refreshes of service hosts before expiry.
+    uint64_t saved_ms;       ///< query time avoided by cache hits.
+} ad2_dns_stats_t;
+
+void ad2_init_dns_cache();
+int ad2_dns_lookup(const char *host, uint32_t *addr, bool *stale = nullptr);
+void ad2_dns_prefetch(const char *owner, const std::string &url);
+void ad2_dns_prefetch_clear(const char *owner);
+void ad2_get_dns_stats(ad2_dns_stats_t *stats);
+
+#endif /* _AD2_DNS_H */
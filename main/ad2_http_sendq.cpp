@@ -0,0 +1,826 @@
+/**
+ *  @file    ad2_http_sendq.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Prioritized HTTP request queue, keep-alive pool and notification batching.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "AD2SENDQ";
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// esp includes
+#include "esp_chip_info.h"
+#include "esp_heap_caps.h"
+
+/**
+ * @brief A queued HTTP request.
+ */
+typedef struct sendQ_event_data {
+    esp_http_client_config_t *client_config;
+    ad2_http_sendQ_ready_cb_t ready;
+    ad2_http_sendQ_done_cb_t done;
+    uint8_t priority;        // ad2_http_priority_t lane.
+    uint32_t coalesce_key;   // 0 never coalesces.
+    uint32_t seq;            // FIFO order inside a lane.
+    uint64_t queued_ms;
+} sendQ_event_data_t;
+
+/**
+ * @brief Bounded sub-queue for one integration. Unordered; seq gives the
+ * FIFO order so removing from the middle is a swap with the last item.
+ */
+typedef struct sendQ_source {
+    sendQ_event_data_t items[AD2_HTTP_SENDQ_DEPTH];
+    uint8_t count;
+} sendQ_source_t;
+
+static sendQ_source_t _http_sendQ[AD2_HTTP_SRC_COUNT];
+static SemaphoreHandle_t _http_sendQ_mutex = NULL;
+static TaskHandle_t _http_sendQ_task = NULL;
+static ad2_http_sendQ_stats_t _http_sendQ_stats = {};
+static uint32_t _http_sendQ_seq = 0;
+static bool _http_sendQ_coalesce = false;
+// scheduler state. Round robin source per lane and security sends left
+// before an informational request gets a turn.
+static uint8_t _http_sendQ_next_src[AD2_HTTP_PRIO_COUNT] = {};
+static uint8_t _http_sendQ_security_credit = AD2_HTTP_SENDQ_SECURITY_WEIGHT;
+
+/**
+ * @brief Find the oldest item in a sub-queue for a lane.
+ *
+ * @param [in]q sendQ_source_t &
+ * @param [in]lane int priority or -1 for the lowest priority present.
+ *
+ * @return int index or -1 if none.
+ */
+static int _http_sendQ_oldest(sendQ_source_t &q, int lane)
+{
+    int found = -1;
+    for (int i = 0; i < q.count; i++) {
+        sendQ_event_data_t &e = q.items[i];
+        if (lane >= 0 && e.priority != lane) {
+            continue;
+        }
+        if (found < 0 ||
+                (lane < 0 && e.priority > q.items[found].priority) ||
+                (e.priority == q.items[found].priority && (int32_t)(e.seq - q.items[found].seq) < 0)) {
+            found = i;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Remove an item from a sub-queue. Caller holds _http_sendQ_mutex.
+ */
+static void _http_sendQ_remove(sendQ_source_t &q, int idx)
+{
+    _http_sendQ_stats.depth[q.items[idx].priority]--;
+    q.items[idx] = q.items[--q.count];
+}
+
+/**
+ * @brief Pick the next request to send. Life safety requests always go
+ * first. Security and informational requests share what is left
+ * AD2_HTTP_SENDQ_SECURITY_WEIGHT to 1 so a stream of security events
+ * can not starve informational ones. Inside a lane the sub-queues take
+ * turns so one busy integration can not hold up another.
+ *
+ * @param [out]out sendQ_event_data_t &
+ *
+ * @return bool true if a request was taken.
+ */
+static bool _http_sendQ_pop(sendQ_event_data_t &out)
+{
+    bool found = false;
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    int lane = -1;
+    if (_http_sendQ_stats.depth[AD2_HTTP_PRIO_LIFE_SAFETY]) {
+        lane = AD2_HTTP_PRIO_LIFE_SAFETY;
+    } else if (_http_sendQ_stats.depth[AD2_HTTP_PRIO_SECURITY] &&
+               (_http_sendQ_security_credit || !_http_sendQ_stats.depth[AD2_HTTP_PRIO_INFO])) {
+        lane = AD2_HTTP_PRIO_SECURITY;
+        if (_http_sendQ_security_credit) {
+            _http_sendQ_security_credit--;
+        }
+    } else if (_http_sendQ_stats.depth[AD2_HTTP_PRIO_INFO]) {
+        lane = AD2_HTTP_PRIO_INFO;
+        _http_sendQ_security_credit = AD2_HTTP_SENDQ_SECURITY_WEIGHT;
+    }
+    if (lane >= 0) {
+        for (int n = 0; n < AD2_HTTP_SRC_COUNT && !found; n++) {
+            int src = (_http_sendQ_next_src[lane] + n) % AD2_HTTP_SRC_COUNT;
+            int idx = _http_sendQ_oldest(_http_sendQ[src], lane);
+            if (idx >= 0) {
+                out = _http_sendQ[src].items[idx];
+                _http_sendQ_remove(_http_sendQ[src], idx);
+                _http_sendQ_next_src[lane] = (src + 1) % AD2_HTTP_SRC_COUNT;
+                found = true;
+                uint32_t wait_ms = (uint32_t)(hal_uptime_us() / 1000 - out.queued_ms);
+                _http_sendQ_stats.sent[lane]++;
+                if (wait_ms > _http_sendQ_stats.max_wait_ms[lane]) {
+                    _http_sendQ_stats.max_wait_ms[lane] = wait_ms;
+                }
+            }
+        }
+    }
+    xSemaphoreGive(_http_sendQ_mutex);
+    return found;
+}
+
+/**
+ * @brief A pooled esp_http_client kept open between requests to the same origin.
+ * The client is created with _http_pool_event_handler and the slot as user_data
+ * so the event handler and user_data of the request using it can be swapped in.
+ */
+typedef struct http_pool_conn {
+    esp_http_client_handle_t client;
+    std::string origin;       // scheme://host[:port] the client was opened for.
+    uint64_t last_used_ms;
+    bool connected;           // last request left the socket open.
+    bool request_sent;        // headers of the current attempt were written.
+    http_event_handle_cb handler;
+    void *user_data;
+} http_pool_conn_t;
+
+static http_pool_conn_t _http_pool[AD2_HTTP_POOL_SIZE];
+static ad2_http_pool_stats_t _http_pool_stats = {};
+static SemaphoreHandle_t _http_pool_mutex = NULL;
+
+/**
+ * @brief Update a pool counter under the stats lock.
+ */
+#define HTTP_POOL_STAT(expr) do { \
+    if (_http_pool_mutex) xSemaphoreTake(_http_pool_mutex, portMAX_DELAY); \
+    _http_pool_stats.expr; \
+    if (_http_pool_mutex) xSemaphoreGive(_http_pool_mutex); \
+} while (0)
+
+/**
+ * @brief esp_http_client event handler for pooled clients. Forward the
+ * event to the handler of the request currently using the connection.
+ * Events after the request is done, such as a later idle close, are dropped
+ * since the request user_data may already be freed.
+ *
+ * @param [in]evt esp_http_client_event_t *
+ */
+static esp_err_t _http_pool_event_handler(esp_http_client_event_t *evt)
+{
+    http_pool_conn_t *conn = (http_pool_conn_t *)evt->user_data;
+    if (conn && evt->event_id == HTTP_EVENT_HEADERS_SENT) {
+        conn->request_sent = true;
+    }
+    if (conn == nullptr || conn->handler == nullptr) {
+        return ESP_OK;
+    }
+    evt->user_data = conn->user_data;
+    esp_err_t err = conn->handler(evt);
+    evt->user_data = conn;
+    return err;
+}
+
+/**
+ * @brief Get the scheme://host[:port] part of a url used as the pool key.
+ *
+ * @param [in]url const char *
+ * @param [out]origin std::string &
+ *
+ * @return bool true if the url has a scheme and host.
+ */
+static bool _http_pool_origin(const char *url, std::string &origin)
+{
+    if (url == nullptr) {
+        return false;
+    }
+    const char *host = strstr(url, "://");
+    if (host == nullptr || host == url || host[3] == 0) {
+        return false;
+    }
+    host += 3;
+    size_t len = host - url + strcspn(host, "/?#");
+    origin.assign(url, len);
+    ad2_lcase(origin);
+    return true;
+}
+
+/**
+ * @brief Free a pooled client and its connection.
+ *
+ * @param [in]conn http_pool_conn_t &
+ */
+static void _http_pool_release(http_pool_conn_t &conn)
+{
+    if (conn.client) {
+        conn.handler = nullptr;
+        esp_http_client_cleanup(conn.client);
+        conn.client = nullptr;
+        HTTP_POOL_STAT(open--);
+    }
+    conn.origin.clear();
+    conn.connected = false;
+}
+
+/**
+ * @brief Close idle connections and free clients when the heap is short.
+ * Idle connections only drop the socket and TLS context. The client and
+ * any saved TLS session stay so the next request to the origin resumes.
+ *
+ * @param [in]now_ms uint64_t uptime.
+ * @param [in]skip http_pool_conn_t * slot to leave alone.
+ */
+static void _http_pool_sweep(uint64_t now_ms, http_pool_conn_t *skip)
+{
+    bool heap_low = esp_get_free_heap_size() < AD2_HTTP_POOL_MIN_FREE_HEAP;
+    for (auto &conn : _http_pool) {
+        if (&conn == skip || conn.client == nullptr) {
+            continue;
+        }
+        if (heap_low) {
+            _http_pool_release(conn);
+            HTTP_POOL_STAT(heap_closed++);
+        } else if (conn.connected && now_ms - conn.last_used_ms >= AD2_HTTP_POOL_IDLE_MS) {
+            esp_http_client_close(conn.client);
+            conn.connected = false;
+            HTTP_POOL_STAT(idle_closed++);
+        }
+    }
+}
+
+/**
+ * @brief Find or create the pooled client for a request. The least
+ * recently used slot is recycled when every slot is in use. Request
+ * headers and the POST body left by the last request are cleared so the
+ * ready callback starts from the same state as a new client.
+ *
+ * @param [in]config esp_http_client_config_t *
+ * @param [out]reused bool & true if an open connection is reused.
+ *
+ * @return http_pool_conn_t * or nullptr if no client could be created.
+ */
+static http_pool_conn_t *_http_pool_acquire(esp_http_client_config_t *config, bool &reused)
+{
+    reused = false;
+    std::string origin;
+    if (!_http_pool_origin(config->url, origin)) {
+        return nullptr;
+    }
+    uint64_t now_ms = hal_uptime_us() / 1000;
+
+    http_pool_conn_t *conn = nullptr;
+    for (auto &c : _http_pool) {
+        if (c.client && c.origin == origin) {
+            conn = &c;
+            break;
+        }
+    }
+
+    if (conn) {
+        reused = conn->connected;
+        HTTP_POOL_STAT(hits++);
+        esp_http_client_set_url(conn->client, config->url);
+        esp_http_client_set_method(conn->client, config->method);
+        esp_http_client_set_timeout_ms(conn->client, config->timeout_ms ? config->timeout_ms : 5000);
+        esp_http_client_delete_header(conn->client, "Authorization");
+        // clears the Content-Type header also.
+        esp_http_client_set_post_field(conn->client, NULL, 0);
+    } else {
+        HTTP_POOL_STAT(misses++);
+        // Make room for the new client. Free first so peak heap stays flat.
+        for (auto &c : _http_pool) {
+            if (c.client == nullptr) {
+                conn = &c;
+                break;
+            }
+            if (conn == nullptr || c.last_used_ms < conn->last_used_ms) {
+                conn = &c;
+            }
+        }
+        _http_pool_release(*conn);
+
+        // The client is bound to the slot. Request handler and user_data are
+        // forwarded by _http_pool_event_handler.
+        esp_http_client_config_t pool_config = *config;
+        pool_config.event_handler = _http_pool_event_handler;
+        pool_config.user_data = conn;
+        pool_config.keep_alive_enable = true;
+#if defined(CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS)
+        pool_config.save_client_session = true;
+#endif
+        conn->client = esp_http_client_init(&pool_config);
+        if (conn->client == nullptr) {
+            return nullptr;
+        }
+        HTTP_POOL_STAT(open++);
+        conn->origin = origin;
+
+        // Set user agent no including version info.
+        esp_chip_info_t chip_info;
+        esp_chip_info(&chip_info);
+        std::string ua = "AD2IoT-HTTP-Client/NOPE (ESP32-r" + std::to_string(chip_info.revision) + ")";
+        esp_http_client_set_header(conn->client, "User-Agent", ua.c_str());
+    }
+
+    conn->handler = config->event_handler;
+    conn->user_data = config->user_data;
+    conn->last_used_ms = now_ms;
+    return conn;
+}
+
+/**
+ * @brief Notifications waiting out the coalescing window for one
+ * integration notify slot.
+ */
+typedef struct http_notify_batch {
+    ad2_http_notify_cb_t send;
+    std::string message;     // messages so far, one per line.
+    uint8_t priority;        // highest priority of the messages.
+    uint64_t deadline_ms;    // window end. Fixed when the batch starts.
+} http_notify_batch_t;
+
+// key is source << 8 | slot.
+static std::map<uint16_t, http_notify_batch_t> _http_notify_batches;
+static uint32_t _http_notify_window_ms = AD2_HTTP_NOTIFY_WINDOW_MS;
+
+/**
+ * @brief Convert a wait in ms to ticks, never less than one tick so a
+ * window ending in under a tick does not turn the wait into a busy poll.
+ */
+static TickType_t _http_wait_ticks(uint32_t wait_ms)
+{
+    TickType_t ticks = pdMS_TO_TICKS(wait_ms);
+    return ticks ? ticks : 1;
+}
+
+/**
+ * @brief Send batches whose window has passed, or all of them.
+ *
+ * @param [in]now_ms uint64_t uptime.
+ * @param [in]only_key int batch to send now or -1 for all due batches.
+ *
+ * @return uint32_t ms until the next window ends or UINT32_MAX if none.
+ */
+static uint32_t _http_notify_flush(uint64_t now_ms, int only_key = -1)
+{
+    std::vector<std::pair<uint16_t, http_notify_batch_t>> due;
+    uint32_t next = UINT32_MAX;
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    for (auto it = _http_notify_batches.begin(); it != _http_notify_batches.end();) {
+        if (it->first == only_key || (only_key < 0 && now_ms >= it->second.deadline_ms)) {
+            due.push_back(*it);
+            it = _http_notify_batches.erase(it);
+        } else {
+            next = std::min(next, (uint32_t)(it->second.deadline_ms - now_ms));
+            ++it;
+        }
+    }
+    _http_sendQ_stats.requests += due.size();
+    xSemaphoreGive(_http_sendQ_mutex);
+
+    // build and queue outside the lock. It calls ad2_add_http_sendQ().
+    // An integration with spooled requests gets new ones appended to the
+    // spool so they are replayed after the older ones.
+    for (auto &b : due) {
+        if (ad2_http_spool_route((ad2_http_source_t)(b.first >> 8), b.first & 0xff,
+                                 (ad2_http_priority_t)b.second.priority, b.second.message)) {
+            if (b.second.priority == AD2_HTTP_PRIO_LIFE_SAFETY && _http_sendQ_task) {
+                xTaskNotifyGive(_http_sendQ_task);
+            }
+            continue;
+        }
+        b.second.send(b.first & 0xff, b.second.message, (ad2_http_priority_t)b.second.priority, 0);
+    }
+    return next;
+}
+
+/**
+ * @brief Queue a notification through the per destination coalescing window.
+ *
+ * The first message to an integration notify slot opens a window of
+ * `notifywindow` ms (AD2_HTTP_NOTIFY_WINDOW_MS by default, 0 disables).
+ * Messages for the same slot until it ends are merged one per line into a
+ * single request. A life safety message closes the window at once and goes
+ * out with anything already waiting. A batch that would grow past
+ * AD2_HTTP_NOTIFY_MAX_BYTES is sent and a new one started.
+ *
+ * @param [in]source ad2_http_source_t
+ * @param [in]slot uint8_t integration notify slot.
+ * @param [in]message std::string & rendered message.
+ * @param [in]priority ad2_http_priority_t
+ * @param [in]send ad2_http_notify_cb_t builds and queues the request.
+ */
+void ad2_http_notify(ad2_http_source_t source, uint8_t slot, const std::string &message,
+                     ad2_http_priority_t priority, ad2_http_notify_cb_t send)
+{
+    if (!_http_sendQ_mutex) {
+        return;
+    }
+    uint16_t key = (uint16_t)(source << 8 | slot);
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    bool flush_now = priority == AD2_HTTP_PRIO_LIFE_SAFETY || !_http_notify_window_ms;
+    bool flush_full = false;
+
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    _http_sendQ_stats.messages++;
+    auto it = _http_notify_batches.find(key);
+    if (it != _http_notify_batches.end() &&
+            it->second.message.length() + 1 + message.length() > AD2_HTTP_NOTIFY_MAX_BYTES) {
+        flush_full = true;
+    }
+    xSemaphoreGive(_http_sendQ_mutex);
+    if (flush_full) {
+        _http_notify_flush(now_ms, key);
+    }
+
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    it = _http_notify_batches.find(key);
+    bool opened = false;
+    if (it == _http_notify_batches.end()) {
+        it = _http_notify_batches.insert({ key, { send, message, (uint8_t)priority, now_ms + _http_notify_window_ms } }).first;
+        opened = true;
+    } else {
+        http_notify_batch_t &b = it->second;
+        // the same text again adds nothing.
+        bool repeat = (b.message == message) ||
+                      (b.message.length() > message.length() &&
+                       b.message.compare(b.message.length() - message.length(), message.length(), message) == 0 &&
+                       b.message[b.message.length() - message.length() - 1] == '\n');
+        if (!repeat) {
+            b.message += "\n" + message;
+        }
+        b.priority = std::min(b.priority, (uint8_t)priority);
+        _http_sendQ_stats.merged++;
+    }
+    xSemaphoreGive(_http_sendQ_mutex);
+
+    if (flush_now) {
+        _http_notify_flush(now_ms, key);
+    } else if (opened && _http_sendQ_task) {
+        // wake the sendQ task so it waits for the new window.
+        xTaskNotifyGive(_http_sendQ_task);
+    }
+}
+
+/**
+ * @brief HTTP sendQ consumer
+ *
+ * @param [in]pvParameters void *
+ */
+static void _http_sendQ_consumer_task(void *pvParameters)
+{
+    esp_err_t err;
+    bool online = false;
+
+    while (1) {
+        if (_http_sendQ_mutex == NULL) {
+            break;
+        }
+        if (g_StopMainTask) {
+            // sleep for a bit then check the queue again.
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        // Coalesced notifications whose window has ended.
+        uint32_t wait_ms = std::min<uint32_t>(_http_notify_flush(hal_uptime_us() / 1000), 1000);
+
+        sendQ_event_data_t event_data;
+        if (!hal_get_network_connected()) {
+            // Nothing can be delivered. Hand queued requests back so the
+            // owner can spool them instead of holding the queue.
+            online = false;
+            if (_http_sendQ_pop(event_data)) {
+                event_data.done(ESP_ERR_HTTP_CONNECT, nullptr, event_data.client_config);
+            } else {
+                ulTaskNotifyTake(pdTRUE, _http_wait_ticks(std::min<uint32_t>(wait_ms, 100)));
+            }
+            continue;
+        }
+        if (!online) {
+            online = true;
+            ad2_http_spool_online();
+        }
+
+        // Spooled requests whose backoff has passed go back in the queue.
+        ad2_http_spool_replay(hal_uptime_us() / 1000);
+
+        // Highest priority request next. Wait for ad2_add_http_sendQ() to
+        // wake us and sweep the pool while idle.
+        if (!_http_sendQ_pop(event_data)) {
+            ulTaskNotifyTake(pdTRUE, _http_wait_ticks(wait_ms));
+            _http_pool_sweep(hal_uptime_us() / 1000, nullptr);
+            continue;
+        }
+#if defined(AD2_STACK_REPORT)
+        ESP_LOGI(TAG, "_http_sendQ_consumer_task stack free %d", uxTaskGetStackHighWaterMark(NULL));
+#endif
+
+        _http_pool_sweep(hal_uptime_us() / 1000, nullptr);
+
+        // Use a kept connection to the same origin if we have one.
+        bool reused = false;
+        http_pool_conn_t *conn = _http_pool_acquire(event_data.client_config, reused);
+        esp_http_client_handle_t http_client = conn ? conn->client : nullptr;
+        if (http_client == nullptr) {
+            ESP_LOGE(TAG, "http sendQ unable to create a client for '%s'", event_data.client_config->url ? event_data.client_config->url : "");
+            // let the component clean up its request.
+            event_data.done(ESP_FAIL, http_client, event_data.client_config);
+            continue;
+        }
+
+        // notify compoenet we are about to send and allow to
+        // update connection details including post data etc.
+        event_data.ready(http_client, event_data.client_config);
+
+        // Allow for multiple requests on a single connection.
+        // TODO: sanity checking. Put back in sendQ for others to get some time? Memory.
+        do {
+            // start the connection
+            conn->request_sent = false;
+            err = esp_http_client_perform(http_client);
+
+            // The server may have dropped a kept connection while it was idle.
+            // Retry once on a fresh connection, but only if the request never
+            // went out. Once the headers are written the server may act on it
+            // and a resend could deliver an SMS, call or push twice. Handlers
+            // start a new response on HTTP_EVENT_HEADERS_SENT.
+            if (err != ESP_OK && reused && !conn->request_sent) {
+                HTTP_POOL_STAT(retries++);
+                esp_http_client_close(http_client);
+                err = esp_http_client_perform(http_client);
+            }
+            reused = (err == ESP_OK);
+
+            // Notify client the request finished and the results.
+            // If it wants to preform again it will return false;
+            if (event_data.done(err, http_client, event_data.client_config)) {
+                break;
+            }
+        } while (err == ESP_OK);
+
+        // The request may be freed by done(). Stop forwarding events to it.
+        conn->handler = nullptr;
+        conn->user_data = nullptr;
+        conn->last_used_ms = hal_uptime_us() / 1000;
+        conn->connected = (err == ESP_OK);
+
+        // Keep the connection for the next request unless it failed or
+        // we are short on heap.
+        if (err != ESP_OK) {
+            _http_pool_release(*conn);
+            HTTP_POOL_STAT(error_closed++);
+        } else if (esp_get_free_heap_size() < AD2_HTTP_POOL_MIN_FREE_HEAP) {
+            _http_pool_release(*conn);
+            HTTP_POOL_STAT(heap_closed++);
+        }
+    }
+    ESP_LOGW(TAG, "http sendQ ending. HTTP request delivery halted.");
+    for (auto &conn : _http_pool) {
+        _http_pool_release(conn);
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Initialize and start the HTTP request send queue.
+ * Allows for components to POST requests to server ASYNC and serialized with each other.
+ * Connections are kept open per origin for AD2_HTTP_POOL_IDLE_MS so only the
+ * first request to a server pays for the TCP and TLS handshake.
+ * Each integration has its own sub-queue and requests are sent by priority
+ * lane, see _http_sendQ_pop().
+ *
+ * Requests that fail are spooled by their owner with ad2_http_spool_report()
+ * and replayed in order per integration with exponential backoff.
+ *
+ */
+void ad2_init_http_sendQ()
+{
+    if (_http_sendQ_task) {
+        return;
+    }
+
+    // Init the queue.
+    _http_sendQ_mutex = xSemaphoreCreateMutex();
+    _http_pool_mutex = xSemaphoreCreateMutex();
+
+    // Undelivered requests from before a restart are replayed when online.
+    ad2_init_http_spool();
+
+    // Full sub-queue policy. evict(default) or coalesce.
+    std::string policy;
+    ad2_get_config_key_string(CFG_SECTION_MAIN, HTTPQFULL_CONFIG_KEY, policy);
+    ad2_lcase(policy);
+    _http_sendQ_coalesce = (policy == "coalesce");
+
+    // Notification coalescing window in ms. 0 sends every message alone.
+    int window = AD2_HTTP_NOTIFY_WINDOW_MS;
+    ad2_get_config_key_int(CFG_SECTION_MAIN, NOTIFYWINDOW_CONFIG_KEY, &window);
+    _http_notify_window_ms = window > 0 ? window : 0;
+
+    // Start the queue consumer task. Keep the stack as small as possible.
+    // 20210815SM: 1444 bytes stack free
+    xTaskCreate(_http_sendQ_consumer_task, "AD2 sendQ", 1024 * 8, NULL, tskIDLE_PRIORITY + 1, &_http_sendQ_task);
+}
+
+/**
+ * @brief Get a copy of the HTTP sendQ connection pool counters.
+ *
+ * @param [out]stats ad2_http_pool_stats_t *
+ */
+void ad2_get_http_pool_stats(ad2_http_pool_stats_t *stats)
+{
+    if (_http_pool_mutex) {
+        xSemaphoreTake(_http_pool_mutex, portMAX_DELAY);
+    }
+    *stats = _http_pool_stats;
+    if (_http_pool_mutex) {
+        xSemaphoreGive(_http_pool_mutex);
+    }
+}
+
+/**
+ * @brief Add a http client config to the queue
+ *
+ * When the integration sub-queue is full the `httpqfull` policy applies.
+ * With "coalesce" a queued request with the same coalesce_key is replaced
+ * by the new one in place. Otherwise, or if none match, the oldest request
+ * of the lowest priority below the new one is evicted. Replaced and
+ * evicted requests are handed to their done callback with a NULL client
+ * and AD2_HTTP_SENDQ_ERR_COALESCED or ESP_ERR_NO_MEM so the owner can free
+ * or spool them.
+ *
+ * @param [in]client_config esp_http_client_config_t *
+ * @param [in]ready_cb ad2_http_sendQ_ready_cb_t: Called before esp_http_client_perform()
+ * @param [in]done_cb ad2_http_sendQ_done_cb_t: Called after each esp_http_client_perform()
+ * @param [in]source ad2_http_source_t sub-queue to use.
+ * @param [in]priority ad2_http_priority_t lane.
+ * @param [in]coalesce_key uint32_t requests with the same non zero key may be merged.
+ *
+ * @return bool false if the request was not queued.
+ */
+bool ad2_add_http_sendQ(esp_http_client_config_t *client_config, ad2_http_sendQ_ready_cb_t ready_cb, ad2_http_sendQ_done_cb_t done_cb,
+                        ad2_http_source_t source, ad2_http_priority_t priority, uint32_t coalesce_key)
+{
+    if (!_http_sendQ_mutex) {
+        ESP_LOGE(TAG, "Invalid queue handle");
+        return false;
+    }
+    if (source >= AD2_HTTP_SRC_COUNT) {
+        source = AD2_HTTP_SRC_OTHER;
+    }
+    if (priority >= AD2_HTTP_PRIO_COUNT) {
+        priority = AD2_HTTP_PRIO_INFO;
+    }
+
+    // Save queue data into a structure for storage in the sendQ
+    sendQ_event_data_t event_data = {
+        .client_config = client_config,
+        .ready = ready_cb,
+        .done = done_cb,
+        .priority = (uint8_t)priority,
+        .coalesce_key = coalesce_key,
+        .seq = 0,
+        .queued_ms = hal_uptime_us() / 1000
+    };
+
+    bool queued = true;
+    esp_err_t dropped_err = ESP_OK;
+    sendQ_event_data_t old;
+
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    sendQ_source_t &q = _http_sendQ[source];
+    event_data.seq = _http_sendQ_seq++;
+    if (q.count < AD2_HTTP_SENDQ_DEPTH) {
+        q.items[q.count++] = event_data;
+        _http_sendQ_stats.depth[priority]++;
+    } else {
+        int idx = -1;
+        if (_http_sendQ_coalesce && coalesce_key) {
+            for (int i = 0; i < q.count; i++) {
+                if (q.items[i].coalesce_key == coalesce_key) {
+                    idx = i;
+                    break;
+                }
+            }
+        }
+        if (idx >= 0) {
+            // take over the queued request's place in line.
+            old = q.items[idx];
+            event_data.seq = old.seq;
+            event_data.queued_ms = old.queued_ms;
+            event_data.priority = std::min(old.priority, event_data.priority);
+            _http_sendQ_remove(q, idx);
+            q.items[q.count++] = event_data;
+            _http_sendQ_stats.depth[event_data.priority]++;
+            _http_sendQ_stats.coalesced++;
+            dropped_err = AD2_HTTP_SENDQ_ERR_COALESCED;
+        } else {
+            idx = _http_sendQ_oldest(q, -1);
+            if (idx >= 0 && q.items[idx].priority > priority) {
+                old = q.items[idx];
+                _http_sendQ_remove(q, idx);
+                q.items[q.count++] = event_data;
+                _http_sendQ_stats.depth[priority]++;
+                _http_sendQ_stats.evicted++;
+                dropped_err = ESP_ERR_NO_MEM;
+            } else {
+                _http_sendQ_stats.dropped++;
+                queued = false;
+            }
+        }
+    }
+    xSemaphoreGive(_http_sendQ_mutex);
+
+    if (dropped_err != ESP_OK) {
+        ESP_LOGW(TAG, "http sendQ full, %s a queued request",
+                 dropped_err == AD2_HTTP_SENDQ_ERR_COALESCED ? "coalesced" : "evicted");
+        old.done(dropped_err, nullptr, old.client_config);
+    }
+    if (queued && _http_sendQ_task) {
+        xTaskNotifyGive(_http_sendQ_task);
+    }
+    return queued;
+}
+
+/**
+ * @brief Get a copy of the HTTP sendQ scheduler counters.
+ *
+ * @param [out]stats ad2_http_sendQ_stats_t *
+ */
+void ad2_get_http_sendQ_stats(ad2_http_sendQ_stats_t *stats)
+{
+    if (_http_sendQ_mutex) {
+        xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    }
+    *stats = _http_sendQ_stats;
+    if (_http_sendQ_mutex) {
+        xSemaphoreGive(_http_sendQ_mutex);
+    }
+}
+
+/**
+ * @brief Pick a sendQ lane for a notification from the message that caused
+ * it, not from the partition's standing state, so a zone or trouble event
+ * during a fire is not sent as life safety.
+ *
+ * @details New or repeated Contact ID fire, panic and medical events
+ * (100-129) are life safety and other alarms (130-149) security. Their
+ * restores (qualifier 3) are informational. A keypad message is life
+ * safety if it carries the fire bit and security if it carries the alarm
+ * bell bit. Everything else is informational.
+ *
+ * @param [in]msg std::string * message that matched. May be nullptr.
+ *
+ * @return ad2_http_priority_t
+ */
+ad2_http_priority_t ad2_http_sendQ_priority(std::string *msg)
+{
+    if (!msg) {
+        return AD2_HTTP_PRIO_INFO;
+    }
+    size_t pos = msg->find("CID_");
+    if (pos != std::string::npos && msg->length() >= pos + 8) {
+        // CID_QEEE Q=1 new event, 3 restore, 6 previously reported.
+        char q = (*msg)[pos + 4];
+        const char *e = msg->c_str() + pos + 5;
+        if (q == '3' || e[0] != '1') {
+            return AD2_HTTP_PRIO_INFO;
+        }
+        if (e[1] == '0' || e[1] == '1' || e[1] == '2') {
+            return AD2_HTTP_PRIO_LIFE_SAFETY;
+        }
+        if (e[1] == '3' || e[1] == '4') {
+            return AD2_HTTP_PRIO_SECURITY;
+        }
+        return AD2_HTTP_PRIO_INFO;
+    }
+    if (msg->length() > FIRE_BYTE && (*msg)[0] == '[') {
+        if (is_bit_set(FIRE_BYTE, msg->c_str())) {
+            return AD2_HTTP_PRIO_LIFE_SAFETY;
+        }
+        if (is_bit_set(ALARM_BYTE, msg->c_str())) {
+            return AD2_HTTP_PRIO_SECURITY;
+        }
+    }
+    return AD2_HTTP_PRIO_INFO;
+}
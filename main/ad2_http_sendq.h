@@ -0,0 +1,91 @@
+/**
+ *  @file    ad2_http_sendq.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Prioritized HTTP request queue, keep-alive pool and notification batching.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_HTTP_SENDQ_H
+#define _AD2_HTTP_SENDQ_H
+
+// ASYNC serialized http request api for components.
+
+/// ad2_http async http request callback. Called before esp_http_client_perform()
+typedef void (*ad2_http_sendQ_ready_cb_t)(esp_http_client_handle_t, esp_http_client_config_t*);
+/// ad2_http async http request callback. Called after each esp_http_client_perform()
+/// or with a NULL client when the request is dropped from a full queue.
+typedef bool (*ad2_http_sendQ_done_cb_t)(esp_err_t, esp_http_client_handle_t, esp_http_client_config_t*);
+/// HTTP sendQ sub-queue. One per integration.
+typedef enum {
+    AD2_HTTP_SRC_OTHER = 0, ///< anything not listed.
+    AD2_HTTP_SRC_PUSHOVER,  ///< Pushover notifications.
+    AD2_HTTP_SRC_TWILIO,    ///< Twilio and SendGrid notifications.
+    AD2_HTTP_SRC_COUNT
+} ad2_http_source_t;
+
+/// HTTP sendQ priority lanes. Lower is sent first.
+typedef enum {
+    AD2_HTTP_PRIO_LIFE_SAFETY = 0, ///< fire, panic and medical.
+    AD2_HTTP_PRIO_SECURITY,        ///< burglary and other alarms.
+    AD2_HTTP_PRIO_INFO,            ///< everything else.
+    AD2_HTTP_PRIO_COUNT
+} ad2_http_priority_t;
+
+/// HTTP sendQ scheduler counters. Arrays are by ad2_http_priority_t.
+typedef struct {
+    uint32_t depth[AD2_HTTP_PRIO_COUNT];       ///< requests waiting.
+    uint32_t sent[AD2_HTTP_PRIO_COUNT];        ///< requests taken off the queue.
+    uint32_t max_wait_ms[AD2_HTTP_PRIO_COUNT]; ///< worst time spent queued.
+    uint32_t evicted;        ///< lower priority requests pushed out of a full sub-queue.
+    uint32_t coalesced;      ///< queued requests replaced by a newer one with the same key.
+    uint32_t dropped;        ///< new requests refused by a full sub-queue.
+    uint32_t messages;       ///< notifications given to ad2_http_notify().
+    uint32_t merged;         ///< notifications merged into an open window.
+    uint32_t requests;       ///< notification requests built from windows.
+} ad2_http_sendQ_stats_t;
+
+/// done callback result for a queued request replaced by a newer copy.
+#define AD2_HTTP_SENDQ_ERR_COALESCED 0xAD20
+
+/// Build and queue a notification request for an integration slot. spool_id
+/// is non zero when retrying a spooled request. Return false if not queued.
+typedef bool (*ad2_http_notify_cb_t)(uint8_t slot, const std::string &message, ad2_http_priority_t priority, uint32_t spool_id);
+
+/// HTTP sendQ keep-alive pool counters.
+typedef struct {
+    uint32_t open;           ///< connections held by the pool.
+    uint32_t hits;           ///< requests sent on a kept connection.
+    uint32_t misses;         ///< requests that opened a new connection.
+    uint32_t retries;        ///< stale kept connections reopened before the request went out.
+    uint32_t idle_closed;    ///< connections closed after AD2_HTTP_POOL_IDLE_MS.
+    uint32_t heap_closed;    ///< connections closed to recover heap.
+    uint32_t error_closed;   ///< connections closed after a failed request.
+} ad2_http_pool_stats_t;
+
+void ad2_init_http_sendQ();
+bool ad2_add_http_sendQ(esp_http_client_config_t*, ad2_http_sendQ_ready_cb_t, ad2_http_sendQ_done_cb_t,
+                        ad2_http_source_t source = AD2_HTTP_SRC_OTHER,
+                        ad2_http_priority_t priority = AD2_HTTP_PRIO_INFO,
+                        uint32_t coalesce_key = 0);
+ad2_http_priority_t ad2_http_sendQ_priority(std::string *msg);
+void ad2_get_http_sendQ_stats(ad2_http_sendQ_stats_t *stats);
+void ad2_http_notify(ad2_http_source_t source, uint8_t slot, const std::string &message,
+                     ad2_http_priority_t priority, ad2_http_notify_cb_t send);
+void ad2_get_http_pool_stats(ad2_http_pool_stats_t *stats);
+
+#endif /* _AD2_HTTP_SENDQ_H */
@@ -0,0 +1,541 @@
+/**
+ *  @file    ad2_http_spool.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Retry spool for undelivered HTTP sendQ notifications.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "AD2SPOOL";
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// esp includes
+#include "esp_rom_crc.h"
+#include "esp_random.h"
+
+/**
+ * @brief HTTP sendQ spool record. Fixed size so the spool file is a ring
+ * of records after its header. A record with id 0 is free.
+ */
+typedef struct ad2_http_spool_rec {
+    uint32_t magic;
+    uint32_t crc;            // crc32 of everything after crc.
+    uint32_t id;             // spool id, never 0 while in use.
+    uint32_t created_s;      // wall clock or 0 if the clock was not set.
+    uint8_t source;          // ad2_http_source_t
+    uint8_t slot;            // integration notify slot.
+    uint8_t priority;        // ad2_http_priority_t
+    uint8_t attempts;        // failed sends so far.
+    uint16_t length;
+    char message[AD2_HTTP_SPOOL_RECORD_SIZE - 22];
+} __attribute__((packed)) ad2_http_spool_rec_t;
+static_assert(sizeof(ad2_http_spool_rec_t) == AD2_HTTP_SPOOL_RECORD_SIZE, "spool record size");
+static_assert(AD2_HTTP_NOTIFY_MAX_BYTES <= sizeof(((ad2_http_spool_rec_t *)0)->message), "merged notifications must fit a spool record");
+
+typedef struct ad2_http_spool_hdr {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t head;           // oldest record.
+    uint32_t count;          // records from head, including delivered holes.
+    uint32_t next_id;
+    uint32_t crc;
+} ad2_http_spool_hdr_t;
+
+/**
+ * @brief In RAM summary of a spool record so scans do not read the card.
+ */
+typedef struct ad2_http_spool_meta {
+    uint32_t id;
+    uint32_t created_s;
+    uint64_t created_ms;     // uptime when spooled, 0 if from a previous boot.
+    uint8_t source;
+} ad2_http_spool_meta_t;
+
+#define AD2_HTTP_SPOOL_MAGIC 0x51324441 // "AD2Q"
+
+static SemaphoreHandle_t _http_spool_mutex = NULL;
+static FILE *_http_spool_file = NULL;
+static ad2_http_spool_hdr_t _http_spool_hdr = {};
+static std::vector<ad2_http_spool_meta_t> _http_spool_meta;
+static std::vector<ad2_http_spool_rec_t> _http_spool_ram; // used without a uSD card.
+static ad2_http_spool_stats_t _http_spool_stats = {};
+static ad2_http_notify_cb_t _http_spool_replay_cb[AD2_HTTP_SRC_COUNT] = {};
+// per integration retry state. One replayed record in flight at a time keeps order.
+static uint32_t _http_spool_inflight[AD2_HTTP_SRC_COUNT] = {};
+static uint8_t _http_spool_failures[AD2_HTTP_SRC_COUNT] = {};
+static uint64_t _http_spool_next_try_ms[AD2_HTTP_SRC_COUNT] = {};
+
+static uint32_t _http_spool_crc(const ad2_http_spool_rec_t &rec)
+{
+    const uint8_t *p = (const uint8_t *)&rec + offsetof(ad2_http_spool_rec_t, id);
+    return esp_rom_crc32_le(0, p, sizeof(rec) - offsetof(ad2_http_spool_rec_t, id));
+}
+
+/**
+ * @brief Write the spool header. Caller holds _http_spool_mutex.
+ */
+static bool _http_spool_write_hdr()
+{
+    if (!_http_spool_file) {
+        return true;
+    }
+    _http_spool_hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)&_http_spool_hdr, offsetof(ad2_http_spool_hdr_t, crc));
+    bool ok = fseek(_http_spool_file, 0, SEEK_SET) == 0 &&
+              fwrite(&_http_spool_hdr, 1, sizeof(_http_spool_hdr), _http_spool_file) == sizeof(_http_spool_hdr) &&
+              fflush(_http_spool_file) == 0 && fsync(fileno(_http_spool_file)) == 0;
+    if (!ok) {
+        _http_spool_stats.write_errors++;
+    }
+    return ok;
+}
+
+/**
+ * @brief Read or write spool record idx. Caller holds _http_spool_mutex.
+ */
+static bool _http_spool_io(uint32_t idx, ad2_http_spool_rec_t &rec, bool write)
+{
+    if (!_http_spool_file) {
+        if (write) {
+            _http_spool_ram[idx] = rec;
+        } else {
+            rec = _http_spool_ram[idx];
+        }
+        return true;
+    }
+    long pos = (long)(sizeof(ad2_http_spool_hdr_t) + idx * sizeof(ad2_http_spool_rec_t));
+    if (fseek(_http_spool_file, pos, SEEK_SET) != 0) {
+        return false;
+    }
+    if (!write) {
+        return fread(&rec, 1, sizeof(rec), _http_spool_file) == sizeof(rec);
+    }
+    rec.magic = AD2_HTTP_SPOOL_MAGIC;
+    rec.crc = _http_spool_crc(rec);
+    bool ok = fwrite(&rec, 1, sizeof(rec), _http_spool_file) == sizeof(rec) &&
+              fflush(_http_spool_file) == 0 && fsync(fileno(_http_spool_file)) == 0;
+    if (!ok) {
+        _http_spool_stats.write_errors++;
+    }
+    return ok;
+}
+
+/**
+ * @brief Free a spool record and move head past delivered records.
+ * Caller holds _http_spool_mutex.
+ */
+static void _http_spool_free(uint32_t idx)
+{
+    ad2_http_spool_rec_t rec = {};
+    _http_spool_meta[idx].id = 0;
+    _http_spool_io(idx, rec, true);
+    _http_spool_stats.depth--;
+    while (_http_spool_hdr.count && _http_spool_meta[_http_spool_hdr.head].id == 0) {
+        _http_spool_hdr.head = (_http_spool_hdr.head + 1) % _http_spool_hdr.capacity;
+        _http_spool_hdr.count--;
+    }
+    _http_spool_write_hdr();
+}
+
+/**
+ * @brief Close the holes delivered records left inside the head..count
+ * window so a full window with free slots can take a new record. Live
+ * records keep their order. Each is written to its new slot before the old
+ * one is cleared so a restart part way through can repeat a record but
+ * never lose one. Caller holds _http_spool_mutex.
+ */
+static void _http_spool_compact()
+{
+    uint32_t out = 0;
+    for (uint32_t n = 0; n < _http_spool_hdr.count; n++) {
+        uint32_t idx = (_http_spool_hdr.head + n) % _http_spool_hdr.capacity;
+        if (!_http_spool_meta[idx].id) {
+            continue;
+        }
+        uint32_t dst = (_http_spool_hdr.head + out++) % _http_spool_hdr.capacity;
+        if (dst == idx) {
+            continue;
+        }
+        ad2_http_spool_rec_t rec;
+        if (!_http_spool_io(idx, rec, false) || !_http_spool_io(dst, rec, true)) {
+            // leave the rest in place. The window is still consistent.
+            out = n + 1;
+            continue;
+        }
+        _http_spool_meta[dst] = _http_spool_meta[idx];
+        _http_spool_meta[idx].id = 0;
+        memset(&rec, 0, sizeof(rec));
+        _http_spool_io(idx, rec, true);
+    }
+    _http_spool_hdr.count = out;
+    _http_spool_write_hdr();
+}
+
+/**
+ * @brief Find the spool record holding id. Caller holds _http_spool_mutex.
+ *
+ * @return int index or -1.
+ */
+static int _http_spool_find(uint32_t id)
+{
+    for (uint32_t n = 0; n < _http_spool_hdr.count; n++) {
+        uint32_t idx = (_http_spool_hdr.head + n) % _http_spool_hdr.capacity;
+        if (_http_spool_meta[idx].id == id) {
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Open the spool ring file on the uSD card or fall back to a small
+ * RAM ring. Records left from before a restart are kept for replay.
+ */
+static void _http_spool_open()
+{
+    uint32_t capacity = AD2_HTTP_SPOOL_RAM_RECORDS;
+    if (g_uSD_mounted) {
+        _http_spool_file = fopen(AD2_HTTP_SPOOL_PATH, "r+b");
+        if (!_http_spool_file) {
+            _http_spool_file = fopen(AD2_HTTP_SPOOL_PATH, "w+b");
+        }
+    }
+    if (_http_spool_file) {
+        // a fully allocated file keeps later writes from growing it.
+        capacity = AD2_HTTP_SPOOL_RECORDS;
+        ad2_http_spool_hdr_t hdr = {};
+        bool valid = fread(&hdr, 1, sizeof(hdr), _http_spool_file) == sizeof(hdr) &&
+                     hdr.magic == AD2_HTTP_SPOOL_MAGIC && hdr.capacity == capacity &&
+                     hdr.head < capacity && hdr.count <= capacity &&
+                     hdr.crc == esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(ad2_http_spool_hdr_t, crc));
+        if (!valid) {
+            hdr = { AD2_HTTP_SPOOL_MAGIC, capacity, 0, 0, 1, 0 };
+        }
+        _http_spool_hdr = hdr;
+        _http_spool_meta.assign(capacity, ad2_http_spool_meta_t());
+        ad2_http_spool_rec_t rec;
+        if (!valid) {
+            // new or damaged spool. Allocate the whole ring up front.
+            memset(&rec, 0, sizeof(rec));
+            fseek(_http_spool_file, sizeof(hdr), SEEK_SET);
+            for (uint32_t idx = 0; idx < capacity; idx++) {
+                fwrite(&rec, 1, sizeof(rec), _http_spool_file);
+            }
+        }
+        for (uint32_t idx = 0; valid && idx < capacity; idx++) {
+            if (_http_spool_io(idx, rec, false) && rec.magic == AD2_HTTP_SPOOL_MAGIC && rec.id &&
+                    rec.crc == _http_spool_crc(rec) && rec.source < AD2_HTTP_SRC_COUNT) {
+                _http_spool_meta[idx] = { rec.id, rec.created_s, 0, rec.source };
+            }
+        }
+        // records outside head..count are stale.
+        for (uint32_t idx = 0; idx < capacity; idx++) {
+            uint32_t n = (idx + capacity - hdr.head) % capacity;
+            if (n >= hdr.count) {
+                _http_spool_meta[idx].id = 0;
+            } else if (_http_spool_meta[idx].id) {
+                _http_spool_stats.depth++;
+            }
+        }
+        _http_spool_stats.persistent = true;
+        _http_spool_write_hdr();
+        if (_http_spool_stats.depth) {
+            ESP_LOGI(TAG, "HTTP spool %s has %lu undelivered requests", AD2_HTTP_SPOOL_PATH, (unsigned long)_http_spool_stats.depth);
+        }
+    } else {
+        _http_spool_hdr = { AD2_HTTP_SPOOL_MAGIC, capacity, 0, 0, 1, 0 };
+        _http_spool_meta.assign(capacity, ad2_http_spool_meta_t());
+        _http_spool_ram.assign(capacity, ad2_http_spool_rec_t());
+    }
+    _http_spool_stats.capacity = capacity;
+}
+
+/**
+ * @brief Register the function that re-creates and queues a spooled request
+ * for an integration.
+ *
+ * @param [in]source ad2_http_source_t
+ * @param [in]fn ad2_http_notify_cb_t
+ */
+void ad2_http_spool_register(ad2_http_source_t source, ad2_http_notify_cb_t fn)
+{
+    if (source < AD2_HTTP_SRC_COUNT) {
+        _http_spool_replay_cb[source] = fn;
+    }
+}
+
+/**
+ * @brief Decide if a finished sendQ request should be tried again later.
+ * Connection, DNS and timeout errors, requests pushed out of a full queue,
+ * HTTP 429 and 5xx responses are retried. Other responses are final.
+ *
+ * @param [in]res esp_err_t given to the done callback.
+ * @param [in]client esp_http_client_handle_t given to the done callback.
+ *
+ * @return bool true to spool the request.
+ */
+bool ad2_http_sendQ_should_retry(esp_err_t res, esp_http_client_handle_t client)
+{
+    if (res == AD2_HTTP_SENDQ_ERR_COALESCED) {
+        return false;
+    }
+    if (res != ESP_OK || client == nullptr) {
+        return true;
+    }
+    int status = esp_http_client_get_status_code(client);
+    return status == 429 || status >= 500;
+}
+
+/**
+ * @brief Report how a notification went from an integration done callback.
+ *
+ * A failed new request (spool_id 0) is added to the spool. A failed replay
+ * is counted and its integration backs off. A delivered replay, or one that
+ * will never succeed, is removed.
+ *
+ * @param [in]source ad2_http_source_t
+ * @param [in]slot uint8_t integration notify slot.
+ * @param [in]priority ad2_http_priority_t
+ * @param [in]message std::string & rendered message.
+ * @param [in]spool_id uint32_t id given to the replay callback or 0.
+ * @param [in]retry bool true if delivery failed and should be tried again.
+ */
+void ad2_http_spool_report(ad2_http_source_t source, uint8_t slot, ad2_http_priority_t priority,
+                           const std::string &message, uint32_t spool_id, bool retry)
+{
+    if (!_http_spool_mutex || source >= AD2_HTTP_SRC_COUNT || (!retry && !spool_id)) {
+        return;
+    }
+    xSemaphoreTake(_http_spool_mutex, portMAX_DELAY);
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    if (spool_id) {
+        int idx = _http_spool_find(spool_id);
+        if (_http_spool_inflight[source] == spool_id) {
+            _http_spool_inflight[source] = 0;
+        }
+        if (retry) {
+            // exponential backoff with jitter for the whole integration.
+            if (_http_spool_failures[source] < 16) {
+                _http_spool_failures[source]++;
+            }
+            uint64_t delay = (uint64_t)AD2_HTTP_SPOOL_RETRY_MIN_MS << (_http_spool_failures[source] - 1);
+            if (delay > AD2_HTTP_SPOOL_RETRY_MAX_MS) {
+                delay = AD2_HTTP_SPOOL_RETRY_MAX_MS;
+            }
+            delay = delay / 2 + esp_random() % (delay / 2 + 1);
+            _http_spool_next_try_ms[source] = now_ms + delay;
+        } else {
+            _http_spool_failures[source] = 0;
+            _http_spool_next_try_ms[source] = 0;
+            _http_spool_stats.delivered++;
+        }
+        if (idx >= 0) {
+            ad2_http_spool_rec_t rec;
+            if (retry && _http_spool_io(idx, rec, false) && ++rec.attempts < AD2_HTTP_SPOOL_MAX_ATTEMPTS) {
+                _http_spool_io(idx, rec, true);
+            } else {
+                if (retry) {
+                    ESP_LOGW(TAG, "HTTP spool giving up on request %lu after %u attempts", (unsigned long)spool_id, rec.attempts);
+                    _http_spool_stats.dropped++;
+                }
+                _http_spool_free(idx);
+            }
+        }
+        xSemaphoreGive(_http_spool_mutex);
+        return;
+    }
+
+    // new failure. Close holes left by delivered records first and only
+    // drop the oldest record if every slot is really in use.
+    if (_http_spool_hdr.count == _http_spool_hdr.capacity && _http_spool_stats.depth < _http_spool_hdr.capacity) {
+        _http_spool_compact();
+    }
+    if (_http_spool_hdr.count == _http_spool_hdr.capacity) {
+        ESP_LOGW(TAG, "HTTP spool full, dropping the oldest request");
+        _http_spool_stats.dropped++;
+        if (_http_spool_inflight[_http_spool_meta[_http_spool_hdr.head].source] == _http_spool_meta[_http_spool_hdr.head].id) {
+            _http_spool_inflight[_http_spool_meta[_http_spool_hdr.head].source] = 0;
+        }
+        _http_spool_free(_http_spool_hdr.head);
+    }
+    uint32_t idx = (_http_spool_hdr.head + _http_spool_hdr.count) % _http_spool_hdr.capacity;
+    ad2_http_spool_rec_t rec = {};
+    rec.id = _http_spool_hdr.next_id++;
+    if (_http_spool_hdr.next_id == 0) {
+        _http_spool_hdr.next_id = 1;
+    }
+    int64_t wall_ms = ad2_wall_clock_ms();
+    rec.created_s = (uint32_t)(wall_ms / 1000);
+    rec.source = source;
+    rec.slot = slot;
+    rec.priority = priority;
+    rec.attempts = 1;
+    rec.length = std::min(message.length(), sizeof(rec.message));
+    memcpy(rec.message, message.data(), rec.length);
+    if (_http_spool_io(idx, rec, true)) {
+        _http_spool_meta[idx] = { rec.id, rec.created_s, now_ms ? now_ms : 1, (uint8_t)source };
+        _http_spool_hdr.count++;
+        _http_spool_stats.depth++;
+        _http_spool_stats.spooled++;
+        _http_spool_write_hdr();
+        if (!_http_spool_next_try_ms[source]) {
+            _http_spool_next_try_ms[source] = now_ms + AD2_HTTP_SPOOL_RETRY_MIN_MS;
+        }
+    } else {
+        _http_spool_stats.dropped++;
+    }
+    xSemaphoreGive(_http_spool_mutex);
+}
+
+/**
+ * @brief Spool a new notification instead of sending it when older ones for
+ * the same integration are still waiting, so replay keeps them in order.
+ * A life safety message ends the integration's backoff so the backlog and
+ * then the message go out as soon as the sendQ task runs again.
+ *
+ * @return bool true if the message was spooled.
+ */
+bool ad2_http_spool_route(ad2_http_source_t source, uint8_t slot, ad2_http_priority_t priority,
+                          const std::string &message)
+{
+    if (!_http_spool_mutex || source >= AD2_HTTP_SRC_COUNT) {
+        return false;
+    }
+    bool waiting = false;
+    xSemaphoreTake(_http_spool_mutex, portMAX_DELAY);
+    for (uint32_t n = 0; n < _http_spool_hdr.count && !waiting; n++) {
+        ad2_http_spool_meta_t &m = _http_spool_meta[(_http_spool_hdr.head + n) % _http_spool_hdr.capacity];
+        waiting = m.id && m.source == source;
+    }
+    if (waiting && priority == AD2_HTTP_PRIO_LIFE_SAFETY) {
+        _http_spool_failures[source] = 0;
+        _http_spool_next_try_ms[source] = 0;
+    }
+    xSemaphoreGive(_http_spool_mutex);
+    if (!waiting) {
+        return false;
+    }
+    ad2_http_spool_report(source, slot, priority, message, 0, true);
+    return true;
+}
+
+/**
+ * @brief Hand the oldest spooled request of each integration back to it
+ * once its backoff has passed. Called from the sendQ task while online.
+ *
+ * @param [in]now_ms uint64_t uptime.
+ */
+void ad2_http_spool_replay(uint64_t now_ms)
+{
+    for (int src = 0; src < AD2_HTTP_SRC_COUNT; src++) {
+        ad2_http_spool_rec_t rec;
+        bool found = false;
+        xSemaphoreTake(_http_spool_mutex, portMAX_DELAY);
+        if (_http_spool_replay_cb[src] && !_http_spool_inflight[src] && now_ms >= _http_spool_next_try_ms[src]) {
+            for (uint32_t n = 0; n < _http_spool_hdr.count && !found; n++) {
+                uint32_t idx = (_http_spool_hdr.head + n) % _http_spool_hdr.capacity;
+                if (_http_spool_meta[idx].id && _http_spool_meta[idx].source == src) {
+                    found = _http_spool_io(idx, rec, false) && rec.id == _http_spool_meta[idx].id;
+                    if (!found) {
+                        // unreadable record. Do not retry it forever.
+                        _http_spool_stats.dropped++;
+                        _http_spool_free(idx);
+                    }
+                }
+            }
+            if (found) {
+                _http_spool_inflight[src] = rec.id;
+                _http_spool_stats.replayed++;
+            }
+        }
+        xSemaphoreGive(_http_spool_mutex);
+
+        if (found) {
+            std::string message(rec.message, std::min((size_t)rec.length, sizeof(rec.message)));
+            if (!_http_spool_replay_cb[src](rec.slot, message, (ad2_http_priority_t)rec.priority, rec.id)) {
+                // could not queue it. Try again on the next pass.
+                xSemaphoreTake(_http_spool_mutex, portMAX_DELAY);
+                if (_http_spool_inflight[src] == rec.id) {
+                    _http_spool_inflight[src] = 0;
+                }
+                _http_spool_next_try_ms[src] = now_ms + AD2_HTTP_SPOOL_RETRY_MIN_MS;
+                xSemaphoreGive(_http_spool_mutex);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Connectivity is back. Retry every integration now.
+ */
+void ad2_http_spool_online()
+{
+    xSemaphoreTake(_http_spool_mutex, portMAX_DELAY);
+    for (int src = 0; src < AD2_HTTP_SRC_COUNT; src++) {
+        _http_spool_failures[src] = 0;
+        _http_spool_next_try_ms[src] = 0;
+    }
+    xSemaphoreGive(_http_spool_mutex);
+}
+
+/**
+ * @brief Get a copy of the HTTP sendQ spool counters.
+ *
+ * @param [out]stats ad2_http_spool_stats_t *
+ */
+void ad2_get_http_spool_stats(ad2_http_spool_stats_t *stats)
+{
+    if (!_http_spool_mutex) {
+        *stats = _http_spool_stats;
+        return;
+    }
+    xSemaphoreTake(_http_spool_mutex, portMAX_DELAY);
+    *stats = _http_spool_stats;
+    stats->oldest_age_s = 0;
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    int64_t wall_ms = ad2_wall_clock_ms();
+    for (uint32_t n = 0; n < _http_spool_hdr.count; n++) {
+        ad2_http_spool_meta_t &m = _http_spool_meta[(_http_spool_hdr.head + n) % _http_spool_hdr.capacity];
+        if (m.id) {
+            if (m.created_s && wall_ms / 1000 >= m.created_s) {
+                stats->oldest_age_s = (uint32_t)(wall_ms / 1000 - m.created_s);
+            } else {
+                // from a previous boot without a clock. At least this old.
+                stats->oldest_age_s = (uint32_t)((now_ms - m.created_ms) / 1000);
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(_http_spool_mutex);
+}
+
+/**
+ * @brief Initialize the spool. Called by ad2_init_http_sendQ() before its
+ * task starts.
+ */
+void ad2_init_http_spool()
+{
+    if (_http_spool_mutex) {
+        return;
+    }
+    _http_spool_mutex = xSemaphoreCreateMutex();
+    _http_spool_open();
+}
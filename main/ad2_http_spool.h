@@ -0,0 +1,52 @@
+/**
+ *  @file    ad2_http_spool.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Retry spool for undelivered HTTP sendQ notifications.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_HTTP_SPOOL_H
+#define _AD2_HTTP_SPOOL_H
+
+/// HTTP sendQ spool counters.
+typedef struct {
+    uint32_t depth;          ///< undelivered requests in the spool.
+    uint32_t capacity;       ///< spool records. Smaller without a uSD card.
+    uint32_t oldest_age_s;   ///< age of the oldest undelivered request.
+    uint32_t spooled;        ///< failed requests added.
+    uint32_t replayed;       ///< retries handed back to an integration.
+    uint32_t delivered;      ///< spooled requests finished on a retry.
+    uint32_t dropped;        ///< requests lost to a full spool or too many attempts.
+    uint32_t write_errors;   ///< failed spool file writes.
+    bool persistent;         ///< stored on the uSD card.
+} ad2_http_spool_stats_t;
+
+bool ad2_http_sendQ_should_retry(esp_err_t res, esp_http_client_handle_t client);
+void ad2_http_spool_register(ad2_http_source_t source, ad2_http_notify_cb_t fn);
+void ad2_http_spool_report(ad2_http_source_t source, uint8_t slot, ad2_http_priority_t priority,
+                           const std::string &message, uint32_t spool_id, bool retry);
+void ad2_get_http_spool_stats(ad2_http_spool_stats_t *stats);
+
+// Used by the HTTP sendQ task.
+void ad2_init_http_spool();
+bool ad2_http_spool_route(ad2_http_source_t source, uint8_t slot, ad2_http_priority_t priority,
+                          const std::string &message);
+void ad2_http_spool_replay(uint64_t now_ms);
+void ad2_http_spool_online();
+
+#endif /* _AD2_HTTP_SPOOL_H */
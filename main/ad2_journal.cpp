@@ -0,0 +1,605 @@
+/**
+ *  @file    ad2_journal.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Append only uSD event journal with indexed historical queries.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "AD2JOURNAL";
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// esp includes
+#include "esp_rom_crc.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Persistent parser event journal.
+ *
+ * Append only file of 1 KiB blocks on the uSD card. Each block is a 64 byte
+ * header with a CRC followed by up to 15 fixed size 64 byte records. Only
+ * the newest block can be partly filled so a record's position follows
+ * from its sequence number. The block being filled is rewritten in place
+ * as records arrive and a torn or corrupt tail is truncated back to the
+ * last valid block at startup. A sparse RAM index keeps the first sequence
+ * and wall clock time of every AD2_JOURNAL_INDEX_STRIDE blocks and block
+ * headers carry partition and event masks so queries skip blocks without
+ * reading their records. */
+#define AD2_JOURNAL_MAGIC 0x4a324441 // "AD2J"
+#define AD2_JOURNAL_BLOCK_SIZE 1024
+#define AD2_JOURNAL_RECS_PER_BLOCK 15
+struct ad2_journal_rec {
+    uint32_t seq;
+    uint32_t wall_s;         // 0 if the clock was not set.
+    uint64_t uptime_ms;
+    uint16_t boot;
+    uint8_t event;           // ad2_event_t
+    uint8_t partition;
+    uint8_t zone;
+    int8_t zone_state;       // AD2_CMD_ZONE_state_t
+    uint16_t flags;          // AD2_JOURNAL_F_*
+    char text[40];           // alpha or LRR message.
+};
+struct ad2_journal_blk_hdr {
+    uint32_t magic;
+    uint32_t crc;            // header after this field and the records.
+    uint32_t first_seq;
+    uint16_t count;
+    uint16_t boot;
+    uint32_t wall_first_s;
+    uint32_t wall_last_s;
+    uint64_t event_mask;
+    uint16_t partition_mask;
+    uint8_t reserved[30];
+};
+struct ad2_journal_block {
+    ad2_journal_blk_hdr hdr;
+    ad2_journal_rec recs[AD2_JOURNAL_RECS_PER_BLOCK];
+};
+struct ad2_journal_index {
+    uint32_t first_seq;
+    uint32_t wall_s;         // carried forward when the clock was not set.
+};
+struct ad2_journal_file {
+    const char *path;
+    uint32_t first_seq;
+    uint32_t blocks;
+    std::vector<ad2_journal_index> index;
+};
+#define AD2_JOURNAL_F_READY      0x0001
+#define AD2_JOURNAL_F_ARMED_AWAY 0x0002
+#define AD2_JOURNAL_F_ARMED_STAY 0x0004
+#define AD2_JOURNAL_F_ALARM      0x0008
+#define AD2_JOURNAL_F_FIRE       0x0010
+#define AD2_JOURNAL_F_AC_POWER   0x0020
+#define AD2_JOURNAL_F_BATT_LOW   0x0040
+#define AD2_JOURNAL_F_BYPASSED   0x0080
+#define AD2_JOURNAL_F_CHIME      0x0100
+#define AD2_JOURNAL_F_EXIT_NOW   0x0200
+static SemaphoreHandle_t _ad2_journal_mutex = nullptr;      // pending records.
+static SemaphoreHandle_t _ad2_journal_file_mutex = nullptr; // files, index and block being filled.
+static TaskHandle_t _ad2_journal_task_handle = NULL;
+static ad2_journal_file _ad2_journal_cur = { AD2_JOURNAL_PATH, 0, 0, {} };
+static ad2_journal_file _ad2_journal_old = { AD2_JOURNAL_OLD_PATH, 0, 0, {} };
+static ad2_journal_block _ad2_journal_blk;   // block being filled.
+static uint32_t _ad2_journal_blk_index = 0;  // its block number in the current file.
+static bool _ad2_journal_blk_dirty = false;
+static std::vector<ad2_journal_rec> _ad2_journal_pending;
+static uint32_t _ad2_journal_next_seq = 1;
+static uint16_t _ad2_journal_boot = 1;
+static bool _ad2_journal_urgent = false;
+// counters are only touched under spinlock.
+static uint32_t _ad2_journal_dropped = 0;
+static uint32_t _ad2_journal_write_errors = 0;
+
+static uint32_t _ad2_journal_crc(const ad2_journal_block &blk)
+{
+    const uint8_t *start = (const uint8_t *)&blk.hdr.first_seq;
+    size_t length = sizeof(blk.hdr) - offsetof(ad2_journal_blk_hdr, first_seq) +
+                    blk.hdr.count * sizeof(ad2_journal_rec);
+    return esp_rom_crc32_le(0, start, length);
+}
+
+static bool _ad2_journal_read_block(FILE *file, uint32_t index, ad2_journal_block &blk)
+{
+    if (fseek(file, (long)index * AD2_JOURNAL_BLOCK_SIZE, SEEK_SET) != 0 ||
+            fread(&blk, 1, sizeof(blk), file) != sizeof(blk)) {
+        return false;
+    }
+    return blk.hdr.magic == AD2_JOURNAL_MAGIC && blk.hdr.count >= 1 &&
+           blk.hdr.count <= AD2_JOURNAL_RECS_PER_BLOCK && blk.hdr.crc == _ad2_journal_crc(blk);
+}
+
+/**
+ * @brief Rebuild the sparse index of a journal file from its block headers.
+ */
+static void _ad2_journal_build_index(FILE *file, ad2_journal_file &jf)
+{
+    jf.index.clear();
+    uint32_t wall_s = 0;
+    ad2_journal_block blk;
+    for (uint32_t n = 0; n < jf.blocks; n += AD2_JOURNAL_INDEX_STRIDE) {
+        ad2_journal_index entry = { 0, wall_s };
+        if (_ad2_journal_read_block(file, n, blk)) {
+            entry.first_seq = blk.hdr.first_seq;
+            if (blk.hdr.wall_first_s) {
+                wall_s = entry.wall_s = blk.hdr.wall_first_s;
+            }
+        }
+        if (n == 0) {
+            jf.first_seq = entry.first_seq;
+        }
+        jf.index.push_back(entry);
+    }
+}
+
+/**
+ * @brief Open a journal file, truncate anything after the last valid block
+ * and index it.
+ *
+ * @return bool true if at least one valid block remains. blk holds it.
+ */
+static bool _ad2_journal_recover(ad2_journal_file &jf, ad2_journal_block &blk)
+{
+    jf.blocks = 0;
+    jf.index.clear();
+    FILE *file = fopen(jf.path, "r+b");
+    if (!file) {
+        return false;
+    }
+    struct stat info;
+    uint32_t blocks = (fstat(fileno(file), &info) == 0) ? info.st_size / AD2_JOURNAL_BLOCK_SIZE : 0;
+    while (blocks && !_ad2_journal_read_block(file, blocks - 1, blk)) {
+        blocks--;
+    }
+    if ((off_t)blocks * AD2_JOURNAL_BLOCK_SIZE != info.st_size) {
+        ESP_LOGW(TAG, "Journal %s truncated to %lu valid blocks", jf.path, (unsigned long)blocks);
+        fflush(file);
+        ftruncate(fileno(file), (off_t)blocks * AD2_JOURNAL_BLOCK_SIZE);
+    }
+    jf.blocks = blocks;
+    _ad2_journal_build_index(file, jf);
+    fclose(file);
+    return blocks > 0;
+}
+
+/**
+ * @brief Write the block being filled at its place in the current file.
+ */
+static bool _ad2_journal_write_block()
+{
+    _ad2_journal_blk.hdr.crc = _ad2_journal_crc(_ad2_journal_blk);
+    FILE *file = fopen(_ad2_journal_cur.path, _ad2_journal_cur.blocks ? "r+b" : "w+b");
+    if (!file) {
+        return false;
+    }
+    bool ok = fseek(file, (long)_ad2_journal_blk_index * AD2_JOURNAL_BLOCK_SIZE, SEEK_SET) == 0 &&
+              fwrite(&_ad2_journal_blk, 1, sizeof(_ad2_journal_blk), file) == sizeof(_ad2_journal_blk) &&
+              fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (ok && _ad2_journal_blk_index >= _ad2_journal_cur.blocks) {
+        _ad2_journal_cur.blocks = _ad2_journal_blk_index + 1;
+        if (_ad2_journal_blk_index == 0) {
+            _ad2_journal_cur.first_seq = _ad2_journal_blk.hdr.first_seq;
+        }
+        if (_ad2_journal_blk_index % AD2_JOURNAL_INDEX_STRIDE == 0) {
+            uint32_t wall_s = _ad2_journal_blk.hdr.wall_first_s;
+            if (!wall_s && !_ad2_journal_cur.index.empty()) {
+                wall_s = _ad2_journal_cur.index.back().wall_s;
+            }
+            _ad2_journal_cur.index.push_back({ _ad2_journal_blk.hdr.first_seq, wall_s });
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Start an empty block after the current one. Moves a full current
+ * file to AD2_JOURNAL_OLD_PATH first.
+ */
+static void _ad2_journal_next_block()
+{
+    _ad2_journal_blk_index++;
+    if ((uint64_t)_ad2_journal_blk_index * AD2_JOURNAL_BLOCK_SIZE >= AD2_JOURNAL_MAX_BYTES) {
+        remove(_ad2_journal_old.path);
+        if (rename(_ad2_journal_cur.path, _ad2_journal_old.path) == 0) {
+            _ad2_journal_old.first_seq = _ad2_journal_cur.first_seq;
+            _ad2_journal_old.blocks = _ad2_journal_cur.blocks;
+            _ad2_journal_old.index.swap(_ad2_journal_cur.index);
+        } else {
+            remove(_ad2_journal_cur.path);
+            _ad2_journal_old.blocks = 0;
+            _ad2_journal_old.index.clear();
+        }
+        _ad2_journal_cur.blocks = 0;
+        _ad2_journal_cur.index.clear();
+        _ad2_journal_blk_index = 0;
+    }
+    memset(&_ad2_journal_blk, 0, sizeof(_ad2_journal_blk));
+    _ad2_journal_blk_dirty = false;
+}
+
+/**
+ * @brief Journal writer. Moves pending records into the block being filled
+ * and writes it when it is full, after AD2_JOURNAL_FLUSH_MS or right away
+ * for alarm events.
+ */
+static void _ad2_journal_task(void *pvParameters)
+{
+    uint64_t dirty_since_ms = 0;
+    std::vector<ad2_journal_rec> batch;
+    batch.reserve(AD2_JOURNAL_PENDING_MAX);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AD2_JOURNAL_FLUSH_MS));
+        if (!g_uSD_mounted) {
+            continue;
+        }
+        // the file lock is taken first so queries see each record once.
+        xSemaphoreTake(_ad2_journal_file_mutex, portMAX_DELAY);
+        xSemaphoreTake(_ad2_journal_mutex, portMAX_DELAY);
+        batch.swap(_ad2_journal_pending);
+        bool urgent = _ad2_journal_urgent;
+        _ad2_journal_urgent = false;
+        xSemaphoreGive(_ad2_journal_mutex);
+
+        for (auto &rec : batch) {
+            ad2_journal_blk_hdr &hdr = _ad2_journal_blk.hdr;
+            if (!hdr.count) {
+                hdr.magic = AD2_JOURNAL_MAGIC;
+                hdr.first_seq = rec.seq;
+                hdr.boot = rec.boot;
+                dirty_since_ms = hal_uptime_us() / 1000;
+            }
+            _ad2_journal_blk.recs[hdr.count++] = rec;
+            if (rec.wall_s) {
+                if (!hdr.wall_first_s) {
+                    hdr.wall_first_s = rec.wall_s;
+                }
+                hdr.wall_last_s = rec.wall_s;
+            }
+            hdr.event_mask |= 1ULL << (rec.event & 63);
+            hdr.partition_mask |= 1 << (rec.partition & 15);
+            _ad2_journal_blk_dirty = true;
+            if (hdr.count == AD2_JOURNAL_RECS_PER_BLOCK) {
+                if (!_ad2_journal_write_block()) {
+                    taskENTER_CRITICAL(&spinlock);
+                    _ad2_journal_write_errors++;
+                    taskEXIT_CRITICAL(&spinlock);
+                }
+                _ad2_journal_next_block();
+            }
+        }
+        batch.clear();
+        if (_ad2_journal_blk_dirty &&
+                (urgent || hal_uptime_us() / 1000 - dirty_since_ms >= AD2_JOURNAL_FLUSH_MS)) {
+            if (_ad2_journal_write_block()) {
+                _ad2_journal_blk_dirty = false;
+            } else {
+                taskENTER_CRITICAL(&spinlock);
+                _ad2_journal_write_errors++;
+                taskEXIT_CRITICAL(&spinlock);
+            }
+        }
+        xSemaphoreGive(_ad2_journal_file_mutex);
+    }
+}
+
+/**
+ * @brief Parser event subscriber. Queues a record for the journal task.
+ */
+static void _ad2_journal_on_event(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    int event = (intptr_t)arg;
+    ad2_journal_rec rec = {};
+    rec.wall_s = ad2_wall_clock_ms() / 1000;
+    rec.uptime_ms = hal_uptime_us() / 1000;
+    rec.boot = _ad2_journal_boot;
+    rec.event = event;
+    if (s) {
+        rec.partition = s->partition;
+        rec.zone_state = AD2_STATE_UNKNOWN;
+        // s->zone is the last zone the partition saw. Only zone events own it.
+        if (event == ON_ZONE_CHANGE) {
+            rec.zone = s->zone;
+            auto zone = s->zone_states.find(s->zone);
+            if (zone != s->zone_states.end()) {
+                rec.zone_state = zone->second.state();
+            }
+        }
+        rec.flags = (s->ready ? AD2_JOURNAL_F_READY : 0) |
+                    (s->armed_away ? AD2_JOURNAL_F_ARMED_AWAY : 0) |
+                    (s->armed_stay ? AD2_JOURNAL_F_ARMED_STAY : 0) |
+                    (s->alarm_sounding ? AD2_JOURNAL_F_ALARM : 0) |
+                    (s->fire_alarm ? AD2_JOURNAL_F_FIRE : 0) |
+                    (s->ac_power ? AD2_JOURNAL_F_AC_POWER : 0) |
+                    (s->battery_low ? AD2_JOURNAL_F_BATT_LOW : 0) |
+                    (s->zone_bypassed ? AD2_JOURNAL_F_BYPASSED : 0) |
+                    (s->chime_on ? AD2_JOURNAL_F_CHIME : 0) |
+                    (s->exit_now ? AD2_JOURNAL_F_EXIT_NOW : 0);
+        strlcpy(rec.text, s->last_alpha_message.c_str(), sizeof(rec.text));
+    }
+    if (event == ON_LRR && msg) {
+        strlcpy(rec.text, msg->c_str(), sizeof(rec.text));
+    }
+
+    if (xSemaphoreTake(_ad2_journal_mutex, pdMS_TO_TICKS(50)) != pdTRUE) {
+        taskENTER_CRITICAL(&spinlock);
+        _ad2_journal_dropped++;
+        taskEXIT_CRITICAL(&spinlock);
+        return;
+    }
+    if (_ad2_journal_pending.size() >= AD2_JOURNAL_PENDING_MAX) {
+        taskENTER_CRITICAL(&spinlock);
+        _ad2_journal_dropped++;
+        taskEXIT_CRITICAL(&spinlock);
+    } else {
+        rec.seq = _ad2_journal_next_seq++;
+        _ad2_journal_pending.push_back(rec);
+        _ad2_journal_urgent |= event == ON_ALARM_CHANGE || event == ON_FIRE_CHANGE ||
+                               event == ON_PANIC || event == ON_LRR;
+    }
+    xSemaphoreGive(_ad2_journal_mutex);
+    xTaskNotifyGive(_ad2_journal_task_handle);
+}
+
+void ad2_init_journal()
+{
+    bool enabled = true;
+    ad2_get_config_key_bool(CFG_SECTION_MAIN, JOURNAL_CONFIG_KEY, &enabled);
+    if (!enabled || !g_uSD_mounted) {
+        return;
+    }
+    _ad2_journal_mutex = xSemaphoreCreateMutex();
+    _ad2_journal_file_mutex = xSemaphoreCreateMutex();
+    if (!_ad2_journal_mutex || !_ad2_journal_file_mutex) {
+        return;
+    }
+
+    // power loss recovery. Continue the last block if it has room.
+    ad2_journal_block last;
+    _ad2_journal_recover(_ad2_journal_old, last);
+    memset(&_ad2_journal_blk, 0, sizeof(_ad2_journal_blk));
+    if (_ad2_journal_recover(_ad2_journal_cur, last)) {
+        _ad2_journal_next_seq = last.hdr.first_seq + last.hdr.count;
+        _ad2_journal_boot = last.hdr.boot + 1;
+        _ad2_journal_blk_index = _ad2_journal_cur.blocks - 1;
+        if (last.hdr.count < AD2_JOURNAL_RECS_PER_BLOCK) {
+            _ad2_journal_blk = last;
+        } else {
+            _ad2_journal_next_block();
+        }
+    } else if (_ad2_journal_old.blocks) {
+        FILE *file = fopen(_ad2_journal_old.path, "rb");
+        if (file && _ad2_journal_read_block(file, _ad2_journal_old.blocks - 1, last)) {
+            _ad2_journal_next_seq = last.hdr.first_seq + last.hdr.count;
+            _ad2_journal_boot = last.hdr.boot + 1;
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+    _ad2_journal_pending.reserve(AD2_JOURNAL_PENDING_MAX);
+
+    if (xTaskCreate(_ad2_journal_task, "AD2 journal", 1024 * 4, NULL,
+                    tskIDLE_PRIORITY + 1, &_ad2_journal_task_handle) != pdPASS) {
+        return;
+    }
+
+    static const ad2_event_t events[] = {
+        ON_ARM, ON_DISARM, ON_POWER_CHANGE, ON_READY_CHANGE, ON_ALARM_CHANGE,
+        ON_FIRE_CHANGE, ON_ZONE_BYPASSED_CHANGE, ON_ZONE_CHANGE, ON_LOW_BATTERY,
+        ON_PANIC, ON_CHIME_CHANGE, ON_PROGRAMMING_CHANGE, ON_LRR, ON_EXIT_CHANGE
+    };
+    for (ad2_event_t event : events) {
+        AD2Parse.subscribeTo(event, _ad2_journal_on_event, (void *)event);
+    }
+    ad2_printf_host(true, "%s: Event journal %s next sequence %lu boot %u", TAG,
+                    _ad2_journal_cur.path, (unsigned long)_ad2_journal_next_seq, _ad2_journal_boot);
+}
+
+/**
+ * @brief Add a journal record to a query result if it matches.
+ */
+static bool _ad2_journal_match(const ad2_journal_rec &rec, const ad2_journal_query_t &q)
+{
+    if (q.cursor && rec.seq >= q.cursor) {
+        return false;
+    }
+    if ((q.from_s || q.to_s) && !rec.wall_s) {
+        return false;
+    }
+    if ((q.from_s && rec.wall_s < q.from_s) || (q.to_s && rec.wall_s > q.to_s)) {
+        return false;
+    }
+    return (q.partition < 0 || rec.partition == q.partition) &&
+           (q.zone < 0 || rec.zone == q.zone) &&
+           (q.event < 0 || rec.event == q.event);
+}
+
+static void _ad2_journal_add_json(cJSON *items, const ad2_journal_rec &rec)
+{
+    cJSON *item = cJSON_CreateObject();
+    cJSON_AddNumberToObject(item, "sequence", rec.seq);
+    cJSON_AddNumberToObject(item, "uptime_ms", (double)rec.uptime_ms);
+    cJSON_AddNumberToObject(item, "boot", rec.boot);
+    if (rec.wall_s) {
+        cJSON_AddNumberToObject(item, "time", rec.wall_s);
+    }
+    cJSON_AddNumberToObject(item, "partition", rec.partition);
+    cJSON_AddNumberToObject(item, "zone", rec.zone);
+    if (rec.event == ON_ZONE_CHANGE) {
+        cJSON_AddNumberToObject(item, "zone_state", rec.zone_state);
+    }
+    cJSON_AddStringToObject(item, "event", AD2Parse.event_str[rec.event].c_str());
+    cJSON_AddNumberToObject(item, "flags", rec.flags);
+    char text[sizeof(rec.text) + 1];
+    memcpy(text, rec.text, sizeof(rec.text));
+    text[sizeof(rec.text)] = 0;
+    cJSON_AddStringToObject(item, "alpha", text);
+    cJSON_AddItemToArray(items, item);
+}
+
+/**
+ * @brief Walk the blocks of one journal file newest first.
+ *
+ * @return bool false when the query is complete.
+ */
+static bool _ad2_journal_query_file(ad2_journal_file &jf, uint32_t last_block,
+                                    const ad2_journal_query_t &q, cJSON *items,
+                                    size_t &found, size_t &scanned, uint32_t &next_cursor)
+{
+    if (!jf.blocks) {
+        return true;
+    }
+    uint32_t block = std::min(last_block, jf.blocks - 1);
+    // position from the cursor sequence. all blocks but the last are full.
+    if (q.cursor && q.cursor > jf.first_seq) {
+        block = std::min(block, (q.cursor - 1 - jf.first_seq) / AD2_JOURNAL_RECS_PER_BLOCK);
+    } else if (q.cursor) {
+        return true;
+    }
+    // skip groups that start after the end of the time range.
+    if (q.to_s) {
+        for (size_t g = 0; g < jf.index.size(); g++) {
+            if (jf.index[g].wall_s > q.to_s) {
+                if (g == 0) {
+                    return true;
+                }
+                block = std::min(block, (uint32_t)(g * AD2_JOURNAL_INDEX_STRIDE - 1));
+                break;
+            }
+        }
+    }
+
+    FILE *file = fopen(jf.path, "rb");
+    if (!file) {
+        return true;
+    }
+    uint64_t event_bit = q.event >= 0 ? 1ULL << (q.event & 63) : 0;
+    uint16_t partition_bit = q.partition >= 0 ? 1 << (q.partition & 15) : 0;
+    ad2_journal_block blk;
+    bool more = true;
+    for (int64_t b = block; b >= 0; b--) {
+        if (scanned++ >= AD2_JOURNAL_QUERY_MAX_BLOCKS) {
+            more = false;
+            break;
+        }
+        if (!_ad2_journal_read_block(file, b, blk)) {
+            continue;
+        }
+        next_cursor = blk.hdr.first_seq;
+        if (q.from_s && blk.hdr.wall_last_s && blk.hdr.wall_last_s < q.from_s) {
+            // everything older is outside the range.
+            next_cursor = 0;
+            more = false;
+            break;
+        }
+        if ((event_bit && !(blk.hdr.event_mask & event_bit)) ||
+                (partition_bit && !(blk.hdr.partition_mask & partition_bit))) {
+            continue;
+        }
+        for (int r = blk.hdr.count - 1; r >= 0; r--) {
+            if (_ad2_journal_match(blk.recs[r], q)) {
+                _ad2_journal_add_json(items, blk.recs[r]);
+                if (++found >= q.limit) {
+                    next_cursor = blk.recs[r].seq;
+                    more = false;
+                    break;
+                }
+            }
+        }
+        if (!more) {
+            break;
+        }
+    }
+    fclose(file);
+    return more;
+}
+
+cJSON *ad2_journal_query_json(const ad2_journal_query_t &q)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON *items = cJSON_CreateArray();
+    cJSON_AddStringToObject(root, "event", "HISTORY");
+    cJSON_AddNumberToObject(root, "uptime_ms", (double)(hal_uptime_us() / 1000));
+    cJSON_AddItemToObject(root, "items", items);
+    if (!_ad2_journal_file_mutex ||
+            xSemaphoreTake(_ad2_journal_file_mutex, pdMS_TO_TICKS(AD2_JOURNAL_QUERY_WAIT_MS)) != pdTRUE) {
+        cJSON_AddNumberToObject(root, "next_cursor", q.cursor);
+        return root;
+    }
+
+    size_t found = 0;
+    size_t scanned = 0;
+    uint32_t next_cursor = 0;
+    bool more = true;
+    // records not yet moved into a block, newest first.
+    std::vector<ad2_journal_rec> pending;
+    xSemaphoreTake(_ad2_journal_mutex, portMAX_DELAY);
+    pending = _ad2_journal_pending;
+    xSemaphoreGive(_ad2_journal_mutex);
+    for (auto it = pending.rbegin(); more && it != pending.rend(); ++it) {
+        if (_ad2_journal_match(*it, q)) {
+            _ad2_journal_add_json(items, *it);
+            if (++found >= q.limit) {
+                next_cursor = it->seq;
+                more = false;
+            }
+        }
+    }
+    // block being filled.
+    for (int r = _ad2_journal_blk.hdr.count - 1; more && r >= 0; r--) {
+        if (_ad2_journal_match(_ad2_journal_blk.recs[r], q)) {
+            _ad2_journal_add_json(items, _ad2_journal_blk.recs[r]);
+            if (++found >= q.limit) {
+                next_cursor = _ad2_journal_blk.recs[r].seq;
+                more = false;
+            }
+        }
+    }
+    if (more && _ad2_journal_blk_index > 0) {
+        more = _ad2_journal_query_file(_ad2_journal_cur, _ad2_journal_blk_index - 1, q,
+                                       items, found, scanned, next_cursor);
+    }
+    if (more) {
+        more = _ad2_journal_query_file(_ad2_journal_old, UINT32_MAX, q,
+                                       items, found, scanned, next_cursor);
+        if (more) {
+            // reached the oldest record.
+            next_cursor = 0;
+        }
+    }
+    xSemaphoreGive(_ad2_journal_file_mutex);
+    cJSON_AddNumberToObject(root, "next_cursor", next_cursor);
+    return root;
+}
+
+void ad2_get_journal_status(uint32_t *next_seq, uint32_t *blocks, uint32_t *dropped, uint32_t *write_errors)
+{
+    taskENTER_CRITICAL(&spinlock);
+    *next_seq = _ad2_journal_next_seq;
+    *blocks = _ad2_journal_cur.blocks + _ad2_journal_old.blocks;
+    *dropped = _ad2_journal_dropped;
+    *write_errors = _ad2_journal_write_errors;
+    taskEXIT_CRITICAL(&spinlock);
+}
@@ -0,0 +1,43 @@
+/**
+ *  @file    ad2_journal.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Append only uSD event journal with indexed historical queries.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_JOURNAL_H
+#define _AD2_JOURNAL_H
+
+/**
+ * @brief Persistent event journal query. Newest matching records first.
+ */
+typedef struct {
+    uint32_t cursor;         ///< only records older than this sequence. 0 for newest.
+    uint32_t from_s;         ///< wall clock range in epoch seconds. 0 for open.
+    uint32_t to_s;
+    int partition;           ///< -1 for any.
+    int zone;                ///< -1 for any.
+    int event;               ///< ad2_event_t or -1 for any.
+    size_t limit;            ///< max records returned.
+} ad2_journal_query_t;
+
+void ad2_init_journal();
+cJSON *ad2_journal_query_json(const ad2_journal_query_t &q);
+void ad2_get_journal_status(uint32_t *next_seq, uint32_t *blocks, uint32_t *dropped, uint32_t *write_errors);
+
+#endif /* _AD2_JOURNAL_H */
@@ -0,0 +1,1061 @@
+/**
+ *  @file    ad2_json.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Streaming JSON writer and field schemas for AD2IoT documents.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// esp includes
+#include "esp_chip_info.h"
+#include "esp_flash.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+
+// Serialized partition state per AD2PartitionState, newest version only.
+static std::map<AD2PartitionState *, ad2_json_snapshot_ptr> _json_snapshots;
+static SemaphoreHandle_t _json_snapshots_mutex = nullptr;
+static ad2_json_snapshot_stats_t _json_snapshot_stats = {};
+// Versions restart at 0 on boot so the ETag also carries a boot id.
+static uint32_t _json_boot_id = 0;
+
+/**
+ * @brief Construct a writer over buf.
+ *
+ * @param [in]buf char * output storage.
+ * @param [in]size size_t bytes in buf.
+ * @param [in]sink ad2_json_sink_t optional. Flushed each time buf fills.
+ * @param [in]arg void * passed to sink.
+ * @param [in]format ad2_json_format_t JSON text or CBOR.
+ */
+AD2JsonWriter::AD2JsonWriter(char *buf, size_t size, ad2_json_sink_t sink, void *arg,
+                             ad2_json_format_t format)
+    : _buf(buf), _size(size), _pos(0), _total(0), _sink(sink), _arg(arg),
+      _ok(buf && size > 1), _finished(false), _cbor(format == AD2_JSON_FORMAT_CBOR),
+      _depth(0), _first(1), _arrays(0)
+{
+}
+
+void AD2JsonWriter::_put(const char *s, size_t n)
+{
+    _total += n;
+    if (!_ok) {
+        return;
+    }
+    while (n) {
+        // without a sink keep a byte for the NUL.
+        size_t room = _size - _pos - (_sink ? 0 : 1);
+        if (!room) {
+            if (!_sink || !_sink(_buf, _pos, _arg)) {
+                _ok = false;
+                return;
+            }
+            _pos = 0;
+            continue;
+        }
+        size_t c = n < room ? n : room;
+        memcpy(_buf + _pos, s, c);
+        _pos += c;
+        s += c;
+        n -= c;
+    }
+}
+
+void AD2JsonWriter::_putc(char c)
+{
+    _put(&c, 1);
+}
+
+/**
+ * @brief CBOR major type and argument in the shortest form.
+ */
+void AD2JsonWriter::_head(uint8_t major, uint64_t v)
+{
+    uint8_t b[9];
+    size_t n;
+    if (v < 24) {
+        b[0] = (major << 5) | v;
+        n = 1;
+    } else {
+        n = v <= 0xff ? 2 : v <= 0xffff ? 3 : v <= 0xffffffffULL ? 5 : 9;
+        // 24..27 is a 1, 2, 4 or 8 byte argument.
+        b[0] = (major << 5) | (n == 2 ? 24 : n == 3 ? 25 : n == 5 ? 26 : 27);
+        for (size_t i = 1; i < n; i++) {
+            b[i] = (uint8_t)(v >> (8 * (n - 1 - i)));
+        }
+    }
+    _put((const char *)b, n);
+}
+
+/**
+ * @brief Separator and key for the next member of the open level.
+ */
+void AD2JsonWriter::_key(const char *key)
+{
+    uint32_t bit = 1UL << _depth;
+    if (_cbor) {
+        if (key && !(_arrays & bit)) {
+            size_t n = strlen(key);
+            _head(3, n);
+            _put(key, n);
+        }
+        return;
+    }
+    if (_first & bit) {
+        _first &= ~bit;
+    } else {
+        _putc(',');
+    }
+    if (key && !(_arrays & bit)) {
+        _string(key, strlen(key));
+        _putc(':');
+    }
+}
+
+/**
+ * @brief Quoted and escaped string. Runs of plain characters are copied
+ * in one piece.
+ */
+void AD2JsonWriter::_string(const char *s, size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    if (_cbor) {
+        _head(3, n);
+        _put(s, n);
+        return;
+    }
+    _putc('"');
+    size_t run = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        _put(s + run, i - run);
+        run = i + 1;
+        char esc[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t len = 2;
+        switch (c) {
+        case '"':
+            esc[1] = '"';
+            break;
+        case '\\':
+            esc[1] = '\\';
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xf];
+            len = 6;
+            break;
+        }
+        _put(esc, len);
+    }
+    _put(s + run, n - run);
+    _putc('"');
+}
+
+void AD2JsonWriter::_open(char c, bool is_array, const char *key)
+{
+    if (_depth >= 31) {
+        _ok = false;
+        return;
+    }
+    if (_depth) {
+        _key(key);
+    }
+    if (_cbor) {
+        _putc((char)(is_array ? 0x9f : 0xbf));
+    } else {
+        _putc(c);
+    }
+    _depth++;
+    uint32_t bit = 1UL << _depth;
+    _first |= bit;
+    if (is_array) {
+        _arrays |= bit;
+    } else {
+        _arrays &= ~bit;
+    }
+}
+
+AD2JsonWriter &AD2JsonWriter::object(const char *key)
+{
+    _open('{', false, key);
+    return *this;
+}
+
+AD2JsonWriter &AD2JsonWriter::array(const char *key)
+{
+    _open('[', true, key);
+    return *this;
+}
+
+AD2JsonWriter &AD2JsonWriter::end()
+{
+    if (_depth) {
+        if (_cbor) {
+            _putc((char)0xff);
+        } else {
+            _putc((_arrays & (1UL << _depth)) ? ']' : '}');
+        }
+        _depth--;
+    }
+    return *this;
+}
+
+AD2JsonWriter &AD2JsonWriter::add(const char *key, bool v)
+{
+    _key(key);
+    if (_cbor) {
+        _putc((char)(v ? 0xf5 : 0xf4));
+    } else if (v) {
+        _put("true", 4);
+    } else {
+        _put("false", 5);
+    }
+    return *this;
+}
+
+AD2JsonWriter &AD2JsonWriter::add(const char *key, const char *v)
+{
+    if (!v) {
+        _key(key);
+        if (_cbor) {
+            _putc((char)0xf6);
+        } else {
+            _put("null", 4);
+        }
+        return *this;
+    }
+    return add(key, v, strlen(v));
+}
+
+AD2JsonWriter &AD2JsonWriter::add(const char *key, const char *v, size_t len)
+{
+    _key(key);
+    _string(v, len);
+    return *this;
+}
+
+AD2JsonWriter &AD2JsonWriter::add_uint(const char *key, uint64_t v)
+{
+    if (_cbor) {
+        _key(key);
+        _head(0, v);
+        return *this;
+    }
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[sizeof(tmp) - ++n] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    _key(key);
+    _put(tmp + sizeof(tmp) - n, n);
+    return *this;
+}
+
+AD2JsonWriter &AD2JsonWriter::add_int(const char *key, int64_t v)
+{
+    if (v >= 0) {
+        return add_uint(key, (uint64_t)v);
+    }
+    if (_cbor) {
+        // major type 1 holds -1 - v.
+        _key(key);
+        _head(1, (uint64_t)(-(v + 1)));
+        return *this;
+    }
+    char tmp[21];
+    uint64_t u = 0 - (uint64_t)v;
+    size_t n = 0;
+    do {
+        tmp[sizeof(tmp) - ++n] = '0' + (u % 10);
+        u /= 10;
+    } while (u);
+    tmp[sizeof(tmp) - ++n] = '-';
+    _key(key);
+    _put(tmp + sizeof(tmp) - n, n);
+    return *this;
+}
+
+AD2JsonWriter &AD2JsonWriter::add_raw(const char *key, const char *json, size_t len)
+{
+    _key(key);
+    _put(json, len);
+    return *this;
+}
+
+/**
+ * @brief Splice already encoded members into the open object.
+ *
+ * @param [in]json const char * members without braces ex. '"a":1,"b":2'.
+ * @param [in]len size_t bytes in json. Nothing is written if 0.
+ */
+AD2JsonWriter &AD2JsonWriter::members(const char *json, size_t len)
+{
+    if (len) {
+        _key(nullptr);
+        _put(json, len);
+    }
+    return *this;
+}
+
+const char *AD2JsonWriter::finish()
+{
+    if (!_finished) {
+        _finished = true;
+        while (_depth) {
+            end();
+        }
+        if (_ok) {
+            if (_sink) {
+                if (_pos && !_sink(_buf, _pos, _arg)) {
+                    _ok = false;
+                }
+                _pos = 0;
+            } else {
+                _buf[_pos] = 0;
+            }
+        }
+    }
+    return _ok ? _buf : nullptr;
+}
+
+/**
+ * @brief Partition state document.
+ */
+static constexpr AD2JsonField<AD2PartitionState> AD2_PARTITION_STATE_SCHEMA[] = {
+    { "ready", &AD2PartitionState::ready },
+    { "armed_away", &AD2PartitionState::armed_away },
+    { "armed_stay", &AD2PartitionState::armed_stay },
+    { "backlight_on", &AD2PartitionState::backlight_on },
+    { "programming", &AD2PartitionState::programming },
+    { "zone_bypassed", &AD2PartitionState::zone_bypassed },
+    { "ac_power", &AD2PartitionState::ac_power },
+    { "chime_on", &AD2PartitionState::chime_on },
+    { "alarm_event_occurred", &AD2PartitionState::alarm_event_occurred },
+    { "alarm_sounding", &AD2PartitionState::alarm_sounding },
+    { "battery_low", &AD2PartitionState::battery_low },
+    { "entry_delay_off", &AD2PartitionState::entry_delay_off },
+    { "fire_alarm", &AD2PartitionState::fire_alarm },
+    { "system_issue", &AD2PartitionState::system_issue },
+    { "perimeter_only", &AD2PartitionState::perimeter_only },
+    { "exit_now", &AD2PartitionState::exit_now },
+    { "system_specific", &AD2PartitionState::system_specific },
+    { "beeps", &AD2PartitionState::beeps },
+    { "panel_type", &AD2PartitionState::panel_type },
+    { "last_alpha_message", &AD2PartitionState::last_alpha_message },
+    // Can have HEX digits ex. 'FC'.
+    { "last_numeric_messages", &AD2PartitionState::last_numeric_message },
+    { "mask", &AD2PartitionState::address_mask_filter },
+};
+
+/**
+ * @brief Write the standard partition state members.
+ *
+ * @param [in]w AD2JsonWriter & with an object open.
+ * @param [in]s AD2PartitionState * may be nullptr.
+ */
+void ad2_json_partition_state(AD2JsonWriter &w, AD2PartitionState *s)
+{
+    if (s && !s->unknown_state) {
+        ad2_json_write_fields(w, AD2_PARTITION_STATE_SCHEMA, *s);
+    } else {
+        w.add("last_alpha_message", "Unknown");
+    }
+}
+
+/**
+ * @brief One zone of a partition as seen by the zone documents.
+ */
+struct ad2_json_zone_view {
+    AD2PartitionState *s;
+    uint8_t zone;
+    uint8_t partition;
+    uint32_t mask;
+    AD2_CMD_ZONE_state_t state;
+};
+
+static void _json_zone_state(AD2JsonWriter &w, const char *key, const ad2_json_zone_view &z)
+{
+    auto it = AD2Parse.state_str.find(z.state);
+    w.add(key, it != AD2Parse.state_str.end() ? it->second.c_str() : "");
+}
+
+template <typename V>
+static void _json_zone_name(AD2JsonWriter &w, const char *key, const V &z)
+{
+    std::string zalpha;
+    AD2Parse.getZoneString(z.zone, zalpha);
+    w.add(key, zalpha);
+}
+
+static constexpr AD2JsonField<ad2_json_zone_view> AD2_ZONE_ALERT_SCHEMA[] = {
+    { "zone", &ad2_json_zone_view::zone },
+    { "partition", &ad2_json_zone_view::partition },
+    { "mask", &ad2_json_zone_view::mask },
+    { "state", _json_zone_state },
+    { "name", _json_zone_name<ad2_json_zone_view> },
+};
+
+/**
+ * @brief Write the array of zones that are not CLOSED.
+ *
+ * @param [in]w AD2JsonWriter & with an object open.
+ * @param [in]key const char * array key.
+ * @param [in]s AD2PartitionState * may be nullptr.
+ */
+void ad2_json_zone_alerts(AD2JsonWriter &w, const char *key, AD2PartitionState *s)
+{
+    w.array(key);
+    if (s) {
+        for (auto &e : s->zone_states) {
+            ad2_json_zone_view z = { s, e.first, s->partition, s->address_mask_filter, e.second.state() };
+            if (z.state != AD2_STATE_CLOSED) {
+                w.object();
+                ad2_json_write_fields(w, AD2_ZONE_ALERT_SCHEMA, z);
+                w.end();
+            }
+        }
+    }
+    w.end();
+}
+
+/**
+ * @brief Zone change document.
+ */
+static void _json_zone_event_state(AD2JsonWriter &w, const char *key, const ad2_json_zone_event_t &z)
+{
+    w.add(key, z.state);
+}
+
+static constexpr AD2JsonField<ad2_json_zone_event_t> AD2_ZONE_CHANGE_SCHEMA[] = {
+    { "state", _json_zone_event_state },
+    { "partition", &ad2_json_zone_event_t::partition },
+    { "mask", &ad2_json_zone_event_t::mask },
+    { "system", &ad2_json_zone_event_t::system },
+    { "name", _json_zone_name<ad2_json_zone_event_t> },
+};
+
+/**
+ * @brief Capture the zone that last changed on s.
+ *
+ * @param [in]s AD2PartitionState *.
+ * @param [out]z ad2_json_zone_event_t *.
+ */
+void ad2_json_get_zone_event(AD2PartitionState *s, ad2_json_zone_event_t *z)
+{
+    z->zone = s->zone;
+    z->partition = s->partition;
+    z->mask = s->address_mask_filter;
+    auto it = s->zone_states.find(s->zone);
+    z->system = it != s->zone_states.end() && it->second.is_system();
+
+    // grab the verb(FOO) 'ZONE FOO 001'
+    const std::string &m = s->last_event_message;
+    size_t start = m.find(' ');
+    start = start == std::string::npos ? m.length() : start + 1;
+    size_t end = m.find(' ', start);
+    end = end == std::string::npos ? m.length() : end;
+    size_t len = std::min(end - start, sizeof(z->state) - 1);
+    memcpy(z->state, m.data() + start, len);
+    z->state[len] = 0;
+}
+
+/**
+ * @brief Write the members of a captured zone change.
+ *
+ * @param [in]w AD2JsonWriter & with an object open.
+ * @param [in]z const ad2_json_zone_event_t &.
+ */
+void ad2_json_zone_event(AD2JsonWriter &w, const ad2_json_zone_event_t &z)
+{
+    ad2_json_write_fields(w, AD2_ZONE_CHANGE_SCHEMA, z);
+}
+
+/**
+ * @brief Write the members for the zone that last changed on s.
+ *
+ * @param [in]w AD2JsonWriter & with an object open.
+ * @param [in]s AD2PartitionState *.
+ */
+void ad2_json_zone_change(AD2JsonWriter &w, AD2PartitionState *s)
+{
+    ad2_json_zone_event_t z;
+    ad2_json_get_zone_event(s, &z);
+    ad2_json_zone_event(w, z);
+}
+
+/**
+ * @brief Device info document.
+ */
+struct ad2_json_device_view {
+    const char *firmware_version;
+    uint32_t cpu_model;
+    uint32_t cpu_revision;
+    uint32_t cpu_cores;
+    uint32_t cpu_features;
+    uint32_t cpu_flash_size;
+    const char *cpu_flash_type;
+};
+
+static void _json_cpu_features(AD2JsonWriter &w, const char *key, const ad2_json_device_view &d)
+{
+    w.array(key);
+    if (d.cpu_features & CHIP_FEATURE_WIFI_BGN) {
+        w.add(nullptr, "WiFi");
+    }
+    if (d.cpu_features & CHIP_FEATURE_BLE) {
+        w.add(nullptr, "BLE");
+    }
+    if (d.cpu_features & CHIP_FEATURE_BT) {
+        w.add(nullptr, "BT");
+    }
+    w.end();
+}
+
+static void _json_ad2_version(AD2JsonWriter &w, const char *key, const ad2_json_device_view &d)
+{
+    w.add(key, AD2Parse.ad2_version_string);
+}
+
+static void _json_ad2_config(AD2JsonWriter &w, const char *key, const ad2_json_device_view &d)
+{
+    w.add(key, AD2Parse.ad2_config_string);
+}
+
+static constexpr AD2JsonField<ad2_json_device_view> AD2_DEVICE_INFO_SCHEMA[] = {
+    { "firmware_version", &ad2_json_device_view::firmware_version },
+    { "cpu_model", &ad2_json_device_view::cpu_model },
+    { "cpu_revision", &ad2_json_device_view::cpu_revision },
+    { "cpu_cores", &ad2_json_device_view::cpu_cores },
+    { "cpu_features", _json_cpu_features },
+    { "cpu_flash_size", &ad2_json_device_view::cpu_flash_size },
+    { "cpu_flash_type", &ad2_json_device_view::cpu_flash_type },
+    { "ad2_version_string", _json_ad2_version },
+    { "ad2_config_string", _json_ad2_config },
+};
+
+/**
+ * @brief Write the AD2IoT device details.
+ *
+ * @param [in]w AD2JsonWriter & with an object open.
+ */
+void ad2_json_device_info(AD2JsonWriter &w)
+{
+    esp_chip_info_t chip_info;
+    esp_chip_info(&chip_info);
+    uint32_t size_flash_chip = 0;
+    esp_flash_get_size(NULL, &size_flash_chip);
+
+    ad2_json_device_view d = {
+        ad2_firmware_version(),
+        (uint32_t)chip_info.model,
+        (uint32_t)chip_info.revision,
+        (uint32_t)chip_info.cores,
+        (uint32_t)chip_info.features,
+        size_flash_chip,
+        (chip_info.features & CHIP_FEATURE_EMB_FLASH) ? "embedded" : "external",
+    };
+    ad2_json_write_fields(w, AD2_DEVICE_INFO_SCHEMA, d);
+}
+
+/**
+ * @brief CRC32 of the top level members of a JSON object, leaving out
+ * the members named in skip. Used to tell if the parts of a document
+ * a consumer cares about changed.
+ *
+ * @param [in]json const char * compact object as written by AD2JsonWriter.
+ * @param [in]len size_t bytes in json.
+ * @param [in]skip std::vector<std::string> * keys to leave out or nullptr.
+ *
+ * @return uint32_t hash.
+ */
+uint32_t ad2_json_hash_members(const char *json, size_t len, const std::vector<std::string> *skip)
+{
+    if (!skip || skip->empty()) {
+        return esp_rom_crc32_le(0, (const uint8_t *)json, len);
+    }
+
+    uint32_t crc = 0;
+    size_t i = (len && json[0] == '{') ? 1 : 0;
+    while (i < len) {
+        // find the end of this member. ',' or the closing '}' at depth 0.
+        size_t start = i;
+        int depth = 0;
+        bool in_string = false;
+        for (; i < len; i++) {
+            char c = json[i];
+            if (in_string) {
+                if (c == '\\') {
+                    i++;
+                } else if (c == '"') {
+                    in_string = false;
+                }
+            } else if (c == '"') {
+                in_string = true;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (!depth) {
+                    break;
+                }
+                depth--;
+            } else if (c == ',' && !depth) {
+                break;
+            }
+        }
+
+        bool skipped = false;
+        for (auto &key : *skip) {
+            size_t klen = key.length();
+            if (start + klen + 2 <= i && json[start] == '"' && json[start + klen + 1] == '"' &&
+                    memcmp(json + start + 1, key.data(), klen) == 0) {
+                skipped = true;
+                break;
+            }
+        }
+        if (!skipped) {
+            crc = esp_rom_crc32_le(crc, (const uint8_t *)json + start, i - start);
+        }
+        i++;
+    }
+    return crc;
+}
+
+/// Read position in a JSON buffer.
+typedef struct {
+    const char *p;
+    const char *end;
+} _json_cursor_t;
+
+static void _json_skip_ws(_json_cursor_t &c)
+{
+    while (c.p < c.end && (*c.p == ' ' || *c.p == '\t' || *c.p == '\r' || *c.p == '\n')) {
+        c.p++;
+    }
+}
+
+static bool _json_expect(_json_cursor_t &c, char ch)
+{
+    _json_skip_ws(c);
+    if (c.p < c.end && *c.p == ch) {
+        c.p++;
+        return true;
+    }
+    return false;
+}
+
+static bool _json_read_hex4(_json_cursor_t &c, uint32_t &v)
+{
+    if (c.end - c.p < 4) {
+        return false;
+    }
+    v = 0;
+    for (int n = 0; n < 4; n++) {
+        char h = *c.p++;
+        v <<= 4;
+        if (h >= '0' && h <= '9') {
+            v |= h - '0';
+        } else if (h >= 'a' && h <= 'f') {
+            v |= h - 'a' + 10;
+        } else if (h >= 'A' && h <= 'F') {
+            v |= h - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Read the string at the cursor. With out the unescaped value is
+ * copied and NUL terminated, otherwise it is only checked.
+ *
+ * @return false on a syntax error or if the value does not fit size.
+ */
+static bool _json_read_string(_json_cursor_t &c, char *out, size_t size)
+{
+    if (c.p >= c.end || *c.p != '"') {
+        return false;
+    }
+    c.p++;
+    size_t n = 0;
+    while (c.p < c.end) {
+        uint8_t ch = *c.p++;
+        if (ch == '"') {
+            if (out) {
+                out[n] = 0;
+            }
+            return true;
+        }
+        if (ch < 0x20) {
+            return false;
+        }
+        uint32_t cp = ch;
+        if (ch == '\\') {
+            if (c.p >= c.end) {
+                return false;
+            }
+            switch (*c.p++) {
+            case '"':
+                cp = '"';
+                break;
+            case '\\':
+                cp = '\\';
+                break;
+            case '/':
+                cp = '/';
+                break;
+            case 'b':
+                cp = '\b';
+                break;
+            case 'f':
+                cp = '\f';
+                break;
+            case 'n':
+                cp = '\n';
+                break;
+            case 'r':
+                cp = '\r';
+                break;
+            case 't':
+                cp = '\t';
+                break;
+            case 'u': {
+                if (!_json_read_hex4(c, cp) || cp == 0 || (cp >= 0xDC00 && cp < 0xE000)) {
+                    return false;
+                }
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    uint32_t lo;
+                    if (c.end - c.p < 2 || c.p[0] != '\\' || c.p[1] != 'u') {
+                        return false;
+                    }
+                    c.p += 2;
+                    if (!_json_read_hex4(c, lo) || lo < 0xDC00 || lo >= 0xE000) {
+                        return false;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        if (!out) {
+            continue;
+        }
+
+        // escaped code points are written as UTF-8. Raw bytes pass through.
+        char utf8[4];
+        size_t k = 0;
+        if (cp < 0x80 || ch != '\\') {
+            utf8[k++] = (char)cp;
+        } else if (cp < 0x800) {
+            utf8[k++] = 0xC0 | (cp >> 6);
+            utf8[k++] = 0x80 | (cp & 0x3F);
+        } else if (cp < 0x10000) {
+            utf8[k++] = 0xE0 | (cp >> 12);
+            utf8[k++] = 0x80 | ((cp >> 6) & 0x3F);
+            utf8[k++] = 0x80 | (cp & 0x3F);
+        } else {
+            utf8[k++] = 0xF0 | (cp >> 18);
+            utf8[k++] = 0x80 | ((cp >> 12) & 0x3F);
+            utf8[k++] = 0x80 | ((cp >> 6) & 0x3F);
+            utf8[k++] = 0x80 | (cp & 0x3F);
+        }
+        if (n + k >= size) {
+            return false;
+        }
+        memcpy(out + n, utf8, k);
+        n += k;
+    }
+    return false;
+}
+
+/**
+ * @brief Read the number at the cursor. With v it is converted.
+ */
+static bool _json_read_number(_json_cursor_t &c, double *v)
+{
+    const char *start = c.p;
+    if (c.p < c.end && *c.p == '-') {
+        c.p++;
+    }
+    if (c.p >= c.end || !isdigit((uint8_t)*c.p)) {
+        return false;
+    }
+    if (*c.p == '0') {
+        c.p++;
+    } else {
+        while (c.p < c.end && isdigit((uint8_t)*c.p)) {
+            c.p++;
+        }
+    }
+    if (c.p < c.end && *c.p == '.') {
+        c.p++;
+        if (c.p >= c.end || !isdigit((uint8_t)*c.p)) {
+            return false;
+        }
+        while (c.p < c.end && isdigit((uint8_t)*c.p)) {
+            c.p++;
+        }
+    }
+    if (c.p < c.end && (*c.p == 'e' || *c.p == 'E')) {
+        c.p++;
+        if (c.p < c.end && (*c.p == '+' || *c.p == '-')) {
+            c.p++;
+        }
+        if (c.p >= c.end || !isdigit((uint8_t)*c.p)) {
+            return false;
+        }
+        while (c.p < c.end && isdigit((uint8_t)*c.p)) {
+            c.p++;
+        }
+    }
+    if (v) {
+        // the buffer is not NUL terminated. Convert a bounded copy.
+        char tmp[32];
+        size_t n = c.p - start;
+        if (n >= sizeof(tmp)) {
+            return false;
+        }
+        memcpy(tmp, start, n);
+        tmp[n] = 0;
+        *v = strtod(tmp, nullptr);
+    }
+    return true;
+}
+
+/**
+ * @brief Check and skip the value at the cursor. Objects and arrays
+ * recurse at most AD2_JSON_READ_MAX_DEPTH levels.
+ */
+static bool _json_skip_value(_json_cursor_t &c, int depth)
+{
+    _json_skip_ws(c);
+    if (c.p >= c.end) {
+        return false;
+    }
+    char ch = *c.p;
+    if (ch == '"') {
+        return _json_read_string(c, nullptr, 0);
+    }
+    if (ch == '{' || ch == '[') {
+        if (depth >= AD2_JSON_READ_MAX_DEPTH) {
+            return false;
+        }
+        char close = ch == '{' ? '}' : ']';
+        c.p++;
+        if (_json_expect(c, close)) {
+            return true;
+        }
+        do {
+            if (ch == '{') {
+                _json_skip_ws(c);
+                if (!_json_read_string(c, nullptr, 0) || !_json_expect(c, ':')) {
+                    return false;
+                }
+            }
+            if (!_json_skip_value(c, depth + 1)) {
+                return false;
+            }
+        } while (_json_expect(c, ','));
+        return _json_expect(c, close);
+    }
+    for (const char *lit : { "true", "false", "null" }) {
+        size_t n = strlen(lit);
+        if ((size_t)(c.end - c.p) >= n && memcmp(c.p, lit, n) == 0) {
+            c.p += n;
+            return true;
+        }
+    }
+    return _json_read_number(c, nullptr);
+}
+
+/**
+ * @brief Read the listed top level members of a JSON object.
+ *
+ * @details A single pass over json with no allocation. Strings are
+ * unescaped into the caller storage. The first occurrence of a key is
+ * used. A member with the wrong type is skipped and stays not found.
+ * Keys are compared as written so escaped keys do not match.
+ *
+ * @param [in]json const char * object, need not be NUL terminated.
+ * @param [in]len size_t bytes in json.
+ * @param [in/out]members ad2_json_member_t * keys to read.
+ * @param [in]count size_t entries in members.
+ *
+ * @return false if json is not a valid object, nests too deep or a
+ * string member does not fit its storage.
+ */
+bool ad2_json_read_members(const char *json, size_t len, ad2_json_member_t *members, size_t count)
+{
+    for (size_t n = 0; n < count; n++) {
+        members[n].found = false;
+    }
+
+    _json_cursor_t c = { json, json + len };
+    if (!_json_expect(c, '{')) {
+        return false;
+    }
+    if (!_json_expect(c, '}')) {
+        do {
+            _json_skip_ws(c);
+            const char *key = c.p + 1;
+            if (!_json_read_string(c, nullptr, 0)) {
+                return false;
+            }
+            size_t klen = c.p - 1 - key;
+            if (!_json_expect(c, ':')) {
+                return false;
+            }
+            _json_skip_ws(c);
+
+            ad2_json_member_t *m = nullptr;
+            for (size_t n = 0; n < count && !m; n++) {
+                if (!members[n].found && strlen(members[n].key) == klen &&
+                        memcmp(members[n].key, key, klen) == 0) {
+                    m = &members[n];
+                }
+            }
+            if (m && m->kind == AD2_JSON_MEMBER_STRING && c.p < c.end && *c.p == '"') {
+                if (!_json_read_string(c, m->str, m->size)) {
+                    return false;
+                }
+                m->found = true;
+            } else if (m && m->kind == AD2_JSON_MEMBER_INT && c.p < c.end &&
+                       (*c.p == '-' || isdigit((uint8_t)*c.p))) {
+                double v;
+                if (!_json_read_number(c, &v)) {
+                    return false;
+                }
+                *m->num = v < INT32_MIN ? INT32_MIN : v > INT32_MAX ? INT32_MAX : (int32_t)v;
+                m->found = true;
+            } else if (!_json_skip_value(c, 1)) {
+                return false;
+            }
+        } while (_json_expect(c, ','));
+        if (!_json_expect(c, '}')) {
+            return false;
+        }
+    }
+    _json_skip_ws(c);
+    return c.p == c.end;
+}
+
+/**
+ * @brief Initialize the partition snapshot cache.
+ */
+void ad2_init_json_snapshots()
+{
+    _json_snapshots_mutex = xSemaphoreCreateMutex();
+    _json_boot_id = esp_random();
+}
+
+/**
+ * @brief Get the serialized partition state for the current version of s.
+ * It is rendered at most once per version and shared by every reader.
+ *
+ * @param [in]s AD2PartitionState *.
+ *
+ * @return ad2_json_snapshot_ptr or nullptr if s is nullptr or out of memory.
+ */
+ad2_json_snapshot_ptr ad2_json_get_snapshot(AD2PartitionState *s)
+{
+    if (!s || !_json_snapshots_mutex) {
+        return nullptr;
+    }
+
+    ad2_json_snapshot_ptr snap;
+    xSemaphoreTake(_json_snapshots_mutex, portMAX_DELAY);
+
+    // Read the version before serializing. If the parser changes s while
+    // we render, the next reader sees a newer version and renders again.
+    uint32_t version = s->version;
+    auto it = _json_snapshots.find(s);
+    if (it != _json_snapshots.end() && it->second->version == version) {
+        snap = it->second;
+        _json_snapshot_stats.shared++;
+    } else {
+        size_t state_len = 0;
+        AD2JsonBuffer<1024> json;
+        const char *out = json.render([&](AD2JsonWriter &w) {
+            w.object();
+            ad2_json_partition_state(w, s);
+            state_len = w.length();
+            w.add("partition", s->partition);
+            w.add("zone", s->zone);
+            ad2_json_zone_alerts(w, "zone_alerts", s);
+        });
+        if (out) {
+            std::shared_ptr<ad2_json_snapshot_t> n = std::make_shared<ad2_json_snapshot_t>();
+            n->version = version;
+            n->state_len = state_len;
+            n->json.assign(out, json.length());
+            snprintf(n->etag, sizeof(n->etag), "\"%08lx-%lu\"", _json_boot_id, version);
+            snap = n;
+            _json_snapshots[s] = snap;
+            _json_snapshot_stats.rendered++;
+        }
+    }
+
+    xSemaphoreGive(_json_snapshots_mutex);
+    return snap;
+}
+
+/**
+ * @brief Get partition snapshot stats.
+ *
+ * @param [out]stats ad2_json_snapshot_stats_t *.
+ */
+void ad2_get_json_snapshot_stats(ad2_json_snapshot_stats_t *stats)
+{
+    if (_json_snapshots_mutex) {
+        xSemaphoreTake(_json_snapshots_mutex, portMAX_DELAY);
+    }
+    *stats = _json_snapshot_stats;
+    if (_json_snapshots_mutex) {
+        xSemaphoreGive(_json_snapshots_mutex);
+    }
+}
@@ -0,0 +1,342 @@
+/**
+ *  @file    ad2_json.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Streaming JSON writer and field schemas for AD2IoT documents.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_JSON_H
+#define _AD2_JSON_H
+
+#include <memory>
+#include <type_traits>
+
+/// Called with each full buffer of output. Return false to stop the writer.
+typedef bool (*ad2_json_sink_t)(const char *data, size_t len, void *arg);
+
+/// Output encoding of an AD2JsonWriter.
+typedef enum {
+    AD2_JSON_FORMAT_JSON = 0,
+    AD2_JSON_FORMAT_CBOR     ///< RFC 8949 with indefinite length maps and arrays.
+} ad2_json_format_t;
+
+/**
+ * @brief Compact JSON writer that writes straight into a caller buffer.
+ *
+ * Without a sink the document must fit the buffer. One byte is kept for
+ * the NUL. On overflow writing continues to count so length() gives the
+ * size needed. With a sink the buffer is flushed each time it fills, so
+ * any size document can stream through a small buffer.
+ *
+ * With AD2_JSON_FORMAT_CBOR the same calls write CBOR, so every schema
+ * and document below can produce either. Maps and arrays are written
+ * with indefinite lengths so nothing has to be counted first. add_raw()
+ * and members() then take CBOR. The output is binary, use length().
+ *
+ * Nothing is allocated.
+ */
+class AD2JsonWriter
+{
+public:
+    AD2JsonWriter(char *buf, size_t size, ad2_json_sink_t sink = nullptr, void *arg = nullptr,
+                  ad2_json_format_t format = AD2_JSON_FORMAT_JSON);
+
+    /// Open an object or array. key is required inside an object.
+    AD2JsonWriter &object(const char *key = nullptr);
+    AD2JsonWriter &array(const char *key = nullptr);
+    /// Close the last open object or array.
+    AD2JsonWriter &end();
+
+    AD2JsonWriter &add(const char *key, bool v);
+    AD2JsonWriter &add(const char *key, const char *v);
+    AD2JsonWriter &add(const char *key, const char *v, size_t len);
+    AD2JsonWriter &add(const char *key, const std::string &v)
+    {
+        return add(key, v.data(), v.length());
+    }
+    template <typename T, typename std::enable_if<std::is_integral<T>::value &&
+                                                  !std::is_same<T, bool>::value, int>::type = 0>
+    AD2JsonWriter &add(const char *key, T v)
+    {
+        return std::is_signed<T>::value ? add_int(key, (int64_t)v) : add_uint(key, (uint64_t)v);
+    }
+    AD2JsonWriter &add_int(const char *key, int64_t v);
+    AD2JsonWriter &add_uint(const char *key, uint64_t v);
+    /// Add already encoded JSON as a value.
+    AD2JsonWriter &add_raw(const char *key, const char *json, size_t len);
+    /// Splice already encoded members, without braces, into the open object.
+    AD2JsonWriter &members(const char *json, size_t len);
+
+    /// Close anything still open and NUL terminate or flush to the sink.
+    /// @return the document, or nullptr if it did not fit or the sink failed.
+    const char *finish();
+
+    /// Bytes written so far, or needed if the buffer overflowed.
+    size_t length() const
+    {
+        return _total;
+    }
+    bool ok() const
+    {
+        return _ok;
+    }
+
+private:
+    void _put(const char *s, size_t n);
+    void _putc(char c);
+    void _key(const char *key);
+    void _string(const char *s, size_t n);
+    void _open(char c, bool is_array, const char *key);
+    void _head(uint8_t major, uint64_t v);
+
+    char *_buf;
+    size_t _size;
+    size_t _pos;
+    size_t _total;
+    ad2_json_sink_t _sink;
+    void *_arg;
+    bool _ok;
+    bool _finished;
+    bool _cbor;
+    uint8_t _depth;
+    uint32_t _first;   // bit per level: no member written yet.
+    uint32_t _arrays;  // bit per level: level is an array.
+};
+
+/**
+ * @brief Render a document into stack storage. If it does not fit, it is
+ * measured and rendered once more into an exact heap buffer.
+ */
+template <size_t N>
+class AD2JsonBuffer
+{
+public:
+    explicit AD2JsonBuffer(ad2_json_format_t format = AD2_JSON_FORMAT_JSON) : _format(format) {}
+    ~AD2JsonBuffer()
+    {
+        free(_heap);
+    }
+
+    /// @param fill callable taking AD2JsonWriter &.
+    /// @return the document or nullptr if out of memory.
+    template <typename F>
+    const char *render(F fill)
+    {
+        AD2JsonWriter w(_stack, N, nullptr, nullptr, _format);
+        fill(w);
+        const char *out = w.finish();
+        _len = w.length();
+        if (out) {
+            return out;
+        }
+        free(_heap);
+        _heap = (char *)malloc(_len + 1);
+        if (!_heap) {
+            return nullptr;
+        }
+        AD2JsonWriter w2(_heap, _len + 1, nullptr, nullptr, _format);
+        fill(w2);
+        return w2.finish();
+    }
+    size_t length() const
+    {
+        return _len;
+    }
+
+private:
+    char _stack[N];
+    char *_heap = nullptr;
+    size_t _len = 0;
+    ad2_json_format_t _format;
+};
+
+/// Value kinds a schema field can describe.
+typedef enum {
+    AD2_JSON_FIELD_BOOL = 0,
+    AD2_JSON_FIELD_U8,
+    AD2_JSON_FIELD_U32,
+    AD2_JSON_FIELD_CHAR,   ///< single char written as a one character string.
+    AD2_JSON_FIELD_CSTR,
+    AD2_JSON_FIELD_STRING,
+    AD2_JSON_FIELD_FN      ///< computed by a function.
+} ad2_json_field_kind_t;
+
+/**
+ * @brief One member of T and the key it is written under. Schemas are
+ * constexpr arrays of these, so the key table and member offsets are
+ * fixed at compile time and the serializer is a loop over the table.
+ */
+template <typename T>
+struct AD2JsonField {
+    typedef void (*fn_t)(AD2JsonWriter &w, const char *key, const T &obj);
+
+    const char *key;
+    ad2_json_field_kind_t kind;
+    union {
+        bool T::*b;
+        uint8_t T::*u8;
+        uint32_t T::*u32;
+        char T::*c;
+        const char *T::*cs;
+        std::string T::*str;
+        fn_t fn;
+    };
+
+    constexpr AD2JsonField(const char *k, bool T::*m) : key(k), kind(AD2_JSON_FIELD_BOOL), b(m) {}
+    constexpr AD2JsonField(const char *k, uint8_t T::*m) : key(k), kind(AD2_JSON_FIELD_U8), u8(m) {}
+    constexpr AD2JsonField(const char *k, uint32_t T::*m) : key(k), kind(AD2_JSON_FIELD_U32), u32(m) {}
+    constexpr AD2JsonField(const char *k, char T::*m) : key(k), kind(AD2_JSON_FIELD_CHAR), c(m) {}
+    constexpr AD2JsonField(const char *k, const char *T::*m) : key(k), kind(AD2_JSON_FIELD_CSTR), cs(m) {}
+    constexpr AD2JsonField(const char *k, std::string T::*m) : key(k), kind(AD2_JSON_FIELD_STRING), str(m) {}
+    constexpr AD2JsonField(const char *k, fn_t f) : key(k), kind(AD2_JSON_FIELD_FN), fn(f) {}
+};
+
+/**
+ * @brief Write every field in a schema into the open object.
+ */
+template <typename T, size_t N>
+void ad2_json_write_fields(AD2JsonWriter &w, const AD2JsonField<T> (&schema)[N], const T &obj)
+{
+    for (const AD2JsonField<T> &f : schema) {
+        switch (f.kind) {
+        case AD2_JSON_FIELD_BOOL:
+            w.add(f.key, obj.*(f.b));
+            break;
+        case AD2_JSON_FIELD_U8:
+            w.add(f.key, obj.*(f.u8));
+            break;
+        case AD2_JSON_FIELD_U32:
+            w.add(f.key, obj.*(f.u32));
+            break;
+        case AD2_JSON_FIELD_CHAR:
+            w.add(f.key, &(obj.*(f.c)), 1);
+            break;
+        case AD2_JSON_FIELD_CSTR:
+            w.add(f.key, obj.*(f.cs));
+            break;
+        case AD2_JSON_FIELD_STRING:
+            w.add(f.key, obj.*(f.str));
+            break;
+        case AD2_JSON_FIELD_FN:
+            f.fn(w, f.key, obj);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief A zone change captured when it happened so its document can be
+ * written later, after the partition state has moved on.
+ */
+typedef struct ad2_json_zone_event {
+    uint8_t zone;
+    uint8_t partition;
+    uint32_t mask;
+    bool system;
+    char state[16];  ///< event verb, OPEN CLOSE TROUBLE.
+} ad2_json_zone_event_t;
+
+// AD2IoT documents. Each writes its members into the object already open
+// on the writer so callers can add their own keys.
+void ad2_json_device_info(AD2JsonWriter &w);
+void ad2_json_partition_state(AD2JsonWriter &w, AD2PartitionState *s);
+void ad2_json_zone_alerts(AD2JsonWriter &w, const char *key, AD2PartitionState *s);
+void ad2_json_zone_change(AD2JsonWriter &w, AD2PartitionState *s);
+void ad2_json_get_zone_event(AD2PartitionState *s, ad2_json_zone_event_t *z);
+void ad2_json_zone_event(AD2JsonWriter &w, const ad2_json_zone_event_t &z);
+
+/**
+ * @brief A partition state serialized once for one AD2PartitionState
+ * version and shared read only by every reader until the next change.
+ *
+ * json is {<state members>,"partition":N,"zone":N,"zone_alerts":[...]}.
+ * state_len is where the state members end so readers can put their
+ * own keys between the two parts with AD2JsonWriter::members().
+ */
+struct ad2_json_snapshot_t {
+    uint32_t version;
+    size_t state_len;
+    std::string json;
+    char etag[24];  ///< quoted "<boot id>-<version>".
+
+    const char *state() const
+    {
+        return json.data() + 1;
+    }
+    size_t state_length() const
+    {
+        return state_len - 1;
+    }
+    const char *extra() const
+    {
+        return json.data() + state_len + 1;
+    }
+    size_t extra_length() const
+    {
+        return json.length() - state_len - 2;
+    }
+};
+typedef std::shared_ptr<const ad2_json_snapshot_t> ad2_json_snapshot_ptr;
+
+/**
+ * @brief Partition snapshot stats for `top`.
+ */
+typedef struct ad2_json_snapshot_stats {
+    uint32_t rendered;  ///< snapshots serialized.
+    uint32_t shared;    ///< reads served from a cached snapshot.
+} ad2_json_snapshot_stats_t;
+
+/**
+ * @brief CRC32 of a JSON object leaving out the top level members whose
+ * key is in skip. Without skip the whole document is hashed.
+ */
+uint32_t ad2_json_hash_members(const char *json, size_t len, const std::vector<std::string> *skip = nullptr);
+
+/// Nesting allowed in values ad2_json_read_members() skips over.
+#define AD2_JSON_READ_MAX_DEPTH 8
+
+/// Value kinds ad2_json_read_members() can fill.
+typedef enum {
+    AD2_JSON_MEMBER_STRING = 0,  ///< unescaped and NUL terminated into str.
+    AD2_JSON_MEMBER_INT          ///< number truncated into num.
+} ad2_json_member_kind_t;
+
+/**
+ * @brief A top level member to pick out of a JSON object and the fixed
+ * storage its value is read into.
+ */
+typedef struct ad2_json_member {
+    const char *key;
+    ad2_json_member_kind_t kind;
+    char *str;      ///< STRING storage.
+    size_t size;    ///< STRING storage size including the NUL.
+    int32_t *num;   ///< INT storage.
+    bool found;     ///< set if the member was present with the right type.
+} ad2_json_member_t;
+
+/**
+ * @brief Read the listed top level members of a JSON object without
+ * building a document. Other members are checked and skipped.
+ */
+bool ad2_json_read_members(const char *json, size_t len, ad2_json_member_t *members, size_t count);
+
+void ad2_init_json_snapshots();
+ad2_json_snapshot_ptr ad2_json_get_snapshot(AD2PartitionState *s);
+void ad2_get_json_snapshot_stats(ad2_json_snapshot_stats_t *stats);
+
+#endif /* _AD2_JSON_H */
@@ -0,0 +1,1186 @@
+/**
+ *  @file    ad2_log.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Diagnostic log history and uSD log segment writer.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "AD2LOG";
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// esp includes
+#include "esp_memory_utils.h"
+#include <atomic>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/* Bounded, reboot-scoped diagnostic log retained for the read-only Web UI.
+ *
+ * Log calls are kept in binary form in a lock free multi producer ring of
+ * fixed size slots: uptime, task number, the format string pointer and the
+ * raw arguments. Text is only formatted when an entry is read by the `logs`
+ * command, /api/logs or the SD writer. String arguments in flash are kept as
+ * pointers and others are copied. A record uses one or more slots so the
+ * same memory as AD2_LOG_HISTORY_SIZE text lines holds several times more
+ * entries. Format strings that are not in flash are formatted at once and
+ * stored as text. */
+#define AD2_LOG_LINE_SIZE 192
+#define AD2_LOG_SLOT_SIZE 32
+#define AD2_LOG_SLOT_DATA (AD2_LOG_SLOT_SIZE - 5)
+#define AD2_LOG_SLOTS ((AD2_LOG_HISTORY_SIZE * AD2_LOG_LINE_SIZE) / AD2_LOG_SLOT_SIZE)
+#define AD2_LOG_RECORD_MAX (8 * AD2_LOG_SLOT_DATA)
+struct ad2_log_slot {
+    std::atomic<uint32_t> seq; // slot index + 1 when written. 0 while writing.
+    uint8_t nslots;            // record size in slots. 0 for continuation slots.
+    uint8_t data[AD2_LOG_SLOT_DATA];
+};
+struct ad2_log_record {
+    uint64_t uptime_ms;
+    const char *fmt;           // nullptr for a text record.
+    uint16_t task;
+    uint16_t length;           // record bytes including this header.
+};
+enum {
+    AD2_LOG_ARG_NONE = 0,
+    AD2_LOG_ARG_I32,
+    AD2_LOG_ARG_I64,
+    AD2_LOG_ARG_DBL,
+    AD2_LOG_ARG_PTR,
+    AD2_LOG_ARG_STR
+};
+#define AD2_LOG_STR_PTR    0   // string argument stored as a flash pointer.
+#define AD2_LOG_STR_INLINE 1   // string argument copied into the record.
+static ad2_log_slot _ad2_log_ring[AD2_LOG_SLOTS];
+static std::atomic<uint32_t> _ad2_log_next(0);
+static volatile bool _ad2_sd_log_enabled = false;
+static bool _ad2_sd_log_task_started = false;
+static TaskHandle_t _ad2_sd_log_task_handle = NULL;
+static uint32_t _ad2_sd_log_dropped = 0;
+static uint32_t _ad2_sd_log_write_errors = 0;
+static ad2_sd_log_stats_t _ad2_sd_log_stats = {};
+static uint64_t _ad2_sd_log_flush_us_total = 0;
+static char _ad2_sd_log_stage[AD2_SD_LOG_STAGE_SIZE];
+static size_t _ad2_sd_log_staged = 0;
+static uint32_t _ad2_sd_log_staged_lines = 0;
+static uint64_t _ad2_sd_log_staged_first_ms = 0;
+static uint64_t _ad2_sd_log_staged_last_ms = 0;
+
+/* uSD log segments. Each file in AD2_SD_LOG_DIR is a header followed by
+ * compressed blocks, one per group commit. The header time range is written
+ * when the segment is closed so queries can skip whole segments and block
+ * headers let them skip blocks without decompressing. */
+#define AD2_LOG_SEG_MAGIC 0x4c324441 // "AD2L"
+#define AD2_LOG_BLK_MAGIC 0x42324441 // "AD2B"
+struct ad2_log_seg_hdr {
+    uint32_t magic;
+    uint32_t boot_seq;       // first segment written by this boot.
+    uint64_t first_ms;       // uptime of the first line.
+    uint64_t last_ms;        // uptime of the last line. 0 while open.
+    int64_t wall_first_ms;   // wall clock range. 0 if the clock was not set.
+    int64_t wall_last_ms;
+};
+struct ad2_log_blk_hdr {
+    uint32_t magic;
+    uint16_t raw_len;
+    uint16_t comp_len;       // == raw_len if stored uncompressed.
+    uint64_t first_ms;
+    uint64_t last_ms;
+    int64_t wall_offset_ms;  // wall clock - uptime. 0 if the clock was not set.
+};
+static struct {
+    FILE *file;
+    uint32_t seq;
+    uint32_t boot_seq;
+    size_t size;
+    ad2_log_seg_hdr hdr;
+} _ad2_sd_seg = {};
+static std::vector<std::pair<uint32_t, uint32_t>> _ad2_sd_log_segments; // seq, bytes
+static bool _ad2_sd_log_segments_scanned = false;
+static uint64_t _ad2_sd_log_retention_bytes = (uint64_t)AD2_SD_LOG_RETENTION_MB * 1024 * 1024;
+static uint8_t _ad2_sd_log_block[sizeof(ad2_log_blk_hdr) + AD2_SD_LOG_STAGE_SIZE];
+
+/**
+ * @brief Parse one printf conversion.
+ *
+ * @param [in]p character after the '%'.
+ * @param [out]spec conversion copied with its leading '%'. nullptr to skip.
+ * @param [out]type AD2_LOG_ARG_* argument class.
+ * @param [out]stars number of '*' int arguments before the value.
+ *
+ * @return const char * first character after the conversion.
+ */
+static const char *_ad2_log_spec(const char *p, char *spec, size_t spec_size, int &type, int &stars)
+{
+    const char *start = p - 1;
+    int lcount = 0;
+    bool ll = false, z = false;
+    stars = 0;
+    while (*p && strchr("-+ #0", *p)) {
+        p++;
+    }
+    while (*p == '*' || isdigit((unsigned char)*p)) {
+        stars += (*p++ == '*');
+    }
+    if (*p == '.') {
+        p++;
+        while (*p == '*' || isdigit((unsigned char)*p)) {
+            stars += (*p++ == '*');
+        }
+    }
+    const char *mods = p;
+    while (*p && strchr("hlLqjzt", *p)) {
+        lcount += (*p == 'l');
+        ll |= (*p == 'q' || *p == 'j' || *p == 'L');
+        z |= (*p == 'z' || *p == 't');
+        p++;
+    }
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+        if (ll || lcount >= 2 || (lcount == 1 && sizeof(long) == 8) || (z && sizeof(size_t) == 8)) {
+            type = AD2_LOG_ARG_I64;
+        } else {
+            type = AD2_LOG_ARG_I32;
+        }
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        type = AD2_LOG_ARG_DBL;
+        break;
+    case 's':
+        type = AD2_LOG_ARG_STR;
+        break;
+    case 'p': case 'n':
+        type = AD2_LOG_ARG_PTR;
+        break;
+    default:
+        type = AD2_LOG_ARG_NONE;
+        break;
+    }
+    if (!spec) {
+        return *p ? p + 1 : p;
+    }
+    // rebuild the conversion with a length modifier matching the stored value.
+    std::string out(start, mods - start);
+    if (type == AD2_LOG_ARG_I64) {
+        out += "ll";
+    } else if (type == AD2_LOG_ARG_I32 && mods[0] == 'h') {
+        out += (mods[1] == 'h') ? "hh" : "h";
+    }
+    if (*p) {
+        out += *p++;
+    }
+    strlcpy(spec, out.c_str(), spec_size);
+    return p;
+}
+
+/**
+ * @brief Walk the arguments of a log call and size or store them.
+ *
+ * @details Called once to size the record and again to write it so both
+ * passes make the same inline string truncation choices.
+ *
+ * @param [in]fmt format string.
+ * @param [in]args arguments. Consumed.
+ * @param [in]out nullptr to only size else the destination.
+ * @param [in]budget max bytes for arguments.
+ *
+ * @return size_t argument bytes.
+ */
+static size_t _ad2_log_pack_args(const char *fmt, va_list args, uint8_t *out, size_t budget)
+{
+    size_t used = 0;
+    for (const char *p = fmt; *p;) {
+        if (*p++ != '%') {
+            continue;
+        }
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        int type, stars;
+        p = _ad2_log_spec(p, nullptr, 0, type, stars);
+        for (int n = 0; n < stars && used + sizeof(int) <= budget; n++) {
+            int v = va_arg(args, int);
+            if (out) {
+                memcpy(out + used, &v, sizeof(v));
+            }
+            used += sizeof(v);
+        }
+        if (type == AD2_LOG_ARG_I32 && used + 4 <= budget) {
+            int32_t v = va_arg(args, int);
+            if (out) {
+                memcpy(out + used, &v, sizeof(v));
+            }
+            used += sizeof(v);
+        } else if (type == AD2_LOG_ARG_I64 && used + 8 <= budget) {
+            int64_t v = va_arg(args, long long);
+            if (out) {
+                memcpy(out + used, &v, sizeof(v));
+            }
+            used += sizeof(v);
+        } else if (type == AD2_LOG_ARG_DBL && used + 8 <= budget) {
+            double v = va_arg(args, double);
+            if (out) {
+                memcpy(out + used, &v, sizeof(v));
+            }
+            used += sizeof(v);
+        } else if (type == AD2_LOG_ARG_PTR && used + sizeof(void *) <= budget) {
+            void *v = va_arg(args, void *);
+            if (out) {
+                memcpy(out + used, &v, sizeof(v));
+            }
+            used += sizeof(v);
+        } else if (type == AD2_LOG_ARG_STR && used + 1 + sizeof(char *) <= budget) {
+            const char *v = va_arg(args, const char *);
+            if (!v) {
+                v = "(null)";
+            }
+            if (esp_ptr_in_drom(v)) {
+                if (out) {
+                    out[used] = AD2_LOG_STR_PTR;
+                    memcpy(out + used + 1, &v, sizeof(v));
+                }
+                used += 1 + sizeof(v);
+            } else {
+                size_t len = std::min(strlen(v), budget - used - 2);
+                if (out) {
+                    out[used] = AD2_LOG_STR_INLINE;
+                    memcpy(out + used + 1, v, len);
+                    out[used + 1 + len] = 0;
+                }
+                used += len + 2;
+            }
+        } else if (type != AD2_LOG_ARG_NONE) {
+            // out of room. Later conversions print as missing.
+            break;
+        }
+    }
+    return used;
+}
+
+/**
+ * @brief Reserve slots and copy a record into the ring.
+ */
+static void _ad2_log_commit(const uint8_t *rec, size_t length)
+{
+    uint8_t nslots = (length + AD2_LOG_SLOT_DATA - 1) / AD2_LOG_SLOT_DATA;
+    uint32_t first = _ad2_log_next.fetch_add(nslots, std::memory_order_relaxed);
+    for (uint8_t n = 0; n < nslots; n++) {
+        ad2_log_slot &slot = _ad2_log_ring[(first + n) % AD2_LOG_SLOTS];
+        slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.nslots = n ? 0 : nslots;
+        size_t off = n * AD2_LOG_SLOT_DATA;
+        memcpy(slot.data, rec + off, std::min((size_t)AD2_LOG_SLOT_DATA, length - off));
+        slot.seq.store(first + n + 1, std::memory_order_release);
+    }
+    if (_ad2_sd_log_task_handle && _ad2_sd_log_enabled) {
+        xTaskNotifyGive(_ad2_sd_log_task_handle);
+    }
+}
+
+/**
+ * @brief Fill the common record header.
+ */
+static void _ad2_log_header(ad2_log_record &hdr, const char *fmt, size_t length)
+{
+    hdr.uptime_ms = hal_uptime_us() / 1000;
+    hdr.fmt = fmt;
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    hdr.task = task ? (uint16_t)uxTaskGetTaskNumber(task) : 0;
+    hdr.length = length;
+}
+
+/**
+ * @brief Record a log call without formatting it.
+ */
+void ad2_capture_log_vprintf(const char *fmt, va_list args)
+{
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    size_t length;
+    if (esp_ptr_in_drom(fmt)) {
+        va_list args_pack;
+        va_copy(args_pack, args);
+        length = sizeof(hdr) + _ad2_log_pack_args(fmt, args_pack, rec + sizeof(hdr), sizeof(rec) - sizeof(hdr));
+        va_end(args_pack);
+        _ad2_log_header(hdr, fmt, length);
+    } else {
+        va_list args_text;
+        va_copy(args_text, args);
+        int len = vsnprintf((char *)rec + sizeof(hdr), sizeof(rec) - sizeof(hdr), fmt, args_text);
+        va_end(args_text);
+        if (len <= 0) {
+            return;
+        }
+        length = sizeof(hdr) + std::min((size_t)len + 1, sizeof(rec) - sizeof(hdr));
+        _ad2_log_header(hdr, nullptr, length);
+    }
+    memcpy(rec, &hdr, sizeof(hdr));
+    _ad2_log_commit(rec, length);
+}
+
+void ad2_capture_log_line(const char *text)
+{
+    if (!text || !text[0]) {
+        return;
+    }
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    size_t len = std::min(strcspn(text, "\r\n"), sizeof(rec) - sizeof(hdr) - 1);
+    _ad2_log_header(hdr, nullptr, sizeof(hdr) + len + 1);
+    memcpy(rec, &hdr, sizeof(hdr));
+    memcpy(rec + sizeof(hdr), text, len);
+    rec[sizeof(hdr) + len] = 0;
+    _ad2_log_commit(rec, hdr.length);
+}
+
+/**
+ * @brief Copy the record that starts at ring index idx.
+ *
+ * @return int slots used by the record, 0 if idx does not start a valid
+ * record, -1 if the slot is still being written.
+ */
+static int _ad2_log_read(uint32_t idx, uint8_t *rec, ad2_log_record &hdr)
+{
+    const ad2_log_slot &head = _ad2_log_ring[idx % AD2_LOG_SLOTS];
+    uint32_t seq = head.seq.load(std::memory_order_acquire);
+    if (seq == 0) {
+        return -1;
+    }
+    if (seq != idx + 1 || !head.nslots) {
+        return 0;
+    }
+    uint8_t nslots = head.nslots;
+    for (uint8_t n = 0; n < nslots; n++) {
+        const ad2_log_slot &slot = _ad2_log_ring[(idx + n) % AD2_LOG_SLOTS];
+        seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != idx + n + 1) {
+            // 0 or an older lap is still being written. A newer lap took it.
+            return n && (int32_t)(seq - (idx + n + 1)) < 0 ? -1 : 0;
+        }
+        memcpy(rec + n * AD2_LOG_SLOT_DATA, slot.data, AD2_LOG_SLOT_DATA);
+    }
+    // Make sure nothing was overwritten while copying.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (uint8_t n = 0; n < nslots; n++) {
+        if (_ad2_log_ring[(idx + n) % AD2_LOG_SLOTS].seq.load(std::memory_order_relaxed) != idx + n + 1) {
+            return 0;
+        }
+    }
+    memcpy(&hdr, rec, sizeof(hdr));
+    if (hdr.length < sizeof(hdr) || hdr.length > nslots * AD2_LOG_SLOT_DATA) {
+        return 0;
+    }
+    return nslots;
+}
+
+/**
+ * @brief Format a record into text. Output stops at the first CR/LF.
+ */
+static void _ad2_log_format(const uint8_t *rec, const ad2_log_record &hdr, char *out, size_t out_size)
+{
+    const uint8_t *arg = rec + sizeof(hdr);
+    const uint8_t *end = rec + hdr.length;
+    size_t pos = 0;
+    out[0] = 0;
+    if (!hdr.fmt) {
+        strlcpy(out, (const char *)arg, std::min(out_size, (size_t)(end - arg)));
+    } else {
+        char spec[24];
+        for (const char *p = hdr.fmt; *p && pos + 1 < out_size;) {
+            if (*p != '%') {
+                out[pos++] = *p++;
+                continue;
+            }
+            p++;
+            if (*p == '%') {
+                out[pos++] = *p++;
+                continue;
+            }
+            int type, stars;
+            p = _ad2_log_spec(p, spec, sizeof(spec), type, stars);
+            int star[2] = {0, 0};
+            for (int n = 0; n < stars; n++) {
+                if (arg + sizeof(int) <= end && n < 2) {
+                    memcpy(&star[n], arg, sizeof(int));
+                }
+                arg += sizeof(int);
+            }
+            char *o = out + pos;
+            size_t room = out_size - pos;
+            int len = 0;
+#define AD2_LOG_SNPRINTF(v) (stars == 0 ? snprintf(o, room, spec, v) : \
+                             stars == 1 ? snprintf(o, room, spec, star[0], v) : \
+                             snprintf(o, room, spec, star[0], star[1], v))
+            if (type == AD2_LOG_ARG_I32 && arg + 4 <= end) {
+                int32_t v;
+                memcpy(&v, arg, sizeof(v));
+                arg += sizeof(v);
+                len = AD2_LOG_SNPRINTF(v);
+            } else if (type == AD2_LOG_ARG_I64 && arg + 8 <= end) {
+                int64_t v;
+                memcpy(&v, arg, sizeof(v));
+                arg += sizeof(v);
+                len = AD2_LOG_SNPRINTF((long long)v);
+            } else if (type == AD2_LOG_ARG_DBL && arg + 8 <= end) {
+                double v;
+                memcpy(&v, arg, sizeof(v));
+                arg += sizeof(v);
+                len = AD2_LOG_SNPRINTF(v);
+            } else if (type == AD2_LOG_ARG_PTR && arg + sizeof(void *) <= end) {
+                void *v;
+                memcpy(&v, arg, sizeof(v));
+                arg += sizeof(v);
+                if (spec[strlen(spec) - 1] == 'p') {
+                    len = AD2_LOG_SNPRINTF(v);
+                }
+            } else if (type == AD2_LOG_ARG_STR && arg + 1 < end) {
+                const char *v;
+                if (*arg == AD2_LOG_STR_PTR && arg + 1 + sizeof(v) <= end) {
+                    memcpy(&v, arg + 1, sizeof(v));
+                    arg += 1 + sizeof(v);
+                } else {
+                    v = (const char *)arg + 1;
+                    arg += strnlen(v, end - arg - 1) + 2;
+                }
+                len = AD2_LOG_SNPRINTF(v);
+            } else if (type != AD2_LOG_ARG_NONE) {
+                len = snprintf(o, room, "?");
+            }
+#undef AD2_LOG_SNPRINTF
+            if (len > 0) {
+                pos += std::min((size_t)len, room - 1);
+            }
+        }
+        out[pos] = 0;
+    }
+    out[strcspn(out, "\r\n")] = 0;
+}
+
+/**
+ * @brief Visit the newest records in the ring oldest first.
+ *
+ * @details Slots that were never written, or were overwritten while being
+ * read, do not start a record and records that format to empty text are
+ * skipped, so they never show up as blank lines.
+ *
+ * @param [in]limit max records.
+ * @param [in]fn called with the formatted text and uptime.
+ *
+ * @return size_t records visited.
+ */
+template <typename F>
+static size_t _ad2_log_for_each_recent(size_t limit, F fn)
+{
+    uint32_t end = _ad2_log_next.load(std::memory_order_acquire);
+    uint32_t start = end > AD2_LOG_SLOTS ? end - AD2_LOG_SLOTS : 0;
+
+    // find record starts first so only the newest are formatted.
+    std::vector<uint32_t> heads;
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    for (uint32_t idx = start; idx < end;) {
+        int n = _ad2_log_read(idx, rec, hdr);
+        if (n > 0) {
+            heads.push_back(idx);
+            idx += n;
+        } else {
+            idx++;
+        }
+    }
+    // walk back from the newest keeping records with text.
+    char text[AD2_LOG_LINE_SIZE];
+    size_t first = heads.size();
+    size_t kept = 0;
+    while (first > 0 && kept < limit) {
+        first--;
+        if (_ad2_log_read(heads[first], rec, hdr) > 0) {
+            _ad2_log_format(rec, hdr, text, sizeof(text));
+            if (text[0]) {
+                kept++;
+                continue;
+            }
+        }
+        heads[first] = UINT32_MAX;
+    }
+    size_t visited = 0;
+    for (size_t h = first; h < heads.size(); h++) {
+        if (heads[h] != UINT32_MAX && _ad2_log_read(heads[h], rec, hdr) > 0) {
+            _ad2_log_format(rec, hdr, text, sizeof(text));
+            if (text[0]) {
+                fn(hdr, text);
+                visited++;
+            }
+        }
+    }
+    return visited;
+}
+
+/**
+ * @brief True if a formatted log line is an error level esp_log entry.
+ */
+static bool _ad2_log_is_error(const char *text)
+{
+    // skip a leading color sequence.
+    if (text[0] == '\033') {
+        const char *m = strchr(text, 'm');
+        text = m ? m + 1 : text;
+    }
+    return text[0] == 'E' && text[1] == ' ' && text[2] == '(';
+}
+
+/**
+ * @brief Compress a block with a small LZ77 codec.
+ *
+ * @details LZ4 style sequences: a token with the literal count in the high
+ * nibble and match length - 4 in the low nibble, 255 run length extension
+ * bytes, the literals, then a 16 bit little endian match offset. The last
+ * sequence only has literals. Uses an 8 KiB hash table and no dynamic
+ * memory. Only called from the uSD log task.
+ *
+ * @return size_t compressed size or 0 if it did not fit in dst_size.
+ */
+static uint16_t _ad2_lz_table[1 << 12];
+static size_t _ad2_lz_compress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    auto read32 = [](const uint8_t *p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    };
+    auto put_length = [&](uint8_t *&op, size_t length) {
+        for (; length >= 255; length -= 255) {
+            *op++ = 255;
+        }
+        *op++ = (uint8_t)length;
+    };
+    memset(_ad2_lz_table, 0, sizeof(_ad2_lz_table));
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + dst_size;
+    size_t ip = 0;
+    size_t anchor = 0;
+    // keep the last bytes as literals.
+    const size_t match_limit = src_size > 12 ? src_size - 5 : 0;
+
+    while (ip + 4 <= match_limit) {
+        uint32_t seq = read32(src + ip);
+        uint32_t h = (seq * 2654435761U) >> 20;
+        size_t ref = _ad2_lz_table[h];
+        _ad2_lz_table[h] = (uint16_t)(ip + 1);
+        if (!ref || ip + 1 - ref > 0xffff || read32(src + ref - 1) != seq) {
+            ip++;
+            continue;
+        }
+        ref--;
+        size_t match = 4;
+        while (ip + match < match_limit && src[ref + match] == src[ip + match]) {
+            match++;
+        }
+        size_t literals = ip - anchor;
+        if (op + 1 + literals + literals / 255 + 2 + 1 + match / 255 + 1 > op_end) {
+            return 0;
+        }
+        uint8_t *token = op++;
+        *token = (uint8_t)((std::min(literals, (size_t)15) << 4) | std::min(match - 4, (size_t)15));
+        if (literals >= 15) {
+            put_length(op, literals - 15);
+        }
+        memcpy(op, src + anchor, literals);
+        op += literals;
+        uint16_t offset = (uint16_t)(ip - ref);
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        if (match - 4 >= 15) {
+            put_length(op, match - 4 - 15);
+        }
+        ip += match;
+        anchor = ip;
+    }
+
+    size_t literals = src_size - anchor;
+    if (op + 1 + literals + literals / 255 + 1 > op_end) {
+        return 0;
+    }
+    *op++ = (uint8_t)(std::min(literals, (size_t)15) << 4);
+    if (literals >= 15) {
+        put_length(op, literals - 15);
+    }
+    memcpy(op, src + anchor, literals);
+    op += literals;
+    return op - dst;
+}
+
+/**
+ * @brief Decompress a block from _ad2_lz_compress.
+ *
+ * @return int decompressed size or -1 if the block is corrupt.
+ */
+static int _ad2_lz_decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *ip = src;
+    const uint8_t *ip_end = src + src_size;
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + dst_size;
+    auto get_length = [&](size_t &length) {
+        uint8_t b;
+        do {
+            if (ip >= ip_end) {
+                return false;
+            }
+            b = *ip++;
+            length += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (ip < ip_end) {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !get_length(literals)) {
+            return -1;
+        }
+        if (literals > (size_t)(ip_end - ip) || literals > (size_t)(op_end - op)) {
+            return -1;
+        }
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == ip_end) {
+            break;
+        }
+        if (ip_end - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match = (token & 0x0f);
+        if (match == 15 && !get_length(match)) {
+            return -1;
+        }
+        match += 4;
+        if (!offset || offset > (size_t)(op - dst) || match > (size_t)(op_end - op)) {
+            return -1;
+        }
+        // byte copy, matches may overlap.
+        const uint8_t *ref = op - offset;
+        while (match--) {
+            *op++ = *ref++;
+        }
+    }
+    return op - dst;
+}
+
+/**
+ * @brief Path of uSD log segment seq.
+ */
+static std::string _ad2_sd_log_segment_path(uint32_t seq)
+{
+    char name[20];
+    snprintf(name, sizeof(name), "/%08lx.lz", (unsigned long)seq);
+    return std::string(AD2_SD_LOG_DIR) + name;
+}
+
+/**
+ * @brief List uSD log segments oldest first.
+ */
+static void _ad2_sd_log_list_segments(std::vector<std::pair<uint32_t, uint32_t>> &segments)
+{
+    segments.clear();
+    DIR *dir = opendir(AD2_SD_LOG_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char *end = NULL;
+        unsigned long seq = strtoul(entry->d_name, &end, 16);
+        if (!seq || !end || strcasecmp(end, ".lz") != 0) {
+            continue;
+        }
+        struct stat info;
+        uint32_t size = 0;
+        if (stat(_ad2_sd_log_segment_path(seq).c_str(), &info) == 0) {
+            size = info.st_size;
+        }
+        segments.push_back(std::make_pair((uint32_t)seq, size));
+    }
+    closedir(dir);
+    std::sort(segments.begin(), segments.end());
+}
+
+/**
+ * @brief Delete the oldest closed segments until the retention budget fits.
+ */
+static void _ad2_sd_log_enforce_retention()
+{
+    uint64_t total = 0;
+    for (auto &segment : _ad2_sd_log_segments) {
+        total += segment.second;
+    }
+    while (_ad2_sd_log_segments.size() > 1 && total > _ad2_sd_log_retention_bytes) {
+        total -= _ad2_sd_log_segments.front().second;
+        remove(_ad2_sd_log_segment_path(_ad2_sd_log_segments.front().first).c_str());
+        _ad2_sd_log_segments.erase(_ad2_sd_log_segments.begin());
+    }
+    taskENTER_CRITICAL(&spinlock);
+    _ad2_sd_log_stats.segments = _ad2_sd_log_segments.size();
+    _ad2_sd_log_stats.stored_bytes = total;
+    taskEXIT_CRITICAL(&spinlock);
+}
+
+/**
+ * @brief Write the final header of the open segment and close it.
+ */
+static void _ad2_sd_log_close_segment()
+{
+    if (!_ad2_sd_seg.file) {
+        return;
+    }
+    if (fseek(_ad2_sd_seg.file, 0, SEEK_SET) != 0 ||
+            fwrite(&_ad2_sd_seg.hdr, 1, sizeof(_ad2_sd_seg.hdr), _ad2_sd_seg.file) != sizeof(_ad2_sd_seg.hdr)) {
+        taskENTER_CRITICAL(&spinlock);
+        _ad2_sd_log_write_errors++;
+        taskEXIT_CRITICAL(&spinlock);
+    }
+    fclose(_ad2_sd_seg.file);
+    _ad2_sd_seg.file = NULL;
+}
+
+/**
+ * @brief Start a new segment after the newest one on the card.
+ */
+static bool _ad2_sd_log_open_segment()
+{
+    if (!_ad2_sd_log_segments_scanned) {
+        mkdir(AD2_SD_LOG_DIR, 0755);
+        _ad2_sd_log_list_segments(_ad2_sd_log_segments);
+        _ad2_sd_log_segments_scanned = true;
+    }
+    uint32_t seq = _ad2_sd_log_segments.empty() ? 1 : _ad2_sd_log_segments.back().first + 1;
+    FILE *file = fopen(_ad2_sd_log_segment_path(seq).c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    // one write() per block.
+    setvbuf(file, NULL, _IONBF, 0);
+    if (!_ad2_sd_seg.boot_seq) {
+        _ad2_sd_seg.boot_seq = seq;
+    }
+    memset(&_ad2_sd_seg.hdr, 0, sizeof(_ad2_sd_seg.hdr));
+    _ad2_sd_seg.hdr.magic = AD2_LOG_SEG_MAGIC;
+    _ad2_sd_seg.hdr.boot_seq = _ad2_sd_seg.boot_seq;
+    if (fwrite(&_ad2_sd_seg.hdr, 1, sizeof(_ad2_sd_seg.hdr), file) != sizeof(_ad2_sd_seg.hdr)) {
+        fclose(file);
+        return false;
+    }
+    _ad2_sd_seg.file = file;
+    _ad2_sd_seg.seq = seq;
+    _ad2_sd_seg.size = sizeof(_ad2_sd_seg.hdr);
+    _ad2_sd_log_segments.push_back(std::make_pair(seq, (uint32_t)_ad2_sd_seg.size));
+    _ad2_sd_log_enforce_retention();
+    return true;
+}
+
+/**
+ * @brief Compress the staged log lines and append them to the open segment
+ * as one block with one write.
+ *
+ * @details Starts a new segment first if the block would go past
+ * AD2_SD_LOG_SEGMENT_BYTES.
+ */
+static void _ad2_sd_log_flush()
+{
+    if (!_ad2_sd_log_staged) {
+        return;
+    }
+    uint8_t *block = _ad2_sd_log_block;
+    ad2_log_blk_hdr blk;
+    blk.magic = AD2_LOG_BLK_MAGIC;
+    blk.raw_len = _ad2_sd_log_staged;
+    blk.first_ms = _ad2_sd_log_staged_first_ms;
+    blk.last_ms = _ad2_sd_log_staged_last_ms;
+    int64_t wall_ms = ad2_wall_clock_ms();
+    blk.wall_offset_ms = wall_ms ? wall_ms - (int64_t)(hal_uptime_us() / 1000) : 0;
+    size_t comp_len = _ad2_lz_compress((const uint8_t *)_ad2_sd_log_stage, _ad2_sd_log_staged,
+                                       block + sizeof(blk), _ad2_sd_log_staged - 1);
+    if (!comp_len) {
+        // not compressible. Store it as is.
+        comp_len = _ad2_sd_log_staged;
+        memcpy(block + sizeof(blk), _ad2_sd_log_stage, comp_len);
+    }
+    blk.comp_len = comp_len;
+    memcpy(block, &blk, sizeof(blk));
+    size_t length = sizeof(blk) + comp_len;
+
+    if (_ad2_sd_seg.file && _ad2_sd_seg.size + length > AD2_SD_LOG_SEGMENT_BYTES) {
+        _ad2_sd_log_close_segment();
+    }
+    if (!_ad2_sd_seg.file && !_ad2_sd_log_open_segment()) {
+        taskENTER_CRITICAL(&spinlock);
+        _ad2_sd_log_write_errors++;
+        _ad2_sd_log_stats.dropped += _ad2_sd_log_staged_lines;
+        taskEXIT_CRITICAL(&spinlock);
+        _ad2_sd_log_staged = 0;
+        _ad2_sd_log_staged_lines = 0;
+        return;
+    }
+
+    uint64_t start_us = hal_uptime_us();
+    size_t written = fwrite(block, 1, length, _ad2_sd_seg.file);
+    bool ok = written == length && fsync(fileno(_ad2_sd_seg.file)) == 0;
+    uint32_t flush_us = (uint32_t)(hal_uptime_us() - start_us);
+    _ad2_sd_seg.size += written;
+    _ad2_sd_log_segments.back().second = _ad2_sd_seg.size;
+
+    // segment header time range.
+    if (!_ad2_sd_seg.hdr.first_ms) {
+        _ad2_sd_seg.hdr.first_ms = blk.first_ms;
+    }
+    _ad2_sd_seg.hdr.last_ms = blk.last_ms;
+    if (blk.wall_offset_ms) {
+        if (!_ad2_sd_seg.hdr.wall_first_ms) {
+            _ad2_sd_seg.hdr.wall_first_ms = blk.wall_offset_ms + (int64_t)blk.first_ms;
+        }
+        _ad2_sd_seg.hdr.wall_last_ms = blk.wall_offset_ms + (int64_t)blk.last_ms;
+    }
+
+    taskENTER_CRITICAL(&spinlock);
+    _ad2_sd_log_stats.writes++;
+    _ad2_sd_log_stats.bytes += written;
+    _ad2_sd_log_stats.raw_bytes += _ad2_sd_log_staged;
+    _ad2_sd_log_stats.lines += _ad2_sd_log_staged_lines;
+    _ad2_sd_log_stats.stored_bytes += written;
+    _ad2_sd_log_flush_us_total += flush_us;
+    if (flush_us > _ad2_sd_log_stats.max_flush_us) {
+        _ad2_sd_log_stats.max_flush_us = flush_us;
+    }
+    if (!ok) {
+        _ad2_sd_log_write_errors++;
+    }
+    taskEXIT_CRITICAL(&spinlock);
+
+    _ad2_sd_log_staged = 0;
+    _ad2_sd_log_staged_lines = 0;
+}
+
+/**
+ * @brief SD log writer. Reads the log ring with its own cursor.
+ *
+ * @details Group commit. Everything available in the ring is formatted into
+ * a staging buffer and written as one compressed block when the buffer
+ * fills, when the oldest staged line is AD2_SD_LOG_FLUSH_MS old or right
+ * away when an error level line is staged.
+ */
+static void _ad2_sd_log_task(void *pvParameters)
+{
+    uint32_t cursor = _ad2_log_next.load(std::memory_order_acquire);
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    char text[AD2_LOG_LINE_SIZE];
+    uint64_t staged_at_ms = 0;
+
+    while (true) {
+        TickType_t wait = pdMS_TO_TICKS(1000);
+        if (_ad2_sd_log_staged) {
+            uint64_t age = hal_uptime_us() / 1000 - staged_at_ms;
+            wait = age >= AD2_SD_LOG_FLUSH_MS ? 0 : pdMS_TO_TICKS(AD2_SD_LOG_FLUSH_MS - age);
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        uint32_t end = _ad2_log_next.load(std::memory_order_acquire);
+        if (!_ad2_sd_log_enabled || !g_uSD_mounted) {
+            if (_ad2_sd_seg.file) {
+                if (g_uSD_mounted) {
+                    _ad2_sd_log_flush();
+                }
+                _ad2_sd_log_close_segment();
+            }
+            _ad2_sd_log_staged = 0;
+            _ad2_sd_log_staged_lines = 0;
+            cursor = end;
+            continue;
+        }
+        if (!_ad2_sd_log_stats.since_ms) {
+            _ad2_sd_log_stats.since_ms = hal_uptime_us() / 1000;
+        }
+
+        // Entries overwritten before they were written out are dropped.
+        if (end - cursor > AD2_LOG_SLOTS) {
+            taskENTER_CRITICAL(&spinlock);
+            _ad2_sd_log_dropped += end - cursor - AD2_LOG_SLOTS;
+            taskEXIT_CRITICAL(&spinlock);
+            cursor = end - AD2_LOG_SLOTS;
+        }
+
+        bool urgent = false;
+        while (cursor < end) {
+            int n = _ad2_log_read(cursor, rec, hdr);
+            if (n < 0) {
+                // still being written. Try again on the next wake.
+                break;
+            }
+            if (n == 0) {
+                cursor++;
+                continue;
+            }
+            cursor += n;
+            _ad2_log_format(rec, hdr, text, sizeof(text));
+            if (!text[0]) {
+                continue;
+            }
+
+            if (AD2_SD_LOG_STAGE_SIZE - _ad2_sd_log_staged < AD2_LOG_LINE_SIZE + 32) {
+                _ad2_sd_log_flush();
+            }
+            int line_length = snprintf(_ad2_sd_log_stage + _ad2_sd_log_staged,
+                                       AD2_SD_LOG_STAGE_SIZE - _ad2_sd_log_staged,
+                                       "[%llu ms] %s\r\n", (unsigned long long)hdr.uptime_ms, text);
+            if (line_length <= 0) {
+                continue;
+            }
+            if (!_ad2_sd_log_staged) {
+                staged_at_ms = hal_uptime_us() / 1000;
+                _ad2_sd_log_staged_first_ms = hdr.uptime_ms;
+            }
+            _ad2_sd_log_staged_last_ms = hdr.uptime_ms;
+            _ad2_sd_log_staged += std::min((size_t)line_length, AD2_SD_LOG_STAGE_SIZE - _ad2_sd_log_staged - 1);
+            _ad2_sd_log_staged_lines++;
+            urgent |= _ad2_log_is_error(text);
+        }
+
+        if (_ad2_sd_log_staged &&
+                (urgent || hal_uptime_us() / 1000 - staged_at_ms >= AD2_SD_LOG_FLUSH_MS)) {
+            _ad2_sd_log_flush();
+        }
+    }
+}
+
+static bool _ad2_start_sd_log_task()
+{
+    if (_ad2_sd_log_task_started) {
+        return true;
+    }
+    if (!g_uSD_mounted) {
+        return false;
+    }
+    if (xTaskCreate(_ad2_sd_log_task, "AD2 SD log", 1024 * 4, NULL,
+                    tskIDLE_PRIORITY + 1, &_ad2_sd_log_task_handle) != pdPASS) {
+        return false;
+    }
+    _ad2_sd_log_task_started = true;
+    return true;
+}
+
+cJSON *ad2_get_recent_logs_json(size_t limit)
+{
+    // newest first.
+    std::vector<cJSON *> newest;
+    _ad2_log_for_each_recent(limit, [&](const ad2_log_record & hdr, const char *text) {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "uptime_ms", (double)hdr.uptime_ms);
+        cJSON_AddNumberToObject(item, "task", hdr.task);
+        cJSON_AddStringToObject(item, "text", text);
+        newest.push_back(item);
+    });
+    cJSON *items = cJSON_CreateArray();
+    for (auto it = newest.rbegin(); it != newest.rend(); ++it) {
+        cJSON_AddItemToArray(items, *it);
+    }
+    return items;
+}
+
+size_t ad2_print_recent_logs(size_t limit)
+{
+    return _ad2_log_for_each_recent(limit, [](const ad2_log_record & hdr, const char *text) {
+        char line[AD2_LOG_LINE_SIZE + 40];
+        int len = snprintf(line, sizeof(line), "[%llu ms] %s\r\n", (unsigned long long)hdr.uptime_ms, text);
+        if (len > 0) {
+            cli_write_bytes(line, std::min((size_t)len, sizeof(line) - 1));
+        }
+    });
+}
+
+size_t ad2_sd_log_query(int64_t from_ms, int64_t to_ms, bool wall_clock,
+                        ad2_log_line_cb_t fn, void *arg)
+{
+    if (!g_uSD_mounted) {
+        return 0;
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> segments;
+    _ad2_sd_log_list_segments(segments);
+    uint32_t boot_seq = _ad2_sd_seg.boot_seq;
+
+    std::vector<uint8_t> comp(AD2_SD_LOG_STAGE_SIZE);
+    std::vector<char> raw(AD2_SD_LOG_STAGE_SIZE + 1);
+    char line[AD2_LOG_LINE_SIZE + 64];
+    size_t count = 0;
+    bool stop = false;
+
+    for (auto &segment : segments) {
+        if (stop) {
+            break;
+        }
+        FILE *file = fopen(_ad2_sd_log_segment_path(segment.first).c_str(), "rb");
+        if (!file) {
+            continue;
+        }
+        ad2_log_seg_hdr seg;
+        if (fread(&seg, 1, sizeof(seg), file) != sizeof(seg) || seg.magic != AD2_LOG_SEG_MAGIC) {
+            fclose(file);
+            continue;
+        }
+        // skip whole segments using the header time range. last_ms is only
+        // set once a segment is closed.
+        if (!wall_clock && seg.boot_seq != boot_seq) {
+            fclose(file);
+            continue;
+        }
+        if (seg.last_ms) {
+            int64_t first = wall_clock ? seg.wall_first_ms : (int64_t)seg.first_ms;
+            int64_t last = wall_clock ? seg.wall_last_ms : (int64_t)seg.last_ms;
+            if ((wall_clock && !seg.wall_last_ms) || last < from_ms || first > to_ms) {
+                fclose(file);
+                continue;
+            }
+        }
+
+        ad2_log_blk_hdr blk;
+        while (!stop && fread(&blk, 1, sizeof(blk), file) == sizeof(blk)) {
+            if (blk.magic != AD2_LOG_BLK_MAGIC || blk.comp_len > comp.size() ||
+                    blk.raw_len > AD2_SD_LOG_STAGE_SIZE || blk.comp_len > blk.raw_len) {
+                break;
+            }
+            int64_t offset = wall_clock ? blk.wall_offset_ms : 0;
+            if ((wall_clock && !offset) ||
+                    offset + (int64_t)blk.last_ms < from_ms || offset + (int64_t)blk.first_ms > to_ms) {
+                if (fseek(file, blk.comp_len, SEEK_CUR) != 0) {
+                    break;
+                }
+                continue;
+            }
+            if (fread(comp.data(), 1, blk.comp_len, file) != blk.comp_len) {
+                break;
+            }
+            int raw_len = blk.raw_len;
+            if (blk.comp_len == blk.raw_len) {
+                memcpy(raw.data(), comp.data(), raw_len);
+            } else {
+                raw_len = _ad2_lz_decompress(comp.data(), blk.comp_len, (uint8_t *)raw.data(), blk.raw_len);
+                if (raw_len != blk.raw_len) {
+                    break;
+                }
+            }
+            raw[raw_len] = 0;
+
+            // lines are "[<uptime> ms] text\r\n".
+            for (char *p = raw.data(); *p && !stop;) {
+                char *eol = p + strcspn(p, "\r\n");
+                char saved = *eol;
+                *eol = 0;
+                unsigned long long uptime = (*p == '[') ? strtoull(p + 1, NULL, 10) : 0;
+                int64_t when = offset + (int64_t)uptime;
+                if (*p && when >= from_ms && when <= to_ms) {
+                    int len;
+                    if (wall_clock) {
+                        time_t secs = when / 1000;
+                        struct tm tm;
+                        localtime_r(&secs, &tm);
+                        char stamp[24];
+                        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+                        len = snprintf(line, sizeof(line), "%s %s", stamp, p);
+                    } else {
+                        len = snprintf(line, sizeof(line), "%s", p);
+                    }
+                    count++;
+                    if (len > 0 && !fn(line, std::min((size_t)len, sizeof(line) - 1), arg)) {
+                        stop = true;
+                    }
+                }
+                *eol = saved;
+                p = eol + strspn(eol, "\r\n");
+            }
+        }
+        fclose(file);
+    }
+    return count;
+}
+
+void ad2_init_sd_logging()
+{
+    bool enabled = false;
+    ad2_get_config_key_bool(CFG_SECTION_MAIN, SDLOG_CONFIG_KEY, &enabled);
+    int keep_mb = AD2_SD_LOG_RETENTION_MB;
+    ad2_get_config_key_int(CFG_SECTION_MAIN, SDLOGKEEP_CONFIG_KEY, &keep_mb);
+    ad2_set_sd_logging_retention(keep_mb);
+    ad2_set_sd_logging_enabled(enabled);
+}
+
+void ad2_set_sd_logging_retention(int megabytes)
+{
+    if (megabytes < 1) {
+        megabytes = AD2_SD_LOG_RETENTION_MB;
+    }
+    taskENTER_CRITICAL(&spinlock);
+    _ad2_sd_log_retention_bytes = (uint64_t)megabytes * 1024 * 1024;
+    _ad2_sd_log_stats.retention_bytes = _ad2_sd_log_retention_bytes;
+    // applied by the writer when it starts the next segment.
+    taskEXIT_CRITICAL(&spinlock);
+}
+
+bool ad2_set_sd_logging_enabled(bool enabled)
+{
+    _ad2_sd_log_enabled = enabled;
+    if (enabled && !_ad2_start_sd_log_task()) {
+        return false;
+    }
+    return true;
+}
+
+void ad2_get_sd_logging_status(bool *enabled, bool *active,
+                               uint32_t *dropped, uint32_t *write_errors)
+{
+    taskENTER_CRITICAL(&spinlock);
+    if (enabled) {
+        *enabled = _ad2_sd_log_enabled;
+    }
+    if (active) {
+        *active = _ad2_sd_log_enabled && _ad2_sd_log_task_started && g_uSD_mounted;
+    }
+    if (dropped) {
+        *dropped = _ad2_sd_log_dropped;
+    }
+    if (write_errors) {
+        *write_errors = _ad2_sd_log_write_errors;
+    }
+    taskEXIT_CRITICAL(&spinlock);
+}
+
+void ad2_get_sd_logging_stats(ad2_sd_log_stats_t *stats)
+{
+    taskENTER_CRITICAL(&spinlock);
+    *stats = _ad2_sd_log_stats;
+    stats->dropped += _ad2_sd_log_dropped;
+    stats->avg_flush_us = _ad2_sd_log_stats.writes ?
+                          (uint32_t)(_ad2_sd_log_flush_us_total / _ad2_sd_log_stats.writes) : 0;
+    taskEXIT_CRITICAL(&spinlock);
+}
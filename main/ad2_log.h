@@ -0,0 +1,58 @@
+/**
+ *  @file    ad2_log.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Diagnostic log history and uSD log segment writer.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_LOG_H
+#define _AD2_LOG_H
+
+/**
+ * @brief uSD log group commit writer counters.
+ */
+typedef struct {
+    uint64_t since_ms;       ///< uptime the writer started.
+    uint32_t writes;         ///< batched writes to the card.
+    uint32_t lines;          ///< log lines written.
+    uint32_t bytes;          ///< compressed bytes written.
+    uint32_t raw_bytes;      ///< log text bytes before compression.
+    uint32_t dropped;        ///< lines lost before they were written.
+    uint32_t segments;       ///< segment files on the card.
+    uint64_t stored_bytes;   ///< bytes in all segments.
+    uint64_t retention_bytes;///< segment retention budget.
+    uint32_t avg_flush_us;   ///< average write and sync time.
+    uint32_t max_flush_us;   ///< worst write and sync time.
+} ad2_sd_log_stats_t;
+
+cJSON *ad2_get_recent_logs_json(size_t limit);
+size_t ad2_print_recent_logs(size_t limit);
+void ad2_init_sd_logging();
+bool ad2_set_sd_logging_enabled(bool enabled);
+void ad2_get_sd_logging_status(bool *enabled, bool *active,
+                               uint32_t *dropped, uint32_t *write_errors);
+void ad2_get_sd_logging_stats(ad2_sd_log_stats_t *stats);
+void ad2_set_sd_logging_retention(int megabytes);
+
+typedef bool (*ad2_log_line_cb_t)(const char *line, size_t len, void *arg);
+size_t ad2_sd_log_query(int64_t from_ms, int64_t to_ms, bool wall_clock,
+                        ad2_log_line_cb_t fn, void *arg);
+void ad2_capture_log_vprintf(const char *fmt, va_list args);
+void ad2_capture_log_line(const char *text);
+
+#endif /* _AD2_LOG_H */
@@ -100,11 +100,47 @@
 // @brief opt-in persistent diagnostic log on the mounted uSD card
 #define SDLOG_CONFIG_KEY      "sdlog"
 
+// @brief persistent parser event journal on the mounted uSD card. Default Y.
+#define JOURNAL_CONFIG_KEY    "journal"
+
+// @brief uSD log retention budget in MiB
+#define SDLOGKEEP_CONFIG_KEY  "sdlogkeep"
+
+// @brief HTTP sendQ full sub-queue policy. evict(default) or coalesce.
+#define HTTPQFULL_CONFIG_KEY  "httpqfull"
+
+// @brief notification coalescing window in ms. 0 disables.
+#define NOTIFYWINDOW_CONFIG_KEY "notifywindow"
+
 // @brief bounded diagnostic log sizes and uSD paths
 #define AD2_LOG_HISTORY_SIZE 64
-#define AD2_SD_LOG_MAX_BYTES (512 * 1024)
-#define AD2_SD_LOG_PATH "/" AD2_USD_MOUNT_POINT "/ad2iot.log"
-#define AD2_SD_LOG_OLD_PATH "/" AD2_USD_MOUNT_POINT "/ad2iot.log.1"
+#define AD2_SD_LOG_DIR "/" AD2_USD_MOUNT_POINT "/ad2log"
+#ifndef AD2_SD_LOG_SEGMENT_BYTES
+#define AD2_SD_LOG_SEGMENT_BYTES (128 * 1024)
+#endif
+#define AD2_SD_LOG_RETENTION_MB 64
+#define AD2_SD_LOG_QUERY_MAX_LINES 1000
+
+// @brief uSD log group commit staging buffer and max age of staged lines in ms.
+#define AD2_SD_LOG_STAGE_SIZE 4096
+#define AD2_SD_LOG_FLUSH_MS 2000
+
+// @brief uSD event journal paths, size before it moves to the old file,
+// blocks per sparse index entry, write delay in ms, queued record limit,
+// blocks read per query page and max wait for the journal in a query.
+#define AD2_JOURNAL_PATH "/" AD2_USD_MOUNT_POINT "/ad2event.jnl"
+#define AD2_JOURNAL_OLD_PATH "/" AD2_USD_MOUNT_POINT "/ad2event.old"
+#ifndef AD2_JOURNAL_MAX_BYTES
+#define AD2_JOURNAL_MAX_BYTES (4 * 1024 * 1024)
+#endif
+#define AD2_JOURNAL_INDEX_STRIDE 16
+#define AD2_JOURNAL_FLUSH_MS 5000
+#define AD2_JOURNAL_PENDING_MAX 64
+#define AD2_JOURNAL_QUERY_MAX_BLOCKS 256
+#define AD2_JOURNAL_QUERY_WAIT_MS 2000
+
+// @brief wall clock times before this (2021-01-01) are treated as unset.
+#define AD2_LOG_WALL_CLOCK_MIN 1609459200
 
 // UART RX buffer size
 #define AD2_UART_RX_BUFF_SIZE  100
@@ -119,10 +155,81 @@
 // Signon message
 #define AD2_SIGNON "%s: Starting AlarmDecoder AD2IoT network appliance version (%s) build flag (%s)"
 
-// The virtual mount prefix for all file operations.
+// The virtual mount prefix for all file operations. The host tests
+// build with these pointed at a scratch directory.
+#ifndef AD2_USD_MOUNT_POINT
 #define AD2_USD_MOUNT_POINT "sdcard"
+#endif
+#ifndef AD2_SPIFFS_MOUNT_POINT
 #define AD2_SPIFFS_MOUNT_POINT "spiffs"
+#endif
 #define AD2_CONFIG_FILE "/ad2iot.ini"
 
+// Precompiled binary image of the active ini. Always kept on SPIFFS and
+// rebuilt whenever the hash of the source ini changes.
+#define AD2_CONFIG_CACHE_FILE "/ad2iot.cfg"
+
+// Line buffer for the streaming ini loader. Longer lines are truncated.
+#define AD2_CONFIG_LINE_SIZE (AD2_MAX_VALUE_SIZE + 128)
+
 // Console LOCK timeout
 #define AD2_CONSOLE_LOCK_TIME 500
+
+// Outbound AD2 command queue depth per source.
+#define AD2_CMD_SENDQ_DEPTH 16
+
+// Max wait for "!Sending...done" before the next keypad command is written.
+#define AD2_CMD_SENDQ_ACK_TIMEOUT 1500
+
+// HTTP sendQ requests queued per integration.
+#define AD2_HTTP_SENDQ_DEPTH 8
+
+// Security requests sent for each informational one while both wait.
+#define AD2_HTTP_SENDQ_SECURITY_WEIGHT 3
+
+// HTTP sendQ spool for undelivered notifications. Ring file on the uSD card,
+// its record size and count, records kept in RAM without a card, retry
+// backoff range in ms and sends before a request is given up on.
+#define AD2_HTTP_SPOOL_PATH "/" AD2_USD_MOUNT_POINT "/ad2spool.bin"
+#define AD2_HTTP_SPOOL_RECORD_SIZE 256
+#define AD2_HTTP_SPOOL_RECORDS 128
+#define AD2_HTTP_SPOOL_RAM_RECORDS 8
+#define AD2_HTTP_SPOOL_RETRY_MIN_MS 5000
+#define AD2_HTTP_SPOOL_RETRY_MAX_MS (10 * 60 * 1000)
+#define AD2_HTTP_SPOOL_MAX_ATTEMPTS 20
+
+// Notifications to one integration slot within this many ms are sent as one
+// request, up to this many bytes of message text. Must fit a spool record.
+#define AD2_HTTP_NOTIFY_WINDOW_MS 750
+#define AD2_HTTP_NOTIFY_MAX_BYTES 232
+
+// Shared DNS cache for outbound service hosts. Entries and prefetch hosts
+// kept, longest host name, TTL clamp, how early a prefetch host is refreshed,
+// how long a failed host waits before the next query and how old a last
+// known address may be when served after DNS fails.
+#define AD2_DNS_CACHE_SIZE 8
+#define AD2_DNS_PREFETCH_HOSTS 6
+#define AD2_DNS_HOST_MAX 96
+#define AD2_DNS_TTL_MIN_S 30
+#define AD2_DNS_TTL_MAX_S 3600
+#define AD2_DNS_PREFETCH_S 60
+#define AD2_DNS_RETRY_S 10
+#define AD2_DNS_STALE_MAX_S (24 * 3600)
+#ifndef AD2_DNS_TIMEOUT_MS
+#define AD2_DNS_TIMEOUT_MS 1500
+#endif
+#ifndef AD2_DNS_PORT
+#define AD2_DNS_PORT 53
+#endif
+
+// HTTP sendQ keep-alive pool. Clients kept open, one per origin(scheme://host:port).
+// Pushover, Twilio and SendGrid each get one.
+#define AD2_HTTP_POOL_SIZE 3
+
+// Close a pooled connection after this long without a request. Kept below
+// the common 60s server keep-alive so a reused socket is rarely stale.
+#define AD2_HTTP_POOL_IDLE_MS 45000
+
+// Close idle pooled connections when free heap drops below this. A TLS
+// session holds roughly 40k.
+#define AD2_HTTP_POOL_MIN_FREE_HEAP (48 * 1024)
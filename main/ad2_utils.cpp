@@ -42,12 +42,52 @@ static const char *TAG = "AD2UTIL";
 #include "mbedtls/base64.h"
 #include "esp_system.h"
 #include "esp_mac.h"
-#include "esp_chip_info.h"
 #include "esp_flash.h"
 #include "esp_app_desc.h"
+#include "esp_rom_crc.h"
 #include <SimpleIni.h>
-// ini config class
-static CSimpleIniA _ad2ini;
+#include <unistd.h>
+#include <sys/time.h>
+
+/* Resident configuration store. Section, key and value strings are interned
+ * into one pool and referenced by offset from an index kept sorted by
+ * section/key, case insensitive like SimpleIni. The same layout is saved on
+ * SPIFFS as the precompiled config image so unchanged boots skip parsing.
+ * A SimpleIni DOM only exists while saving. */
+#define AD2_CONFIG_CACHE_MAGIC   0x47464341 // "ACFG"
+#define AD2_CONFIG_CACHE_SCHEMA  1
+#define AD2_CONFIG_CACHE_FLAG_SD 0x0001
+// Replaced and removed strings stay in the pool until this many bytes and a
+// quarter of the pool are dead, then live entries are copied to a new pool.
+#define AD2_CONFIG_POOL_SLACK    512
+struct ad2_config_image_header {
+    uint32_t magic;
+    uint16_t schema;
+    uint16_t flags;
+    uint32_t ini_hash;
+    uint32_t ini_size;
+    uint32_t entry_count;
+    uint32_t strings_size;
+    uint32_t crc;
+};
+struct ad2_config_entry {
+    uint32_t section;
+    uint32_t key;
+    uint32_t value;
+};
+static std::vector<char> _ad2cfg_pool;
+static std::vector<ad2_config_entry> _ad2cfg_entries;
+static size_t _ad2cfg_garbage = 0;
+static SemaphoreHandle_t _ad2cfg_mutex = NULL;
+
+// config change subscribers and sections changed since the last reload.
+struct ad2_config_subscriber {
+    std::vector<std::string> sections;
+    ad2_config_change_cb_t fn;
+    void *arg;
+};
+static std::vector<ad2_config_subscriber> _ad2cfg_subscribers;
+static std::vector<std::string> _ad2cfg_changed_sections;
 
 // auto save and cache states.
 static bool _config_autosave = false;
@@ -60,244 +100,633 @@ const char *ad2_firmware_version()
     return app && app->version[0] ? app->version : "Unknown";
 }
 
-/* Bounded, reboot-scoped diagnostic log retained for the read-only Web UI. */
-#define AD2_LOG_LINE_SIZE 192
-#define AD2_SD_LOG_QUEUE_SIZE 16
-struct ad2_log_entry {
-    uint64_t uptime_ms;
-    char text[AD2_LOG_LINE_SIZE];
-};
-static ad2_log_entry _ad2_log_history[AD2_LOG_HISTORY_SIZE];
-static size_t _ad2_log_history_head = 0;
-static size_t _ad2_log_history_count = 0;
-static QueueHandle_t _ad2_sd_log_queue = NULL;
-static volatile bool _ad2_sd_log_enabled = false;
-static bool _ad2_sd_log_task_started = false;
-static uint32_t _ad2_sd_log_dropped = 0;
-static uint32_t _ad2_sd_log_write_errors = 0;
-
-static void _ad2_sd_log_task(void *pvParameters)
-{
-    FILE *log_file = NULL;
-    size_t file_size = 0;
-    ad2_log_entry entry;
-    char line[AD2_LOG_LINE_SIZE + 40];
-
-    while (true) {
-        if (xQueueReceive(_ad2_sd_log_queue, &entry, pdMS_TO_TICKS(1000)) != pdTRUE) {
-            if (!_ad2_sd_log_enabled && log_file) {
-                fclose(log_file);
-                log_file = NULL;
-                file_size = 0;
-            }
-            continue;
-        }
+/**
+ * @brief Wall clock time in ms or 0 if the clock was never set.
+ */
+int64_t ad2_wall_clock_ms()
+{
+    struct timeval tv;
+    if (gettimeofday(&tv, NULL) != 0 || tv.tv_sec < AD2_LOG_WALL_CLOCK_MIN) {
+        return 0;
+    }
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
 
-        if (!_ad2_sd_log_enabled || !g_uSD_mounted) {
-            continue;
-        }
+/**
+ * @brief Path of the ini the running config was loaded from.
+ */
+static const char *_ad2_config_ini_path()
+{
+    return _uSD_config ? "/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE : "/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_FILE;
+}
 
-        int line_length = snprintf(line, sizeof(line), "[%llu ms] %s\r\n",
-                                   (unsigned long long)entry.uptime_ms, entry.text);
-        if (line_length <= 0) {
-            continue;
+/**
+ * @brief FNV-1a hash a file without loading it into memory.
+ *
+ * @param [in]path file to hash.
+ * @param [out]hash uint32_t * result.
+ * @param [out]size uint32_t * file size.
+ *
+ * @return bool true if the file could be read.
+ */
+static bool _ad2_config_hash_file(const char *path, uint32_t *hash, uint32_t *size)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    uint8_t buf[256];
+    uint32_t h = 2166136261UL;
+    uint32_t total = 0;
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            h = (h ^ buf[i]) * 16777619UL;
         }
-        size_t bytes_to_write = std::min((size_t)line_length, sizeof(line) - 1);
+        total += n;
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    *hash = h;
+    *size = total;
+    return ok;
+}
 
-        if (!log_file) {
-            log_file = fopen(AD2_SD_LOG_PATH, "a+");
-            if (!log_file) {
-                taskENTER_CRITICAL(&spinlock);
-                _ad2_sd_log_write_errors++;
-                taskEXIT_CRITICAL(&spinlock);
-                continue;
-            }
-            if (fseek(log_file, 0, SEEK_END) == 0) {
-                long position = ftell(log_file);
-                file_size = position > 0 ? (size_t)position : 0;
-            }
-        }
+/**
+ * @brief Serialize access to the config store between tasks.
+ */
+static void _ad2_config_lock()
+{
+    if (_ad2cfg_mutex) {
+        xSemaphoreTakeRecursive(_ad2cfg_mutex, portMAX_DELAY);
+    }
+}
+static void _ad2_config_unlock()
+{
+    if (_ad2cfg_mutex) {
+        xSemaphoreGiveRecursive(_ad2cfg_mutex);
+    }
+}
 
-        if (file_size + bytes_to_write > AD2_SD_LOG_MAX_BYTES) {
-            fclose(log_file);
-            log_file = NULL;
-            remove(AD2_SD_LOG_OLD_PATH);
-            if (rename(AD2_SD_LOG_PATH, AD2_SD_LOG_OLD_PATH) != 0) {
-                taskENTER_CRITICAL(&spinlock);
-                _ad2_sd_log_write_errors++;
-                taskEXIT_CRITICAL(&spinlock);
-                log_file = fopen(AD2_SD_LOG_PATH, "a");
-                if (!log_file) {
-                    taskENTER_CRITICAL(&spinlock);
-                    _ad2_sd_log_write_errors++;
-                    taskEXIT_CRITICAL(&spinlock);
-                }
-                continue;
-            }
-            log_file = fopen(AD2_SD_LOG_PATH, "w");
-            file_size = 0;
-            if (!log_file) {
-                taskENTER_CRITICAL(&spinlock);
-                _ad2_sd_log_write_errors++;
-                taskEXIT_CRITICAL(&spinlock);
-                continue;
-            }
-        }
+/**
+ * @brief Pool string at offset.
+ */
+static inline const char *_ad2_config_str(uint32_t offset)
+{
+    return &_ad2cfg_pool[offset];
+}
+
+/**
+ * @brief Append a string to the pool without interning.
+ *
+ * @return uint32_t pool offset.
+ */
+static uint32_t _ad2_config_pool_add(const char *str, size_t len)
+{
+    uint32_t offset = _ad2cfg_pool.size();
+    _ad2cfg_pool.insert(_ad2cfg_pool.end(), str, str + len);
+    _ad2cfg_pool.push_back('\0');
+    return offset;
+}
 
-        size_t written = fwrite(line, 1, bytes_to_write, log_file);
-        if (written != bytes_to_write || fflush(log_file) != 0) {
-            taskENTER_CRITICAL(&spinlock);
-            _ad2_sd_log_write_errors++;
-            taskEXIT_CRITICAL(&spinlock);
+/**
+ * @brief Case insensitive section/key order. Matches SimpleIni key lookup.
+ */
+static int _ad2_config_key_cmp(const char *s1, const char *k1, const char *s2, const char *k2)
+{
+    int r = strcasecmp(s1, s2);
+    return r ? r : strcasecmp(k1, k2);
+}
+
+/**
+ * @brief Binary search the index for the first entry not less than section/key.
+ *
+ * @param [out]found true if the entry at the returned index matches.
+ *
+ * @return size_t index into _ad2cfg_entries.
+ */
+static size_t _ad2_config_lower_bound(const char *section, const char *key, bool *found)
+{
+    size_t lo = 0, hi = _ad2cfg_entries.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        ad2_config_entry &e = _ad2cfg_entries[mid];
+        if (_ad2_config_key_cmp(_ad2_config_str(e.section), _ad2_config_str(e.key), section, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
-        file_size += written;
     }
+    *found = lo < _ad2cfg_entries.size() &&
+             _ad2_config_key_cmp(_ad2_config_str(_ad2cfg_entries[lo].section),
+                                 _ad2_config_str(_ad2cfg_entries[lo].key), section, key) == 0;
+    return lo;
 }
 
-static bool _ad2_start_sd_log_task()
+/**
+ * @brief Look up a config value. Caller must hold the config lock and copy
+ * the result before releasing it.
+ *
+ * @return const char * value or NULL if not found.
+ */
+static const char *_ad2_config_get_value(const char *section, const char *key)
 {
-    if (_ad2_sd_log_task_started) {
-        return true;
+    if (!section || !key) {
+        return NULL;
     }
-    if (!g_uSD_mounted) {
-        return false;
+    bool found;
+    size_t i = _ad2_config_lower_bound(section, key, &found);
+    return found ? _ad2_config_str(_ad2cfg_entries[i].value) : NULL;
+}
+
+static void _ad2_config_compact();
+
+/**
+ * @brief Set or remove a config value.
+ *
+ * @details Strings are shared after interning so a replaced value can not be
+ * overwritten in place. The dead bytes are counted and the pool is compacted
+ * once they pass AD2_CONFIG_POOL_SLACK and a quarter of the pool.
+ *
+ * @param [in]value new value or NULL to remove the key.
+ */
+static void _ad2_config_set_value(const char *section, const char *key, const char *value)
+{
+    bool found;
+    size_t i = _ad2_config_lower_bound(section, key, &found);
+    if (!value) {
+        if (found) {
+            _ad2cfg_garbage += strlen(_ad2_config_str(_ad2cfg_entries[i].key)) + 1 +
+                               strlen(_ad2_config_str(_ad2cfg_entries[i].value)) + 1;
+            _ad2cfg_entries.erase(_ad2cfg_entries.begin() + i);
+            _ad2_config_compact();
+        }
+        return;
     }
-    if (!_ad2_sd_log_queue) {
-        _ad2_sd_log_queue = xQueueCreate(AD2_SD_LOG_QUEUE_SIZE, sizeof(ad2_log_entry));
-        if (!_ad2_sd_log_queue) {
-            return false;
+    if (found) {
+        const char *old = _ad2_config_str(_ad2cfg_entries[i].value);
+        if (strcmp(old, value) != 0) {
+            _ad2cfg_garbage += strlen(old) + 1;
+            _ad2cfg_entries[i].value = _ad2_config_pool_add(value, strlen(value));
+            _ad2_config_compact();
         }
+        return;
     }
-    if (xTaskCreate(_ad2_sd_log_task, "AD2 SD log", 1024 * 4, NULL,
-                    tskIDLE_PRIORITY + 1, NULL) != pdPASS) {
-        vQueueDelete(_ad2_sd_log_queue);
-        _ad2_sd_log_queue = NULL;
-        return false;
+
+    // Share the section name with a neighbour when the section already exists.
+    ad2_config_entry e;
+    if (i > 0 && strcasecmp(_ad2_config_str(_ad2cfg_entries[i - 1].section), section) == 0) {
+        e.section = _ad2cfg_entries[i - 1].section;
+    } else if (i < _ad2cfg_entries.size() && strcasecmp(_ad2_config_str(_ad2cfg_entries[i].section), section) == 0) {
+        e.section = _ad2cfg_entries[i].section;
+    } else {
+        e.section = _ad2_config_pool_add(section, strlen(section));
     }
-    _ad2_sd_log_task_started = true;
-    return true;
+    e.key = _ad2_config_pool_add(key, strlen(key));
+    e.value = _ad2_config_pool_add(value, strlen(value));
+    _ad2cfg_entries.insert(_ad2cfg_entries.begin() + i, e);
 }
 
-static void ad2_capture_log_line(const char *text)
+/**
+ * @brief Transient intern table used while loading so repeated section
+ * names, keys and values share one copy in the pool.
+ */
+class ad2_config_interner
 {
-    if (!text || !text[0]) {
-        return;
+public:
+    ad2_config_interner() : used(0), requested(0)
+    {
+        slots.resize(256, 0);
     }
-    ad2_log_entry entry = {};
-    entry.uptime_ms = hal_uptime_us() / 1000;
-    strlcpy(entry.text, text, sizeof(entry.text));
-    entry.text[strcspn(entry.text, "\r\n")] = '\0';
-    taskENTER_CRITICAL(&spinlock);
-    _ad2_log_history[_ad2_log_history_head] = entry;
-    _ad2_log_history_head = (_ad2_log_history_head + 1) % AD2_LOG_HISTORY_SIZE;
-    if (_ad2_log_history_count < AD2_LOG_HISTORY_SIZE) {
-        _ad2_log_history_count++;
+
+    uint32_t add(const char *str, size_t len)
+    {
+        requested += len + 1;
+        if ((used + 1) * 4 > slots.size() * 3) {
+            grow();
+        }
+        uint32_t h = _hash(str, len);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            if (!slots[i]) {
+                uint32_t offset = _ad2_config_pool_add(str, len);
+                slots[i] = offset + 1;
+                used++;
+                return offset;
+            }
+            const char *s = _ad2_config_str(slots[i] - 1);
+            if (strncmp(s, str, len) == 0 && s[len] == '\0') {
+                return slots[i] - 1;
+            }
+        }
     }
-    taskEXIT_CRITICAL(&spinlock);
 
-    if (_ad2_sd_log_enabled && _ad2_sd_log_queue &&
-            xQueueSend(_ad2_sd_log_queue, &entry, 0) != pdPASS) {
-        taskENTER_CRITICAL(&spinlock);
-        _ad2_sd_log_dropped++;
-        taskEXIT_CRITICAL(&spinlock);
+    // bytes that would have been stored without interning.
+    size_t requested_bytes()
+    {
+        return requested;
     }
-}
 
-cJSON *ad2_get_recent_logs_json(size_t limit)
-{
-    cJSON *items = cJSON_CreateArray();
-    size_t count;
-    size_t head;
-    taskENTER_CRITICAL(&spinlock);
-    count = _ad2_log_history_count;
-    head = _ad2_log_history_head;
-    taskEXIT_CRITICAL(&spinlock);
+private:
+    std::vector<uint32_t> slots;
+    size_t used;
+    size_t requested;
 
-    limit = std::min(limit, count);
-    for (size_t offset = 0; offset < limit; offset++) {
-        const size_t index = (head + AD2_LOG_HISTORY_SIZE - 1 - offset) % AD2_LOG_HISTORY_SIZE;
-        ad2_log_entry entry;
-        taskENTER_CRITICAL(&spinlock);
-        entry = _ad2_log_history[index];
-        taskEXIT_CRITICAL(&spinlock);
-        cJSON *item = cJSON_CreateObject();
-        cJSON_AddNumberToObject(item, "uptime_ms", (double)entry.uptime_ms);
-        cJSON_AddStringToObject(item, "text", entry.text);
-        cJSON_AddItemToArray(items, item);
+    static uint32_t _hash(const char *str, size_t len)
+    {
+        uint32_t h = 2166136261UL;
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ (uint8_t)str[i]) * 16777619UL;
+        }
+        return h;
+    }
+
+    void grow()
+    {
+        std::vector<uint32_t> old;
+        old.swap(slots);
+        slots.resize(old.size() * 2, 0);
+        size_t mask = slots.size() - 1;
+        for (uint32_t v : old) {
+            if (v) {
+                const char *s = _ad2_config_str(v - 1);
+                size_t i = _hash(s, strlen(s)) & mask;
+                while (slots[i]) {
+                    i = (i + 1) & mask;
+                }
+                slots[i] = v;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Sort the index and drop duplicate keys keeping the last one seen,
+ * the same result SimpleIni gives when a key repeats.
+ */
+static void _ad2_config_finish_index()
+{
+    std::stable_sort(_ad2cfg_entries.begin(), _ad2cfg_entries.end(),
+    [](const ad2_config_entry & a, const ad2_config_entry & b) {
+        return _ad2_config_key_cmp(_ad2_config_str(a.section), _ad2_config_str(a.key),
+                                   _ad2_config_str(b.section), _ad2_config_str(b.key)) < 0;
+    });
+    size_t out = 0;
+    for (size_t i = 0; i < _ad2cfg_entries.size(); i++) {
+        if (i + 1 < _ad2cfg_entries.size() &&
+                _ad2_config_key_cmp(_ad2_config_str(_ad2cfg_entries[i].section), _ad2_config_str(_ad2cfg_entries[i].key),
+                                    _ad2_config_str(_ad2cfg_entries[i + 1].section), _ad2_config_str(_ad2cfg_entries[i + 1].key)) == 0) {
+            continue;
+        }
+        _ad2cfg_entries[out++] = _ad2cfg_entries[i];
     }
-    return items;
+    _ad2cfg_entries.resize(out);
+    _ad2cfg_entries.shrink_to_fit();
+    _ad2cfg_pool.shrink_to_fit();
 }
 
-size_t ad2_print_recent_logs(size_t limit)
+/**
+ * @brief Copy the strings still referenced by the index into a new pool
+ * when enough of the current one is dead. Caller must hold the config lock.
+ */
+static void _ad2_config_compact()
 {
-    size_t count;
-    size_t head;
-    taskENTER_CRITICAL(&spinlock);
-    count = _ad2_log_history_count;
-    head = _ad2_log_history_head;
-    taskEXIT_CRITICAL(&spinlock);
-
-    limit = std::min(limit, count);
-    const size_t first = (head + AD2_LOG_HISTORY_SIZE - limit) % AD2_LOG_HISTORY_SIZE;
-    for (size_t offset = 0; offset < limit; offset++) {
-        ad2_log_entry entry;
-        const size_t index = (first + offset) % AD2_LOG_HISTORY_SIZE;
-        taskENTER_CRITICAL(&spinlock);
-        entry = _ad2_log_history[index];
-        taskEXIT_CRITICAL(&spinlock);
-        std::string line = ad2_string_printf("[%llu ms] %s\r\n",
-                                             (unsigned long long)entry.uptime_ms,
-                                             entry.text);
-        cli_write_bytes(line.c_str(), line.length());
+    if (_ad2cfg_garbage < AD2_CONFIG_POOL_SLACK || _ad2cfg_garbage * 4 < _ad2cfg_pool.size()) {
+        return;
+    }
+    std::vector<char> old_pool;
+    old_pool.swap(_ad2cfg_pool);
+    ad2_config_interner strtab;
+    for (ad2_config_entry &e : _ad2cfg_entries) {
+        const char *p = &old_pool[e.section];
+        e.section = strtab.add(p, strlen(p));
+        p = &old_pool[e.key];
+        e.key = strtab.add(p, strlen(p));
+        p = &old_pool[e.value];
+        e.value = strtab.add(p, strlen(p));
     }
-    return limit;
+    _ad2cfg_pool.shrink_to_fit();
+    _ad2cfg_garbage = 0;
 }
 
-void ad2_init_sd_logging()
+/**
+ * @brief Strip leading and trailing white space in place.
+ */
+static char *_ad2_config_trim(char *p)
 {
-    bool enabled = false;
-    ad2_get_config_key_bool(CFG_SECTION_MAIN, SDLOG_CONFIG_KEY, &enabled);
-    ad2_set_sd_logging_enabled(enabled);
+    while (*p && isspace((unsigned char)*p)) {
+        p++;
+    }
+    char *e = p + strlen(p);
+    while (e > p && isspace((unsigned char)e[-1])) {
+        *--e = '\0';
+    }
+    return p;
 }
 
-bool ad2_set_sd_logging_enabled(bool enabled)
+/**
+ * @brief Stream an ini file line by line into the config store.
+ *
+ * @details Uses one fixed line buffer. Follows the SimpleIni rules this
+ * project relies on: ';' and '#' comments, [section] headers, trimmed
+ * key = value pairs, last duplicate key wins and <<<TAG multi line values.
+ *
+ * @param [in]path ini file.
+ * @param [out]requested bytes the strings would need without interning.
+ *
+ * @return bool true if the file was read.
+ */
+static bool _ad2_config_parse_file(const char *path, size_t *requested)
 {
-    _ad2_sd_log_enabled = enabled;
-    if (enabled && !_ad2_start_sd_log_task()) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    char *line = (char *)malloc(AD2_CONFIG_LINE_SIZE);
+    if (!line) {
+        fclose(f);
+        errno = ENOMEM;
         return false;
     }
+
+    _ad2cfg_pool.clear();
+    _ad2cfg_entries.clear();
+    _ad2cfg_garbage = 0;
+    ad2_config_interner strtab;
+    uint32_t section = strtab.add("", 0);
+    uint32_t ml_key = 0;
+    std::string ml_tag;
+    std::string ml_value;
+    bool first = true;
+    int truncated = 0;
+
+    while (fgets(line, AD2_CONFIG_LINE_SIZE, f)) {
+        size_t len = strlen(line);
+        if (len && line[len - 1] != '\n' && !feof(f)) {
+            // over long line. keep what fits and skip the rest.
+            int c;
+            while ((c = fgetc(f)) != EOF && c != '\n') {
+            }
+            truncated++;
+        }
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        char *p = line;
+        if (first) {
+            first = false;
+            if (strncmp(p, "\xEF\xBB\xBF", 3) == 0) {
+                p += 3;
+            }
+        }
+
+        // collecting a multi line value until its end tag.
+        if (ml_tag.length()) {
+            if (ml_tag == p) {
+                _ad2cfg_entries.push_back({section, ml_key, strtab.add(ml_value.c_str(), ml_value.length())});
+                ml_tag.clear();
+                ml_value.clear();
+            } else {
+                if (ml_value.length()) {
+                    ml_value += '\n';
+                }
+                ml_value += p;
+            }
+            continue;
+        }
+
+        p = _ad2_config_trim(p);
+        if (!*p || *p == ';' || *p == '#') {
+            continue;
+        }
+        if (*p == '[') {
+            char *e = strchr(p, ']');
+            if (e) {
+                *e = '\0';
+                char *name = _ad2_config_trim(p + 1);
+                section = strtab.add(name, strlen(name));
+            }
+            continue;
+        }
+        char *eq = strchr(p, '=');
+        if (!eq) {
+            continue;
+        }
+        *eq = '\0';
+        char *key = _ad2_config_trim(p);
+        char *value = _ad2_config_trim(eq + 1);
+        if (!*key) {
+            continue;
+        }
+        if (strncmp(value, "<<<", 3) == 0 && value[3]) {
+            ml_key = strtab.add(key, strlen(key));
+            ml_tag = value + 3;
+            continue;
+        }
+        _ad2cfg_entries.push_back({section, strtab.add(key, strlen(key)), strtab.add(value, strlen(value))});
+    }
+    free(line);
+    fclose(f);
+
+    if (truncated) {
+        ESP_LOGW(TAG, "%s: %i line(s) longer than %i bytes were truncated in '%s'.", __func__, truncated, AD2_CONFIG_LINE_SIZE, path);
+    }
+    *requested = strtab.requested_bytes();
+    _ad2_config_finish_index();
     return true;
 }
 
-void ad2_get_sd_logging_status(bool *enabled, bool *active,
-                               uint32_t *dropped, uint32_t *write_errors)
+/**
+ * @brief Load and validate the SPIFFS config image against the source ini.
+ *
+ * @return bool true if the image matches and is now the active store.
+ */
+static bool _ad2_config_load_image(uint32_t ini_hash, uint32_t ini_size, uint16_t flags)
 {
-    taskENTER_CRITICAL(&spinlock);
-    if (enabled) {
-        *enabled = _ad2_sd_log_enabled;
+    FILE *f = fopen("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_CACHE_FILE, "r");
+    if (!f) {
+        return false;
+    }
+    ad2_config_image_header hdr;
+    bool ok = fread(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) &&
+              hdr.magic == AD2_CONFIG_CACHE_MAGIC &&
+              hdr.schema == AD2_CONFIG_CACHE_SCHEMA &&
+              hdr.flags == flags &&
+              hdr.ini_hash == ini_hash &&
+              hdr.ini_size == ini_size &&
+              hdr.entry_count < 0x10000 &&
+              hdr.strings_size > 0 && hdr.strings_size < 0x100000;
+    if (ok) {
+        _ad2cfg_entries.resize(hdr.entry_count);
+        _ad2cfg_pool.resize(hdr.strings_size);
+        _ad2cfg_garbage = 0;
+        size_t entries_size = hdr.entry_count * sizeof(ad2_config_entry);
+        ok = fread(_ad2cfg_entries.data(), 1, entries_size, f) == entries_size &&
+             fread(_ad2cfg_pool.data(), 1, hdr.strings_size, f) == hdr.strings_size;
+        if (ok) {
+            uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)_ad2cfg_entries.data(), entries_size);
+            crc = esp_rom_crc32_le(crc, (const uint8_t *)_ad2cfg_pool.data(), hdr.strings_size);
+            ok = crc == hdr.crc && _ad2cfg_pool.back() == '\0';
+        }
+        // every offset must land inside the terminated string pool.
+        for (uint32_t i = 0; ok && i < hdr.entry_count; i++) {
+            ok = _ad2cfg_entries[i].section < hdr.strings_size &&
+                 _ad2cfg_entries[i].key < hdr.strings_size &&
+                 _ad2cfg_entries[i].value < hdr.strings_size;
+        }
     }
-    if (active) {
-        *active = _ad2_sd_log_enabled && _ad2_sd_log_task_started && g_uSD_mounted;
+    fclose(f);
+    if (!ok) {
+        _ad2cfg_entries.clear();
+        _ad2cfg_pool.clear();
     }
-    if (dropped) {
-        *dropped = _ad2_sd_log_dropped;
+    return ok;
+}
+
+/**
+ * @brief Save the config store as the SPIFFS config image for an ini.
+ */
+static void _ad2_config_write_image(uint32_t ini_hash, uint32_t ini_size, uint16_t flags)
+{
+    ad2_config_image_header hdr;
+    size_t entries_size = _ad2cfg_entries.size() * sizeof(ad2_config_entry);
+    hdr.magic = AD2_CONFIG_CACHE_MAGIC;
+    hdr.schema = AD2_CONFIG_CACHE_SCHEMA;
+    hdr.flags = flags;
+    hdr.ini_hash = ini_hash;
+    hdr.ini_size = ini_size;
+    hdr.entry_count = _ad2cfg_entries.size();
+    hdr.strings_size = _ad2cfg_pool.size();
+    hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)_ad2cfg_entries.data(), entries_size);
+    hdr.crc = esp_rom_crc32_le(hdr.crc, (const uint8_t *)_ad2cfg_pool.data(), _ad2cfg_pool.size());
+
+    FILE *f = fopen("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_CACHE_FILE, "w");
+    if (!f) {
+        ESP_LOGW(TAG, "%s: unable to write config cache.", __func__);
+        return;
     }
-    if (write_errors) {
-        *write_errors = _ad2_sd_log_write_errors;
+    bool ok = fwrite(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) &&
+              fwrite(_ad2cfg_entries.data(), 1, entries_size, f) == entries_size &&
+              fwrite(_ad2cfg_pool.data(), 1, _ad2cfg_pool.size(), f) == _ad2cfg_pool.size();
+    fclose(f);
+    if (!ok) {
+        ESP_LOGW(TAG, "%s: unable to write config cache.", __func__);
+        unlink("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_CACHE_FILE);
     }
-    taskEXIT_CRITICAL(&spinlock);
 }
 
 /**
- * @brief  ini file error string helper
+ * @brief Remember a section changed so reload subscribers get told.
+ */
+static void _ad2_config_mark_changed(const char *section)
+{
+    std::string name = section;
+    ad2_lcase(name);
+    if (std::find(_ad2cfg_changed_sections.begin(), _ad2cfg_changed_sections.end(), name) ==
+            _ad2cfg_changed_sections.end()) {
+        _ad2cfg_changed_sections.push_back(name);
+    }
+}
+
+/**
+ * @brief Mark every section that differs between two config stores.
  *
+ * @details Both indexes are sorted the same way so a single merge walk
+ * finds added, removed and changed keys.
  */
-const char * _ini_file_error(SI_Error e)
+static void _ad2_config_diff(const std::vector<char> &old_pool, const std::vector<ad2_config_entry> &old_entries)
+{
+    size_t i = 0, j = 0;
+    while (i < old_entries.size() || j < _ad2cfg_entries.size()) {
+        const char *os = nullptr, *ok = nullptr, *ns = nullptr, *nk = nullptr;
+        if (i < old_entries.size()) {
+            os = &old_pool[old_entries[i].section];
+            ok = &old_pool[old_entries[i].key];
+        }
+        if (j < _ad2cfg_entries.size()) {
+            ns = _ad2_config_str(_ad2cfg_entries[j].section);
+            nk = _ad2_config_str(_ad2cfg_entries[j].key);
+        }
+        int r = !os ? 1 : !ns ? -1 : _ad2_config_key_cmp(os, ok, ns, nk);
+        if (r < 0) {
+            _ad2_config_mark_changed(os);
+            i++;
+        } else if (r > 0) {
+            _ad2_config_mark_changed(ns);
+            j++;
+        } else {
+            if (strcmp(&old_pool[old_entries[i].value], _ad2_config_str(_ad2cfg_entries[j].value)) != 0) {
+                _ad2_config_mark_changed(ns);
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+/**
+ * @brief Test if a changed section belongs to a subscribed section family.
+ *   "switch" matches "switch" and "switch 12".
+ */
+static bool _ad2_config_section_match(const std::string &subscribed, const std::string &changed)
 {
-    if (e == SI_NOMEM) {
-        return "out of memory.";
+    if (changed.compare(0, subscribed.length(), subscribed) != 0) {
+        return false;
+    }
+    return changed.length() == subscribed.length() || changed[subscribed.length()] == ' ';
+}
+
+/**
+ * @brief Rewrite the active ini from the config store.
+ *
+ * @details The existing file is loaded into a temporary SimpleIni DOM so
+ * comments and ordering survive, keys no longer in the store are removed,
+ * changed values applied and the file saved. The DOM is released before
+ * returning and the config image rebuilt for the new file.
+ *
+ * @return bool true on success.
+ */
+static bool _ad2_config_save()
+{
+    const char *path = _ad2_config_ini_path();
+    SI_Error rc;
+    {
+        CSimpleIniA ini;
+        ini.SetUnicode();
+        ini.SetMultiLine();
+        // a missing file is fine. Everything comes from the store.
+        ini.LoadFile(path);
+
+        std::vector<std::pair<std::string, std::string>> removed;
+        CSimpleIniA::TNamesDepend sections;
+        ini.GetAllSections(sections);
+        for (auto &sec : sections) {
+            CSimpleIniA::TNamesDepend keys;
+            ini.GetAllKeys(sec.pItem, keys);
+            for (auto &key : keys) {
+                if (!_ad2_config_get_value(sec.pItem, key.pItem)) {
+                    removed.push_back(std::make_pair(sec.pItem, key.pItem));
+                }
+            }
+        }
+        for (auto &sk : removed) {
+            ini.Delete(sk.first.c_str(), sk.second.c_str(), false);
+        }
+        for (auto &e : _ad2cfg_entries) {
+            ini.SetValue(_ad2_config_str(e.section), _ad2_config_str(e.key), _ad2_config_str(e.value));
+        }
+        rc = ini.SaveFile(path);
+    }
+    if (rc < 0) {
+        ESP_LOGE(TAG, "%s: Error (%i) ini saveFile.", __func__, rc);
+        return false;
+    }
+
+    uint32_t ini_hash, ini_size;
+    if (_ad2_config_hash_file(path, &ini_hash, &ini_size)) {
+        _ad2_config_write_image(ini_hash, ini_size, _uSD_config ? AD2_CONFIG_CACHE_FLAG_SD : 0);
     }
-    return (const char *)strerror(errno);
+    return true;
 }
 
 /**
@@ -306,51 +735,71 @@ const char * _ini_file_error(SI_Error e)
  */
 void ad2_save_persistent_config()
 {
+    _ad2_config_lock();
     if (!_config_autosave && _config_dirty) {
-        SI_Error rc;
-        if (_uSD_config) {
-            rc = _ad2ini.SaveFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
-        } else {
-            rc = _ad2ini.SaveFile("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_FILE);
-        }
-        if (rc < 0) {
-            ESP_LOGE(TAG, "%s: Error (%i) ini saveFile.", __func__, rc);
-        } else {
+        if (_ad2_config_save()) {
             _config_dirty = false;
         }
     }
+    _ad2_config_unlock();
 }
 
 /**
  * @brief  ad2_load_persistent_config
  *
+ * @details Use the SPIFFS config image when its hash matches the active ini
+ * and only stream parse the ini when it has changed. Either way the result
+ * is the compact config store; no SimpleIni DOM stays resident.
  */
 void ad2_load_persistent_config()
 {
-    // Set config storage format to UTF-8.
-    _ad2ini.SetUnicode();
+    if (!_ad2cfg_mutex) {
+        _ad2cfg_mutex = xSemaphoreCreateRecursiveMutex();
+    }
+    _ad2_config_lock();
+
+    uint64_t start_us = hal_uptime_us();
+
+    // uSD config overrides SPIFFS when present.
+    uint32_t ini_hash = 0;
+    uint32_t ini_size = 0;
+    bool have_source = false;
+    if (_ad2_config_hash_file("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE, &ini_hash, &ini_size)) {
+        _uSD_config = true;
+        have_source = true;
+    } else {
+        have_source = _ad2_config_hash_file("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_FILE, &ini_hash, &ini_size);
+    }
+    uint16_t flags = _uSD_config ? AD2_CONFIG_CACHE_FLAG_SD : 0;
 
-    // Enable multi line values.
-    _ad2ini.SetMultiLine();
+    if (have_source && _ad2_config_load_image(ini_hash, ini_size, flags)) {
+        ad2_printf_host(true, "%s: Loaded config cache for %s in %llu ms. %d keys %d B strings %d B index.", TAG,
+                        _ad2_config_ini_path(), (hal_uptime_us() - start_us) / 1000, _ad2cfg_entries.size(),
+                        _ad2cfg_pool.size(), _ad2cfg_entries.size() * sizeof(ad2_config_entry));
+        _ad2_config_unlock();
+        return;
+    }
+    _uSD_config = false;
 
     // See if a config exists on the uSD card and use if found.
+    size_t requested = 0;
     ad2_printf_host(true, "%s: Attempting to load config file: " AD2_USD_MOUNT_POINT AD2_CONFIG_FILE, TAG);
-    SI_Error rc = _ad2ini.LoadFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
+    bool ok = _ad2_config_parse_file("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE, &requested);
 
-    if (rc < 0) {
+    if (!ok) {
         // USD config load failed show why.
         ad2_printf_host( false, " failed(");
-        ad2_printf_host( false, _ini_file_error(rc));
+        ad2_printf_host( false, strerror(errno));
         ad2_printf_host( false, ")");
 
         // See if a config exists on the SPIFFS and use if found.
         ad2_printf_host(true, "%s: Attempting to load config file: " AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_FILE, TAG);
         // load from internal SPIFFS storage
-        rc = _ad2ini.LoadFile("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_FILE);
-        if (rc < 0) {
+        ok = _ad2_config_parse_file("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_FILE, &requested);
+        if (!ok) {
             // USD config load failed show why.
             ad2_printf_host( false, " failed(");
-            ad2_printf_host( false, _ini_file_error(rc));
+            ad2_printf_host( false, strerror(errno));
             ad2_printf_host( false, ")");
 
             // last option create a new one with factory reset and reboot.
@@ -363,6 +812,121 @@ void ad2_load_persistent_config()
         ad2_printf_host(false, " success.");
         _uSD_config = true;
     }
+    if (ok) {
+        ad2_printf_host(true, "%s: Parsed ini in %llu ms. %d keys %d B strings (%d B before interning) %d B index.", TAG,
+                        (hal_uptime_us() - start_us) / 1000, _ad2cfg_entries.size(), _ad2cfg_pool.size(),
+                        requested, _ad2cfg_entries.size() * sizeof(ad2_config_entry));
+
+        // Compile the image for the next boot.
+        flags = _uSD_config ? AD2_CONFIG_CACHE_FLAG_SD : 0;
+        if (_ad2_config_hash_file(_ad2_config_ini_path(), &ini_hash, &ini_size)) {
+            _ad2_config_write_image(ini_hash, ini_size, flags);
+        }
+    }
+    _ad2_config_unlock();
+}
+
+/**
+ * @brief Subscribe to config changes applied by ad2_reload_persistent_config.
+ *
+ * @details fn is called at most once per reload with every changed
+ * section that matches any name in the list.
+ *
+ * @param [in]section comma separated section names or section families
+ * like "switch".
+ * @param [in]fn callback given the list of changed sections that match.
+ * @param [in]arg user argument passed to fn.
+ */
+void ad2_config_subscribe(const char *section, ad2_config_change_cb_t fn, void *arg)
+{
+    ad2_config_subscriber sub;
+    std::string list = section;
+    ad2_lcase(list);
+    ad2_tokenize(list, ",", sub.sections);
+    for (auto &name : sub.sections) {
+        ad2_trim(name);
+    }
+    sub.fn = fn;
+    sub.arg = arg;
+    _ad2_config_lock();
+    _ad2cfg_subscribers.push_back(sub);
+    _ad2_config_unlock();
+}
+
+/**
+ * @brief Apply configuration changes without a restart.
+ *
+ * @details Pending CLI changes are saved, then the active ini is read again
+ * and compared with the running config section by section. Subscribers
+ * are only called for sections that changed. Callbacks run with the parser
+ * lock held so components can rebuild their AD2EventSearch subscriptions
+ * between messages while events keep flowing.
+ *
+ * @return int number of changed sections or -1 on error.
+ */
+int ad2_reload_persistent_config()
+{
+    uint64_t start_us = hal_uptime_us();
+    _ad2_config_lock();
+
+    // Persist pending changes so the ini we read back includes them.
+    if (_config_dirty && _ad2_config_save()) {
+        _config_dirty = false;
+    }
+    if (_config_dirty) {
+        _ad2_config_unlock();
+        return -1;
+    }
+
+    std::vector<char> old_pool;
+    std::vector<ad2_config_entry> old_entries;
+    old_pool.swap(_ad2cfg_pool);
+    old_entries.swap(_ad2cfg_entries);
+    size_t requested = 0;
+    if (!_ad2_config_parse_file(_ad2_config_ini_path(), &requested)) {
+        ESP_LOGE(TAG, "%s: unable to read '%s' keeping running config.", __func__, _ad2_config_ini_path());
+        old_pool.swap(_ad2cfg_pool);
+        old_entries.swap(_ad2cfg_entries);
+        _ad2_config_unlock();
+        return -1;
+    }
+    _ad2_config_diff(old_pool, old_entries);
+    std::vector<char>().swap(old_pool);
+    std::vector<ad2_config_entry>().swap(old_entries);
+
+    uint32_t ini_hash, ini_size;
+    if (_ad2_config_hash_file(_ad2_config_ini_path(), &ini_hash, &ini_size)) {
+        _ad2_config_write_image(ini_hash, ini_size, _uSD_config ? AD2_CONFIG_CACHE_FLAG_SD : 0);
+    }
+
+    std::vector<std::string> changed;
+    changed.swap(_ad2cfg_changed_sections);
+    std::vector<ad2_config_subscriber> subscribers = _ad2cfg_subscribers;
+    _ad2_config_unlock();
+
+    // Notify only the subscribers that own a changed section.
+    int notified = 0;
+    xSemaphoreTake(g_ad2_parser_mutex, portMAX_DELAY);
+    for (auto &sub : subscribers) {
+        std::vector<std::string> sections;
+        for (auto &name : changed) {
+            for (auto &subscribed : sub.sections) {
+                if (_ad2_config_section_match(subscribed, name)) {
+                    sections.push_back(name);
+                    break;
+                }
+            }
+        }
+        if (sections.size()) {
+            sub.fn(sections, sub.arg);
+            notified++;
+        }
+    }
+    xSemaphoreGive(g_ad2_parser_mutex);
+
+    ad2_printf_host(true, "%s: Config reload applied %d changed section(s) to %d subscriber(s) in %llu ms.", TAG,
+                    (int)changed.size(), notified, (hal_uptime_us() - start_us) / 1000);
+    return (int)changed.size();
 }
 
 /**
@@ -382,6 +946,15 @@ void ad2_load_persistent_config()
  *                       -2 ad2_acl_check.ACL_ERR_BADFORMAT_IP
  */
 int ad2_acl_check::add(std::string &acl)
+{
+    int res = _add_tokens(acl);
+    // The tables follow allowed_networks even if a later token failed.
+    _compile();
+    return res;
+}
+
+// @brief parse ACL tokens into allowed_networks.
+int ad2_acl_check::_add_tokens(std::string &acl)
 {
     bool is_ipv4;
 
@@ -447,8 +1020,10 @@ int ad2_acl_check::add(std::string &acl)
                 if (!this->_szIPaddrParse(szend, eaddr, is_ipv4)) {
                     return this->ACL_ERR_BADFORMAT_IP;
                 }
-                // Currently start needs to be less than end.
-                // FIXME if (saddr <= eaddr) {
+                // Accept the range in either order.
+                if (memcmp(saddr.u8_addr, eaddr.u8_addr, sizeof(saddr.u8_addr)) > 0) {
+                    std::swap(saddr, eaddr);
+                }
                 allowed_networks.push_back({saddr, eaddr});
             } else {
 
@@ -464,6 +1039,105 @@ int ad2_acl_check::add(std::string &acl)
     return this->ACL_FORMAT_OK;
 }
 
+// @brief load a big endian 64 bit word.
+static uint64_t _acl_be64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int n = 0; n < 8; n++) {
+        v = (v << 8) | p[n];
+    }
+    return v;
+}
+
+// @brief IPv4 lives in the last 32 bits with the upper 96 bits set.
+static bool _acl_is_v4(const uint8_t *p)
+{
+    for (int n = 0; n < 12; n++) {
+        if (p[n] != 0xff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Compile allowed_networks into sorted and merged interval tables.
+ *
+ * @details Overlapping and adjacent ranges are merged so a lookup is one
+ * binary search. The part of any range that covers the IPv4 block is also
+ * copied to the 32 bit IPv4 table so IPv4 peers never need 128 bit math.
+ */
+void ad2_acl_check::_compile()
+{
+    const addr128 v4_lo = { UINT64_MAX, 0xffffffff00000000ULL };
+    const addr128 v4_hi = { UINT64_MAX, UINT64_MAX };
+
+    acl_v4.clear();
+    acl_v6.clear();
+    for (auto &net : allowed_networks) {
+        addr128 start = { _acl_be64(&net.first.u8_addr[0]), _acl_be64(&net.first.u8_addr[8]) };
+        addr128 end = { _acl_be64(&net.second.u8_addr[0]), _acl_be64(&net.second.u8_addr[8]) };
+        acl_v6.push_back({start, end});
+        if (!(end < v4_lo) && !(v4_hi < start)) {
+            acl_v4.push_back({ start < v4_lo ? 0 : (uint32_t)start.lo, (uint32_t)end.lo });
+        }
+    }
+
+    std::sort(acl_v4.begin(), acl_v4.end());
+    size_t out = 0;
+    for (size_t n = 0; n < acl_v4.size(); n++) {
+        if (out && (acl_v4[out - 1].second == UINT32_MAX || acl_v4[n].first <= acl_v4[out - 1].second + 1)) {
+            acl_v4[out - 1].second = std::max(acl_v4[out - 1].second, acl_v4[n].second);
+        } else {
+            acl_v4[out++] = acl_v4[n];
+        }
+    }
+    acl_v4.resize(out);
+    acl_v4.shrink_to_fit();
+
+    std::sort(acl_v6.begin(), acl_v6.end());
+    out = 0;
+    for (size_t n = 0; n < acl_v6.size(); n++) {
+        if (out) {
+            addr128 &last = acl_v6[out - 1].second;
+            addr128 next = last;
+            if (++next.lo == 0) {
+                next.hi++;
+            }
+            bool touches = (last.hi == UINT64_MAX && last.lo == UINT64_MAX) || !(next < acl_v6[n].first);
+            if (touches) {
+                if (last < acl_v6[n].second) {
+                    last = acl_v6[n].second;
+                }
+                continue;
+            }
+        }
+        acl_v6[out++] = acl_v6[n];
+    }
+    acl_v6.resize(out);
+    acl_v6.shrink_to_fit();
+}
+
+// @brief binary search the merged IPv4 table.
+bool ad2_acl_check::_find_v4(uint32_t addr)
+{
+    auto it = std::upper_bound(acl_v4.begin(), acl_v4.end(), addr,
+    [](uint32_t a, const pair<uint32_t,uint32_t> &r) {
+        return a < r.first;
+    });
+    return it != acl_v4.begin() && addr <= (it - 1)->second;
+}
+
+// @brief binary search the merged IPv6 table.
+bool ad2_acl_check::_find_v6(const addr128 &addr)
+{
+    auto it = std::upper_bound(acl_v6.begin(), acl_v6.end(), addr,
+    [](const addr128 &a, const pair<addr128,addr128> &r) {
+        return a < r.first;
+    });
+    return it != acl_v6.begin() && !((it - 1)->second < addr);
+}
+
 // @brief test if an IP string is inside of any of the know network ranges.
 bool ad2_acl_check::find(std::string szaddr)
 {
@@ -490,11 +1164,38 @@ bool ad2_acl_check::find(ad2_addr &addr)
     if (!allowed_networks.size()) {
         return true;
     }
-    for (auto acl : allowed_networks) {
-        if (_in_addr_BETWEEN(addr, acl.first, acl.second)) {
-            return true;
+    if (_acl_is_v4(addr.u8_addr)) {
+        return _find_v4((uint32_t)_acl_be64(&addr.u8_addr[8]));
+    }
+    addr128 a = { _acl_be64(&addr.u8_addr[0]), _acl_be64(&addr.u8_addr[8]) };
+    return _find_v6(a);
+}
+
+// @brief test a peer address from getpeername()/accept() without a string round trip.
+// IPv4 mapped IPv6 peers are tested against the IPv4 table.
+bool ad2_acl_check::find(const struct sockaddr_storage &addr)
+{
+    // If no ACLs exist then skip ACL testing and everything passes.
+    if (!allowed_networks.size()) {
+        return true;
+    }
+    if (addr.ss_family == AF_INET) {
+        const struct sockaddr_in *addr4 = (const struct sockaddr_in *)&addr;
+        return _find_v4(ntohl(addr4->sin_addr.s_addr));
+    }
+#if CONFIG_LWIP_IPV6
+    if (addr.ss_family == AF_INET6) {
+        const struct sockaddr_in6 *addr6 = (const struct sockaddr_in6 *)&addr;
+        uint8_t b[16];
+        memcpy(b, &addr6->sin6_addr, sizeof(b));
+        static const uint8_t v4mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+        if (!memcmp(b, v4mapped, sizeof(v4mapped))) {
+            return _find_v4(((uint32_t)b[12] << 24) | ((uint32_t)b[13] << 16) | ((uint32_t)b[14] << 8) | b[15]);
         }
+        addr128 a = { _acl_be64(&b[0]), _acl_be64(&b[8]) };
+        return _find_v6(a);
     }
+#endif
     return false;
 }
 
@@ -533,17 +1234,6 @@ bool ad2_acl_check::_szIPaddrParse(std::string &szaddr, ad2_addr &addr, bool &is
     return true;
 };
 
-// @brief IPv6 or IPv4 math.
-bool ad2_acl_check::_in_addr_BETWEEN(ad2_addr &test, ad2_addr &start, ad2_addr &end)
-{
-    for (int n = 0; n < sizeof(((struct ad2_addr *)0)->u8_addr); n++) {
-        if (test.u8_addr[n] < start.u8_addr[n] || test.u8_addr[n] > end.u8_addr[n]) {
-            return false;
-        }
-    }
-    return true;
-}
-
 // @brief shift 128bit big endian value to the left cnt times.
 void ad2_acl_check::_addr_SHIFT_LEFT(ad2_addr &addr, int cnt)
 {
@@ -631,32 +1321,85 @@ std::string ad2_make_basic_auth_string(const std::string &user, const std::strin
  */
 std::string ad2_urlencode(const std::string str)
 {
-    std::string encoded = "";
-    char c;
-    char code0;
-    char code1;
-    for (int i = 0; i < str.length(); i++) {
-        c = str[i];
+    std::string encoded;
+    encoded.reserve(str.length() * 3);
+    ad2_urlencode_append(encoded, str.data(), str.length());
+    return encoded;
+}
+
+/**
+ * @brief url encode a buffer appending to the end of a string.
+ * Reserve the output first to avoid growing it. Worst case is 3x.
+ *
+ * @arg [in/out]out std::string to append to.
+ * @arg [in]str const char * buffer to encode.
+ * @arg [in]len size_t length of buffer.
+ *
+ */
+void ad2_urlencode_append(std::string &out, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
         if (c == ' ') {
-            encoded += '+';
+            out += '+';
         } else if (isalnum(c)) {
-            encoded += c;
+            out += (char)c;
         } else {
-            code1 = (c & 0xf) + '0';
-            if ((c & 0xf) > 9) {
-                code1 = (c & 0xf) - 10 + 'A';
-            }
-            c = (c >> 4) & 0xf;
-            code0 = c + '0';
-            if (c > 9) {
-                code0 = c - 10 + 'A';
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 0xf];
+        }
+    }
+}
+
+/**
+ * @brief JSON string escape a buffer appending to the end of a string.
+ * Quotes are not added. UTF-8 is passed as is.
+ *
+ * @arg [in/out]out std::string to append to.
+ * @arg [in]str const char * buffer to escape.
+ * @arg [in]len size_t length of buffer.
+ *
+ */
+void ad2_json_escape_append(std::string &out, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xf];
+            } else {
+                out += (char)c;
             }
-            encoded += '%';
-            encoded += code0;
-            encoded += code1;
+            break;
         }
     }
-    return encoded;
 }
 
 /**
@@ -769,7 +1512,11 @@ std::string ad2_string_vasnprintf(const char *fmt, size_t size, va_list args)
 std::string ad2_string_vaprintf(const char *fmt, va_list args)
 {
     std::string out = "";
-    int len = vsnprintf(NULL, 0, fmt, args);
+    // the first pass consumes args on some ABIs.
+    va_list sizing;
+    va_copy(sizing, args);
+    int len = vsnprintf(NULL, 0, fmt, sizing);
+    va_end(sizing);
     if (len < 0) {
         return out;
     }
@@ -883,6 +1630,31 @@ void ad2_remove_ws(std::string &s)
     s = str_no_ws;
 }
 
+/**
+ * @brief Apply a setter change to the config store.
+ *
+ * @param[in] section config section.
+ * @param[in] key full config key.
+ * @param[in] value new value or NULL to remove the key.
+ */
+static void _ad2_config_update(const char *section, const char *key, const char *value)
+{
+    if (!section || !key) {
+        ESP_LOGE(TAG, "%s: fail ini Set|Delete(%s).", __func__, key ? key : "");
+        return;
+    }
+    _ad2_config_lock();
+    _ad2_config_set_value(section, key, value);
+    _ad2_config_mark_changed(section);
+    _config_dirty = true;
+    if (_config_autosave && _config_dirty) {
+        if (_ad2_config_save()) {
+            _config_dirty = false;
+        }
+    }
+    _ad2_config_unlock();
+}
+
 /**
  * @brief Get bool configuration value by section and key.
  *  Optional default value, index(0-999), and suffix helpers.
@@ -911,8 +1683,27 @@ void ad2_get_config_key_bool(
         }
     }
 
-    // If config from uSD is loaded then use it else use NVM
-    *vout = _ad2ini.GetBoolValue(section, tkey.c_str(), *vout);
+    // Same rules as SimpleIni GetBoolValue().
+    _ad2_config_lock();
+    const char *v = _ad2_config_get_value(section, tkey.c_str());
+    if (v) {
+        switch (v[0]) {
+        case 't': case 'T': case 'y': case 'Y': case '1':
+            *vout = true;
+            break;
+        case 'f': case 'F': case 'n': case 'N': case '0':
+            *vout = false;
+            break;
+        case 'o': case 'O':
+            if (v[1] == 'n' || v[1] == 'N') {
+                *vout = true;
+            } else if (v[1] == 'f' || v[1] == 'F') {
+                *vout = false;
+            }
+            break;
+        }
+    }
+    _ad2_config_unlock();
 #ifdef DEBUG_CONFIG
     ESP_LOGI(TAG, "%s: s(%s) k(%s) v(%i)", __func__, section, tkey.c_str(), *vout);
 #endif
@@ -941,37 +1732,16 @@ void ad2_set_config_key_bool(
             tkey += " ";
         }
         tkey += std::to_string(index);
-        if (suffix != nullptr) {
-            tkey += " ";
-            tkey += suffix;
-        }
-    }
-    // If config from persistent storage
-#ifdef DEBUG_CONFIG
-    ESP_LOGI(TAG, "%s: Set|Delete bool key(%s)", __func__, tkey.c_str());
-#endif
-    bool done;
-    if (remove) {
-        if (_ad2ini.KeyExists(section, tkey.c_str())) {
-            done = _ad2ini.Delete(section, tkey.c_str(), false);
-        } else {
-            // asked to delete but does not exist. Still consider done.
-            done = true;
-        }
-    } else {
-        done = _ad2ini.SetBoolValue(section, tkey.c_str(), vin);
-    }
-    if (!done) {
-        ESP_LOGE(TAG, "%s: fail ini Set|Delete(%s).", __func__, tkey.c_str());
-    } else {
-        _config_dirty = true;
-    }
-    if (_config_autosave && _config_dirty) {
-        SI_Error rc = _ad2ini.SaveFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
-        if (rc < 0) {
-            ESP_LOGE(TAG, "%s: Error (%i) ini saveFile.", __func__, rc);
+        if (suffix != nullptr) {
+            tkey += " ";
+            tkey += suffix;
         }
     }
+    // If config from persistent storage
+#ifdef DEBUG_CONFIG
+    ESP_LOGI(TAG, "%s: Set|Delete bool key(%s)", __func__, tkey.c_str());
+#endif
+    _ad2_config_update(section, tkey.c_str(), remove ? NULL : vin ? "true" : "false");
 }
 
 /**
@@ -1002,7 +1772,22 @@ void ad2_get_config_key_int(
         }
     }
 
-    *vout = (int)_ad2ini.GetLongValue(section, tkey.c_str(), *vout);
+    // Same rules as SimpleIni GetLongValue().
+    _ad2_config_lock();
+    const char *v = _ad2_config_get_value(section, tkey.c_str());
+    if (v && v[0]) {
+        char *end = NULL;
+        long n;
+        if (v[0] == '0' && (v[1] == 'x' || v[1] == 'X')) {
+            n = v[2] ? strtol(&v[2], &end, 16) : 0;
+        } else {
+            n = strtol(v, &end, 10);
+        }
+        if (end && !*end) {
+            *vout = (int)n;
+        }
+    }
+    _ad2_config_unlock();
 #ifdef DEBUG_CONFIG
     ESP_LOGI(TAG, "%s: s(%s) k(%s) v(%i)", __func__, section, tkey.c_str(), *vout);
 #endif
@@ -1040,28 +1825,7 @@ void ad2_set_config_key_int(
 #ifdef DEBUG_CONFIG
     ESP_LOGI(TAG, "%s: Set|Delete bool key(%s)", __func__, tkey.c_str());
 #endif
-    bool done;
-    if (remove) {
-        if (_ad2ini.KeyExists(section, tkey.c_str())) {
-            done = _ad2ini.Delete(section, tkey.c_str(), false);
-        } else {
-            // asked to delete but does not exist. Still consider done.
-            done = true;
-        }
-    } else {
-        done = _ad2ini.SetLongValue(section, tkey.c_str(), vin);
-    }
-    if (!done) {
-        ESP_LOGE(TAG, "%s: fail ini Set|Delete(%s).", __func__, tkey.c_str());
-    } else {
-        _config_dirty = true;
-    }
-    if (_config_autosave && _config_dirty) {
-        SI_Error rc = _ad2ini.SaveFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
-        if (rc < 0) {
-            ESP_LOGE(TAG, "%s: Error (%i) ini saveFile.", __func__, rc);
-        }
-    }
+    _ad2_config_update(section, tkey.c_str(), remove ? NULL : std::to_string(vin).c_str());
 }
 
 /**
@@ -1092,7 +1856,12 @@ void ad2_get_config_key_string(
         }
     }
 
-    vout = _ad2ini.GetValue(section, tkey.c_str(), vout.c_str());
+    _ad2_config_lock();
+    const char *v = _ad2_config_get_value(section, tkey.c_str());
+    if (v) {
+        vout = v;
+    }
+    _ad2_config_unlock();
 #ifdef DEBUG_CONFIG
     ESP_LOGI(TAG, "%s: s(%s) k(%s) v(%s)", __func__, section, tkey.c_str(), vout.c_str());
 #endif
@@ -1131,28 +1900,7 @@ void ad2_set_config_key_string(
 #ifdef DEBUG_CONFIG
     ESP_LOGI(TAG, "%s: Set|Delete bool key(%s)", __func__, tkey.c_str());
 #endif
-    bool done;
-    if (remove) {
-        if (_ad2ini.KeyExists(section, tkey.c_str())) {
-            done = _ad2ini.Delete(section, tkey.c_str(), false);
-        } else {
-            // asked to delete but does not exist. Still consider done.
-            done = true;
-        }
-    } else {
-        done = _ad2ini.SetValue(section, tkey.c_str(), vin);
-    }
-    if (!done) {
-        ESP_LOGE(TAG, "%s: fail ini Set|Delete(%s).", __func__, tkey.c_str());
-    } else {
-        _config_dirty = true;
-    }
-    if (_config_autosave && _config_dirty) {
-        SI_Error rc = _ad2ini.SaveFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
-        if (rc < 0) {
-            ESP_LOGE(TAG, "%s: Error (%i) ini saveFile.", __func__, rc);
-        }
-    }
+    _ad2_config_update(section, tkey.c_str(), remove ? NULL : (vin ? vin : ""));
     return;
 }
 
@@ -1242,9 +1990,12 @@ void ad2_fw_update(const char *arg)
  *
  * @param [in]code std::string &
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_arm_away(std::string &code, int partId)
+bool ad2_arm_away(std::string &code, int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1263,10 +2014,10 @@ void ad2_arm_away(std::string &code, int partId)
         }
 
         ESP_LOGI(TAG, "Sending ARM AWAY command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1301,9 +2052,12 @@ void ad2_arm_away(int codeId, int partId)
  *
  * @param [in]code std::string &
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_arm_stay(std::string &code, int partId)
+bool ad2_arm_stay(std::string &code, int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1321,10 +2075,10 @@ void ad2_arm_stay(std::string &code, int partId)
             msg = ad2_string_printf("K%01i1<S4>", address);
         }
         ESP_LOGI(TAG, "Sending ARM STAY command to address %i using code '%s'", address, code.c_str());
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1358,9 +2112,12 @@ void ad2_arm_stay(int codeId, int partId)
  *
  * @param [in]code std::string &
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_disarm(std::string &code, int partId)
+bool ad2_disarm(std::string &code, int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1383,10 +2140,10 @@ void ad2_disarm(std::string &code, int partId)
             }
         }
         ESP_LOGI(TAG, "Sending DISARM command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1420,9 +2177,12 @@ void ad2_disarm(int codeId, int partId)
  *
  * @param [in]code std:string &
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_chime_toggle(std::string &code, int partId)
+bool ad2_chime_toggle(std::string &code, int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1441,10 +2201,10 @@ void ad2_chime_toggle(std::string &code, int partId)
         }
 
         ESP_LOGI(TAG, "Sending CHIME toggle command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1478,9 +2238,12 @@ void ad2_chime_toggle(int codeId, int partId)
  * The message will be sent using the AlarmDecoder 'K' protocol.
  *
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_fire_alarm(int partId)
+bool ad2_fire_alarm(int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1495,10 +2258,10 @@ void ad2_fire_alarm(int partId)
         msg = ad2_string_printf("K%02i<S1>", address);
 
         ESP_LOGI(TAG, "Sending FIRE PANIC button command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1510,9 +2273,12 @@ void ad2_fire_alarm(int partId)
  * The message will be sent using the AlarmDecoder 'K' protocol.
  *
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_panic_alarm(int partId)
+bool ad2_panic_alarm(int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1527,10 +2293,10 @@ void ad2_panic_alarm(int partId)
         msg = ad2_string_printf("K%02i<S2>", address);
 
         ESP_LOGI(TAG, "Sending PANIC button command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1542,9 +2308,12 @@ void ad2_panic_alarm(int partId)
  * The message will be sent using the AlarmDecoder 'K' protocol.
  *
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_aux_alarm(int partId)
+bool ad2_aux_alarm(int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1559,10 +2328,10 @@ void ad2_aux_alarm(int partId)
         msg = ad2_string_printf("K%02i<S3>", address);
 
         ESP_LOGI(TAG, "Sending AUX PANIC button command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1574,9 +2343,12 @@ void ad2_aux_alarm(int partId)
  * The message will be sent using the AlarmDecoder 'K' protocol.
  *
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
+ * @param [in]source ad2_send_source_t queue to use.
  *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  */
-void ad2_exit_now(int partId)
+bool ad2_exit_now(int partId, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1595,10 +2367,10 @@ void ad2_exit_now(int partId)
         }
 
         ESP_LOGI(TAG, "Sending EXIT NOW command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1612,11 +2384,15 @@ void ad2_exit_now(int partId)
  * @param [in]code std::string &
  * @param [in]partId int [0 - AD2_MAX_PARTITION]
  * @param [in]zone uint8_t[1-255] zone number
+ * @param [in]source ad2_send_source_t queue to use.
+ *
+ * @return bool true if the command was queued. false if the partition
+ * has no state yet, there is nothing to send or the queue was full.
  *
  * FIXME: larger panels have 3 digit zones. Detect?
  *
  */
-void ad2_bypass_zone(std::string &code, int partId, uint8_t zone)
+bool ad2_bypass_zone(std::string &code, int partId, uint8_t zone, ad2_send_source_t source)
 {
     // Get the address/partition mask for multi partition support.
     int address = -1;
@@ -1635,10 +2411,10 @@ void ad2_bypass_zone(std::string &code, int partId, uint8_t zone)
         }
 
         ESP_LOGI(TAG, "Sending BYPASS ZONE command");
-        ad2_send(msg);
-    } else {
-        ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+        return msg.length() && ad2_send(msg, source);
     }
+    ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
+    return false;
 }
 
 /**
@@ -1711,32 +2487,72 @@ bool ad2_keypad_send(const std::string &keys, int partId)
     }
 
     ESP_LOGI(TAG, "Sending %u virtual keypad key(s)", (unsigned)keys.length());
-    ad2_send(msg);
+    ad2_send(msg, AD2_SEND_SRC_KEYPAD);
     return true;
 }
 
 /**
- * @brief Send string to the AD2 devices after macro translation.
- *
- * @param [in]buf Pointer to string to send to AD2 devices.
+ * Outbound AD2 command queue.
  *
- * @note Macros <SX> for sending panel specific special keys.
- *       http://www.alarmdecoder.com/wiki/index.php/Protocol#Special_Keys
- * This makes it more simple to send complex sequences with a simple human
- * readable macro.
+ * Every writer used to call uart_write_bytes() or send() from its own task
+ * so concurrent commands could interleave on the wire. Commands are now
+ * queued per source and written by a single task serving the sources round
+ * robin. Ring slots keep their string capacity so steady state sends do not
+ * allocate.
  */
-void ad2_send(std::string &buf)
-{
-    if (g_ad2_client_handle > -1) {
+typedef struct ad2_cmd_sendQ_item {
+    std::string data;
+    TickType_t queued;
+    ad2_send_source_t source;
+} ad2_cmd_sendQ_item_t;
+
+typedef struct ad2_cmd_sendQ_ring {
+    ad2_cmd_sendQ_item_t items[AD2_CMD_SENDQ_DEPTH];
+    uint8_t head;
+    uint8_t count;
+} ad2_cmd_sendQ_ring_t;
+
+static ad2_cmd_sendQ_ring_t _cmd_sendQ[AD2_SEND_SRC_COUNT];
+static SemaphoreHandle_t _cmd_sendQ_mutex = NULL;
+static SemaphoreHandle_t _cmd_sendQ_ack = NULL;
+static TaskHandle_t _cmd_sendQ_task = NULL;
+static ad2_cmd_sendQ_stats_t _cmd_sendQ_stats = {};
+static uint64_t _cmd_sendQ_total_latency_ms = 0;
+static uint64_t _cmd_sendQ_source_latency_ms[AD2_SEND_SRC_COUNT] = {};
 
-        /* replace macros <S1>-<S8> with real values */
-        for (int x = 1; x < 9; x++) {
-            std::string key = ad2_string_printf("<S%01i>", x);
-            std::string out;
-            out.append(3, (char)x);
-            ad2_replace_all(buf, key.c_str(), out.c_str());
+/**
+ * @brief Replace macros <S1>-<S8> with the panel special key bytes.
+ *
+ * @details Each four character macro becomes three bytes so the result is
+ * never longer than the input and is expanded in place in a single pass.
+ *
+ * @param [in/out]buf command to expand.
+ */
+static void _ad2_expand_macros(std::string &buf)
+{
+    size_t len = buf.length();
+    size_t out = 0;
+    for (size_t in = 0; in < len;) {
+        if (buf[in] == '<' && in + 3 < len && buf[in + 1] == 'S' &&
+                buf[in + 2] >= '1' && buf[in + 2] <= '8' && buf[in + 3] == '>') {
+            char key = buf[in + 2] - '0';
+            buf[out++] = key;
+            buf[out++] = key;
+            buf[out++] = key;
+            in += 4;
+        } else {
+            buf[out++] = buf[in++];
         }
+    }
+    buf.resize(out);
+}
 
+/**
+ * @brief Write bytes to the AD2 connection.
+ */
+static void _ad2_write(const std::string &buf)
+{
+    if (g_ad2_client_handle > -1) {
         ESP_LOGD(TAG, "sending '%s' to AD2*", buf.c_str());
 
         if (g_ad2_mode == 'C') {
@@ -1749,8 +2565,245 @@ void ad2_send(std::string &buf)
         }
     } else {
         ESP_LOGE(TAG, "invalid handle in send_to_ad2");
+    }
+}
+
+/**
+ * @brief Test if a command is an addressed keypad command "Kaa...".
+ * The AD2 reports "!Sending...done" when these finish.
+ */
+static bool _ad2_is_keypad_cmd(const std::string &buf)
+{
+    return buf.length() > 2 && buf[0] == 'K' && isdigit((unsigned char)buf[1]);
+}
+
+/**
+ * @brief Test if sending the command twice has the same effect as once.
+ *
+ * @details Only AD2 config 'C' and version 'V' commands qualify. Keypad
+ * input never does, a second disarm or panic press is deliberate.
+ */
+static bool _ad2_is_idempotent_cmd(const std::string &buf)
+{
+    return buf.length() && (buf[0] == 'C' || buf[0] == 'V');
+}
+
+/**
+ * @brief ON_SENDING_RECEIVED subscriber. Release the command writer.
+ */
+static void _cmd_sendQ_on_sending(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    if (msg->find("done") != std::string::npos) {
+        xSemaphoreGive(_cmd_sendQ_ack);
+    }
+}
+
+/**
+ * @brief Take the next command using round robin over the sources.
+ *
+ * @param [in/out]next source to start looking from.
+ * @param [out]item swapped with the queued item.
+ *
+ * @return true if a command was found.
+ */
+static bool _cmd_sendQ_pop(int &next, ad2_cmd_sendQ_item_t &item)
+{
+    bool found = false;
+    xSemaphoreTake(_cmd_sendQ_mutex, portMAX_DELAY);
+    for (int n = 0; n < AD2_SEND_SRC_COUNT && !found; n++) {
+        int src = (next + n) % AD2_SEND_SRC_COUNT;
+        ad2_cmd_sendQ_ring_t &ring = _cmd_sendQ[src];
+        if (ring.count) {
+            // swap keeps the string capacity in the ring slot.
+            ad2_cmd_sendQ_item_t &slot = ring.items[ring.head];
+            item.data.swap(slot.data);
+            item.queued = slot.queued;
+            item.source = (ad2_send_source_t)src;
+            slot.data.clear();
+            ring.head = (ring.head + 1) % AD2_CMD_SENDQ_DEPTH;
+            ring.count--;
+            _cmd_sendQ_stats.depth--;
+            next = (src + 1) % AD2_SEND_SRC_COUNT;
+            found = true;
+        }
+    }
+    xSemaphoreGive(_cmd_sendQ_mutex);
+    return found;
+}
+
+/**
+ * @brief AD2 command writer task.
+ *
+ * @details Keypad commands are paced to the AD2. After one is written the
+ * next waits for "!Sending...done" or AD2_CMD_SENDQ_ACK_TIMEOUT. Other
+ * data such as ad2term key presses is written as soon as it is queued.
+ *
+ * @param [in]pvParameters currently not used NULL.
+ */
+static void _cmd_sendQ_consumer_task(void *pvParameters)
+{
+    int next = 0;
+    bool awaiting_ack = false;
+    TickType_t ack_start = 0;
+    ad2_cmd_sendQ_item_t item;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (_cmd_sendQ_pop(next, item)) {
+            bool keypad = _ad2_is_keypad_cmd(item.data);
+            if (keypad && awaiting_ack) {
+                TickType_t waited = xTaskGetTickCount() - ack_start;
+                TickType_t limit = AD2_CMD_SENDQ_ACK_TIMEOUT / portTICK_PERIOD_MS;
+                bool acked = xSemaphoreTake(_cmd_sendQ_ack, waited >= limit ? 0 : limit - waited) == pdTRUE;
+                xSemaphoreTake(_cmd_sendQ_mutex, portMAX_DELAY);
+                if (acked) {
+                    _cmd_sendQ_stats.acked++;
+                } else {
+                    _cmd_sendQ_stats.ack_timeouts++;
+                }
+                xSemaphoreGive(_cmd_sendQ_mutex);
+                awaiting_ack = false;
+            }
+            if (keypad) {
+                // drop any stale ack then start waiting for this command.
+                xSemaphoreTake(_cmd_sendQ_ack, 0);
+                awaiting_ack = true;
+                ack_start = xTaskGetTickCount();
+            }
+
+            _ad2_write(item.data);
+
+            uint32_t latency = (xTaskGetTickCount() - item.queued) * portTICK_PERIOD_MS;
+            xSemaphoreTake(_cmd_sendQ_mutex, portMAX_DELAY);
+            _cmd_sendQ_stats.sent++;
+            _cmd_sendQ_total_latency_ms += latency;
+            _cmd_sendQ_stats.avg_latency_ms = _cmd_sendQ_total_latency_ms / _cmd_sendQ_stats.sent;
+            if (latency > _cmd_sendQ_stats.max_latency_ms) {
+                _cmd_sendQ_stats.max_latency_ms = latency;
+            }
+            ad2_cmd_sendQ_source_stats_t &src = _cmd_sendQ_stats.sources[item.source];
+            src.sent++;
+            _cmd_sendQ_source_latency_ms[item.source] += latency;
+            src.avg_latency_ms = _cmd_sendQ_source_latency_ms[item.source] / src.sent;
+            if (latency > src.max_latency_ms) {
+                src.max_latency_ms = latency;
+            }
+            xSemaphoreGive(_cmd_sendQ_mutex);
+        }
+    }
+}
+
+/**
+ * @brief Initialize and start the outbound AD2 command queue.
+ * Until this is called ad2_send() writes directly to the AD2.
+ */
+void ad2_init_cmd_sendQ()
+{
+    if (_cmd_sendQ_task) {
         return;
     }
+    _cmd_sendQ_mutex = xSemaphoreCreateMutex();
+    _cmd_sendQ_ack = xSemaphoreCreateBinary();
+
+    // Track keypad command completion.
+    AD2Parse.subscribeTo(ON_SENDING_RECEIVED, _cmd_sendQ_on_sending, nullptr);
+
+    xTaskCreate(_cmd_sendQ_consumer_task, "AD2 cmdQ", 1024 * 3, NULL, tskIDLE_PRIORITY + 2, &_cmd_sendQ_task);
+}
+
+/**
+ * @brief Get a copy of the command queue counters.
+ *
+ * @param [out]stats ad2_cmd_sendQ_stats_t *
+ */
+void ad2_get_cmd_sendQ_stats(ad2_cmd_sendQ_stats_t *stats)
+{
+    if (_cmd_sendQ_mutex) {
+        xSemaphoreTake(_cmd_sendQ_mutex, portMAX_DELAY);
+    }
+    *stats = _cmd_sendQ_stats;
+    if (_cmd_sendQ_mutex) {
+        xSemaphoreGive(_cmd_sendQ_mutex);
+    }
+}
+
+/**
+ * @brief Send string to the AD2 devices after macro translation.
+ *
+ * @param [in]buf Pointer to string to send to AD2 devices.
+ * @param [in]source ad2_send_source_t queue to use.
+ *
+ * @note Macros <SX> for sending panel specific special keys.
+ *       http://www.alarmdecoder.com/wiki/index.php/Protocol#Special_Keys
+ * This makes it more simple to send complex sequences with a simple human
+ * readable macro.
+ *
+ * @note Commands are queued and written by the command writer task. A
+ * built in AD2 config or version command identical to one still waiting
+ * is merged with it. Keypad input is never merged.
+ *
+ * @note ad2term and ser2sock pass through raw byte streams such as a
+ * firmware upload. Losing a chunk would corrupt the stream so on a full
+ * queue they wait for the writer as the direct UART write did.
+ *
+ * @return true if the command was queued or written, false if the queue
+ * for source was full and it was dropped. Always true for stream sources.
+ */
+bool ad2_send(std::string &buf, ad2_send_source_t source)
+{
+    _ad2_expand_macros(buf);
+
+    if (!_cmd_sendQ_task) {
+        _ad2_write(buf);
+        return true;
+    }
+
+    xSemaphoreTake(_cmd_sendQ_mutex, portMAX_DELAY);
+    ad2_cmd_sendQ_ring_t &ring = _cmd_sendQ[source];
+    if (ring.count == AD2_CMD_SENDQ_DEPTH &&
+            (source == AD2_SEND_SRC_TERM || source == AD2_SEND_SRC_SER2SOCK)) {
+        _cmd_sendQ_stats.sources[source].waited++;
+        while (ring.count == AD2_CMD_SENDQ_DEPTH) {
+            xSemaphoreGive(_cmd_sendQ_mutex);
+            xTaskNotifyGive(_cmd_sendQ_task);
+            vTaskDelay(1);
+            xSemaphoreTake(_cmd_sendQ_mutex, portMAX_DELAY);
+        }
+    }
+    bool queued = false;
+    if (source == AD2_SEND_SRC_API && _ad2_is_idempotent_cmd(buf)) {
+        for (int n = 0; n < ring.count; n++) {
+            if (ring.items[(ring.head + n) % AD2_CMD_SENDQ_DEPTH].data == buf) {
+                _cmd_sendQ_stats.coalesced++;
+                queued = true;
+                break;
+            }
+        }
+    }
+    if (!queued) {
+        if (ring.count < AD2_CMD_SENDQ_DEPTH) {
+            ad2_cmd_sendQ_item_t &slot = ring.items[(ring.head + ring.count) % AD2_CMD_SENDQ_DEPTH];
+            slot.data.assign(buf);
+            slot.queued = xTaskGetTickCount();
+            ring.count++;
+            if (++_cmd_sendQ_stats.depth > _cmd_sendQ_stats.max_depth) {
+                _cmd_sendQ_stats.max_depth = _cmd_sendQ_stats.depth;
+            }
+            _cmd_sendQ_stats.sources[source].queued++;
+            queued = true;
+        } else {
+            _cmd_sendQ_stats.dropped++;
+            _cmd_sendQ_stats.sources[source].dropped++;
+        }
+    }
+    xSemaphoreGive(_cmd_sendQ_mutex);
+
+    if (queued) {
+        xTaskNotifyGive(_cmd_sendQ_task);
+    } else {
+        ESP_LOGW(TAG, "AD2 command queue full for source %i. Command dropped.", (int)source);
+    }
+    return queued;
 }
 
 /**
@@ -1765,6 +2818,9 @@ void ad2_send(std::string &buf)
 static bool line_clear = false;
 int ad2_log_vprintf_host(const char *fmt, va_list args)
 {
+    // keep a binary copy for the log history even if the console is busy.
+    ad2_capture_log_vprintf(fmt, args);
+
     // wait 500ms for access to the console.
     if (!ad2_take_host_console((void *)xTaskGetCurrentTaskHandle(), AD2_CONSOLE_LOCK_TIME)) {
         return 0;
@@ -1790,7 +2846,6 @@ int ad2_log_vprintf_host(const char *fmt, va_list args)
             // don't log blank lines or send out \r\n.
             tbuf[strcspn(tbuf, "\r\n")] = 0;
             len = strlen(tbuf);
-            ad2_capture_log_line(tbuf);
             if (!len) {
                 if (!line_clear) {
                     line_clear = false;
@@ -1922,247 +2977,6 @@ AD2PartitionState *ad2_get_partition_state(int partId)
     return s;
 }
 
-/**
- * @brief Generate a standardized JSON string for the AD2IoT device details.
- *
- * @return cJSON*
- *
- */
-cJSON *ad2_get_ad2iot_device_info_json()
-{
-    cJSON *root = cJSON_CreateObject();
-
-    // Add this boards info to the object
-    esp_chip_info_t chip_info;
-    esp_chip_info(&chip_info);
-    cJSON_AddStringToObject(root, "firmware_version", ad2_firmware_version());
-    cJSON_AddNumberToObject(root, "cpu_model", chip_info.model);
-    cJSON_AddNumberToObject(root, "cpu_revision", chip_info.revision);
-    cJSON_AddNumberToObject(root, "cpu_cores", chip_info.cores);
-    cJSON *cjson_cpu_features = cJSON_CreateArray();
-    if (chip_info.features & CHIP_FEATURE_WIFI_BGN) {
-        cJSON_AddItemToArray(cjson_cpu_features, cJSON_CreateString("WiFi"));
-    }
-    if (chip_info.features & CHIP_FEATURE_BLE) {
-        cJSON_AddItemToArray(cjson_cpu_features, cJSON_CreateString("BLE"));
-    }
-    if (chip_info.features & CHIP_FEATURE_BT) {
-        cJSON_AddItemToArray(cjson_cpu_features, cJSON_CreateString("BT"));
-    }
-    cJSON_AddItemToObject(root, "cpu_features", cjson_cpu_features);
-    uint32_t size_flash_chip;
-    esp_flash_get_size(NULL, &size_flash_chip);
-    cJSON_AddNumberToObject(root, "cpu_flash_size", size_flash_chip);
-    std::string flash_type = (chip_info.features & CHIP_FEATURE_EMB_FLASH) ? "embedded" : "external";
-    cJSON_AddStringToObject(root, "cpu_flash_type", flash_type.c_str());
-
-    cJSON_AddStringToObject(root, "ad2_version_string", AD2Parse.ad2_version_string.c_str());
-    cJSON_AddStringToObject(root, "ad2_config_string", AD2Parse.ad2_config_string.c_str());
-
-    return root;
-}
-
-/**
- * @brief Generate a standardized JSON string for the given AD2PartitionState pointer.
- *
- * @param [in]AD2PartitionState * to use for json object.
- *
- * @return cJSON*
- *
- */
-cJSON *ad2_get_partition_state_json(AD2PartitionState *s)
-{
-    cJSON *root = cJSON_CreateObject();
-    if (s && !s->unknown_state) {
-        cJSON_AddBoolToObject(root, "ready", s->ready);
-        cJSON_AddBoolToObject(root, "armed_away", s->armed_away);
-        cJSON_AddBoolToObject(root, "armed_stay", s->armed_stay);
-        cJSON_AddBoolToObject(root, "backlight_on", s->backlight_on);
-        cJSON_AddBoolToObject(root, "programming", s->programming);
-        cJSON_AddBoolToObject(root, "zone_bypassed", s->zone_bypassed);
-        cJSON_AddBoolToObject(root, "ac_power", s->ac_power);
-        cJSON_AddBoolToObject(root, "chime_on", s->chime_on);
-        cJSON_AddBoolToObject(root, "alarm_event_occurred", s->alarm_event_occurred);
-        cJSON_AddBoolToObject(root, "alarm_sounding", s->alarm_sounding);
-        cJSON_AddBoolToObject(root, "battery_low", s->battery_low);
-        cJSON_AddBoolToObject(root, "entry_delay_off", s->entry_delay_off);
-        cJSON_AddBoolToObject(root, "fire_alarm", s->fire_alarm);
-        cJSON_AddBoolToObject(root, "system_issue", s->system_issue);
-        cJSON_AddBoolToObject(root, "perimeter_only", s->perimeter_only);
-        cJSON_AddBoolToObject(root, "exit_now", s->exit_now);
-        cJSON_AddNumberToObject(root, "system_specific", s->system_specific);
-        cJSON_AddNumberToObject(root, "beeps", s->beeps);
-        cJSON_AddStringToObject(root, "panel_type", std::string(1, s->panel_type).c_str());
-        cJSON_AddStringToObject(root, "last_alpha_message", s->last_alpha_message.c_str());
-        cJSON_AddStringToObject(root, "last_numeric_messages", s->last_numeric_message.c_str()); // Can have HEX digits ex. 'FC'.
-        cJSON_AddNumberToObject(root, "mask", s->address_mask_filter);
-    } else {
-        cJSON_AddStringToObject(root, "last_alpha_message", "Unknown");
-    }
-    return root;
-}
-
-/**
- * @brief Generate a standardized JSON string for s->zone_states.
- *
- * @param [in]AD2PartitionState * to use for json object.
- *
- * @return cJSON*
- *
- */
-cJSON *ad2_get_partition_zone_alerts_json(AD2PartitionState *s)
-{
-    // OPEN zones.
-    cJSON *_zone_alerts = cJSON_CreateArray();
-    if (s) {
-        for (std::pair<uint8_t, AD2ZoneState> e : s->zone_states) {
-            if (s->zone_states[e.first].state() != AD2_STATE_CLOSED) {
-                cJSON *zone = cJSON_CreateObject();
-                std::string _state_string = AD2Parse.state_str[s->zone_states[e.first].state()];
-                // grab the verb(FOO) 'ZONE FOO 001'
-                cJSON_AddNumberToObject(zone, "zone", e.first);
-                cJSON_AddNumberToObject(zone, "partition", s->partition);
-                cJSON_AddNumberToObject(zone, "mask", s->address_mask_filter);
-                cJSON_AddStringToObject(zone, "state", _state_string.c_str());
-                std::string zalpha;
-                AD2Parse.getZoneString((int)e.first, zalpha);
-                cJSON_AddStringToObject(zone, "name", zalpha.c_str());
-                cJSON_AddItemToArray(_zone_alerts, zone);
-            }
-        }
-    }
-    return _zone_alerts;
-}
-
-#define HTTP_SEND_QUEUE_SIZE 20  // More? Less?
-#define HTTP_SEND_RATE_LIMIT 200 // 5/s seems like a reasonable value to start with.
-static QueueHandle_t _http_sendQ = NULL;
-
-typedef struct sendQ_event_data {
-    esp_http_client_config_t *client_config;
-    ad2_http_sendQ_ready_cb_t ready;
-    ad2_http_sendQ_done_cb_t done;
-} sendQ_event_data_t;
-
-/**
- * @brief HTTP sendQ consumer
- *
- * @param [in]pvParameters void *
- */
-static void _http_sendQ_consumer_task(void *pvParameters)
-{
-    esp_err_t err;
-
-    while (1) {
-        if (_http_sendQ == NULL) {
-            break;
-        }
-        if (!g_StopMainTask && hal_get_network_connected()) {
-            sendQ_event_data_t event_data;
-            if (xQueueReceive(_http_sendQ, &event_data, portMAX_DELAY)) {
-#if defined(AD2_STACK_REPORT)
-                ESP_LOGI(TAG, "_http_sendQ_consumer_task stack free %d", uxTaskGetStackHighWaterMark(NULL));
-#endif
-
-                // Initialize a new http client using the client_config..
-                esp_http_client_handle_t http_client;
-                http_client = esp_http_client_init(event_data.client_config);
-
-                // Set the user agent.
-                esp_chip_info_t chip_info;
-                esp_chip_info(&chip_info);
-
-                // Set user agent no including version info.
-                std::string ua = "AD2IoT-HTTP-Client/NOPE (ESP32-r" + std::to_string(chip_info.revision) + ")";
-                esp_http_client_set_header(http_client, "User-Agent", ua.c_str());
-
-                // notify compoenet we are about to send and allow to
-                // update connection details including post data etc.
-                event_data.ready(http_client, event_data.client_config);
-
-                // Allow for multiple requests on a single connection.
-                // TODO: sanity checking. Put back in sendQ for others to get some time? Memory.
-                do {
-                    // start the connection
-                    err = esp_http_client_perform(http_client);
-
-                    // Notify client the request finished and the results.
-                    // If it wants to preform again it will return false;
-                    if (event_data.done(err, http_client, event_data.client_config)) {
-                        break;
-                    }
-                } while (err == ESP_OK);
-
-                // free the client
-                esp_http_client_cleanup(http_client);
-
-                // sleep our rate limit. Not exactly the rate not factoring in
-                // client connection time but close enough for now.
-                vTaskDelay(HTTP_SEND_RATE_LIMIT / portTICK_PERIOD_MS);
-            } else {
-                // sleep for a bit then check the queue again.
-                vTaskDelay(100 / portTICK_PERIOD_MS);
-            }
-        }
-        // sleep for a bit then check the queue again.
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
-    ESP_LOGW(TAG, "http sendQ ending. HTTP request delivery halted.");
-    vTaskDelete(NULL);
-}
-
-/**
- * @brief Initialize and start the HTTP request send queue.
- * Allows for components to POST requests to server ASYNC and serialized with each other.
- * This prevents memory exhaustion at the cost of a potential slower delivery time.
- *
- * @note TODO: Add retry logic. Will take some brain time on this. It would not be good
- * to deliver a message out of order yet we need to let other components deliver and not be
- * blocked. Need a queue per component. Maybe have each component manage an internal queue
- * and if one delivery fails let the component decide how to deal with it.
- *
- */
-void ad2_init_http_sendQ()
-{
-    // Init the queue.
-    if (_http_sendQ == NULL) {
-        _http_sendQ = xQueueCreate(HTTP_SEND_QUEUE_SIZE, sizeof(sendQ_event_data_t));
-    }
-
-    // Start the queue consumer task. Keep the stack as small as possible.
-    // 20210815SM: 1444 bytes stack free
-    xTaskCreate(_http_sendQ_consumer_task, "AD2 sendQ", 1024 * 8, NULL, tskIDLE_PRIORITY + 1, NULL);
-}
-
-/**
- * @brief Add a http client config to the queue
- *
- * @param [in]client_config esp_http_client_config_t *
- * @param [in]ready_cb ad2_http_sendQ_ready_cb_t: Called before esp_http_client_perform()
- * @param [in]done_cb ad2_http_sendQ_done_cb_t: Called before esp_http_client_cleanup()
- *
- */
-bool ad2_add_http_sendQ(esp_http_client_config_t *client_config, ad2_http_sendQ_ready_cb_t ready_cb, ad2_http_sendQ_done_cb_t done_cb)
-{
-    // Save queue data into a structure for storage in the sendQ
-    sendQ_event_data_t event_data = {
-        .client_config = client_config,
-        .ready = ready_cb,
-        .done = done_cb
-    };
-
-    if (_http_sendQ) {
-        // Copy the container into the sendQ
-        if (xQueueSend(_http_sendQ, (void *)&event_data, (TickType_t)0) != pdPASS) {
-            return false;
-        }
-        return true;
-    } else {
-        ESP_LOGE(TAG, "Invalid queue handle");
-        return false;
-    }
-}
-
 /**
  * @brief return the ad2 configured network mode value
  *
@@ -30,36 +30,66 @@
 // Debugging config
 //#define DEBUG_CONFIG
 
+/// Outbound AD2 command sources. Each source has its own queue and they are
+/// served round robin by the command writer task.
+typedef enum {
+    AD2_SEND_SRC_API = 0,   ///< ad2_arm_away() and other built in commands.
+    AD2_SEND_SRC_KEYPAD,    ///< virtual keypad input.
+    AD2_SEND_SRC_TERM,      ///< ad2term pass through.
+    AD2_SEND_SRC_SER2SOCK,  ///< ser2sock clients.
+    AD2_SEND_SRC_MQTT,      ///< MQTT commands.
+    AD2_SEND_SRC_COUNT
+} ad2_send_source_t;
+
 // Communication with AD2* device / host
 void ad2_fw_update(const char *arg);
 void ad2_config_update(const char *arg);
-void ad2_arm_away(std::string &code, int partId);
+bool ad2_arm_away(std::string &code, int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
 void ad2_arm_away(int codeId, int partId);
-void ad2_arm_stay(std::string &code, int partId);
+bool ad2_arm_stay(std::string &code, int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
 void ad2_arm_stay(int codeId, int partId);
-void ad2_disarm(std::string &code, int partId);
+bool ad2_disarm(std::string &code, int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
 void ad2_disarm(int codeId, int partId);
-void ad2_chime_toggle(std::string &code, int partId);
+bool ad2_chime_toggle(std::string &code, int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
 void ad2_chime_toggle(int codeId, int partId);
-void ad2_fire_alarm(int partId);
-void ad2_panic_alarm(int partId);
-void ad2_aux_alarm(int partId);
-void ad2_exit_now(int partId);
-void ad2_bypass_zone(std::string &code, int partId, uint8_t zone);
+bool ad2_fire_alarm(int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
+bool ad2_panic_alarm(int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
+bool ad2_aux_alarm(int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
+bool ad2_exit_now(int partId, ad2_send_source_t source = AD2_SEND_SRC_API);
+bool ad2_bypass_zone(std::string &code, int partId, uint8_t zone, ad2_send_source_t source = AD2_SEND_SRC_API);
 void ad2_bypass_zone(int codeId, int partId, uint8_t zone);
 bool ad2_keypad_send(const std::string &keys, int partId);
-void ad2_send(std::string &buf);
+
+/// Outbound AD2 command queue counters for one source.
+typedef struct {
+    uint32_t queued;         ///< commands accepted into the queue.
+    uint32_t sent;           ///< commands written to the AD2.
+    uint32_t dropped;        ///< commands dropped on a full queue.
+    uint32_t waited;         ///< stream writes that waited for room.
+    uint32_t avg_latency_ms; ///< average queue to write time.
+    uint32_t max_latency_ms; ///< worst queue to write time.
+} ad2_cmd_sendQ_source_stats_t;
+
+/// Outbound AD2 command queue counters.
+typedef struct {
+    uint32_t depth;          ///< commands waiting to be written.
+    uint32_t max_depth;      ///< highest depth seen.
+    uint32_t sent;           ///< commands written to the AD2.
+    uint32_t acked;          ///< keypad commands confirmed by "!Sending...done".
+    uint32_t ack_timeouts;   ///< keypad commands not confirmed in time.
+    uint32_t coalesced;      ///< duplicate config or version commands merged while queued.
+    uint32_t dropped;        ///< commands dropped on a full queue.
+    uint32_t avg_latency_ms; ///< average queue to write time.
+    uint32_t max_latency_ms; ///< worst queue to write time.
+    ad2_cmd_sendQ_source_stats_t sources[AD2_SEND_SRC_COUNT];
+} ad2_cmd_sendQ_stats_t;
+
+void ad2_init_cmd_sendQ();
+void ad2_get_cmd_sendQ_stats(ad2_cmd_sendQ_stats_t *stats);
+bool ad2_send(std::string &buf, ad2_send_source_t source = AD2_SEND_SRC_API);
 AD2PartitionState *ad2_get_partition_state(int partId);
-cJSON *ad2_get_ad2iot_device_info_json();
-cJSON *ad2_get_partition_state_json(AD2PartitionState *);
-cJSON *ad2_get_partition_zone_alerts_json(AD2PartitionState *);
-cJSON *ad2_get_recent_logs_json(size_t limit);
-size_t ad2_print_recent_logs(size_t limit);
-void ad2_init_sd_logging();
-bool ad2_set_sd_logging_enabled(bool enabled);
-void ad2_get_sd_logging_status(bool *enabled, bool *active,
-                               uint32_t *dropped, uint32_t *write_errors);
 const char *ad2_firmware_version();
+int64_t ad2_wall_clock_ms();
 int ad2_log_vprintf_host(const char *fmt, va_list args);
 void ad2_printf_host(bool prefix, const char *format, ...);
 void ad2_snprintf_host(const char *fmt, size_t size, ...);
@@ -78,6 +108,8 @@ int ad2_copy_nth_arg(std::string &dest, const char* src, int n, bool remaining =
 void ad2_tokenize(std::string const &str, const char* delim, std::vector<std::string> &out);
 std::string ad2_make_basic_auth_string(const std::string& user, const std::string& password);
 std::string ad2_urlencode(const std::string str);
+void ad2_urlencode_append(std::string &out, const char *str, size_t len);
+void ad2_json_escape_append(std::string &out, const char *str, size_t len);
 void ad2_genUUID(uint8_t n, std::string& ret);
 void ad2_lcase(std::string &str);
 void ad2_ucase(std::string &str);
@@ -97,7 +129,9 @@ struct ad2_addr {
  *  @brief ACL parser and test class
  *
  *  @details Simple parser for ACL strings and testing for matches given
- *  an IP string or the uint32_t value of an IP.
+ *  an IP string, an ad2_addr or a peer sockaddr_storage. Each add() compiles
+ *  the ranges into sorted and merged IPv4 and IPv6 interval tables that are
+ *  tested with a binary search.
  *     Example ACL String: '192.168.0.0/24, 192.168.1.1-192.168.1.2'
  */
 class ad2_acl_check
@@ -106,9 +140,12 @@ public:
     int add(std::string& acl);
     bool find(std::string szaddr);
     bool find(ad2_addr& addr);
+    bool find(const struct sockaddr_storage& addr);
     void clear()
     {
         allowed_networks.clear();
+        acl_v4.clear();
+        acl_v6.clear();
     };
 
     enum {
@@ -121,8 +158,25 @@ public:
     void dump(ad2_addr& addr);
 
 private:
-    // @brief check if addr is between(inclusive) s and e
-    bool _in_addr_BETWEEN(ad2_addr& addr, ad2_addr& start, ad2_addr& end);
+    // @brief 128bit address as two host order words for compares.
+    struct addr128 {
+        uint64_t hi;
+        uint64_t lo;
+        bool operator<(const addr128& b) const
+        {
+            return hi < b.hi || (hi == b.hi && lo < b.lo);
+        }
+    };
+
+    // @brief parse ACL tokens into allowed_networks.
+    int _add_tokens(std::string& acl);
+
+    // @brief build the sorted and merged interval tables.
+    void _compile();
+
+    // @brief binary search the IPv4 / IPv6 interval tables.
+    bool _find_v4(uint32_t addr);
+    bool _find_v6(const addr128& addr);
 
     // @brief 128bit left shift.
     // @note modifies addr
@@ -144,6 +198,11 @@ private:
 
     // @brief list of allowed network start and end addresses.
     vector<pair<ad2_addr,ad2_addr>> allowed_networks;
+
+    // @brief compiled tables. IPv4 is kept in the last word of an ad2_addr
+    // with the upper 96 bits set so it gets its own 32 bit table.
+    vector<pair<uint32_t,uint32_t>> acl_v4;
+    vector<pair<addr128,addr128>> acl_v6;
 };
 
 // Configuration Storage utilities
@@ -188,14 +247,10 @@ void ad2_load_persistent_config();
 void ad2_save_persistent_config();
 bool ad2_config_uses_sd();
 
-// ASYNC serialized http request api for components.
-
-/// ad2_http async http request callback. Called before esp_http_client_perform()
-typedef void (*ad2_http_sendQ_ready_cb_t)(esp_http_client_handle_t, esp_http_client_config_t*);
-/// ad2_http async http request callback. Called before after esp_http_client_cleanup()
-typedef bool (*ad2_http_sendQ_done_cb_t)(esp_err_t, esp_http_client_handle_t, esp_http_client_config_t*);
-void ad2_init_http_sendQ();
-bool ad2_add_http_sendQ(esp_http_client_config_t*, ad2_http_sendQ_ready_cb_t, ad2_http_sendQ_done_cb_t);
+/// config change callback. Given the changed sections matching the subscription.
+typedef void (*ad2_config_change_cb_t)(std::vector<std::string> &sections, void *arg);
+void ad2_config_subscribe(const char *section, ad2_config_change_cb_t fn, void *arg);
+int ad2_reload_persistent_config();
 
 
 #endif /* _AD2_UTILS_H */
@@ -99,7 +99,8 @@ static const char *TAG = "AD2_IoT";
 */
 int g_StopMainTask = 0;
 
-// all module init have finished no more calls to AlarmDecoderParser::subscribeTo
+// all module init have finished. Later AlarmDecoderParser::subscribeTo calls
+// must hold g_ad2_parser_mutex.
 int g_init_done = 0;
 
 // Critical section spin lock.
@@ -111,6 +112,9 @@ SemaphoreHandle_t g_ad2_console_mutex = nullptr;
 // global AlarmDecoder parser class instance
 AlarmDecoderParser AD2Parse;
 
+// global AlarmDecoder parser access mutex
+SemaphoreHandle_t g_ad2_parser_mutex = nullptr;
+
 // global AD2 device connection fd/id <socket or uart id>
 int g_ad2_client_handle = -1;
 
@@ -321,16 +325,13 @@ void SER2SOCKD_ON_RAW_RX_DATA(uint8_t *buffer, size_t s, void *arg)
 void ad2_on_state_change(std::string *msg, AD2PartitionState *s, void *arg)
 {
     if (s) {
-        cJSON *root = ad2_get_partition_state_json(s);
-        cJSON_AddStringToObject(root, "event", AD2Parse.event_str[(int)arg].c_str());
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
-
         // Notify CLI of the new state for easy console diagnostics of panel.
-        ad2_printf_host(true, "%s: %s", TAG, state);
-
-        cJSON_free(state);
-        cJSON_Delete(root);
+        ad2_json_snapshot_ptr snap = ad2_json_get_snapshot(s);
+        if (snap) {
+            ad2_printf_host(true, "%s: {%.*s,\"event\":\"%s\"}", TAG,
+                            (int)snap->state_length(), snap->state(),
+                            AD2Parse.event_str[(int)arg].c_str());
+        }
     }
 }
 
@@ -535,7 +536,85 @@ bool _show_pretty_process_list()
     // clear screen home cursor and print report header
     ad2_printf_host(false, "\033[H\033[2J\033[3J");
     ad2_printf_host(false, "top - %s up %i days TS: %llu Tasks: %-2lu\r\n", esp_log_system_timestamp(), days, uTotalTime, uxArraySize);
-    ad2_printf_host(false, "Mem: %lu total, %lu free, %lu min free\r\n\r\n", heap_total, heap_free, heap_min_free);
+    ad2_printf_host(false, "Mem: %lu total, %lu free, %lu min free\r\n", heap_total, heap_free, heap_min_free);
+
+    // AD2 command queue stats
+    ad2_cmd_sendQ_stats_t cmdq;
+    ad2_get_cmd_sendQ_stats(&cmdq);
+    ad2_printf_host(false, "AD2 cmdQ: %lu queued, %lu max, %lu sent, %lu acked, %lu ack timeouts, %lu coalesced, %lu dropped, %lu ms avg, %lu ms max latency\r\n",
+                    cmdq.depth, cmdq.max_depth, cmdq.sent, cmdq.acked, cmdq.ack_timeouts, cmdq.coalesced,
+                    cmdq.dropped, cmdq.avg_latency_ms, cmdq.max_latency_ms);
+    static const char *cmdq_sources[AD2_SEND_SRC_COUNT] = { "api", "keypad", "term", "ser2sock", "mqtt" };
+    for (int n = 0; n < AD2_SEND_SRC_COUNT; n++) {
+        ad2_cmd_sendQ_source_stats_t &src = cmdq.sources[n];
+        if (src.queued || src.dropped) {
+            ad2_printf_host(false, "AD2 cmdQ %s: %lu queued, %lu sent, %lu dropped, %lu waited, %lu ms avg, %lu ms max latency\r\n",
+                            cmdq_sources[n], src.queued, src.sent, src.dropped, src.waited, src.avg_latency_ms, src.max_latency_ms);
+        }
+    }
+
+    // HTTP sendQ lane stats
+    ad2_http_sendQ_stats_t sendq;
+    ad2_get_http_sendQ_stats(&sendq);
+    ad2_printf_host(false, "HTTP sendQ: life %lu/%lu/%lu ms, security %lu/%lu/%lu ms, info %lu/%lu/%lu ms (queued/sent/max wait), %lu evicted, %lu coalesced, %lu dropped, %lu notifications, %lu merged, %lu requests\r\n",
+                    sendq.depth[AD2_HTTP_PRIO_LIFE_SAFETY], sendq.sent[AD2_HTTP_PRIO_LIFE_SAFETY], sendq.max_wait_ms[AD2_HTTP_PRIO_LIFE_SAFETY],
+                    sendq.depth[AD2_HTTP_PRIO_SECURITY], sendq.sent[AD2_HTTP_PRIO_SECURITY], sendq.max_wait_ms[AD2_HTTP_PRIO_SECURITY],
+                    sendq.depth[AD2_HTTP_PRIO_INFO], sendq.sent[AD2_HTTP_PRIO_INFO], sendq.max_wait_ms[AD2_HTTP_PRIO_INFO],
+                    sendq.evicted, sendq.coalesced, sendq.dropped, sendq.messages, sendq.merged, sendq.requests);
+
+    // HTTP sendQ spool stats
+    ad2_http_spool_stats_t spool;
+    ad2_get_http_spool_stats(&spool);
+    ad2_printf_host(false, "HTTP spool(%s): %lu/%lu queued, %lu s oldest, %lu spooled, %lu retried, %lu delivered, %lu dropped, %lu write errors\r\n",
+                    spool.persistent ? "uSD" : "RAM", spool.depth, spool.capacity, spool.oldest_age_s,
+                    spool.spooled, spool.replayed, spool.delivered, spool.dropped, spool.write_errors);
+
+    // HTTP sendQ connection pool stats
+    ad2_http_pool_stats_t httpq;
+    ad2_get_http_pool_stats(&httpq);
+    ad2_printf_host(false, "HTTP pool: %lu open, %lu hits, %lu misses, %lu retries, %lu idle closed, %lu heap closed, %lu error closed\r\n",
+                    httpq.open, httpq.hits, httpq.misses, httpq.retries, httpq.idle_closed,
+                    httpq.heap_closed, httpq.error_closed);
+
+    // Shared DNS cache stats
+    ad2_dns_stats_t dns;
+    ad2_get_dns_stats(&dns);
+    ad2_printf_host(false, "DNS cache: %lu hosts, %lu hits, %lu misses, %lu stale, %lu failures, %lu bypassed, %lu prefetched, %llu ms saved\r\n",
+                    dns.entries, dns.hits, dns.misses, dns.stale, dns.failures, dns.bypassed, dns.prefetches, dns.saved_ms);
+
+    // Partition state snapshot stats
+    ad2_json_snapshot_stats_t snaps;
+    ad2_get_json_snapshot_stats(&snaps);
+    ad2_printf_host(false, "State snapshots: %lu rendered, %lu shared\r\n",
+                    snaps.rendered, snaps.shared);
+
+#if CONFIG_AD2IOT_MQTT_CLIENT
+    // MQTT retained state publish stats
+    mqtt_stats_t mqtt;
+    mqtt_get_stats(&mqtt);
+    ad2_printf_host(false, "MQTT: %lu sent, %lu unchanged suppressed, %lu topics tracked, %lu CBOR copies\r\n",
+                    mqtt.sent, mqtt.suppressed, mqtt.topics, mqtt.cbor_sent);
+    ad2_printf_host(false, "MQTT discovery: %s, %lu sent, %lu unchanged, %lu in flight, %lu ms last walk\r\n",
+                    mqtt.discovery_walking ? "walking" : "idle", mqtt.discovery_sent,
+                    mqtt.discovery_unchanged, mqtt.discovery_inflight, mqtt.discovery_ms);
+    if (mqtt.outbox_open) {
+        ad2_printf_host(false, "MQTT outbox(uSD): %lu/%lu queued, %lu in flight, %lu of %lu replayed since connect, %lu spooled, %lu collapsed, %lu replayed, %lu dropped, %lu write errors\r\n",
+                        mqtt.outbox_depth, mqtt.outbox_capacity, mqtt.outbox_inflight,
+                        mqtt.outbox_session, mqtt.outbox_session + mqtt.outbox_depth,
+                        mqtt.outbox_spooled, mqtt.outbox_collapsed, mqtt.outbox_replayed,
+                        mqtt.outbox_dropped, mqtt.outbox_write_errors);
+    }
+    if (mqtt.zone_batch) {
+        ad2_printf_host(false, "MQTT zone batching: %lu zone changes, %lu partition deltas, %lu zone topic updates\r\n",
+                        mqtt.zone_changes, mqtt.zone_deltas, mqtt.zone_updates);
+    }
+    if (mqtt.commands) {
+        ad2_printf_host(false, "MQTT commands: %lu received, %lu queued, %lu dropped, rejected %lu retained, %lu size, %lu json, %lu action, %lu rate limited\r\n",
+                        mqtt.commands, mqtt.commands_queued, mqtt.commands_dropped, mqtt.commands_retained, mqtt.commands_bad_size,
+                        mqtt.commands_bad_json, mqtt.commands_bad_action, mqtt.commands_rate_limited);
+    }
+#endif
+    ad2_printf_host(false, "\r\n");
 
     ad2_printf_host(false, "\033[7m");
     ad2_printf_host(false, TABBED_HEADER_FMT, "Name", "ID", "State", "Priority", "Stack", "CPU#", "Time", "%TBusy", "%Busy");
@@ -732,7 +811,9 @@ static void ad2uart_client_task(void *pvParameters)
                 vTaskDelay(5000 / portTICK_PERIOD_MS);
             }
             if (len>0) {
+                xSemaphoreTake(g_ad2_parser_mutex, portMAX_DELAY);
                 AD2Parse.put(rx_buffer, len);
+                xSemaphoreGive(g_ad2_parser_mutex);
             }
         }
         vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -878,7 +959,9 @@ static void ser2sock_client_task(void *pvParameters)
                         else {
                             // Parse data from AD2* and report back to host.
                             rx_buffer[len] = 0; // Null-terminate whatever we received and treat like a string
+                            xSemaphoreTake(g_ad2_parser_mutex, portMAX_DELAY);
                             AD2Parse.put(rx_buffer, len);
+                            xSemaphoreGive(g_ad2_parser_mutex);
                         }
                     }
                     if (!hal_get_network_connected()) {
@@ -994,6 +1077,9 @@ extern "C" {
         // Create console access mutex.
         g_ad2_console_mutex = xSemaphoreCreateMutex();
 
+        // Create parser access mutex.
+        g_ad2_parser_mutex = xSemaphoreCreateMutex();
+
         // Redirect ESP-IDF log to our own handler.
         esp_log_set_vprintf(&ad2_log_vprintf_host);
 
@@ -1027,7 +1113,8 @@ extern "C" {
         size_t mem_a = heap_caps_get_free_size(MALLOC_CAP_8BIT);
         ad2_load_persistent_config();
         size_t mem_b = heap_caps_get_free_size(MALLOC_CAP_8BIT);
-        ad2_printf_host(true, "%s: Approximate Configuration memory usage: %d B", TAG, mem_a - mem_b);
+        ad2_printf_host(true, "%s: Approximate Configuration memory usage: %d B largest free block: %d B", TAG, mem_a - mem_b,
+                        heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
 
         // Persistent logging is opt-in and starts only after config and uSD mount.
         ad2_init_sd_logging();
@@ -1176,6 +1263,9 @@ extern "C" {
             init_ad2_uart_client(ad2_mode_args.c_str());
         }
 
+        // Start the outbound AD2 command queue and writer task.
+        ad2_init_cmd_sendQ();
+
         // Start the CLI.
         // Press "..."" to halt startup and stay if a safe mode command line only.
         cli_main();
@@ -1252,8 +1342,17 @@ extern "C" {
         AD2Parse.subscribeTo(ON_VER, ad2_on_ver, (void *)ON_VER);
 #endif
 
+        // Serialized partition state shared by MQTT, web and console readers.
+        ad2_init_json_snapshots();
+
+        // Persistent event journal on the uSD card.
+        ad2_init_journal();
+
         // Start components
 
+        // Shared DNS cache for outbound service hosts.
+        ad2_init_dns_cache();
+
         // Initialize ad2 HTTP request sendQ and consumer task.
         ad2_init_http_sendQ();
 
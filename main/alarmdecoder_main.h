@@ -47,6 +47,24 @@
 // Common utils
 #include "ad2_utils.h"
 
+// Diagnostic log history
+#include "ad2_log.h"
+
+// Streaming JSON writer and document schemas
+#include "ad2_json.h"
+
+// Persistent event journal
+#include "ad2_journal.h"
+
+// HTTP sendQ scheduler
+#include "ad2_http_sendq.h"
+
+// HTTP sendQ retry spool
+#include "ad2_http_spool.h"
+
+// Shared DNS cache
+#include "ad2_dns.h"
+
 // HAL
 #include "device_control.h"
 
@@ -64,6 +82,10 @@ extern SemaphoreHandle_t g_ad2_console_mutex;
 // global AlarmDecoder parser class instance
 extern AlarmDecoderParser AD2Parse;
 
+// global AlarmDecoder parser access mutex. Held while parsing and while
+// subscriptions change after init.
+extern SemaphoreHandle_t g_ad2_parser_mutex;
+
 // global AD2 device connection fd/id <socket or uart id>
 extern int g_ad2_client_handle;
 
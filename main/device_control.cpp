@@ -1077,6 +1077,18 @@ void hal_get_socket_client_ip(int sockfd, std::string& IP)
 #endif
 }
 
+/**
+ * @brief Return the client address of a socket for ACL tests.
+ *
+ * @return bool true if the peer address was found.
+ */
+bool hal_get_socket_client_addr(int sockfd, struct sockaddr_storage& addr)
+{
+    socklen_t addr_size = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    return !getpeername(sockfd, (sockaddr *) &addr, &addr_size);
+}
+
 /**
  * @brief Return a string of the local address from a socket.
  */
@@ -139,6 +139,7 @@ void hal_set_network_connected(bool connected);
 void hal_do_fwupdate(const char *);
 bool hal_init_sd_card();
 void hal_get_socket_client_ip(int sockfd, std::string& IP);
+bool hal_get_socket_client_addr(int sockfd, struct sockaddr_storage& addr);
 void hal_get_socket_local_ip(int sockfd, std::string& IP);
 void hal_set_log_mode(char m);
 void hal_dump_hw_info();
@@ -0,0 +1,296 @@
+/**
+ *  @file    cjson_fakes.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief cJSON document building for the host tests. Builds the same
+ *  child/next tree as cJSON so results can be walked by tests.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// host includes
+#include "host.h"
+#include <string>
+
+size_t host_cjson_allocs = 0;
+
+static cJSON *_cjson_new(int type)
+{
+    host_cjson_allocs++;
+    cJSON *item = (cJSON *)calloc(1, sizeof(cJSON));
+    item->type = type;
+    return item;
+}
+
+static char *_cjson_strdup(const char *s)
+{
+    host_cjson_allocs++;
+    return strdup(s);
+}
+
+static void _cjson_add(cJSON *parent, const char *name, cJSON *item)
+{
+    if (!parent || !item) {
+        return;
+    }
+    if (name) {
+        item->string = _cjson_strdup(name);
+    }
+    if (!parent->child) {
+        parent->child = item;
+        item->prev = item;
+        return;
+    }
+    // like cJSON the head's prev is the tail.
+    cJSON *tail = parent->child->prev;
+    tail->next = item;
+    item->prev = tail;
+    parent->child->prev = item;
+}
+
+cJSON *cJSON_CreateObject()
+{
+    return _cjson_new(cJSON_Object);
+}
+
+cJSON *cJSON_CreateArray()
+{
+    return _cjson_new(cJSON_Array);
+}
+
+cJSON *cJSON_CreateString(const char *string)
+{
+    cJSON *item = _cjson_new(cJSON_String);
+    item->valuestring = _cjson_strdup(string ? string : "");
+    return item;
+}
+
+cJSON *cJSON_CreateNumber(double number)
+{
+    cJSON *item = _cjson_new(cJSON_Number);
+    item->valuedouble = number;
+    item->valueint = (int)number;
+    return item;
+}
+
+cJSON *cJSON_CreateBool(cJSON_bool boolean)
+{
+    return _cjson_new(boolean ? cJSON_True : cJSON_False);
+}
+
+cJSON *cJSON_CreateNull()
+{
+    return _cjson_new(cJSON_NULL);
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string)
+{
+    cJSON *item = cJSON_CreateString(string);
+    _cjson_add(object, name, item);
+    return item;
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number)
+{
+    cJSON *item = cJSON_CreateNumber(number);
+    _cjson_add(object, name, item);
+    return item;
+}
+
+cJSON *cJSON_AddBoolToObject(cJSON *object, const char *name, cJSON_bool boolean)
+{
+    cJSON *item = cJSON_CreateBool(boolean);
+    _cjson_add(object, name, item);
+    return item;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *name, cJSON *item)
+{
+    _cjson_add(object, name, item);
+    return object && item;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+    _cjson_add(array, nullptr, item);
+    return array && item;
+}
+
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *object, const char *string)
+{
+    for (cJSON *item = object ? object->child : nullptr; item; item = item->next) {
+        if (item->string && strcmp(item->string, string) == 0) {
+            return item;
+        }
+    }
+    return nullptr;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *string)
+{
+    for (cJSON *item = object ? object->child : nullptr; item; item = item->next) {
+        if (item->string && strcasecmp(item->string, string) == 0) {
+            return item;
+        }
+    }
+    return nullptr;
+}
+
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    cJSON *item = array ? array->child : nullptr;
+    while (item && index-- > 0) {
+        item = item->next;
+    }
+    return item;
+}
+
+int cJSON_GetArraySize(const cJSON *array)
+{
+    int size = 0;
+    for (cJSON *item = array ? array->child : nullptr; item; item = item->next) {
+        size++;
+    }
+    return size;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *item)
+{
+    return item && item->type == cJSON_Number;
+}
+
+cJSON_bool cJSON_IsString(const cJSON *item)
+{
+    return item && item->type == cJSON_String;
+}
+
+// documents from the network are not parsed on the host.
+cJSON *cJSON_Parse(const char *value)
+{
+    return nullptr;
+}
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t length)
+{
+    return nullptr;
+}
+
+// escaped as cJSON does. Other bytes, UTF-8 included, are copied.
+static void _cjson_print_string(const char *s, std::string &out)
+{
+    out += '"';
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            } else {
+                out += (char)c;
+            }
+            break;
+        }
+    }
+    out += '"';
+}
+
+static void _cjson_print(const cJSON *item, std::string &out)
+{
+    switch (item->type) {
+    case cJSON_False:
+        out += "false";
+        break;
+    case cJSON_True:
+        out += "true";
+        break;
+    case cJSON_NULL:
+        out += "null";
+        break;
+    case cJSON_Number: {
+        char num[32];
+        snprintf(num, sizeof(num), "%.17g", item->valuedouble);
+        out += num;
+        break;
+    }
+    case cJSON_String:
+        _cjson_print_string(item->valuestring, out);
+        break;
+    default:
+        out += item->type == cJSON_Array ? '[' : '{';
+        for (cJSON *kid = item->child; kid; kid = kid->next) {
+            if (kid != item->child) {
+                out += ',';
+            }
+            if (item->type == cJSON_Object) {
+                _cjson_print_string(kid->string, out);
+                out += ':';
+            }
+            _cjson_print(kid, out);
+        }
+        out += item->type == cJSON_Array ? ']' : '}';
+        break;
+    }
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item)
+{
+    std::string out;
+    _cjson_print(item, out);
+    return _cjson_strdup(out.c_str());
+}
+
+void cJSON_free(void *object)
+{
+    free(object);
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item) {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
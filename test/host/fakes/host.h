@@ -0,0 +1,99 @@
+/**
+ *  @file    host.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Controls for the ESP-IDF and FreeRTOS fakes used by the host tests.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_HOST_H
+#define _AD2_HOST_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/// Fail the test with the file and line of a false condition. Unlike
+/// assert() it is never compiled out.
+#define HOST_CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+/// FreeRTOS tick count. Tests move time forward by hand.
+extern TickType_t host_ticks;
+/// hal_uptime_us() result. Follows host_ticks unless set directly.
+extern uint64_t host_uptime_us;
+/// Run tasks given to xTaskCreate() at once on the caller's stack.
+extern bool host_task_inline;
+/// Tasks started with xTaskCreate() while host_task_inline was false.
+extern int host_tasks_created;
+/// esp_get_free_heap_size() result.
+extern uint32_t host_free_heap;
+/// hal_get_network_connected() result.
+extern bool host_network_connected;
+/// ulTaskNotifyTake() calls left before it throws host_task_stop. -1 never
+/// throws.
+extern int host_notify_wakes;
+/// ulTaskNotifyTake() in host_run_task() waits out its timeout as if
+/// nothing notified the task.
+extern bool host_notify_timeout;
+struct host_task_stop {};
+/// Called each time ulTaskNotifyTake() wakes a task in host_run_task() as
+/// if other tasks ran while it waited.
+extern void (*host_notify_hook)();
+/// dns_getserver() results. All any so the DNS cache has no server.
+extern ip_addr_t host_dns_servers[DNS_MAX_SERVERS];
+/// Data written with uart_write_bytes(), one entry per write.
+extern std::vector<std::string> host_uart;
+/// Called by vTaskDelay() as if other tasks ran meanwhile.
+extern void (*host_delay_hook)();
+/// Data written with cli_write_bytes(), one entry per write.
+extern std::vector<std::string> host_console;
+/// Called by every semaphore take and give.
+extern void (*host_lock_hook)(SemaphoreHandle_t s, bool take);
+/// esp_ptr_in_drom() result. nullptr treats every pointer as flash.
+extern bool (*host_ptr_in_drom)(const void *p);
+
+/// malloc() calls made by the cJSON fakes. One per node, key and string
+/// value and one for the printed text, as cJSON makes.
+extern size_t host_cjson_allocs;
+/// operator new counters.
+extern size_t host_heap_live;
+extern size_t host_heap_peak;
+extern size_t host_heap_allocs;
+
+/// Advance host_ticks and the uptime by ms.
+void host_advance_ms(uint32_t ms);
+/// Reset host_heap_peak to the live size.
+void host_heap_mark();
+/// Run a task loop for wakes turns of ulTaskNotifyTake().
+void host_run_task(TaskFunction_t fn, int wakes);
+/// Function of the last task started with xTaskCreate() under name.
+TaskFunction_t host_task(const char *name);
+/// Handler of a command given to cli_register_command().
+command_function_t host_command(const char *name);
+/// Parse one AD2 message line with AD2Parse.
+void host_feed(const std::string &msg);
+/// An Ademco keypad message with the given bit section, numeric and
+/// alpha text for the keypad at address 18.
+std::string host_keypad(const char *bits, const char *numeric, const char *alpha);
+
+#endif /* _AD2_HOST_H */
@@ -0,0 +1,197 @@
+/**
+ *  @file    http_fakes.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief esp_http_client fake for the host tests. Requests are recorded
+ *  instead of sent.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// host includes
+#include "host.h"
+#include "http_host.h"
+#include <set>
+
+std::vector<host_http_request> host_http_requests;
+int host_http_inits = 0;
+int host_http_cleanups = 0;
+int host_http_connects = 0;
+int host_http_status = 200;
+uint32_t host_http_latency_ms = 0;
+int host_http_fail = 0;
+bool host_http_fail_sent = false;
+void (*host_http_on_request)(const host_http_request &req) = nullptr;
+
+static std::set<host_http_client *> _host_http_clients;
+
+static void _host_http_event(host_http_client *c, esp_http_client_event_id_t id)
+{
+    if (!c->config.event_handler) {
+        return;
+    }
+    esp_http_client_event_t evt = {};
+    evt.event_id = id;
+    evt.client = c;
+    evt.user_data = c->config.user_data;
+    c->config.event_handler(&evt);
+}
+
+void host_http_server_close()
+{
+    for (auto *c : _host_http_clients) {
+        c->connected = false;
+    }
+}
+
+void host_http_reset()
+{
+    host_http_requests.clear();
+    host_http_inits = 0;
+    host_http_cleanups = 0;
+    host_http_connects = 0;
+    host_http_status = 200;
+    host_http_latency_ms = 0;
+    host_http_fail = 0;
+    host_http_fail_sent = false;
+    host_http_on_request = nullptr;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    host_http_client *c = new host_http_client();
+    c->config = *config;
+    c->url = config->url ? config->url : "";
+    c->method = config->method;
+    c->connected = false;
+    _host_http_clients.insert(c);
+    host_http_inits++;
+    return c;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    host_http_client *c = (host_http_client *)client;
+    if (c->connected) {
+        _host_http_event(c, HTTP_EVENT_DISCONNECTED);
+    }
+    _host_http_clients.erase(c);
+    delete c;
+    host_http_cleanups++;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    ((host_http_client *)client)->connected = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    host_http_client *c = (host_http_client *)client;
+    bool reused = c->connected;
+    if (!c->connected) {
+        host_http_connects++;
+        c->connected = true;
+        _host_http_event(c, HTTP_EVENT_ON_CONNECTED);
+    }
+    host_advance_ms(host_http_latency_ms);
+    if (host_http_fail > 0) {
+        host_http_fail--;
+        if (host_http_fail_sent) {
+            _host_http_event(c, HTTP_EVENT_HEADERS_SENT);
+        }
+        c->connected = false;
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    _host_http_event(c, HTTP_EVENT_HEADERS_SENT);
+    host_http_request req = { c->url, c->method, c->post, c->headers, reused };
+    host_http_requests.push_back(req);
+    if (host_http_on_request) {
+        host_http_on_request(req);
+    }
+    _host_http_event(c, HTTP_EVENT_ON_FINISH);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    ((host_http_client *)client)->url = url;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    ((host_http_client *)client)->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len)
+{
+    host_http_client *c = (host_http_client *)client;
+    c->post.assign(data ? data : "", data ? len : 0);
+    if (!data) {
+        c->headers.erase("Content-Type");
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    ((host_http_client *)client)->headers[key] = value;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    ((host_http_client *)client)->headers.erase(key);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_user_data(esp_http_client_handle_t client, void *data)
+{
+    ((host_http_client *)client)->config.user_data = data;
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return host_http_status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return 0;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client)
+{
+    return false;
+}
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    return ESP_OK;
+}
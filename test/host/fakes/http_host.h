@@ -0,0 +1,72 @@
+/**
+ *  @file    http_host.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Controls for the esp_http_client fake used by the host tests.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_HTTP_HOST_H
+#define _AD2_HTTP_HOST_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/// A fake esp_http_client. perform() answers with host_http_status after
+/// host_http_latency_ms without any network.
+struct host_http_client {
+    esp_http_client_config_t config;
+    std::string url;
+    esp_http_client_method_t method;
+    std::string post;
+    std::map<std::string, std::string> headers;
+    bool connected;
+};
+
+/// A request as the fake server saw it.
+struct host_http_request {
+    std::string url;
+    esp_http_client_method_t method;
+    std::string post;
+    std::map<std::string, std::string> headers;
+    bool reused;             ///< sent on an open connection.
+};
+
+/// Requests performed, in order.
+extern std::vector<host_http_request> host_http_requests;
+/// esp_http_client_init(), cleanup() and new connection counts.
+extern int host_http_inits;
+extern int host_http_cleanups;
+extern int host_http_connects;
+/// Status code of every response.
+extern int host_http_status;
+/// Time each perform() takes.
+extern uint32_t host_http_latency_ms;
+/// The next n perform() calls fail. Before the headers are written unless
+/// host_http_fail_sent is set.
+extern int host_http_fail;
+extern bool host_http_fail_sent;
+/// Called with each request before the response.
+extern void (*host_http_on_request)(const host_http_request &req);
+
+/// Drop the connection of every live client as an idle server would.
+void host_http_server_close();
+/// Forget recorded requests and counters.
+void host_http_reset();
+
+#endif /* _AD2_HTTP_HOST_H */
@@ -0,0 +1,422 @@
+/**
+ *  @file    idf_fakes.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Single threaded ESP-IDF, FreeRTOS and board fakes for the host tests.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// host includes
+#include "host.h"
+#include <malloc.h>
+#include <map>
+#include <new>
+
+TickType_t host_ticks = 0;
+uint64_t host_uptime_us = 0;
+bool host_task_inline = false;
+int host_tasks_created = 0;
+uint32_t host_free_heap = 200 * 1024;
+bool host_network_connected = true;
+int host_notify_wakes = -1;
+bool host_notify_timeout = false;
+void (*host_notify_hook)() = nullptr;
+ip_addr_t host_dns_servers[DNS_MAX_SERVERS] = {};
+std::vector<std::string> host_uart;
+void (*host_delay_hook)() = nullptr;
+bool (*host_ptr_in_drom)(const void *p) = nullptr;
+std::vector<std::string> host_console;
+void (*host_lock_hook)(SemaphoreHandle_t s, bool take) = nullptr;
+static std::map<std::string, TaskFunction_t> _host_tasks;
+static std::map<std::string, command_function_t> _host_commands;
+static uintptr_t _host_mutexes = 0x100;
+size_t host_heap_live = 0;
+size_t host_heap_peak = 0;
+size_t host_heap_allocs = 0;
+
+void host_advance_ms(uint32_t ms)
+{
+    host_ticks += pdMS_TO_TICKS(ms);
+    host_uptime_us += (uint64_t)ms * 1000;
+}
+
+void host_heap_mark()
+{
+    host_heap_peak = host_heap_live;
+}
+
+void host_run_task(TaskFunction_t fn, int wakes)
+{
+    host_notify_wakes = wakes;
+    try {
+        fn(nullptr);
+    } catch (host_task_stop &) {
+    }
+    host_notify_wakes = -1;
+}
+
+TaskFunction_t host_task(const char *name)
+{
+    auto it = _host_tasks.find(name);
+    return it == _host_tasks.end() ? nullptr : it->second;
+}
+
+command_function_t host_command(const char *name)
+{
+    auto it = _host_commands.find(name);
+    return it == _host_commands.end() ? nullptr : it->second;
+}
+
+void host_feed(const std::string &msg)
+{
+    std::string line = msg + "\r\n";
+    AD2Parse.put((uint8_t *)line.data(), line.length());
+}
+
+std::string host_keypad(const char *bits, const char *numeric, const char *alpha)
+{
+    char text[33];
+    snprintf(text, sizeof(text), "%-32s", alpha);
+    return std::string("[") + bits + "]," + numeric + ",[f70000071008001c28020000000000],\"" + text + "\"";
+}
+
+void *operator new (size_t n)
+{
+    void *p = malloc(n ? n : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    host_heap_allocs++;
+    host_heap_live += malloc_usable_size(p);
+    if (host_heap_live > host_heap_peak) {
+        host_heap_peak = host_heap_live;
+    }
+    return p;
+}
+
+void operator delete (void *p) noexcept
+{
+    if (p) {
+        host_heap_live -= malloc_usable_size(p);
+        free(p);
+    }
+}
+
+void operator delete (void *p, size_t) noexcept
+{
+    operator delete (p);
+}
+
+// firmware globals normally owned by alarmdecoder_main.cpp.
+AlarmDecoderParser AD2Parse;
+int g_StopMainTask = 0;
+portMUX_TYPE spinlock = portMUX_INITIALIZER_UNLOCKED;
+SemaphoreHandle_t g_ad2_console_mutex = (SemaphoreHandle_t)1;
+SemaphoreHandle_t g_ad2_parser_mutex = (SemaphoreHandle_t)1;
+int g_ad2_client_handle = -1;
+uint8_t g_ad2_mode = 0;
+std::string g_ad2_mode_args;
+bool g_uSD_mounted = false;
+
+// board
+uint64_t hal_uptime_us()
+{
+    return host_uptime_us;
+}
+
+bool hal_get_netif_started()
+{
+    return true;
+}
+
+bool hal_get_network_connected()
+{
+    return host_network_connected;
+}
+
+bool hal_factory_reset(bool erase_sd_config)
+{
+    return false;
+}
+
+void hal_do_fwupdate(const char *arg)
+{
+}
+
+void hal_restart()
+{
+}
+
+void hal_ad2_reset()
+{
+}
+
+// lwIP
+const ip_addr_t *dns_getserver(uint8_t n)
+{
+    return &host_dns_servers[n];
+}
+
+// console
+int cli_write_bytes(const char *buffer, size_t length)
+{
+    host_console.push_back(std::string(buffer, length));
+    return (int)length;
+}
+
+int cli_read_bytes(uint8_t *buffer, size_t length, TickType_t timeout)
+{
+    return 0;
+}
+
+void cli_register_command(cli_cmd_t *cmd)
+{
+    _host_commands[cmd->command] = cmd->command_fn;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size)
+{
+    host_uart.push_back(std::string((const char *)src, size));
+    return (int)size;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t wait)
+{
+    return 0;
+}
+
+// FreeRTOS. Every lock is free and nothing blocks. Mutexes get their own
+// handles so host_lock_hook can tell them apart.
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return (SemaphoreHandle_t)_host_mutexes++;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+    return (SemaphoreHandle_t)_host_mutexes++;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return (SemaphoreHandle_t)1;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait)
+{
+    if (host_lock_hook) {
+        host_lock_hook(s, true);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    if (host_lock_hook) {
+        host_lock_hook(s, false);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t wait)
+{
+    if (host_lock_hook) {
+        host_lock_hook(s, true);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s)
+{
+    if (host_lock_hook) {
+        host_lock_hook(s, false);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *handle)
+{
+    if (handle) {
+        *handle = (TaskHandle_t)1;
+    }
+    _host_tasks[name] = fn;
+    if (host_task_inline) {
+        fn(arg);
+    } else {
+        host_tasks_created++;
+    }
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (host_delay_hook) {
+        host_delay_hook();
+    }
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return host_ticks;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return (TaskHandle_t)1;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    if (host_notify_wakes == 0) {
+        throw host_task_stop();
+    }
+    if (host_notify_wakes > 0) {
+        host_notify_wakes--;
+        bool timeout = host_notify_timeout && wait != portMAX_DELAY;
+        if (timeout) {
+            host_advance_ms(wait * portTICK_PERIOD_MS);
+        }
+        if (host_notify_hook) {
+            host_notify_hook();
+        }
+        return timeout ? 0 : 1;
+    }
+    return 0;
+}
+
+// esp system
+const char *esp_err_to_name(esp_err_t err)
+{
+    return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+uint32_t esp_random()
+{
+    static uint32_t seed = 0x1234;
+    seed = seed * 1103515245 + 12345;
+    return seed >> 1;
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+    for (size_t n = 0; n < len; n++) {
+        ((uint8_t *)buf)[n] = (uint8_t)esp_random();
+    }
+}
+
+uint32_t esp_get_free_heap_size()
+{
+    return host_free_heap;
+}
+
+uint32_t esp_log_timestamp()
+{
+    return (uint32_t)(host_uptime_us / 1000);
+}
+
+int64_t esp_timer_get_time()
+{
+    return (int64_t)host_uptime_us;
+}
+
+void esp_chip_info(esp_chip_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    info->cores = 2;
+}
+
+esp_err_t esp_flash_get_size(void *chip, uint32_t *size)
+{
+    *size = 4 * 1024 * 1024;
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    static const uint8_t fixed[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+    memcpy(mac, fixed, sizeof(fixed));
+    return ESP_OK;
+}
+
+const esp_app_desc_t *esp_app_get_description()
+{
+    static esp_app_desc_t desc = { "AD2IOT-HOST", "alarmdecoder", "00:00:00", "Jan 1 2026", "host" };
+    return &desc;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t need = 4 * ((slen + 2) / 3) + 1;
+    *olen = need;
+    if (!dst || dlen < need) {
+        return -0x002A; // MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL
+    }
+    size_t o = 0;
+    for (size_t n = 0; n < slen; n += 3) {
+        uint32_t v = src[n] << 16;
+        if (n + 1 < slen) {
+            v |= src[n + 1] << 8;
+        }
+        if (n + 2 < slen) {
+            v |= src[n + 2];
+        }
+        dst[o++] = b64[(v >> 18) & 63];
+        dst[o++] = b64[(v >> 12) & 63];
+        dst[o++] = n + 1 < slen ? b64[(v >> 6) & 63] : '=';
+        dst[o++] = n + 2 < slen ? b64[v & 63] : '=';
+    }
+    dst[o] = 0;
+    *olen = o;
+    return 0;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
@@ -0,0 +1,172 @@
+/**
+ *  @file    mqtt_fakes.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Fake esp-mqtt client. Publishes are recorded and QoS 1 publishes wait in an
+ *  outbox for the test to acknowledge.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+#include "ad2mqtt.h"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+std::vector<host_mqtt_publish> host_mqtt_publishes;
+std::map<int, host_mqtt_publish> host_mqtt_outbox;
+std::vector<std::string> host_mqtt_subscriptions;
+bool host_mqtt_enqueue_fail = false;
+
+static esp_event_handler_t _host_mqtt_handler = nullptr;
+static int _host_mqtt_next_id = 1;
+// the live client. Each esp_mqtt_client_init() makes a new one.
+static esp_mqtt_client_handle_t _host_mqtt_client = nullptr;
+static intptr_t _host_mqtt_clients = 0;
+
+void host_mqtt_event(esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t evt = {};
+    evt.event_id = id;
+    evt.client = _host_mqtt_client;
+    evt.msg_id = msg_id;
+    HOST_CHECK(_host_mqtt_handler);
+    _host_mqtt_handler(nullptr, "MQTT_EVENTS", id, &evt);
+}
+
+void host_mqtt_data(const std::string &topic, const std::string &data, bool retain)
+{
+    esp_mqtt_event_t evt = {};
+    evt.event_id = MQTT_EVENT_DATA;
+    evt.client = _host_mqtt_client;
+    evt.topic = (char *)topic.data();
+    evt.topic_len = topic.length();
+    evt.data = (char *)data.data();
+    evt.data_len = data.length();
+    evt.total_data_len = data.length();
+    evt.retain = retain;
+    HOST_CHECK(_host_mqtt_handler);
+    _host_mqtt_handler(nullptr, "MQTT_EVENTS", MQTT_EVENT_DATA, &evt);
+}
+
+bool host_mqtt_ack(int msg_id)
+{
+    if (!host_mqtt_outbox.erase(msg_id)) {
+        return false;
+    }
+    host_mqtt_event(MQTT_EVENT_PUBLISHED, msg_id);
+    return true;
+}
+
+void host_mqtt_ack_all()
+{
+    while (!host_mqtt_outbox.empty()) {
+        host_mqtt_ack(host_mqtt_outbox.begin()->first);
+    }
+}
+
+size_t host_mqtt_outbox_bytes()
+{
+    size_t bytes = 0;
+    for (auto &p : host_mqtt_outbox) {
+        bytes += p.second.topic.length() + p.second.data.length();
+    }
+    return bytes;
+}
+
+mqtt_stats_t host_mqtt_stats()
+{
+    mqtt_stats_t st;
+    mqtt_get_stats(&st);
+    return st;
+}
+
+void host_mqtt_setup(std::initializer_list<std::pair<const char *, const char *>> mqtt, bool ready)
+{
+    // the [mqtt] section names are private to ad2mqtt.cpp.
+    ad2_set_config_key_string("mqtt", "enable", "true");
+    ad2_set_config_key_string("mqtt", "url", "mqtt://host/");
+    for (auto &kv : mqtt) {
+        ad2_set_config_key_string("mqtt", kv.first, kv.second);
+    }
+    ad2_set_config_key_string(AD2PART_CONFIG_SECTION " 1", PART_CONFIG_ADDRESS, "18");
+    host_task_inline = true;
+    ad2_init_json_snapshots();
+    if (ready) {
+        host_feed(host_keypad("00000001000000000A--", "008", "DISARMED CHIME   Ready to Arm"));
+    }
+    mqtt_init();
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    _host_mqtt_client = (esp_mqtt_client_handle_t)++_host_mqtt_clients;
+    return _host_mqtt_client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+        esp_event_handler_t handler, void *arg)
+{
+    _host_mqtt_handler = handler;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    HOST_CHECK(client == _host_mqtt_client);
+    _host_mqtt_client = nullptr;
+    _host_mqtt_handler = nullptr;
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    HOST_CHECK(client && client == _host_mqtt_client);
+    host_mqtt_subscriptions.push_back(topic);
+    return _host_mqtt_next_id++;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store)
+{
+    // never on a destroyed client.
+    HOST_CHECK(client && client == _host_mqtt_client);
+    if (host_mqtt_enqueue_fail) {
+        return -1;
+    }
+    if (len == 0 && data) {
+        len = strlen(data);
+    }
+    host_mqtt_publish p = { topic, std::string(data ? data : "", len), qos, retain, _host_mqtt_next_id++ };
+    if (qos) {
+        host_mqtt_outbox[p.msg_id] = p;
+    }
+    host_mqtt_publishes.push_back(p);
+    return p.msg_id;
+}
@@ -0,0 +1,69 @@
+/**
+ *  @file    mqtt_host.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Controls for the fake esp-mqtt client used by the host tests.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_MQTT_HOST_H
+#define _AD2_MQTT_HOST_H
+
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// A publish as the fake broker saw it.
+struct host_mqtt_publish {
+    std::string topic;
+    std::string data;
+    int qos;
+    int retain;
+    int msg_id;
+};
+
+/// Publishes enqueued on the client, in order.
+extern std::vector<host_mqtt_publish> host_mqtt_publishes;
+/// QoS 1 publishes the broker has not acknowledged yet by msg_id.
+extern std::map<int, host_mqtt_publish> host_mqtt_outbox;
+/// Topics subscribed to.
+extern std::vector<std::string> host_mqtt_subscriptions;
+/// esp_mqtt_client_enqueue() fails while set.
+extern bool host_mqtt_enqueue_fail;
+
+/// Deliver a client event to the registered handler.
+void host_mqtt_event(esp_mqtt_event_id_t id, int msg_id = 0);
+/// Deliver a message on a subscribed topic.
+void host_mqtt_data(const std::string &topic, const std::string &data, bool retain = false);
+/// Acknowledge one QoS 1 publish. false if it is not in the outbox.
+bool host_mqtt_ack(int msg_id);
+/// Acknowledge every QoS 1 publish including any sent in response.
+void host_mqtt_ack_all();
+/// Bytes of topic and payload held in host_mqtt_outbox.
+size_t host_mqtt_outbox_bytes();
+
+/// mqtt_get_stats() as a value.
+mqtt_stats_t host_mqtt_stats();
+/// Enable MQTT with partition 1 at keypad address 18 plus the given
+/// [mqtt] keys, then mqtt_init() with tasks run inline. With ready the
+/// partition first sees a ready keypad message. Nothing is connected.
+void host_mqtt_setup(std::initializer_list<std::pair<const char *, const char *>> mqtt = {},
+                     bool ready = false);
+
+#endif /* _AD2_MQTT_HOST_H */
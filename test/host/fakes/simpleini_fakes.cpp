@@ -0,0 +1,61 @@
+/**
+ *  @file    simpleini_fakes.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief CSimpleIniA stand in. The config store only builds a SimpleIni
+ *  DOM while saving, which the host tests do not cover.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <SimpleIni.h>
+
+void CSimpleIniA::SetUnicode(bool)
+{
+}
+
+void CSimpleIniA::SetMultiLine(bool)
+{
+}
+
+SI_Error CSimpleIniA::LoadFile(const char *)
+{
+    return SI_FILE;
+}
+
+SI_Error CSimpleIniA::SaveFile(const char *, bool) const
+{
+    return SI_FILE;
+}
+
+void CSimpleIniA::GetAllSections(TNamesDepend &) const
+{
+}
+
+bool CSimpleIniA::GetAllKeys(const char *, TNamesDepend &) const
+{
+    return false;
+}
+
+SI_Error CSimpleIniA::SetValue(const char *, const char *, const char *, const char *, bool)
+{
+    return SI_FAIL;
+}
+
+bool CSimpleIniA::Delete(const char *, const char *, bool)
+{
+    return false;
+}
@@ -0,0 +1,5 @@
+#pragma once
+#include "idf_stub.h"
+// every pointer is treated as a flash literal unless a test decides.
+extern bool (*host_ptr_in_drom)(const void *p);
+static inline bool esp_ptr_in_drom(const void *p) { return !host_ptr_in_drom || host_ptr_in_drom(p); }
@@ -0,0 +1,523 @@
+/**
+ *  @file    idf_stub.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief The subset of ESP-IDF, FreeRTOS, lwIP, esp-mqtt, cJSON and
+ *  SimpleIni declarations the firmware uses, for building on the host.
+ *  Every IDF header under stubs/ includes this file. Not part of the
+ *  firmware.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <list>
+#include <map>
+#include <utility>
+#include <algorithm>
+using namespace std;
+
+#define CONFIG_AD2IOT_MQTT_CLIENT 1
+#define CONFIG_AD2IOT_PUSHOVER_CLIENT 1
+#define CONFIG_AD2IOT_TWILIO_CLIENT 1
+#define CONFIG_AD2IOT_WEBSERVER_UI 1
+#define CONFIG_AD2IOT_SER2SOCKD 1
+#define CONFIG_AD2IOT_NETWORK_CLI 1
+#define CONFIG_AD2IOT_FTP_DAEMON 1
+#define CONFIG_HTTPD_WS_SUPPORT 1
+#define CONFIG_ESP_HTTPS_SERVER_ENABLE 1
+#define CONFIG_LWIP_IPV6 1
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_TIMEOUT 0x107
+const char *esp_err_to_name(esp_err_t);
+#define ESP_ERROR_CHECK(x) (void)(x)
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+// log
+#define ESP_LOGI(tag, fmt, ...) printf("%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) printf("%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, fmt, ...) printf("%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) printf("%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) printf("%s: " fmt "\n", tag, ##__VA_ARGS__)
+typedef enum { ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE } esp_log_level_t;
+void esp_log_level_set(const char *, esp_log_level_t);
+typedef int (*vprintf_like_t)(const char *, va_list);
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t);
+
+// freertos
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef void *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+typedef void (*TaskFunction_t)(void *);
+typedef struct { int x; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define configMAX_PRIORITIES 25
+#define tskIDLE_PRIORITY 0
+#define pdMS_TO_TICKS(x) ((TickType_t)(x))
+#define taskENTER_CRITICAL(x) (void)(x)
+#define taskEXIT_CRITICAL(x) (void)(x)
+#define portENTER_CRITICAL(x) (void)(x)
+#define portEXIT_CRITICAL(x) (void)(x)
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t);
+BaseType_t xQueueSend(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueSendToBack(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueSendToFront(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueReceive(QueueHandle_t, void *, TickType_t);
+BaseType_t xQueuePeek(QueueHandle_t, void *, TickType_t);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t);
+void vQueueDelete(QueueHandle_t);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t);
+void vSemaphoreDelete(SemaphoreHandle_t);
+BaseType_t xTaskCreate(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *, BaseType_t);
+void vTaskDelay(TickType_t);
+void vTaskDelete(TaskHandle_t);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+char *pcTaskGetName(TaskHandle_t);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t);
+BaseType_t xTaskNotifyGive(TaskHandle_t);
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t);
+EventGroupHandle_t xEventGroupCreate();
+EventBits_t xEventGroupSetBits(EventGroupHandle_t, EventBits_t);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t, EventBits_t);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t, EventBits_t, BaseType_t, BaseType_t, TickType_t);
+
+// system/heap/timer
+#define MALLOC_CAP_8BIT 4
+#define MALLOC_CAP_32BIT 2
+#define MALLOC_CAP_DEFAULT 4096
+size_t heap_caps_get_free_size(uint32_t);
+size_t heap_caps_get_largest_free_block(uint32_t);
+size_t heap_caps_get_minimum_free_size(uint32_t);
+size_t heap_caps_get_total_size(uint32_t);
+uint32_t esp_get_free_heap_size();
+uint32_t esp_get_minimum_free_heap_size();
+int64_t esp_timer_get_time();
+uint32_t esp_random();
+#define ESP_ERR_HTTP_BASE 0x7000
+#define ESP_ERR_HTTP_CONNECT (ESP_ERR_HTTP_BASE + 3)
+void esp_fill_random(void *, size_t);
+void esp_restart();
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
+typedef struct { char version[32]; char project_name[32]; char time[16]; char date[16]; char idf_ver[32]; } esp_app_desc_t;
+const esp_app_desc_t *esp_app_get_description();
+typedef enum { ESP_MAC_WIFI_STA, ESP_MAC_ETH } esp_mac_type_t;
+esp_err_t esp_read_mac(uint8_t *, esp_mac_type_t);
+typedef struct { int model; uint32_t features; uint16_t revision; uint8_t cores; } esp_chip_info_t;
+void esp_chip_info(esp_chip_info_t *);
+#define CHIP_FEATURE_EMB_FLASH 1
+#define CHIP_FEATURE_BT 2
+#define CHIP_FEATURE_BLE 4
+#define CHIP_FEATURE_WIFI_BGN 8
+esp_err_t esp_flash_get_size(void *, uint32_t *);
+esp_err_t nvs_flash_init();
+int mbedtls_base64_encode(unsigned char *, size_t, size_t *, const unsigned char *, size_t);
+
+// uart
+typedef int uart_port_t;
+typedef struct { int baud_rate, data_bits, parity, stop_bits, flow_ctrl, rx_flow_ctrl_thresh, source_clk; } uart_config_t;
+int uart_write_bytes(uart_port_t, const void *, size_t);
+int uart_read_bytes(uart_port_t, void *, uint32_t, TickType_t);
+esp_err_t uart_param_config(uart_port_t, const uart_config_t *);
+#define UART_DATA_8_BITS 3
+#define UART_PARITY_DISABLE 0
+#define UART_STOP_BITS_1 1
+#define UART_HW_FLOWCTRL_DISABLE 0
+#define UART_NUM_0 0
+#define UART_NUM_2 2
+
+// lwip
+#define closesocket close
+#define lwip_getaddrinfo getaddrinfo
+
+// cJSON
+typedef struct cJSON {
+    struct cJSON *next, *prev, *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+#define cJSON_Invalid 0
+#define cJSON_False 1
+#define cJSON_True 2
+#define cJSON_NULL 4
+#define cJSON_Number 8
+#define cJSON_String 16
+#define cJSON_Array 32
+#define cJSON_Object 64
+typedef int cJSON_bool;
+cJSON *cJSON_CreateObject();
+cJSON *cJSON_CreateArray();
+cJSON *cJSON_CreateString(const char *);
+cJSON *cJSON_CreateNumber(double);
+cJSON *cJSON_CreateBool(cJSON_bool);
+cJSON *cJSON_CreateNull();
+cJSON *cJSON_AddStringToObject(cJSON *, const char *, const char *);
+cJSON *cJSON_AddNumberToObject(cJSON *, const char *, double);
+cJSON *cJSON_AddBoolToObject(cJSON *, const char *, cJSON_bool);
+cJSON *cJSON_AddNullToObject(cJSON *, const char *);
+cJSON *cJSON_AddTrueToObject(cJSON *, const char *);
+cJSON *cJSON_AddFalseToObject(cJSON *, const char *);
+cJSON *cJSON_AddObjectToObject(cJSON *, const char *);
+cJSON *cJSON_AddArrayToObject(cJSON *, const char *);
+cJSON_bool cJSON_AddItemToObject(cJSON *, const char *, cJSON *);
+cJSON_bool cJSON_AddItemToArray(cJSON *, cJSON *);
+cJSON *cJSON_GetObjectItem(const cJSON *, const char *);
+cJSON *cJSON_GetObjectItemCaseSensitive(const cJSON *, const char *);
+cJSON *cJSON_GetArrayItem(const cJSON *, int);
+int cJSON_GetArraySize(const cJSON *);
+cJSON *cJSON_Parse(const char *);
+cJSON *cJSON_ParseWithLength(const char *, size_t);
+char *cJSON_Print(const cJSON *);
+char *cJSON_PrintUnformatted(const cJSON *);
+cJSON_bool cJSON_PrintPreallocated(cJSON *, char *, int, cJSON_bool);
+void cJSON_Minify(char *);
+void cJSON_Delete(cJSON *);
+void cJSON_free(void *);
+cJSON_bool cJSON_IsString(const cJSON *);
+cJSON_bool cJSON_IsNumber(const cJSON *);
+cJSON_bool cJSON_IsBool(const cJSON *);
+cJSON_bool cJSON_IsTrue(const cJSON *);
+cJSON_bool cJSON_IsObject(const cJSON *);
+cJSON_bool cJSON_IsArray(const cJSON *);
+char *cJSON_GetStringValue(const cJSON *);
+cJSON *cJSON_Duplicate(const cJSON *, cJSON_bool);
+#define cJSON_ArrayForEach(element, array) for(element = (array != NULL) ? (array)->child : NULL; element != NULL; element = element->next)
+
+// http client
+typedef void *esp_http_client_handle_t;
+typedef enum { HTTP_METHOD_GET, HTTP_METHOD_POST, HTTP_METHOD_PUT } esp_http_client_method_t;
+typedef enum { HTTP_TRANSPORT_UNKNOWN, HTTP_TRANSPORT_OVER_TCP, HTTP_TRANSPORT_OVER_SSL } esp_http_client_transport_t;
+typedef enum { HTTP_EVENT_ERROR, HTTP_EVENT_ON_CONNECTED, HTTP_EVENT_HEADERS_SENT, HTTP_EVENT_HEADER_SENT = HTTP_EVENT_HEADERS_SENT, HTTP_EVENT_ON_HEADER, HTTP_EVENT_ON_DATA, HTTP_EVENT_ON_FINISH, HTTP_EVENT_DISCONNECTED, HTTP_EVENT_REDIRECT } esp_http_client_event_id_t;
+typedef struct esp_http_client_event {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *);
+typedef struct {
+    const char *url;
+    const char *host;
+    int port;
+    const char *username;
+    const char *password;
+    const char *path;
+    const char *query;
+    const char *cert_pem;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    bool disable_auto_redirect;
+    int max_redirection_count;
+    http_event_handle_cb event_handler;
+    esp_http_client_transport_t transport_type;
+    int buffer_size;
+    int buffer_size_tx;
+    void *user_data;
+    bool is_async;
+    bool use_global_ca_store;
+    bool skip_cert_common_name_check;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    bool keep_alive_enable;
+    int keep_alive_idle;
+    int keep_alive_interval;
+    int keep_alive_count;
+    bool save_client_session;
+} esp_http_client_config_t;
+#define CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS 1
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t, int);
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *);
+esp_err_t esp_http_client_perform(esp_http_client_handle_t);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t);
+esp_err_t esp_http_client_close(esp_http_client_handle_t);
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t, const char *);
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t, const char *, int);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t, const char *, const char *);
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t, const char *);
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t, esp_http_client_method_t);
+esp_err_t esp_http_client_set_user_data(esp_http_client_handle_t, void *);
+int esp_http_client_get_status_code(esp_http_client_handle_t);
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t);
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t);
+esp_err_t esp_crt_bundle_attach(void *conf);
+esp_err_t esp_tls_init_global_ca_store();
+
+// http server
+typedef void *httpd_handle_t;
+typedef enum { HTTP_GET = 1, HTTP_POST = 3, HTTP_PUT = 4, HTTP_DELETE = 0, HTTP_HEAD = 2 } httpd_method_t;
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int method;
+    const char uri[512 + 1];
+    size_t content_len;
+    void *aux;
+    void *user_ctx;
+    void *sess_ctx;
+    void (*free_ctx)(void *ctx);
+    bool ignore_sess_ctx_changes;
+} httpd_req_t;
+typedef struct httpd_uri {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *r);
+    void *user_ctx;
+    bool is_websocket;
+    bool handle_ws_control_frames;
+    const char *supported_subprotocol;
+} httpd_uri_t;
+typedef enum { HTTPD_WS_TYPE_CONTINUE = 0, HTTPD_WS_TYPE_TEXT = 1, HTTPD_WS_TYPE_BINARY = 2, HTTPD_WS_TYPE_CLOSE = 8, HTTPD_WS_TYPE_PING = 9, HTTPD_WS_TYPE_PONG = 10 } httpd_ws_type_t;
+typedef struct httpd_ws_frame { bool final; bool fragmented; httpd_ws_type_t type; uint8_t *payload; size_t len; } httpd_ws_frame_t;
+typedef enum { HTTPD_WS_CLIENT_INVALID = 0, HTTPD_WS_CLIENT_HTTP = 1, HTTPD_WS_CLIENT_WEBSOCKET = 2 } httpd_ws_client_info_t;
+typedef void (*httpd_free_ctx_fn_t)(void *ctx);
+typedef esp_err_t (*httpd_open_func_t)(httpd_handle_t hd, int sockfd);
+typedef void (*httpd_close_func_t)(httpd_handle_t hd, int sockfd);
+typedef bool (*httpd_uri_match_func_t)(const char *, const char *, size_t);
+typedef struct httpd_config {
+    unsigned task_priority; size_t stack_size; int core_id; uint16_t server_port; uint16_t ctrl_port;
+    uint16_t max_open_sockets; uint16_t max_uri_handlers; uint16_t max_resp_headers; uint16_t backlog_conn;
+    bool lru_purge_enable; uint16_t recv_wait_timeout; uint16_t send_wait_timeout;
+    void *global_user_ctx; httpd_free_ctx_fn_t global_user_ctx_free_fn;
+    void *global_transport_ctx; httpd_free_ctx_fn_t global_transport_ctx_free_fn;
+    bool enable_so_linger; int linger_timeout; bool keep_alive_enable; int keep_alive_idle; int keep_alive_interval; int keep_alive_count;
+    httpd_open_func_t open_fn; httpd_close_func_t close_fn; httpd_uri_match_func_t uri_match_fn;
+} httpd_config_t;
+#define HTTPD_DEFAULT_CONFIG() httpd_config_t{}
+typedef struct { httpd_config_t httpd; const uint8_t *servercert; size_t servercert_len; const uint8_t *prvtkey_pem; size_t prvtkey_len; int transport_mode; } httpd_ssl_config_t;
+#define HTTPD_SSL_CONFIG_DEFAULT() httpd_ssl_config_t{}
+#define HTTPD_SSL_TRANSPORT_SECURE 0
+#define HTTPD_SSL_TRANSPORT_INSECURE 1
+typedef enum { HTTPD_500_INTERNAL_SERVER_ERROR = 0, HTTPD_400_BAD_REQUEST, HTTPD_401_UNAUTHORIZED, HTTPD_403_FORBIDDEN, HTTPD_404_NOT_FOUND, HTTPD_405_METHOD_NOT_ALLOWED, HTTPD_408_REQ_TIMEOUT, HTTPD_414_URI_TOO_LONG, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE } httpd_err_code_t;
+#define HTTPD_RESP_USE_STRLEN -1
+#define HTTPD_200 "200 OK"
+#define HTTPD_204 "204 No Content"
+#define HTTPD_207 "207 Multi-Status"
+#define HTTPD_400 "400 Bad Request"
+#define HTTPD_404 "404 Not Found"
+#define HTTPD_408 "408 Request Timeout"
+#define HTTPD_500 "500 Internal Server Error"
+#define HTTPD_SOCK_ERR_TIMEOUT -3
+esp_err_t httpd_start(httpd_handle_t *, const httpd_config_t *);
+esp_err_t httpd_stop(httpd_handle_t);
+esp_err_t httpd_ssl_start(httpd_handle_t *, httpd_ssl_config_t *);
+esp_err_t httpd_ssl_stop(httpd_handle_t);
+esp_err_t httpd_register_uri_handler(httpd_handle_t, const httpd_uri_t *);
+esp_err_t httpd_resp_send(httpd_req_t *, const char *, ssize_t);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *, const char *, ssize_t);
+esp_err_t httpd_resp_sendstr(httpd_req_t *, const char *);
+esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *, const char *);
+esp_err_t httpd_resp_set_type(httpd_req_t *, const char *);
+esp_err_t httpd_resp_set_status(httpd_req_t *, const char *);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *, const char *, const char *);
+esp_err_t httpd_resp_send_err(httpd_req_t *, httpd_err_code_t, const char *);
+esp_err_t httpd_resp_send_404(httpd_req_t *);
+esp_err_t httpd_resp_send_500(httpd_req_t *);
+size_t httpd_req_get_url_query_len(httpd_req_t *);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *, char *, size_t);
+esp_err_t httpd_query_key_value(const char *, const char *, char *, size_t);
+size_t httpd_req_get_hdr_value_len(httpd_req_t *, const char *);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *, const char *, char *, size_t);
+int httpd_req_recv(httpd_req_t *, char *, size_t);
+int httpd_req_to_sockfd(httpd_req_t *);
+esp_err_t httpd_ws_recv_frame(httpd_req_t *, httpd_ws_frame_t *, size_t);
+esp_err_t httpd_ws_send_frame(httpd_req_t *, httpd_ws_frame_t *);
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t, int, httpd_ws_frame_t *);
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t, int);
+esp_err_t httpd_get_client_list(httpd_handle_t, size_t *, int *);
+esp_err_t httpd_queue_work(httpd_handle_t, void (*)(void *), void *);
+esp_err_t httpd_sess_trigger_close(httpd_handle_t, int);
+void *httpd_sess_get_ctx(httpd_handle_t, int);
+void httpd_sess_set_ctx(httpd_handle_t, int, void *, httpd_free_ctx_fn_t);
+bool httpd_uri_match_wildcard(const char *, const char *, size_t);
+esp_err_t httpd_resp_send_custom_err(httpd_req_t *, const char *, const char *);
+
+// mqtt
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+typedef enum { MQTT_EVENT_ANY = -1, MQTT_EVENT_ERROR = 0, MQTT_EVENT_CONNECTED, MQTT_EVENT_DISCONNECTED, MQTT_EVENT_SUBSCRIBED, MQTT_EVENT_UNSUBSCRIBED, MQTT_EVENT_PUBLISHED, MQTT_EVENT_DATA, MQTT_EVENT_BEFORE_CONNECT, MQTT_EVENT_DELETED } esp_mqtt_event_id_t;
+typedef struct esp_mqtt_event_t {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char *data; int data_len; int total_data_len; int current_data_offset;
+    char *topic; int topic_len; int msg_id; int session_present;
+    void *error_handle; bool retain; int qos; bool dup; int protocol_ver;
+} esp_mqtt_event_t;
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *, esp_event_base_t, int32_t, void *);
+typedef struct {
+    struct { struct { const char *uri; const char *hostname; int transport; const char *path; uint32_t port; } address;
+             struct { bool use_global_ca_store; esp_err_t (*crt_bundle_attach)(void *conf); const char *certificate; size_t certificate_len; bool skip_cert_common_name_check; } verification; } broker;
+    struct { const char *username; const char *client_id; bool set_null_client_id; struct { const char *password; const char *certificate; size_t certificate_len; const char *key; size_t key_len; } authentication; } credentials;
+    struct { int keepalive; bool disable_keepalive; bool disable_clean_session; struct { const char *topic; const char *msg; int msg_len; int qos; int retain; } last_will; } session;
+    struct { int reconnect_timeout_ms; int timeout_ms; int refresh_connection_after_ms; bool disable_auto_reconnect; } network;
+    struct { int priority; int stack_size; } task;
+    struct { int size; int out_size; } buffer;
+    struct { int64_t outbox_expired_timeout; } outbox;
+} esp_mqtt_client_config_t;
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t);
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t);
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t);
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t);
+esp_err_t esp_mqtt_set_config(esp_mqtt_client_handle_t, const esp_mqtt_client_config_t *);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t, const char *, int);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t, const char *, const char *, int, int, int);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t, const char *, const char *, int, int, int, bool);
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t, esp_mqtt_event_id_t, esp_event_handler_t, void *);
+#define MQTT_TRANSPORT_OVER_TCP 1
+
+// vfs/storage
+esp_err_t esp_vfs_fat_info(const char *, uint64_t *, uint64_t *);
+esp_err_t esp_spiffs_info(const char *, size_t *, size_t *);
+
+// SimpleIni (subset)
+struct SI_NoCase {};
+typedef int SI_Error;
+#define SI_OK 0
+#define SI_UPDATED 1
+#define SI_INSERTED 2
+#define SI_FAIL -1
+#define SI_NOMEM -2
+#define SI_FILE -3
+class CSimpleIniA {
+public:
+    struct Entry { const char *pItem; const char *pComment; int nOrder; };
+    typedef std::list<Entry> TNamesDepend;
+    void SetUnicode(bool = true);
+    void SetMultiLine(bool = true);
+    void SetMultiKey(bool = true);
+    void SetSpaces(bool = true);
+    void Reset();
+    bool IsEmpty() const;
+    SI_Error LoadFile(const char *);
+    SI_Error LoadData(const char *, size_t);
+    SI_Error LoadData(const std::string &);
+    SI_Error SaveFile(const char *, bool = true) const;
+    SI_Error Save(std::string &, bool = false) const;
+    void GetAllSections(TNamesDepend &) const;
+    bool GetAllKeys(const char *, TNamesDepend &) const;
+    const char *GetValue(const char *, const char *, const char * = NULL, bool * = NULL) const;
+    long GetLongValue(const char *, const char *, long = 0, bool * = NULL) const;
+    bool GetBoolValue(const char *, const char *, bool = false, bool * = NULL) const;
+    SI_Error SetValue(const char *, const char *, const char *, const char * = NULL, bool = false);
+    SI_Error SetLongValue(const char *, const char *, long, const char * = NULL, bool = false, bool = false);
+    SI_Error SetBoolValue(const char *, const char *, bool, const char * = NULL, bool = false);
+    bool KeyExists(const char *, const char *) const;
+    bool SectionExists(const char *) const;
+    bool Delete(const char *, const char *, bool = false);
+    int GetSectionSize(const char *) const;
+};
+
+size_t strlcpy(char *, const char *, size_t);
+uint32_t esp_log_timestamp();
+#include <sys/ioctl.h>
+#include <netinet/tcp.h>
+#include <atomic>
+typedef enum { ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT, ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO } esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason();
+#define UART_PIN_NO_CHANGE -1
+esp_err_t uart_set_pin(uart_port_t, int, int, int, int);
+esp_err_t uart_driver_install(uart_port_t, int, int, int, QueueHandle_t *, int);
+#define ESP_INTR_FLAG_LOWMED 0
+#define MALLOC_CAP_INTERNAL 8
+#define BIT0 1
+#define BIT1 2
+#define BIT2 4
+#define BIT3 8
+#define BIT4 16
+#define BIT5 32
+#define BIT6 64
+#define BIT7 128
+#define ESP_EVENT_ANY_ID -1
+typedef struct esp_netif_obj esp_netif_t;
+typedef struct { void *user_cb; int user_cb_type; struct { int sockfd; void *ssl_ctx; } tls_cfg; } esp_https_server_user_cb_arg_t;
+typedef void (*shutdown_handler_t)(void);
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t);
+static inline UBaseType_t uxTaskGetTaskNumber(TaskHandle_t t){return 0;}
+#ifndef STUB_LWIP_DNS
+#define STUB_LWIP_DNS
+#include <arpa/inet.h>
+typedef struct { uint32_t addr; uint8_t type; } ip_addr_t;
+typedef int8_t err_t;
+typedef uint8_t u8_t;
+#define ERR_OK 0
+#define ERR_VAL -6
+#define DNS_MAX_SERVERS 2
+#define LWIP_IPV6 1
+#define NETCONN_DNS_IPV6 1
+const ip_addr_t *dns_getserver(uint8_t n);
+#define IP_IS_V4(a) ((a)->type == 0)
+#define ip_addr_isany(a) ((a)->addr == 0)
+#define ip_addr_get_ip4_u32(a) ((a)->addr)
+#define ip_addr_set_ip4_u32(a, v) do { (a)->addr = (v); (a)->type = 0; } while (0)
+#define CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM 1
+#endif
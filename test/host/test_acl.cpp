@@ -0,0 +1,288 @@
+/**
+ *  @file    test_acl.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Compiled ACL matching and lookup cost at 1, 10 and 100 entries.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_utils.cpp"
+
+// host includes
+#include "host.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <random>
+
+static std::mt19937 rng(30);
+
+static struct sockaddr_storage peer(const char *ip)
+{
+    struct sockaddr_storage addr = {};
+    if (strchr(ip, ':')) {
+        struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+        addr6->sin6_family = AF_INET6;
+        HOST_CHECK(inet_pton(AF_INET6, ip, &addr6->sin6_addr) == 1);
+    } else {
+        struct sockaddr_in *addr4 = (struct sockaddr_in *)&addr;
+        addr4->sin_family = AF_INET;
+        HOST_CHECK(inet_pton(AF_INET, ip, &addr4->sin_addr) == 1);
+    }
+    return addr;
+}
+
+static std::string ipv4(uint32_t addr)
+{
+    char text[INET_ADDRSTRLEN];
+    uint32_t be = htonl(addr);
+    inet_ntop(AF_INET, &be, text, sizeof(text));
+    return text;
+}
+
+static ad2_acl_check compile(const std::string &text, int want = ad2_acl_check::ACL_FORMAT_OK)
+{
+    ad2_acl_check acl;
+    std::string copy = text;
+    HOST_CHECK(acl.add(copy) == want);
+    return acl;
+}
+
+/**
+ * @brief Test an address by string and by socket address. An IPv4 address
+ * is also tested as an IPv4 mapped IPv6 peer.
+ */
+static bool allowed(ad2_acl_check &acl, const std::string &ip)
+{
+    bool by_string = acl.find(ip);
+    HOST_CHECK(acl.find(peer(ip.c_str())) == by_string);
+    if (ip.find(':') == std::string::npos) {
+        HOST_CHECK(acl.find(peer(("::ffff:" + ip).c_str())) == by_string);
+    }
+    return by_string;
+}
+
+static void test_ipv4()
+{
+    ad2_acl_check acl = compile("192.168.0.0/24, 10.0.0.9-10.0.0.5,172.16.1.1");
+    HOST_CHECK(allowed(acl, "192.168.0.0") && allowed(acl, "192.168.0.255"));
+    HOST_CHECK(!allowed(acl, "192.168.1.0") && !allowed(acl, "192.167.255.255"));
+    HOST_CHECK(allowed(acl, "10.0.0.5") && allowed(acl, "10.0.0.9"));
+    HOST_CHECK(!allowed(acl, "10.0.0.4") && !allowed(acl, "10.0.0.10"));
+    HOST_CHECK(allowed(acl, "172.16.1.1") && !allowed(acl, "172.16.1.2"));
+    // IPv4 entries do not match IPv6 peers.
+    HOST_CHECK(!allowed(acl, "::1") && !allowed(acl, "2001:db8::c0a8:1"));
+    HOST_CHECK(!allowed(acl, "::c0a8:1"));
+
+    acl = compile("0.0.0.0/0");
+    HOST_CHECK(allowed(acl, "0.0.0.0") && allowed(acl, "255.255.255.255") && allowed(acl, "8.8.8.8"));
+    HOST_CHECK(!allowed(acl, "2001:db8::1"));
+    acl = compile("127.0.0.1/32");
+    HOST_CHECK(allowed(acl, "127.0.0.1") && !allowed(acl, "127.0.0.2"));
+}
+
+static void test_ipv6()
+{
+    ad2_acl_check acl = compile("2001:db8::/32, fe80::ff-fe80::1, ::1");
+    HOST_CHECK(allowed(acl, "2001:db8::") && allowed(acl, "2001:db8:ffff:ffff:ffff:ffff:ffff:ffff"));
+    HOST_CHECK(!allowed(acl, "2001:db9::") && !allowed(acl, "2001:db7:ffff:ffff:ffff:ffff:ffff:ffff"));
+    HOST_CHECK(allowed(acl, "fe80::1") && allowed(acl, "fe80::80") && allowed(acl, "fe80::ff"));
+    HOST_CHECK(!allowed(acl, "fe80::") && !allowed(acl, "fe80::100"));
+    HOST_CHECK(allowed(acl, "::1") && !allowed(acl, "::2"));
+    HOST_CHECK(!allowed(acl, "192.168.0.1"));
+
+    // a /64 boundary splits the two 64 bit halves.
+    acl = compile("2001:db8:0:1::/64");
+    HOST_CHECK(allowed(acl, "2001:db8:0:1::") && allowed(acl, "2001:db8:0:1:ffff:ffff:ffff:ffff"));
+    HOST_CHECK(!allowed(acl, "2001:db8:0:2::") && !allowed(acl, "2001:db8::ffff:ffff:ffff:ffff"));
+
+    // all of IPv6 covers the IPv4 block too.
+    acl = compile("::/0");
+    HOST_CHECK(allowed(acl, "::") && allowed(acl, "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"));
+    HOST_CHECK(allowed(acl, "10.1.2.3"));
+    // so does a range that ends inside it.
+    acl = compile("ffff:ffff:ffff:ffff:ffff:ffff:0:0-ffff:ffff:ffff:ffff:ffff:ffff:a00:0");
+    HOST_CHECK(allowed(acl, "0.0.0.0") && allowed(acl, "10.0.0.0") && !allowed(acl, "10.0.0.1"));
+}
+
+static void test_merged()
+{
+    // overlapping, touching, nested and duplicate ranges are merged.
+    ad2_acl_check acl = compile("10.0.0.0/24, 10.0.0.128-10.0.1.10, 10.0.1.11, 10.0.0.0/25, "
+                                "10.0.0.7, 10.0.3.0/24, 10.0.3.0/24");
+    for (uint32_t addr = 0x0a000000 - 16; addr < 0x0a000400 + 16; addr++) {
+        bool want = (addr >= 0x0a000000 && addr <= 0x0a00010b) || (addr >= 0x0a000300 && addr <= 0x0a0003ff);
+        HOST_CHECK(allowed(acl, ipv4(addr)) == want);
+    }
+    acl = compile("fe80::10-fe80::20, fe80::21-fe80::30, fe80::18-fe80::19, fe80::40");
+    HOST_CHECK(allowed(acl, "fe80::10") && allowed(acl, "fe80::25") && allowed(acl, "fe80::30"));
+    HOST_CHECK(!allowed(acl, "fe80::31") && !allowed(acl, "fe80::3f") && allowed(acl, "fe80::40"));
+    // ranges that end at the top of the address space.
+    acl = compile("255.255.255.0/24, 255.255.255.250-255.255.255.255, 255.255.254.255");
+    HOST_CHECK(allowed(acl, "255.255.255.255") && allowed(acl, "255.255.254.255"));
+    HOST_CHECK(!allowed(acl, "255.255.254.254"));
+}
+
+static void test_empty_and_invalid()
+{
+    // no ACL allows everything.
+    ad2_acl_check acl = compile("");
+    HOST_CHECK(allowed(acl, "10.0.0.1") && allowed(acl, "2001:db8::1"));
+
+    compile("300.1.1.1", ad2_acl_check::ACL_ERR_BADFORMAT_IP);
+    compile("hello", ad2_acl_check::ACL_ERR_BADFORMAT_IP);
+    compile("10.0.0.1-nope", ad2_acl_check::ACL_ERR_BADFORMAT_IP);
+    compile("10.0.0.0/200", ad2_acl_check::ACL_ERR_BADFORMAT_CIDR);
+    compile("2001:db8::/129", ad2_acl_check::ACL_ERR_BADFORMAT_CIDR);
+    compile("2001:db8::zz", ad2_acl_check::ACL_ERR_BADFORMAT_IP);
+
+    // entries before a bad one still apply, as callers that only warn
+    // rely on.
+    acl = compile("10.0.0.0/8, bogus, 192.168.0.1", ad2_acl_check::ACL_ERR_BADFORMAT_IP);
+    HOST_CHECK(allowed(acl, "10.1.2.3") && !allowed(acl, "192.168.0.1"));
+    // an unparsable peer is never allowed.
+    HOST_CHECK(!acl.find(std::string("not an ip")));
+    struct sockaddr_storage unknown = {};
+    unknown.ss_family = AF_UNIX;
+    HOST_CHECK(!acl.find(unknown));
+
+    // add() appends and clear() starts over.
+    std::string more = "192.168.0.0/16";
+    HOST_CHECK(acl.add(more) == ad2_acl_check::ACL_FORMAT_OK);
+    HOST_CHECK(allowed(acl, "10.1.2.3") && allowed(acl, "192.168.0.1"));
+    acl.clear();
+    HOST_CHECK(allowed(acl, "8.8.8.8"));
+}
+
+/**
+ * @brief A random IPv4 ACL with entries ranges and the same ranges for a
+ * linear scan.
+ */
+static std::string random_acl(int entries, std::vector<std::pair<uint32_t, uint32_t>> &ranges)
+{
+    std::string text;
+    ranges.clear();
+    for (int n = 0; n < entries; n++) {
+        uint32_t start = rng(), end;
+        if (rng() % 2) {
+            int cidr = 8 + rng() % 25;
+            uint32_t mask = cidr == 32 ? UINT32_MAX : ~(UINT32_MAX >> cidr);
+            start &= mask;
+            end = start | ~mask;
+            text += ipv4(start) + "/" + std::to_string(cidr);
+        } else {
+            end = start + rng() % 5000;
+            end = end < start ? UINT32_MAX : end;
+            text += ipv4(start) + "-" + ipv4(end);
+        }
+        text += n + 1 < entries ? ", " : "";
+        ranges.push_back(std::make_pair(start, end));
+    }
+    return text;
+}
+
+static bool linear_find(const std::vector<std::pair<uint32_t, uint32_t>> &ranges, uint32_t addr)
+{
+    for (auto &range : ranges) {
+        if (addr >= range.first && addr <= range.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void test_random()
+{
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    for (int trial = 0; trial < 200; trial++) {
+        ad2_acl_check acl = compile(random_acl(1 + rng() % 40, ranges));
+        std::vector<uint32_t> probes;
+        for (auto &range : ranges) {
+            probes.insert(probes.end(), {range.first - 1, range.first, range.second, range.second + 1});
+        }
+        for (int n = 0; n < 200; n++) {
+            probes.push_back(rng());
+        }
+        for (uint32_t addr : probes) {
+            HOST_CHECK(allowed(acl, ipv4(addr)) == linear_find(ranges, addr));
+        }
+    }
+}
+
+/**
+ * @brief Time lookups at 1, 10 and 100 entries. The compiled table with a
+ * peer address against the string round trip and a linear scan of the
+ * same ranges.
+ */
+static void bench()
+{
+    using clock = std::chrono::steady_clock;
+    const int lookups = 200000;
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    std::vector<struct sockaddr_storage> peers;
+    std::vector<std::string> texts;
+    std::vector<uint32_t> addrs;
+    for (int n = 0; n < 1024; n++) {
+        addrs.push_back(rng());
+        texts.push_back(ipv4(addrs.back()));
+        peers.push_back(peer(texts.back().c_str()));
+    }
+    auto ns = [&](clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count() / lookups;
+    };
+    printf("%8s %12s %12s %12s\n", "entries", "sockaddr ns", "string ns", "linear ns");
+    for (int entries : {1, 10, 100}) {
+        ad2_acl_check acl = compile(random_acl(entries, ranges));
+        // the ACL matches about half of the probes.
+        for (int n = 0; n < 512; n++) {
+            const auto &range = ranges[n % ranges.size()];
+            addrs[n] = range.first + (range.second - range.first) / 2;
+            texts[n] = ipv4(addrs[n]);
+            peers[n] = peer(texts[n].c_str());
+        }
+        int hits[3] = {0, 0, 0};
+        clock::time_point start = clock::now();
+        for (int n = 0; n < lookups; n++) {
+            hits[0] += acl.find(peers[n & 1023]);
+        }
+        double by_peer = ns(start);
+        start = clock::now();
+        for (int n = 0; n < lookups; n++) {
+            hits[1] += acl.find(texts[n & 1023]);
+        }
+        double by_string = ns(start);
+        start = clock::now();
+        for (int n = 0; n < lookups; n++) {
+            hits[2] += linear_find(ranges, addrs[n & 1023]);
+        }
+        double linear = ns(start);
+        HOST_CHECK(hits[0] == hits[1] && hits[1] == hits[2] && hits[0] >= lookups / 2);
+        printf("%8d %12.1f %12.1f %12.1f\n", entries, by_peer, by_string, linear);
+    }
+}
+
+int main()
+{
+    test_ipv4();
+    test_ipv6();
+    test_merged();
+    test_empty_and_invalid();
+    test_random();
+    bench();
+    puts("acl OK");
+    return 0;
+}
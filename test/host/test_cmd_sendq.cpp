@@ -0,0 +1,111 @@
+/**
+ *  @file    test_cmd_sendq.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Outbound AD2 command queue and raw stream pass through.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_utils.cpp"
+
+// host includes
+#include "host.h"
+
+#define CHUNKS 100
+
+static int writer_runs = 0;
+
+/**
+ * @brief The AD2 command writer catches up while a sender waits.
+ */
+static void run_writer()
+{
+    writer_runs++;
+    host_run_task(host_task("AD2 cmdQ"), 1);
+}
+
+/**
+ * @brief A firmware upload as ser2sock or ad2term pass it through. Intel
+ * hex lines in chunks that do not follow the line ends.
+ */
+static std::vector<std::string> upload(char tag)
+{
+    std::vector<std::string> chunks;
+    for (int n = 0; n < CHUNKS; n++) {
+        chunks.push_back(ad2_string_printf(":10%04X00%c%031d\r\n", n * 16, tag, n).substr(0, 7 + n % 30));
+    }
+    return chunks;
+}
+
+static void test_stream(ad2_send_source_t source, char tag)
+{
+    ad2_cmd_sendQ_stats_t before, after;
+    ad2_get_cmd_sendQ_stats(&before);
+    host_uart.clear();
+    writer_runs = 0;
+
+    // nothing is written until the queue is full and the sender waits.
+    std::string want;
+    for (auto &chunk : upload(tag)) {
+        want += chunk;
+        std::string tmp = chunk;
+        HOST_CHECK(ad2_send(tmp, source));
+    }
+    run_writer();
+
+    std::string got;
+    for (auto &w : host_uart) {
+        got += w;
+    }
+    HOST_CHECK(got == want);
+    ad2_get_cmd_sendQ_stats(&after);
+    const ad2_cmd_sendQ_source_stats_t &b = before.sources[source], &a = after.sources[source];
+    HOST_CHECK(a.queued - b.queued == CHUNKS && a.sent - b.sent == CHUNKS);
+    HOST_CHECK(a.dropped == b.dropped && a.waited - b.waited == (uint32_t)writer_runs - 1);
+    HOST_CHECK(writer_runs > 1 && after.depth == 0);
+}
+
+static void test_commands_drop()
+{
+    // commands are not streams. A full queue still refuses them.
+    int runs = writer_runs;
+    for (int n = 0; n < AD2_CMD_SENDQ_DEPTH; n++) {
+        std::string cmd = "K1812341";
+        HOST_CHECK(ad2_send(cmd, AD2_SEND_SRC_MQTT));
+    }
+    std::string cmd = "K1812341";
+    HOST_CHECK(!ad2_send(cmd, AD2_SEND_SRC_MQTT));
+    HOST_CHECK(writer_runs == runs);
+    run_writer();
+}
+
+int main()
+{
+    // the AD2 is on a UART.
+    g_ad2_client_handle = 1;
+    g_ad2_mode = 'C';
+    ad2_init_cmd_sendQ();
+    HOST_CHECK(host_task("AD2 cmdQ"));
+    host_delay_hook = run_writer;
+
+    test_stream(AD2_SEND_SRC_SER2SOCK, 'A');
+    test_stream(AD2_SEND_SRC_TERM, 'B');
+    test_commands_drop();
+    puts("cmd sendQ OK");
+    return 0;
+}
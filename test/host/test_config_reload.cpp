@@ -0,0 +1,233 @@
+/**
+ *  @file    test_config_reload.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Config reload diff, subscribers and lock order.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_utils.cpp"
+
+// host includes
+#include "host.h"
+#include "ad2_cli_cmd.h"
+#include <set>
+
+#define INI_PATH "/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_FILE
+
+#define TWILIO_V1 "format 3 = <<<END\n<Response>\n  <Say>{0}</Say>\n</Response>\nEND\n"
+#define TWILIO_V2 "format 3 = <<<END\n<Response>\n  <Say>{1}</Say>\n</Response>\nEND\n"
+#define TWILIO_V3 "format 3 = <<<END\n<Response>\n  <Say>{1}</Say>\n  <Hangup/>\n</Response>\nEND\n"
+
+static const char *INI_V1 =
+    "netmode = N\n"
+    "[switch 1]\nopen 1 = !RFX:0012345,1.......\nnotify = 1\n"
+    "[switch 2]\nopen 1 = !RFX:0054321,1.......\n"
+    "[zone 2]\ndescription = door\nalpha = Front\n"
+    "[twilio]\n" TWILIO_V1
+    "[webui]\nenable = true\n";
+
+// lock depth of the config store and parser and any order violation.
+static int config_held = 0;
+static int parser_held = 0;
+static int parser_taken = 0;
+static bool parser_under_config = false;
+
+static void lock_hook(SemaphoreHandle_t s, bool take)
+{
+    if (s == _ad2cfg_mutex) {
+        config_held += take ? 1 : -1;
+    } else if (s == g_ad2_parser_mutex) {
+        if (take) {
+            parser_under_config |= config_held > 0;
+            parser_taken++;
+        }
+        parser_held += take ? 1 : -1;
+    }
+}
+
+struct subscriber {
+    int calls = 0;
+    std::set<std::string> sections;
+    // lock state and store contents seen from the callback.
+    bool locks_ok = true;
+    std::string value;
+    const char *section = nullptr;
+    const char *key = nullptr;
+};
+
+static void on_change(std::vector<std::string> &sections, void *arg)
+{
+    subscriber *sub = (subscriber *)arg;
+    sub->calls++;
+    sub->sections.insert(sections.begin(), sections.end());
+    sub->locks_ok &= parser_held == 1 && config_held == 0;
+    if (sub->section) {
+        sub->value = "<none>";
+        ad2_get_config_key_string(sub->section, sub->key, sub->value);
+    }
+}
+
+static void write_ini(const char *text)
+{
+    FILE *f = fopen(INI_PATH, "w");
+    HOST_CHECK(f);
+    fputs(text, f);
+    fclose(f);
+}
+
+static std::string get(const char *section, const char *key)
+{
+    std::string v = "<none>";
+    ad2_get_config_key_string(section, key, v);
+    return v;
+}
+
+static bool console_has(const char *text)
+{
+    for (auto &s : host_console) {
+        if (s.find(text) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static subscriber switches, zones, webui, unused;
+
+static void reset()
+{
+    for (subscriber *s : {
+                &switches, &zones, &webui, &unused
+            }) {
+        s->calls = 0;
+        s->sections.clear();
+        s->value.clear();
+    }
+    parser_taken = 0;
+    parser_under_config = false;
+}
+
+static void test_reload()
+{
+    write_ini(INI_V1);
+    unlink("/" AD2_SPIFFS_MOUNT_POINT AD2_CONFIG_CACHE_FILE);
+    ad2_load_persistent_config();
+    HOST_CHECK(get("twilio", "format 3") == "<Response>\n  <Say>{0}</Say>\n</Response>");
+
+    ad2_config_subscribe("switch", on_change, &switches);
+    ad2_config_subscribe("zone, Twilio", on_change, &zones);
+    ad2_config_subscribe("webui", on_change, &webui);
+    ad2_config_subscribe("pushover", on_change, &unused);
+    zones.section = "twilio";
+    zones.key = "format 3";
+
+    // a changed key, a removed key and a longer multi line value. The CLI
+    // command saves and reloads.
+    reset();
+    write_ini(
+        "netmode = N\n"
+        "[switch 1]\nopen 1 = !RFX:0012345,0.......\nnotify = 1\n"
+        "[switch 2]\nopen 1 = !RFX:0054321,1.......\n"
+        "[zone 2]\ndescription = door\n"
+        "[twilio]\n" TWILIO_V3
+        "[webui]\nenable = true\n");
+    register_ad2_cli_cmd();
+    command_function_t reload = host_command(AD2_CMD_RELOAD);
+    HOST_CHECK(reload);
+    host_console.clear();
+    reload(AD2_CMD_RELOAD);
+    HOST_CHECK(!console_has("reload failed"));
+    HOST_CHECK(switches.calls == 1 && switches.sections == std::set<std::string>({"switch 1"}));
+    HOST_CHECK(zones.calls == 1 && zones.sections == std::set<std::string>({"twilio", "zone 2"}));
+    HOST_CHECK(zones.value == "<Response>\n  <Say>{1}</Say>\n  <Hangup/>\n</Response>");
+    HOST_CHECK(!webui.calls && !unused.calls);
+    HOST_CHECK(get("switch 1", "open 1") == "!RFX:0012345,0.......");
+    HOST_CHECK(get("zone 2", "alpha") == "<none>" && get("zone 2", "description") == "door");
+
+    // subscribers run with the parser lock and without the config lock.
+    HOST_CHECK(switches.locks_ok && zones.locks_ok);
+    HOST_CHECK(parser_taken == 1 && !parser_under_config);
+    HOST_CHECK(!config_held && !parser_held);
+
+    // nothing changed, nobody is told.
+    reset();
+    HOST_CHECK(ad2_reload_persistent_config() == 0);
+    HOST_CHECK(!switches.calls && !zones.calls && !webui.calls && !unused.calls);
+
+    // only a line inside a multi line value changes.
+    reset();
+    write_ini(
+        "netmode = N\n"
+        "[switch 1]\nopen 1 = !RFX:0012345,0.......\nnotify = 1\n"
+        "[switch 2]\nopen 1 = !RFX:0054321,1.......\n"
+        "[zone 2]\ndescription = door\n"
+        "[twilio]\n" TWILIO_V2
+        "[webui]\nenable = true\n");
+    HOST_CHECK(ad2_reload_persistent_config() == 1);
+    HOST_CHECK(zones.calls == 1 && zones.sections == std::set<std::string>({"twilio"}));
+    HOST_CHECK(zones.value == "<Response>\n  <Say>{1}</Say>\n</Response>");
+    HOST_CHECK(!switches.calls && !webui.calls);
+
+    // a removed section, an added one in the family and one outside it.
+    reset();
+    write_ini(
+        "netmode = N\n"
+        "[switch 1]\nopen 1 = !RFX:0012345,0.......\nnotify = 1\n"
+        "[switch 12]\nopen 1 = !RFX:0099999,1.......\n"
+        "[switches]\nx = 1\n"
+        "[zone 2]\ndescription = door\n"
+        "[twilio]\n" TWILIO_V2
+        "[webui]\nenable = true\n");
+    HOST_CHECK(ad2_reload_persistent_config() == 3);
+    HOST_CHECK(switches.calls == 1 && switches.sections == std::set<std::string>({"switch 12", "switch 2"}));
+    HOST_CHECK(!zones.calls && !webui.calls && !unused.calls);
+    HOST_CHECK(get("switch 2", "open 1") == "<none>");
+
+    // an unreadable ini keeps the running config.
+    reset();
+    unlink(INI_PATH);
+    HOST_CHECK(ad2_reload_persistent_config() == -1);
+    HOST_CHECK(!parser_taken && !switches.calls);
+    HOST_CHECK(get("switch 12", "open 1") == "!RFX:0099999,1.......");
+    HOST_CHECK(!config_held);
+}
+
+static void test_unsaved()
+{
+    // a CLI change that cannot be saved fails the reload and stays.
+    write_ini(INI_V1);
+    reset();
+    ad2_set_config_key_string("webui", "enable", "false");
+    host_console.clear();
+    host_command(AD2_CMD_RELOAD)(AD2_CMD_RELOAD);
+    HOST_CHECK(console_has("Config reload failed"));
+    HOST_CHECK(!parser_taken && !webui.calls);
+    HOST_CHECK(get("webui", "enable") == "false");
+    HOST_CHECK(!config_held);
+}
+
+int main()
+{
+    g_ad2_parser_mutex = xSemaphoreCreateMutex();
+    host_lock_hook = lock_hook;
+    test_reload();
+    test_unsaved();
+    puts("config reload OK");
+    return 0;
+}
@@ -0,0 +1,257 @@
+/**
+ *  @file    test_config_store.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Streaming ini loader and interned config store.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_utils.cpp"
+
+// host includes
+#include "host.h"
+#include <map>
+
+#define TEST_INI "test.ini"
+
+/**
+ * @brief The shipped ini plus 100 zones and 50 switches.
+ */
+static void write_large_ini()
+{
+    FILE *in = fopen(AD2_HOST_ROOT "/data/ad2iot.ini", "r");
+    FILE *out = fopen(TEST_INI, "w");
+    HOST_CHECK(in && out);
+    char buf[512];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        fwrite(buf, 1, n, out);
+    }
+    fclose(in);
+    for (int z = 1; z <= 100; z++) {
+        fprintf(out, "\n# zone %d\n[zone %d]\n", z, z + 100);
+        fprintf(out, "description = {\"type\": \"%s\", \"alpha\": \"Zone %d sensor\"}\n",
+                z % 3 ? "door" : "motion", z);
+    }
+    for (int s = 1; s <= 50; s++) {
+        fprintf(out, "\n[switch %d]\n", s + 150);
+        fprintf(out, "default = 0\nreset = 0\ntypes = EVENT\n");
+        fprintf(out, "open 1 = !RFX:00%05d,1.......\n", s);
+        fprintf(out, "close 1 = !RFX:00%05d,0.......\n", s);
+        fprintf(out, "trouble 1 = !RFX:00%05d,......1.\n", s);
+        fprintf(out, "description = {\"name\": \"Sensor %d\", \"type\": \"door\"}\n", s);
+        fprintf(out, "notify = 1\nopen = OPEN %d\nclose = CLOSE %d\n", s, s);
+    }
+    fclose(out);
+}
+
+/* Allocation model of CSimpleIniA::LoadFile() as the firmware used it
+ * before the interned store. SimpleIni reads the file into a buffer, copies
+ * it into its resident data buffer and frees the first one. Sections and
+ * keys are std::map and std::multimap nodes whose strings point into the
+ * data buffer. SimpleIni itself is fetched by the ESP-IDF build and is not
+ * available to the host tests. */
+struct si_entry {
+    const char *pItem;
+    const char *pComment;
+    int nOrder;
+};
+struct si_less {
+    bool operator()(const si_entry &a, const si_entry &b) const
+    {
+        return strcasecmp(a.pItem, b.pItem) < 0;
+    }
+};
+typedef std::multimap<si_entry, const char *, si_less> si_keyval;
+typedef std::map<si_entry, si_keyval, si_less> si_sections;
+
+struct si_model {
+    char *data = nullptr;
+    si_sections sections;
+    ~si_model()
+    {
+        delete[] data;
+    }
+};
+
+static void si_model_load(si_model &dom, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    HOST_CHECK(f);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *file = new char[size + 1];
+    HOST_CHECK(fread(file, 1, size, f) == (size_t)size);
+    fclose(f);
+    dom.data = new char[size + 1];
+    memcpy(dom.data, file, size);
+    dom.data[size] = '\0';
+    delete[] file;
+
+    int order = 0;
+    si_keyval *section = &dom.sections[ {"", nullptr, order++}];
+    char *next = dom.data;
+    while (*next) {
+        char *line = next;
+        char *nl = strchr(line, '\n');
+        next = nl ? nl + 1 : line + strlen(line);
+        if (nl) {
+            *nl = '\0';
+        }
+        char *p = _ad2_config_trim(line);
+        if (!*p || *p == ';' || *p == '#') {
+            continue;
+        }
+        if (*p == '[') {
+            char *e = strchr(p, ']');
+            if (e) {
+                *e = '\0';
+                section = &dom.sections[ {_ad2_config_trim(p + 1), nullptr, order++}];
+            }
+            continue;
+        }
+        char *eq = strchr(p, '=');
+        if (eq) {
+            *eq = '\0';
+            si_entry key = { _ad2_config_trim(p), nullptr, order++ };
+            char *value = _ad2_config_trim(eq + 1);
+            if (strncmp(value, "<<<", 3) == 0 && value[3]) {
+                // multi line values stay in place up to the end tag line.
+                const char *tag = value + 3;
+                value = next;
+                while (*next) {
+                    char *l = next;
+                    nl = strchr(l, '\n');
+                    next = nl ? nl + 1 : l + strlen(l);
+                    if ((size_t)(next - l - (nl ? 1 : 0)) == strlen(tag) && strncmp(l, tag, strlen(tag)) == 0) {
+                        l[l > value ? -1 : 0] = '\0';
+                        break;
+                    }
+                }
+            }
+            section->erase(key);
+            section->insert(std::make_pair(key, value));
+        }
+    }
+}
+
+static std::string get(const char *section, const char *key)
+{
+    std::string v = "<none>";
+    ad2_get_config_key_string(section, key, v);
+    return v;
+}
+
+static void test_heap_report()
+{
+    write_large_ini();
+    struct stat st;
+    HOST_CHECK(stat(TEST_INI, &st) == 0);
+
+    host_heap_mark();
+    size_t base = host_heap_live;
+    size_t allocs = host_heap_allocs;
+    size_t si_resident, si_peak, si_allocs, si_keys = 0;
+    {
+        si_model dom;
+        si_model_load(dom, TEST_INI);
+        si_resident = host_heap_live - base;
+        si_peak = host_heap_peak - base;
+        si_allocs = host_heap_allocs - allocs;
+        for (auto &s : dom.sections) {
+            si_keys += s.second.size();
+        }
+    }
+    HOST_CHECK(host_heap_live == base);
+
+    host_heap_mark();
+    allocs = host_heap_allocs;
+    size_t requested = 0;
+    HOST_CHECK(_ad2_config_parse_file(TEST_INI, &requested));
+    size_t resident = host_heap_live - base;
+    // the line buffer is a malloc() and not seen by the counters.
+    size_t peak = host_heap_peak - base + AD2_CONFIG_LINE_SIZE;
+    size_t store_allocs = host_heap_allocs - allocs;
+    size_t index = _ad2cfg_entries.capacity() * sizeof(ad2_config_entry);
+
+    printf("ini %ld B, %zu keys (100 zones, 50 switches on top of data/ad2iot.ini)\n", (long)st.st_size,
+           _ad2cfg_entries.size());
+    printf("SimpleIni DOM model: resident %zu B, peak %zu B, %zu allocations\n", si_resident, si_peak, si_allocs);
+    printf("config store: resident %zu B (%zu B strings, %zu B before interning, %zu B index), "
+           "peak %zu B, %zu allocations\n", resident, _ad2cfg_pool.capacity(), requested, index, peak,
+           store_allocs);
+
+    HOST_CHECK(si_keys == _ad2cfg_entries.size());
+    HOST_CHECK(_ad2cfg_pool.size() < requested);
+    HOST_CHECK(resident < si_resident / 2);
+    HOST_CHECK(peak < si_peak);
+}
+
+static void test_lookups()
+{
+    FILE *f = fopen(TEST_INI, "w");
+    HOST_CHECK(f);
+    fputs("\xEF\xBB\xBF" "netmode = N\n", f);
+    fputs("; comment\n# comment\n\n", f);
+    fputs("[zone 2]\n  description = {\"type\": \"door\"}  \n", f);
+    fputs("[Switch 10]\nopen 1 = first\nOPEN 1 = second\n", f);
+    fputs("[twilio]\nformat 3 = <<<END\n<Response>\n  <Say>{0}</Say>\n</Response>\nEND\n", f);
+    fputs("[long]\nvalue = ", f);
+    for (int n = 0; n < AD2_CONFIG_LINE_SIZE; n++) {
+        fputc('x', f);
+    }
+    fputs("\nafter = yes\n", f);
+    fclose(f);
+
+    size_t requested = 0;
+    HOST_CHECK(_ad2_config_parse_file(TEST_INI, &requested));
+    HOST_CHECK(get("", "netmode") == "N");
+    HOST_CHECK(get("ZONE 2", "Description") == "{\"type\": \"door\"}");
+    HOST_CHECK(get("switch 10", "open 1") == "second");
+    HOST_CHECK(get("twilio", "format 3") == "<Response>\n  <Say>{0}</Say>\n</Response>");
+    HOST_CHECK(get("long", "value").length() < AD2_CONFIG_LINE_SIZE);
+    HOST_CHECK(get("long", "after") == "yes");
+    HOST_CHECK(get("nope", "x") == "<none>");
+
+    // setters keep the index sorted and compact the pool.
+    for (int n = 0; n < 200; n++) {
+        ad2_set_config_key_string("zone 7", "description", std::to_string(n).c_str());
+    }
+    ad2_set_config_key_string("webui", "enable", "true");
+    ad2_set_config_key_string("zone 2", "description", nullptr, -1, nullptr, true);
+    HOST_CHECK(get("zone 7", "description") == "199");
+    HOST_CHECK(get("webui", "enable") == "true");
+    HOST_CHECK(get("zone 2", "description") == "<none>");
+    HOST_CHECK(_ad2cfg_garbage <= AD2_CONFIG_POOL_SLACK || _ad2cfg_garbage * 4 <= _ad2cfg_pool.size());
+    for (size_t i = 1; i < _ad2cfg_entries.size(); i++) {
+        ad2_config_entry &a = _ad2cfg_entries[i - 1];
+        ad2_config_entry &b = _ad2cfg_entries[i];
+        HOST_CHECK(_ad2_config_key_cmp(_ad2_config_str(a.section), _ad2_config_str(a.key),
+                                       _ad2_config_str(b.section), _ad2_config_str(b.key)) < 0);
+    }
+}
+
+int main()
+{
+    _ad2cfg_mutex = xSemaphoreCreateRecursiveMutex();
+    test_heap_report();
+    test_lookups();
+    puts("config store OK");
+    return 0;
+}
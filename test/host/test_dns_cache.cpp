@@ -0,0 +1,307 @@
+/**
+ *  @file    test_dns_cache.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Shared DNS cache TTL, prefetch and stale fallback.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_dns.cpp"
+
+// host includes
+#include "host.h"
+#include <atomic>
+#include <thread>
+
+/* Fake DNS server on 127.0.0.1:AD2_DNS_PORT. It answers every A query with
+ * 10.0.0.<_dns_octet> and a 120 s TTL after a stray reply with the wrong id.
+ * cname.* answers through a CNAME with a 40 s TTL. nx.* does not exist.
+ * While _dns_down is set queries are read and never answered. */
+static std::atomic<int> _dns_octet(7);
+static std::atomic<bool> _dns_down(false);
+static std::atomic<int> _dns_queries(0);
+static std::atomic<bool> _dns_stop(false);
+
+static void put16(std::string &out, uint16_t v)
+{
+    out += (char)(v >> 8);
+    out += (char)(v & 0xff);
+}
+
+static void put32(std::string &out, uint32_t v)
+{
+    put16(out, v >> 16);
+    put16(out, v & 0xffff);
+}
+
+static std::string dns_name(const std::string &host)
+{
+    std::string out;
+    size_t start = 0;
+    while (start <= host.length()) {
+        size_t dot = host.find('.', start);
+        std::string label = host.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+        out += (char)label.length();
+        out += label;
+        if (dot == std::string::npos) {
+            break;
+        }
+        start = dot + 1;
+    }
+    out += '\0';
+    return out;
+}
+
+static void dns_server(int sock)
+{
+    uint8_t buf[512];
+    while (!_dns_stop) {
+        struct sockaddr_in from = {};
+        socklen_t fromlen = sizeof(from);
+        int n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen);
+        if (n < 12) {
+            continue;
+        }
+        _dns_queries++;
+        if (_dns_down) {
+            continue;
+        }
+        // question name up to the qtype and qclass.
+        std::string host;
+        size_t pos = 12;
+        while (pos < (size_t)n && buf[pos]) {
+            host += std::string(host.empty() ? "" : ".") + std::string((char *)buf + pos + 1, buf[pos]);
+            pos += 1 + buf[pos];
+        }
+        std::string question((char *)buf + 12, pos + 5 - 12);
+        std::string id((char *)buf, 2);
+
+        if (host.compare(0, 3, "nx.") == 0) {
+            std::string r = id + "\x81\x83";
+            put16(r, 1);
+            put16(r, 0);
+            put32(r, 0);
+            r += question;
+            sendto(sock, r.data(), r.length(), 0, (struct sockaddr *)&from, fromlen);
+            continue;
+        }
+
+        std::string stray("\0\0\x81\x80", 4);
+        put16(stray, 1);
+        put16(stray, 0);
+        put32(stray, 0);
+        stray += question;
+        sendto(sock, stray.data(), stray.length(), 0, (struct sockaddr *)&from, fromlen);
+
+        std::string ans;
+        int count = 1;
+        if (host.compare(0, 6, "cname.") == 0) {
+            std::string target = dns_name("real.example.com");
+            ans += "\xc0\x0c";
+            put16(ans, 5);
+            put16(ans, 1);
+            put32(ans, 40);
+            put16(ans, target.length());
+            ans += target;
+            ans += target;
+            count = 2;
+        } else {
+            ans += "\xc0\x0c";
+        }
+        put16(ans, 1);
+        put16(ans, 1);
+        put32(ans, 120);
+        put16(ans, 4);
+        ans += std::string("\x0a\x00\x00", 3) + (char)_dns_octet;
+
+        std::string r = id + "\x81\x80";
+        put16(r, 1);
+        put16(r, count);
+        put32(r, 0);
+        r += question + ans;
+        sendto(sock, r.data(), r.length(), 0, (struct sockaddr *)&from, fromlen);
+    }
+}
+
+static uint32_t ip(int octet)
+{
+    return htonl(0x0a000000 | octet);
+}
+
+/**
+ * @brief Resolve through the lwIP hook the way getaddrinfo does.
+ *
+ * @return int hook result. err and addr are set when it is 1.
+ */
+static int resolve(const char *name, uint32_t *addr = nullptr, err_t *err = nullptr)
+{
+    ip_addr_t a = {};
+    err_t e = 99;
+    int res = lwip_hook_netconn_external_resolve(name, &a, 0, &e);
+    if (addr) {
+        *addr = ip_addr_get_ip4_u32(&a);
+    }
+    if (err) {
+        *err = e;
+    }
+    return res;
+}
+
+static ad2_dns_stats_t stats()
+{
+    ad2_dns_stats_t s;
+    ad2_get_dns_stats(&s);
+    return s;
+}
+
+static void prefetch_pass()
+{
+    host_run_task(host_task("AD2 dns"), 1);
+}
+
+static void test_lookup()
+{
+    uint32_t a = 0;
+    err_t err;
+    bool stale = true;
+    HOST_CHECK(ad2_dns_lookup("api.pushover.net", &a, &stale) == 0);
+    HOST_CHECK(a == ip(7) && !stale);
+    HOST_CHECK(_dns_queries == 1);
+    HOST_CHECK(ad2_dns_lookup("API.Pushover.NET", &a, &stale) == 0);
+    HOST_CHECK(a == ip(7) && !stale);
+    HOST_CHECK(_dns_queries == 1);
+    ad2_dns_stats_t s = stats();
+    HOST_CHECK(s.hits == 1 && s.misses == 1 && s.entries == 1);
+
+    // literals, single labels and mDNS names are left to lwIP.
+    HOST_CHECK(resolve("10.1.2.3") == 0);
+    HOST_CHECK(resolve("printer.local") == 0);
+    HOST_CHECK(resolve("localhost") == 0);
+    HOST_CHECK(_dns_queries == 1);
+
+    HOST_CHECK(resolve("nx.example.com", nullptr, &err) == 1 && err == ERR_VAL);
+    HOST_CHECK(resolve("cname.example.com", &a, &err) == 1 && err == ERR_OK && a == ip(7));
+    // the CNAME TTL is the lowest along the chain.
+    HOST_CHECK(_ad2_dns_find("cname.example.com")->expires_ms == host_uptime_us / 1000 + 40 * 1000);
+    s = stats();
+    HOST_CHECK(s.entries == 2 && s.failures == 1 && s.misses == 3);
+}
+
+static void test_prefetch()
+{
+    uint32_t a;
+    int queries = _dns_queries;
+    ad2_dns_prefetch("twilio", "https://api.twilio.com/2010-04-01/Accounts/x");
+    ad2_dns_prefetch("twilio", "https://API.twilio.com/other");
+    ad2_dns_prefetch("mqtt", "mqtts://user:pw@broker.example.com:8883");
+    ad2_dns_prefetch("mqtt", "mqtt://192.168.1.5");
+    ad2_dns_prefetch("mqtt", "mqtt://broker");
+    prefetch_pass();
+    HOST_CHECK(_dns_queries == queries + 2);
+    HOST_CHECK(stats().prefetches == 2 && stats().entries == 4);
+
+    // nothing is due until 60 s before the 120 s TTL runs out.
+    host_advance_ms(30 * 1000);
+    prefetch_pass();
+    HOST_CHECK(_dns_queries == queries + 2);
+    host_advance_ms(31 * 1000);
+    _dns_octet = 8;
+    prefetch_pass();
+    HOST_CHECK(_dns_queries == queries + 4);
+    HOST_CHECK(ad2_dns_lookup("api.twilio.com", &a) == 0 && a == ip(8));
+    HOST_CHECK(ad2_dns_lookup("broker.example.com", &a) == 0 && a == ip(8));
+    HOST_CHECK(_dns_queries == queries + 4);
+
+    // a reloaded section drops its hosts.
+    ad2_dns_prefetch_clear("mqtt");
+    host_advance_ms(61 * 1000);
+    prefetch_pass();
+    HOST_CHECK(_dns_queries == queries + 5);
+}
+
+static void test_stale()
+{
+    uint32_t a;
+    bool stale;
+    err_t err;
+    // cname.example.com expired long ago and DNS stops answering.
+    _dns_down = true;
+    int queries = _dns_queries;
+    HOST_CHECK(resolve("cname.example.com", &a, &err) == 1 && err == ERR_OK && a == ip(7));
+    HOST_CHECK(_dns_queries == queries + 1);
+    // served stale without a query until the retry time passes.
+    HOST_CHECK(ad2_dns_lookup("cname.example.com", &a, &stale) == 0 && stale && a == ip(7));
+    HOST_CHECK(_dns_queries == queries + 1);
+    // an uncached host does not wait on DNS again.
+    HOST_CHECK(resolve("unknown.example.com") == 0);
+    HOST_CHECK(_dns_queries == queries + 1);
+    ad2_dns_stats_t s = stats();
+    HOST_CHECK(s.stale == 2 && s.bypassed == 1);
+
+    host_advance_ms(AD2_DNS_RETRY_S * 1000);
+    _dns_down = false;
+    _dns_octet = 9;
+    HOST_CHECK(ad2_dns_lookup("cname.example.com", &a, &stale) == 0 && !stale && a == ip(9));
+    HOST_CHECK(ad2_dns_lookup("unknown.example.com", &a, &stale) == 0 && a == ip(9));
+}
+
+static void test_lru()
+{
+    uint32_t a;
+    // api.twilio.com is a prefetch host. It stays cached as one off
+    // lookups fill the cache.
+    for (int n = 0; n < AD2_DNS_CACHE_SIZE * 2; n++) {
+        host_advance_ms(1000);
+        prefetch_pass();
+        std::string host = "host" + std::to_string(n) + ".example.com";
+        HOST_CHECK(ad2_dns_lookup(host.c_str(), &a) == 0);
+    }
+    HOST_CHECK(stats().entries == AD2_DNS_CACHE_SIZE);
+    HOST_CHECK(_ad2_dns_find("api.twilio.com"));
+    HOST_CHECK(!_ad2_dns_find("api.pushover.net"));
+    HOST_CHECK(_ad2_dns_find("host15.example.com"));
+}
+
+int main()
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(AD2_DNS_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    HOST_CHECK(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    struct timeval tv = { 0, 50 * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    std::thread server(dns_server, sock);
+
+    // the second server is unset. The first is the fake.
+    ip_addr_set_ip4_u32(&host_dns_servers[0], htonl(INADDR_LOOPBACK));
+    host_advance_ms(1000);
+    ad2_init_dns_cache();
+
+    test_lookup();
+    test_prefetch();
+    test_stale();
+    test_lru();
+
+    _dns_stop = true;
+    server.join();
+    close(sock);
+    puts("dns cache OK");
+    return 0;
+}
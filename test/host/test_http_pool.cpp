@@ -0,0 +1,193 @@
+/**
+ *  @file    test_http_pool.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief HTTP sendQ keep-alive connection pool.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_http_sendq.cpp"
+
+// host includes
+#include "host.h"
+#include "http_host.h"
+
+/**
+ * @brief A component request. Owns its config like the integrations do.
+ */
+struct test_request {
+    esp_http_client_config_t config;
+    std::string url;
+    const char *auth;        // Authorization header set in ready.
+    const char *body;        // POST body set in ready.
+    int events;              // client events forwarded to this request.
+    esp_err_t result;
+};
+
+static std::vector<test_request *> finished;
+
+static esp_err_t request_event(esp_http_client_event_t *evt)
+{
+    test_request *r = (test_request *)evt->user_data;
+    // the pool must never forward events to a finished request.
+    HOST_CHECK(std::find(finished.begin(), finished.end(), r) == finished.end());
+    r->events++;
+    return ESP_OK;
+}
+
+static void request_ready(esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    test_request *r = (test_request *)config->user_data;
+    if (r->auth) {
+        esp_http_client_set_header(client, "Authorization", r->auth);
+    }
+    if (r->body) {
+        esp_http_client_set_post_field(client, r->body, strlen(r->body));
+        esp_http_client_set_header(client, "Content-Type", "application/json");
+    }
+}
+
+static bool request_done(esp_err_t res, esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    test_request *r = (test_request *)config->user_data;
+    r->result = res;
+    finished.push_back(r);
+    return true;
+}
+
+static test_request *run_request(const char *url, const char *auth = nullptr, const char *body = nullptr)
+{
+    test_request *r = new test_request();
+    r->url = url;
+    r->auth = auth;
+    r->body = body;
+    r->config.url = r->url.c_str();
+    r->config.method = body ? HTTP_METHOD_POST : HTTP_METHOD_GET;
+    r->config.event_handler = request_event;
+    r->config.user_data = r;
+    HOST_CHECK(ad2_add_http_sendQ(&r->config, request_ready, request_done));
+    // run the consumer until the queue is empty.
+    host_run_task(_http_sendQ_consumer_task, 0);
+    HOST_CHECK(finished.back() == r);
+    return r;
+}
+
+static ad2_http_pool_stats_t pool_stats()
+{
+    ad2_http_pool_stats_t s;
+    ad2_get_http_pool_stats(&s);
+    return s;
+}
+
+static void test_reuse()
+{
+    test_request *a = run_request("https://api.pushover.net/1/messages.json", "Bearer a", "{\"a\":1}");
+    test_request *b = run_request("HTTPS://API.pushover.net/1/messages.json?x=1");
+    ad2_http_pool_stats_t s = pool_stats();
+    HOST_CHECK(a->result == ESP_OK && b->result == ESP_OK);
+    HOST_CHECK(a->events && b->events);
+    HOST_CHECK(host_http_inits == 1 && host_http_connects == 1);
+    HOST_CHECK(s.hits == 1 && s.misses == 1 && s.open == 1);
+    HOST_CHECK(host_http_requests[1].reused);
+    // headers and body of the last request are not carried over.
+    HOST_CHECK(host_http_requests[0].headers["Authorization"] == "Bearer a");
+    HOST_CHECK(host_http_requests[1].headers.count("Authorization") == 0);
+    HOST_CHECK(host_http_requests[1].headers.count("Content-Type") == 0);
+    HOST_CHECK(host_http_requests[1].post.empty() && host_http_requests[1].method == HTTP_METHOD_GET);
+    HOST_CHECK(host_http_requests[1].headers["User-Agent"].rfind("AD2IoT-HTTP-Client/", 0) == 0);
+}
+
+static void test_lru()
+{
+    run_request("https://api.twilio.com/2010-04-01/Accounts/x/Messages.json");
+    host_advance_ms(10);
+    run_request("https://api.sendgrid.com/v3/mail/send");
+    host_advance_ms(10);
+    // pushover is the least recently used and gives up its slot.
+    run_request("http://10.0.0.1:8080/hook?zone=1");
+    ad2_http_pool_stats_t s = pool_stats();
+    HOST_CHECK(host_http_inits == 4 && host_http_cleanups == 1);
+    HOST_CHECK(s.open == AD2_HTTP_POOL_SIZE);
+    for (auto &conn : _http_pool) {
+        HOST_CHECK(conn.origin != "https://api.pushover.net");
+    }
+}
+
+static void test_idle_close()
+{
+    int connects = host_http_connects;
+    host_advance_ms(AD2_HTTP_POOL_IDLE_MS);
+    // one idle turn of the consumer sweeps the pool.
+    host_run_task(_http_sendQ_consumer_task, 1);
+    ad2_http_pool_stats_t s = pool_stats();
+    HOST_CHECK(s.idle_closed == AD2_HTTP_POOL_SIZE && s.open == AD2_HTTP_POOL_SIZE);
+    // the client and its TLS session stay. Only the socket is new.
+    int inits = host_http_inits;
+    run_request("https://api.sendgrid.com/v3/mail/send");
+    HOST_CHECK(host_http_inits == inits && host_http_connects == connects + 1);
+    HOST_CHECK(!host_http_requests.back().reused);
+}
+
+static void test_stale_retry()
+{
+    // the server dropped the kept socket before the request went out.
+    size_t sent = host_http_requests.size();
+    host_http_fail = 1;
+    test_request *r = run_request("https://api.sendgrid.com/v3/mail/send");
+    HOST_CHECK(r->result == ESP_OK && pool_stats().retries == 1);
+    HOST_CHECK(host_http_requests.size() == sent + 1);
+
+    // once the headers are out a retry could deliver twice.
+    host_http_fail = 1;
+    host_http_fail_sent = true;
+    r = run_request("https://api.sendgrid.com/v3/mail/send");
+    host_http_fail_sent = false;
+    ad2_http_pool_stats_t s = pool_stats();
+    HOST_CHECK(r->result != ESP_OK && s.retries == 1 && s.error_closed == 1);
+    HOST_CHECK(host_http_requests.size() == sent + 1);
+    HOST_CHECK(s.open == AD2_HTTP_POOL_SIZE - 1);
+}
+
+static void test_heap_low()
+{
+    host_free_heap = AD2_HTTP_POOL_MIN_FREE_HEAP - 1;
+    run_request("https://api.twilio.com/2010-04-01/Accounts/x/Calls.json");
+    ad2_http_pool_stats_t s = pool_stats();
+    HOST_CHECK(s.open == 0 && s.heap_closed >= 1);
+    HOST_CHECK(host_http_inits == host_http_cleanups);
+    host_free_heap = 200 * 1024;
+}
+
+int main()
+{
+    ad2_init_http_sendQ();
+    test_reuse();
+    test_lru();
+    test_idle_close();
+    test_stale_retry();
+    test_heap_low();
+    ad2_http_pool_stats_t s = pool_stats();
+    printf("%zu requests, %d connections: hits %u misses %u retries %u idle %u heap %u error %u\n",
+           host_http_requests.size(), host_http_connects, s.hits, s.misses, s.retries,
+           s.idle_closed, s.heap_closed, s.error_closed);
+    for (auto *r : finished) {
+        delete r;
+    }
+    puts("http pool OK");
+    return 0;
+}
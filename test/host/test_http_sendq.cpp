@@ -0,0 +1,199 @@
+/**
+ *  @file    test_http_sendq.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief HTTP sendQ priority lanes, per integration sub-queues and
+ *  full queue policies.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_http_sendq.cpp"
+
+// host includes
+#include "host.h"
+#include "http_host.h"
+
+// the slow endpoint takes this long for every request.
+#define ENDPOINT_MS 2000
+
+static std::vector<esp_err_t> dropped;
+
+static void request_ready(esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+}
+
+static bool request_done(esp_err_t res, esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    if (!client) {
+        dropped.push_back(res);
+    }
+    free((void *)config->url);
+    delete config;
+    return true;
+}
+
+static bool add(ad2_http_source_t source, ad2_http_priority_t priority, const char *name, uint32_t key = 0)
+{
+    esp_http_client_config_t *config = new esp_http_client_config_t();
+    std::string url = std::string("https://host") + std::to_string(source) + "/" + name;
+    config->url = strdup(url.c_str());
+    if (!ad2_add_http_sendQ(config, request_ready, request_done, source, priority, key)) {
+        free((void *)config->url);
+        delete config;
+        return false;
+    }
+    return true;
+}
+
+static std::string sent_name(size_t n)
+{
+    const std::string &url = host_http_requests[n].url;
+    return url.substr(url.rfind('/') + 1);
+}
+
+static void test_classifier()
+{
+    std::string fire = "!LRR:001,1,CID_1110,ff";
+    std::string burglary = "!LRR:001,1,CID_1131,ff";
+    std::string restore = "!LRR:001,1,CID_3110,ff";
+    std::string opening = "!LRR:001,1,CID_1401,ff";
+    std::string keypad(21, '0');
+    keypad[0] = '[';
+    keypad += "],008,[f70200ff1008001c28020000000000],\"FIRE 08\"";
+    std::string chime = keypad;
+    keypad[FIRE_BYTE] = '1';
+    std::string bell = chime;
+    bell[ALARM_BYTE] = '1';
+    HOST_CHECK(ad2_http_sendQ_priority(&fire) == AD2_HTTP_PRIO_LIFE_SAFETY);
+    HOST_CHECK(ad2_http_sendQ_priority(&burglary) == AD2_HTTP_PRIO_SECURITY);
+    HOST_CHECK(ad2_http_sendQ_priority(&restore) == AD2_HTTP_PRIO_INFO);
+    HOST_CHECK(ad2_http_sendQ_priority(&opening) == AD2_HTTP_PRIO_INFO);
+    HOST_CHECK(ad2_http_sendQ_priority(&keypad) == AD2_HTTP_PRIO_LIFE_SAFETY);
+    HOST_CHECK(ad2_http_sendQ_priority(&bell) == AD2_HTTP_PRIO_SECURITY);
+    HOST_CHECK(ad2_http_sendQ_priority(&chime) == AD2_HTTP_PRIO_INFO);
+    HOST_CHECK(ad2_http_sendQ_priority(nullptr) == AD2_HTTP_PRIO_INFO);
+}
+
+static uint64_t fire_queued_ms = 0;
+static uint64_t fire_sent_ms = 0;
+
+static void on_request(const host_http_request &req)
+{
+    uint64_t now_ms = host_uptime_us / 1000;
+    if (host_http_requests.size() == 2) {
+        // the alarm comes in while the second chime is on the wire.
+        fire_queued_ms = now_ms - ENDPOINT_MS / 2;
+        HOST_CHECK(add(AD2_HTTP_SRC_TWILIO, AD2_HTTP_PRIO_LIFE_SAFETY, "fire"));
+    }
+    if (req.url.find("/fire") != std::string::npos) {
+        fire_sent_ms = now_ms;
+    }
+}
+
+static void test_alarm_behind_chimes()
+{
+    // 8 chimes from each integration fill both sub-queues.
+    for (int n = 0; n < AD2_HTTP_SENDQ_DEPTH; n++) {
+        HOST_CHECK(add(AD2_HTTP_SRC_PUSHOVER, AD2_HTTP_PRIO_INFO, ("chime" + std::to_string(n)).c_str()));
+        HOST_CHECK(add(AD2_HTTP_SRC_TWILIO, AD2_HTTP_PRIO_INFO, ("chime" + std::to_string(n)).c_str()));
+    }
+    // a full sub-queue refuses more of the same and evicts for higher.
+    HOST_CHECK(!add(AD2_HTTP_SRC_PUSHOVER, AD2_HTTP_PRIO_INFO, "chime8"));
+    HOST_CHECK(add(AD2_HTTP_SRC_PUSHOVER, AD2_HTTP_PRIO_SECURITY, "burglary"));
+    HOST_CHECK(dropped.size() == 1 && dropped[0] == ESP_ERR_NO_MEM);
+
+    host_http_latency_ms = ENDPOINT_MS;
+    host_http_on_request = on_request;
+    host_run_task(_http_sendQ_consumer_task, 0);
+    host_http_on_request = nullptr;
+
+    ad2_http_sendQ_stats_t s;
+    ad2_get_http_sendQ_stats(&s);
+    printf("order:");
+    for (size_t n = 0; n < host_http_requests.size(); n++) {
+        printf(" %s", sent_name(n).c_str());
+    }
+    printf("\nfire waited %llu ms behind 16 chimes with a %d ms endpoint\n",
+           (unsigned long long)(fire_sent_ms - fire_queued_ms), ENDPOINT_MS);
+
+    // burglary first, the fire right after the request in flight. Both
+    // pushed the oldest chime out of their full sub-queue.
+    HOST_CHECK(host_http_requests.size() == 2 * AD2_HTTP_SENDQ_DEPTH);
+    HOST_CHECK(sent_name(0) == "burglary");
+    HOST_CHECK(sent_name(2) == "fire");
+    // at worst the rest of the request in flight and its own.
+    HOST_CHECK(fire_sent_ms - fire_queued_ms <= 2 * ENDPOINT_MS);
+    // integrations take turns in the informational lane.
+    for (size_t n = 3; n + 1 < host_http_requests.size(); n++) {
+        HOST_CHECK(host_http_requests[n].url.compare(0, 13, host_http_requests[n + 1].url, 0, 13) != 0);
+    }
+    HOST_CHECK(s.evicted == 2 && s.dropped == 1);
+    HOST_CHECK(s.sent[AD2_HTTP_PRIO_LIFE_SAFETY] == 1 && s.sent[AD2_HTTP_PRIO_SECURITY] == 1);
+    HOST_CHECK(s.max_wait_ms[AD2_HTTP_PRIO_LIFE_SAFETY] <= ENDPOINT_MS);
+    HOST_CHECK(s.depth[AD2_HTTP_PRIO_INFO] == 0);
+    host_http_latency_ms = 0;
+}
+
+static void test_security_weight()
+{
+    // security may not starve informational requests.
+    host_http_reset();
+    for (int n = 0; n < 6; n++) {
+        HOST_CHECK(add(AD2_HTTP_SRC_PUSHOVER, AD2_HTTP_PRIO_SECURITY, ("s" + std::to_string(n)).c_str()));
+    }
+    HOST_CHECK(add(AD2_HTTP_SRC_TWILIO, AD2_HTTP_PRIO_INFO, "i0"));
+    HOST_CHECK(add(AD2_HTTP_SRC_TWILIO, AD2_HTTP_PRIO_INFO, "i1"));
+    host_run_task(_http_sendQ_consumer_task, 0);
+    std::string order;
+    for (size_t n = 0; n < host_http_requests.size(); n++) {
+        order += sent_name(n) + " ";
+    }
+    HOST_CHECK(order == "s0 s1 s2 i0 s3 s4 s5 i1 ");
+}
+
+static void test_coalesce()
+{
+    host_http_reset();
+    dropped.clear();
+    _http_sendQ_coalesce = true;
+    for (int n = 0; n < AD2_HTTP_SENDQ_DEPTH; n++) {
+        HOST_CHECK(add(AD2_HTTP_SRC_PUSHOVER, AD2_HTTP_PRIO_INFO, ("k" + std::to_string(n)).c_str(), 100 + n));
+    }
+    // a newer copy takes the queued one's place in line.
+    HOST_CHECK(add(AD2_HTTP_SRC_PUSHOVER, AD2_HTTP_PRIO_INFO, "k3again", 103));
+    HOST_CHECK(!add(AD2_HTTP_SRC_PUSHOVER, AD2_HTTP_PRIO_INFO, "nokey"));
+    HOST_CHECK(dropped.size() == 1 && dropped[0] == AD2_HTTP_SENDQ_ERR_COALESCED);
+    host_run_task(_http_sendQ_consumer_task, 0);
+    HOST_CHECK(host_http_requests.size() == AD2_HTTP_SENDQ_DEPTH);
+    HOST_CHECK(sent_name(3) == "k3again");
+    ad2_http_sendQ_stats_t s;
+    ad2_get_http_sendQ_stats(&s);
+    HOST_CHECK(s.coalesced == 1);
+    _http_sendQ_coalesce = false;
+}
+
+int main()
+{
+    ad2_init_http_sendQ();
+    test_classifier();
+    test_alarm_behind_chimes();
+    test_security_weight();
+    test_coalesce();
+    puts("http sendQ OK");
+    return 0;
+}
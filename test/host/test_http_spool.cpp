@@ -0,0 +1,235 @@
+/**
+ *  @file    test_http_spool.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief HTTP sendQ retry spool against a stand-in server that fails
+ *  and recovers.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// wall clock the test controls. Renames the ad2_utils.h declaration too.
+#define ad2_wall_clock_ms host_wall_clock_ms
+
+// module under test
+#include "ad2_http_spool.cpp"
+
+// host includes
+#include "host.h"
+#include "http_host.h"
+
+#define WALL_BASE_S 1700000000
+
+int64_t host_wall_clock_ms()
+{
+    return (int64_t)WALL_BASE_S * 1000 + host_uptime_us / 1000;
+}
+
+/**
+ * @brief A Pushover like notification request. Reports to the spool from
+ * its done callback the way the integrations do.
+ */
+struct notice {
+    esp_http_client_config_t config;
+    std::string message;
+    uint8_t slot;
+    ad2_http_priority_t priority;
+    uint32_t spool_id;
+};
+
+static void notice_ready(esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    notice *n = (notice *)config->user_data;
+    esp_http_client_set_post_field(client, n->message.c_str(), n->message.length());
+}
+
+static bool notice_done(esp_err_t res, esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    notice *n = (notice *)config->user_data;
+    ad2_http_spool_report(AD2_HTTP_SRC_PUSHOVER, n->slot, n->priority, n->message, n->spool_id,
+                          ad2_http_sendQ_should_retry(res, client));
+    delete n;
+    return true;
+}
+
+static bool notice_send(uint8_t slot, const std::string &message, ad2_http_priority_t priority, uint32_t spool_id)
+{
+    notice *n = new notice();
+    n->message = message;
+    n->slot = slot;
+    n->priority = priority;
+    n->spool_id = spool_id;
+    n->config.url = "https://api.pushover.net/1/messages.json";
+    n->config.method = HTTP_METHOD_POST;
+    n->config.user_data = n;
+    if (!ad2_add_http_sendQ(&n->config, notice_ready, notice_done, AD2_HTTP_SRC_PUSHOVER, priority)) {
+        delete n;
+        return false;
+    }
+    return true;
+}
+
+static TaskFunction_t sendq_task;
+
+static ad2_http_spool_stats_t spool_stats()
+{
+    ad2_http_spool_stats_t s;
+    ad2_get_http_spool_stats(&s);
+    return s;
+}
+
+static std::vector<std::string> delivered()
+{
+    std::vector<std::string> out;
+    for (auto &req : host_http_requests) {
+        out.push_back(req.post);
+    }
+    return out;
+}
+
+static std::vector<uint64_t> tries_ms;
+
+static void record_try(const host_http_request &req)
+{
+    tries_ms.push_back(host_uptime_us / 1000);
+}
+
+/**
+ * @brief Restart the firmware as far as the spool can tell.
+ */
+static void restart_spool()
+{
+    fclose(_http_spool_file);
+    _http_spool_file = NULL;
+    _http_spool_mutex = NULL;
+    _http_spool_stats = {};
+    memset(_http_spool_inflight, 0, sizeof(_http_spool_inflight));
+    memset(_http_spool_failures, 0, sizeof(_http_spool_failures));
+    memset(_http_spool_next_try_ms, 0, sizeof(_http_spool_next_try_ms));
+    ad2_init_http_spool();
+}
+
+static void test_backoff()
+{
+    // the server answers 503 for two minutes.
+    host_http_status = 503;
+    host_http_on_request = record_try;
+    for (int n = 0; n < 5; n++) {
+        HOST_CHECK(notice_send(1, "msg" + std::to_string(n), AD2_HTTP_PRIO_INFO, 0));
+    }
+    host_run_task(sendq_task, 120);
+    host_http_on_request = nullptr;
+
+    ad2_http_spool_stats_t s = spool_stats();
+    HOST_CHECK(s.depth == 5 && s.spooled == 5 && s.persistent);
+    HOST_CHECK(s.oldest_age_s >= 100);
+    // one replay in flight at a time and always the oldest.
+    printf("tries after failing:");
+    for (size_t n = 5; n < tries_ms.size(); n++) {
+        printf(" %llus", (unsigned long long)(tries_ms[n] - tries_ms[0]) / 1000);
+        HOST_CHECK(host_http_requests[n].post == "msg0");
+    }
+    printf("\n");
+    size_t retries = tries_ms.size() - 5;
+    HOST_CHECK(s.replayed == retries && retries >= 3 && retries < 10);
+    // exponential with jitter. Each delay is at least the last one.
+    for (size_t n = 7; n < tries_ms.size(); n++) {
+        HOST_CHECK(tries_ms[n] - tries_ms[n - 1] >= tries_ms[n - 1] - tries_ms[n - 2]);
+    }
+    HOST_CHECK(tries_ms[5] - tries_ms[4] >= AD2_HTTP_SPOOL_RETRY_MIN_MS / 2);
+}
+
+static void test_offline()
+{
+    // nothing is sent while offline. The request is handed back to spool.
+    host_http_reset();
+    host_network_connected = false;
+    HOST_CHECK(notice_send(2, "offline", AD2_HTTP_PRIO_INFO, 0));
+    host_run_task(sendq_task, 1);
+    host_network_connected = true;
+    HOST_CHECK(host_http_requests.empty());
+    HOST_CHECK(spool_stats().depth == 6);
+}
+
+static void test_restart_replay()
+{
+    restart_spool();
+    ad2_http_spool_stats_t s = spool_stats();
+    HOST_CHECK(s.depth == 6 && s.persistent);
+
+    // online again. A new message whose window ends while the backlog is
+    // still going out is spooled behind it.
+    host_http_reset();
+    host_http_latency_ms = 500;
+    ad2_http_notify(AD2_HTTP_SRC_PUSHOVER, 1, "new", AD2_HTTP_PRIO_INFO, notice_send);
+    host_run_task(sendq_task, 30);
+    host_http_latency_ms = 0;
+    std::vector<std::string> want = { "msg0", "msg1", "msg2", "msg3", "msg4", "offline", "new" };
+    HOST_CHECK(delivered() == want);
+    s = spool_stats();
+    HOST_CHECK(s.depth == 0 && _http_spool_hdr.count == 0);
+    HOST_CHECK(s.delivered == 7);
+}
+
+static void test_overflow()
+{
+    // the oldest requests are dropped when the ring is full.
+    host_http_reset();
+    uint32_t dropped = spool_stats().dropped;
+    for (int n = 0; n < AD2_HTTP_SPOOL_RECORDS + 2; n++) {
+        ad2_http_spool_report(AD2_HTTP_SRC_PUSHOVER, 1, AD2_HTTP_PRIO_INFO, "o" + std::to_string(n), 0, true);
+    }
+    ad2_http_spool_stats_t s = spool_stats();
+    HOST_CHECK(s.depth == AD2_HTTP_SPOOL_RECORDS && s.dropped == dropped + 2);
+    host_run_task(sendq_task, 2 * AD2_HTTP_SPOOL_RECORDS);
+    std::vector<std::string> got = delivered();
+    HOST_CHECK(got.size() == AD2_HTTP_SPOOL_RECORDS);
+    HOST_CHECK(got.front() == "o2" && got.back() == "o" + std::to_string(AD2_HTTP_SPOOL_RECORDS + 1));
+    HOST_CHECK(spool_stats().depth == 0);
+}
+
+static void test_should_retry()
+{
+    host_http_status = 503;
+    HOST_CHECK(ad2_http_sendQ_should_retry(ESP_OK, (esp_http_client_handle_t)1));
+    host_http_status = 429;
+    HOST_CHECK(ad2_http_sendQ_should_retry(ESP_OK, (esp_http_client_handle_t)1));
+    host_http_status = 400;
+    HOST_CHECK(!ad2_http_sendQ_should_retry(ESP_OK, (esp_http_client_handle_t)1));
+    HOST_CHECK(ad2_http_sendQ_should_retry(ESP_ERR_HTTP_CONNECT, nullptr));
+    HOST_CHECK(ad2_http_sendQ_should_retry(ESP_ERR_NO_MEM, nullptr));
+    HOST_CHECK(!ad2_http_sendQ_should_retry(AD2_HTTP_SENDQ_ERR_COALESCED, nullptr));
+    host_http_status = 200;
+}
+
+int main()
+{
+    remove(AD2_HTTP_SPOOL_PATH);
+    g_uSD_mounted = true;
+    ad2_init_http_sendQ();
+    ad2_http_spool_register(AD2_HTTP_SRC_PUSHOVER, notice_send);
+    sendq_task = host_task("AD2 sendQ");
+    HOST_CHECK(sendq_task);
+    // idle waits of the sendQ task pass in host time.
+    host_notify_timeout = true;
+    test_backoff();
+    test_offline();
+    test_restart_replay();
+    test_overflow();
+    test_should_retry();
+    puts("http spool OK");
+    return 0;
+}
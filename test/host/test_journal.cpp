@@ -0,0 +1,232 @@
+/**
+ *  @file    test_journal.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Event journal rotation, paging, filters and power loss recovery.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// wall clock the test controls. Renames the ad2_utils.h declaration too.
+#define ad2_wall_clock_ms host_wall_clock_ms
+
+// module under test
+#include "ad2_journal.cpp"
+
+// host includes
+#include "host.h"
+
+#define WALL_BASE_S 1700000000
+#define EVENTS 2000
+#define RECS AD2_JOURNAL_RECS_PER_BLOCK
+
+int64_t host_wall_clock_ms()
+{
+    return (int64_t)WALL_BASE_S * 1000 + host_uptime_us / 1000;
+}
+
+/**
+ * @brief Event n of the test stream. Every 7th is a zone change on zone
+ * n % 20 and partitions alternate. Its sequence is n + 1 and its wall
+ * clock WALL_BASE_S + n + 1.
+ */
+static int event_of(int n)
+{
+    return n % 7 == 0 ? ON_ZONE_CHANGE : ON_READY_CHANGE;
+}
+
+static void post_event(AD2PartitionState &s, int n)
+{
+    s.partition = 1 + n % 2;
+    s.zone = n % 20;
+    std::string msg = "";
+    _ad2_journal_on_event(&msg, &s, (void *)(intptr_t)event_of(n));
+}
+
+/**
+ * @brief Page through a query by cursor and check every page is newest
+ * first and follows the last one.
+ *
+ * @return the sequences found.
+ */
+static std::vector<uint32_t> page_all(ad2_journal_query_t q, int *pages = nullptr)
+{
+    std::vector<uint32_t> seqs;
+    int count = 0;
+    while (true) {
+        cJSON *root = ad2_journal_query_json(q);
+        cJSON *items = cJSON_GetObjectItem(root, "items");
+        HOST_CHECK(cJSON_GetArraySize(items) <= (int)q.limit);
+        cJSON *item;
+        cJSON_ArrayForEach(item, items) {
+            uint32_t seq = cJSON_GetObjectItem(item, "sequence")->valueint;
+            HOST_CHECK(seqs.empty() || seq < seqs.back());
+            HOST_CHECK(q.partition < 0 || cJSON_GetObjectItem(item, "partition")->valueint == q.partition);
+            HOST_CHECK(q.zone < 0 || cJSON_GetObjectItem(item, "zone")->valueint == q.zone);
+            seqs.push_back(seq);
+        }
+        uint32_t next = cJSON_GetObjectItem(root, "next_cursor")->valueint;
+        cJSON_Delete(root);
+        count++;
+        if (!next) {
+            break;
+        }
+        HOST_CHECK(next < q.cursor || !q.cursor);
+        q.cursor = next;
+    }
+    if (pages) {
+        *pages = count;
+    }
+    return seqs;
+}
+
+static ad2_journal_query_t query_all()
+{
+    ad2_journal_query_t q = { 0, 0, 0, -1, -1, -1, 64 };
+    return q;
+}
+
+static void test_rotation_and_queries()
+{
+    ad2_init_journal();
+    HOST_CHECK(_ad2_journal_task_handle);
+
+    AD2PartitionState s;
+    for (int n = 0; n < EVENTS; n++) {
+        host_advance_ms(1000);
+        post_event(s, n);
+        if (n % 10 == 9) {
+            host_run_task(_ad2_journal_task, 1);
+        }
+    }
+    // the flush timer writes the partly filled block.
+    host_advance_ms(AD2_JOURNAL_FLUSH_MS);
+    host_run_task(_ad2_journal_task, 1);
+    HOST_CHECK(!_ad2_journal_blk_dirty);
+
+    // 64 blocks per file. The first file was rotated out and dropped.
+    uint32_t per_file = AD2_JOURNAL_MAX_BYTES / AD2_JOURNAL_BLOCK_SIZE;
+    uint32_t blocks = (EVENTS + RECS - 1) / RECS;
+    HOST_CHECK(_ad2_journal_old.blocks == per_file);
+    HOST_CHECK(_ad2_journal_cur.blocks == blocks % per_file);
+    uint32_t oldest = (blocks / per_file - 1) * per_file * RECS + 1;
+    HOST_CHECK(_ad2_journal_old.first_seq == oldest);
+    struct stat st;
+    HOST_CHECK(stat(AD2_JOURNAL_PATH, &st) == 0 && st.st_size == _ad2_journal_cur.blocks * AD2_JOURNAL_BLOCK_SIZE);
+    HOST_CHECK(stat(AD2_JOURNAL_OLD_PATH, &st) == 0 && st.st_size == AD2_JOURNAL_MAX_BYTES);
+
+    uint32_t next_seq, total, dropped, errors;
+    ad2_get_journal_status(&next_seq, &total, &dropped, &errors);
+    HOST_CHECK(next_seq == EVENTS + 1 && dropped == 0 && errors == 0);
+
+    // every retained record once, newest first, across both files.
+    int pages;
+    std::vector<uint32_t> seqs = page_all(query_all(), &pages);
+    HOST_CHECK(seqs.size() == EVENTS - oldest + 1);
+    HOST_CHECK(seqs.front() == EVENTS && seqs.back() == oldest);
+    HOST_CHECK(pages == (int)(seqs.size() + 63) / 64);
+    printf("%d events: %u + %u blocks, sequences %u..%u in %d pages\n", EVENTS,
+           _ad2_journal_old.blocks, _ad2_journal_cur.blocks, oldest, (uint32_t)EVENTS, pages);
+
+    // zone, event and partition filters.
+    ad2_journal_query_t q = query_all();
+    q.zone = 7;
+    size_t want = 0;
+    for (int n = oldest - 1; n < EVENTS; n++) {
+        want += event_of(n) == ON_ZONE_CHANGE && n % 20 == 7;
+    }
+    HOST_CHECK(want && page_all(q).size() == want);
+
+    q = query_all();
+    q.event = ON_ZONE_CHANGE;
+    q.partition = 2;
+    want = 0;
+    for (int n = oldest - 1; n < EVENTS; n++) {
+        want += event_of(n) == ON_ZONE_CHANGE && n % 2 == 1;
+    }
+    HOST_CHECK(want && page_all(q).size() == want);
+
+    // time range, inclusive, in the old file.
+    q = query_all();
+    q.from_s = WALL_BASE_S + 1500;
+    q.to_s = WALL_BASE_S + 1600;
+    seqs = page_all(q);
+    HOST_CHECK(seqs.size() == 101 && seqs.front() == 1600 && seqs.back() == 1500);
+
+    // a limit stops mid block and the cursor resumes after it.
+    q = query_all();
+    q.limit = 7;
+    cJSON *root = ad2_journal_query_json(q);
+    HOST_CHECK(cJSON_GetArraySize(cJSON_GetObjectItem(root, "items")) == 7);
+    HOST_CHECK(cJSON_GetObjectItem(root, "next_cursor")->valueint == EVENTS - 6);
+    cJSON_Delete(root);
+}
+
+static void test_torn_tail()
+{
+    // a half written record in the last block and a few bytes after it.
+    FILE *f = fopen(AD2_JOURNAL_PATH, "r+b");
+    HOST_CHECK(f);
+    fseek(f, -AD2_JOURNAL_BLOCK_SIZE + sizeof(ad2_journal_blk_hdr) + 2 * sizeof(ad2_journal_rec), SEEK_END);
+    fwrite("torn write", 1, 10, f);
+    fseek(f, 0, SEEK_END);
+    fwrite("tail", 1, 4, f);
+    fclose(f);
+
+    uint32_t cur_blocks = _ad2_journal_cur.blocks;
+    uint32_t lost_from = (_ad2_journal_old.first_seq - 1) / RECS * RECS + 1 +
+                         (_ad2_journal_old.blocks + cur_blocks - 1) * RECS;
+    _ad2_journal_pending.clear();
+    ad2_init_journal();
+
+    struct stat st;
+    HOST_CHECK(stat(AD2_JOURNAL_PATH, &st) == 0);
+    HOST_CHECK(_ad2_journal_cur.blocks == cur_blocks - 1);
+    HOST_CHECK(st.st_size == (cur_blocks - 1) * AD2_JOURNAL_BLOCK_SIZE);
+    HOST_CHECK(_ad2_journal_next_seq == lost_from);
+    HOST_CHECK(_ad2_journal_boot == 2);
+    HOST_CHECK(_ad2_journal_blk_index == cur_blocks - 1 && _ad2_journal_blk.hdr.count == 0);
+
+    std::vector<uint32_t> seqs = page_all(query_all());
+    HOST_CHECK(seqs.front() == lost_from - 1);
+    HOST_CHECK(seqs.back() == _ad2_journal_old.first_seq);
+    HOST_CHECK(seqs.size() == seqs.front() - seqs.back() + 1);
+
+    // an alarm is written at once and continues the sequence.
+    AD2PartitionState s;
+    s.partition = 1;
+    s.zone = 0;
+    std::string msg = "";
+    _ad2_journal_on_event(&msg, &s, (void *)(intptr_t)ON_ALARM_CHANGE);
+    host_run_task(_ad2_journal_task, 1);
+    HOST_CHECK(!_ad2_journal_blk_dirty && _ad2_journal_cur.blocks == cur_blocks);
+    cJSON *root = ad2_journal_query_json(query_all());
+    cJSON *first = cJSON_GetArrayItem(cJSON_GetObjectItem(root, "items"), 0);
+    HOST_CHECK(cJSON_GetObjectItem(first, "sequence")->valueint == (int)lost_from);
+    HOST_CHECK(cJSON_GetObjectItem(first, "boot")->valueint == 2);
+    cJSON_Delete(root);
+}
+
+int main()
+{
+    remove(AD2_JOURNAL_PATH);
+    remove(AD2_JOURNAL_OLD_PATH);
+    g_uSD_mounted = true;
+    test_rotation_and_queries();
+    test_torn_tail();
+    puts("event journal OK");
+    return 0;
+}
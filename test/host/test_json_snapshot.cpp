@@ -0,0 +1,130 @@
+/**
+ *  @file    test_json_snapshot.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Shared partition snapshots per state version.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_json.cpp"
+
+// host includes
+#include "host.h"
+
+#define K_READY "[00000001000000000A--],008,[f70000071008001c28020000000000],\"DISARMED CHIME   Ready to Arm   \""
+// same bits, numeric and alpha with different raw bytes the parser ignores.
+#define K_READY_RAW "[00000001000000000A--],008,[f70000071008001c28020000ff0000],\"DISARMED CHIME   Ready to Arm   \""
+#define K_FAULT "[00000011000000000A--],002,[f70600ef1002000018020000000000],\"FAULT 02                        \""
+
+static void feed(const char *msg)
+{
+    std::string s = std::string(msg) + "\r\n";
+    AD2Parse.put((uint8_t *)s.data(), s.length());
+}
+
+/**
+ * @brief The partition the parser keeps K_READY under.
+ */
+static AD2PartitionState *partition()
+{
+    std::string msg = K_READY;
+    uint32_t mask = strtol(msg.substr(AMASK_START, AMASK_END - AMASK_START).c_str(), nullptr, 16);
+    mask = AD2_NTOHL(mask);
+    return AD2Parse.getAD2PState(&mask);
+}
+
+static ad2_json_snapshot_stats_t stats()
+{
+    ad2_json_snapshot_stats_t st;
+    ad2_get_json_snapshot_stats(&st);
+    return st;
+}
+
+static void test_versions()
+{
+    feed(K_READY);
+    AD2PartitionState *s = partition();
+    HOST_CHECK(s);
+
+    // a repeated keypad message is not a change.
+    uint32_t v1 = s->version;
+    feed(K_READY);
+    feed(K_READY_RAW);
+    HOST_CHECK(s->version == v1);
+
+    ad2_json_snapshot_ptr a = ad2_json_get_snapshot(s);
+    ad2_json_snapshot_ptr b = ad2_json_get_snapshot(s);
+    HOST_CHECK(a && a.get() == b.get());
+    HOST_CHECK(stats().rendered == 1 && stats().shared == 1);
+
+    feed(K_FAULT);
+    HOST_CHECK(s->version > v1);
+    ad2_json_snapshot_ptr c = ad2_json_get_snapshot(s);
+    HOST_CHECK(c && c.get() != a.get() && c->version == s->version);
+    HOST_CHECK(strcmp(a->etag, c->etag) != 0);
+    // readers holding the old copy keep it.
+    HOST_CHECK(a->version == v1 && a->json.find("Ready to Arm") != std::string::npos);
+    HOST_CHECK(stats().rendered == 2);
+
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", _json_boot_id, (unsigned long)c->version);
+    HOST_CHECK(strcmp(c->etag, etag) == 0);
+    HOST_CHECK(!ad2_json_get_snapshot(nullptr));
+}
+
+static void test_splice()
+{
+    AD2PartitionState *s = partition();
+    ad2_json_snapshot_ptr snap = ad2_json_get_snapshot(s);
+    HOST_CHECK(snap->json.front() == '{' && snap->json.back() == '}');
+    HOST_CHECK(std::string(snap->extra(), snap->extra_length()).compare(0, 12, "\"partition\":") == 0);
+
+    // the web document spliced from the snapshot matches one rendered whole.
+    char b1[2048], b2[2048];
+    AD2JsonWriter w1(b1, sizeof(b1));
+    w1.object();
+    w1.members(snap->state(), snap->state_length());
+    w1.add("event", "FAULT");
+    w1.add("uptime_ms", 5);
+    w1.members(snap->extra(), snap->extra_length());
+    AD2JsonWriter w2(b2, sizeof(b2));
+    w2.object();
+    ad2_json_partition_state(w2, s);
+    w2.add("event", "FAULT");
+    w2.add("uptime_ms", 5);
+    w2.add("partition", s->partition);
+    w2.add("zone", s->zone);
+    ad2_json_zone_alerts(w2, "zone_alerts", s);
+    HOST_CHECK(strcmp(w1.finish(), w2.finish()) == 0);
+
+    // so does the whole snapshot.
+    AD2JsonWriter w3(b2, sizeof(b2));
+    w3.object();
+    w3.members(snap->state(), snap->state_length());
+    w3.members(snap->extra(), snap->extra_length());
+    HOST_CHECK(snap->json == w3.finish());
+}
+
+int main()
+{
+    ad2_init_json_snapshots();
+    test_versions();
+    test_splice();
+    puts("json snapshot OK");
+    return 0;
+}
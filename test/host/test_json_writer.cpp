@@ -0,0 +1,429 @@
+/**
+ *  @file    test_json_writer.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Streaming JSON and CBOR writer against cJSON.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2_json.cpp"
+
+// host includes
+#include "host.h"
+#include <chrono>
+
+#define READY "00000001000000000A--"
+#define FAULT "00000011000000000A--"
+
+/**
+ * @brief The partition the keypad at address 18 reports.
+ */
+static AD2PartitionState *partition()
+{
+    std::string msg = host_keypad(READY, "008", "");
+    uint32_t mask = strtol(msg.substr(AMASK_START, AMASK_END - AMASK_START).c_str(), nullptr, 16);
+    mask = AD2_NTOHL(mask);
+    return AD2Parse.getAD2PState(&mask);
+}
+
+/**
+ * @brief The cJSON partition state the writer replaced, as the reference.
+ */
+static cJSON *cjson_partition_state(AD2PartitionState *s)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (s && !s->unknown_state) {
+        cJSON_AddBoolToObject(root, "ready", s->ready);
+        cJSON_AddBoolToObject(root, "armed_away", s->armed_away);
+        cJSON_AddBoolToObject(root, "armed_stay", s->armed_stay);
+        cJSON_AddBoolToObject(root, "backlight_on", s->backlight_on);
+        cJSON_AddBoolToObject(root, "programming", s->programming);
+        cJSON_AddBoolToObject(root, "zone_bypassed", s->zone_bypassed);
+        cJSON_AddBoolToObject(root, "ac_power", s->ac_power);
+        cJSON_AddBoolToObject(root, "chime_on", s->chime_on);
+        cJSON_AddBoolToObject(root, "alarm_event_occurred", s->alarm_event_occurred);
+        cJSON_AddBoolToObject(root, "alarm_sounding", s->alarm_sounding);
+        cJSON_AddBoolToObject(root, "battery_low", s->battery_low);
+        cJSON_AddBoolToObject(root, "entry_delay_off", s->entry_delay_off);
+        cJSON_AddBoolToObject(root, "fire_alarm", s->fire_alarm);
+        cJSON_AddBoolToObject(root, "system_issue", s->system_issue);
+        cJSON_AddBoolToObject(root, "perimeter_only", s->perimeter_only);
+        cJSON_AddBoolToObject(root, "exit_now", s->exit_now);
+        cJSON_AddNumberToObject(root, "system_specific", s->system_specific);
+        cJSON_AddNumberToObject(root, "beeps", s->beeps);
+        cJSON_AddStringToObject(root, "panel_type", std::string(1, s->panel_type).c_str());
+        cJSON_AddStringToObject(root, "last_alpha_message", s->last_alpha_message.c_str());
+        cJSON_AddStringToObject(root, "last_numeric_messages", s->last_numeric_message.c_str());
+        cJSON_AddNumberToObject(root, "mask", s->address_mask_filter);
+    } else {
+        cJSON_AddStringToObject(root, "last_alpha_message", "Unknown");
+    }
+    return root;
+}
+
+/**
+ * @brief The cJSON zone alerts the writer replaced, as the reference.
+ */
+static cJSON *cjson_zone_alerts(AD2PartitionState *s)
+{
+    cJSON *alerts = cJSON_CreateArray();
+    for (auto &e : s->zone_states) {
+        if (e.second.state() != AD2_STATE_CLOSED) {
+            cJSON *zone = cJSON_CreateObject();
+            cJSON_AddNumberToObject(zone, "zone", e.first);
+            cJSON_AddNumberToObject(zone, "partition", s->partition);
+            cJSON_AddNumberToObject(zone, "mask", s->address_mask_filter);
+            cJSON_AddStringToObject(zone, "state", AD2Parse.state_str[e.second.state()].c_str());
+            std::string zalpha;
+            AD2Parse.getZoneString(e.first, zalpha);
+            cJSON_AddStringToObject(zone, "name", zalpha.c_str());
+            cJSON_AddItemToArray(alerts, zone);
+        }
+    }
+    return alerts;
+}
+
+/**
+ * @brief The shared partition document built with cJSON and printed.
+ */
+static std::string cjson_document(AD2PartitionState *s)
+{
+    cJSON *root = cjson_partition_state(s);
+    cJSON_AddNumberToObject(root, "partition", s->partition);
+    cJSON_AddNumberToObject(root, "zone", s->zone);
+    cJSON_AddItemToObject(root, "zone_alerts", cjson_zone_alerts(s));
+    char *text = cJSON_PrintUnformatted(root);
+    std::string out = text;
+    cJSON_free(text);
+    cJSON_Delete(root);
+    return out;
+}
+
+/**
+ * @brief The same document with the writer.
+ */
+static void writer_document(AD2JsonWriter &w, AD2PartitionState *s)
+{
+    w.object();
+    ad2_json_partition_state(w, s);
+    w.add("partition", s->partition);
+    w.add("zone", s->zone);
+    ad2_json_zone_alerts(w, "zone_alerts", s);
+    w.end();
+}
+
+static std::string writer_text(AD2PartitionState *s)
+{
+    char buf[2048];
+    AD2JsonWriter w(buf, sizeof(buf));
+    writer_document(w, s);
+    const char *out = w.finish();
+    HOST_CHECK(out && strlen(out) == w.length());
+    return out;
+}
+
+static void test_matches_cjson()
+{
+    host_feed(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+    AD2PartitionState *s = partition();
+    HOST_CHECK(s);
+    HOST_CHECK(writer_text(s) == cjson_document(s));
+
+    // faulted zones fill zone_alerts.
+    host_feed(host_keypad(FAULT, "002", "FAULT 02"));
+    host_feed(host_keypad(FAULT, "005", "FAULT 05"));
+    HOST_CHECK(!s->zone_states.empty());
+    std::string text = writer_text(s);
+    HOST_CHECK(text.find("{\"zone\":2,") != std::string::npos && text.find("{\"zone\":5,") != std::string::npos);
+    HOST_CHECK(text == cjson_document(s));
+
+    // panel text needing escapes.
+    s->last_alpha_message = "say \"hi\" C:\\ \t\x01 caf\xc3\xa9 \x7f/";
+    HOST_CHECK(writer_text(s) == cjson_document(s));
+
+    s->unknown_state = true;
+    HOST_CHECK(writer_text(s) == cjson_document(s));
+    s->unknown_state = false;
+}
+
+static std::string write_json(void (*fill)(AD2JsonWriter &w))
+{
+    char buf[512];
+    AD2JsonWriter w(buf, sizeof(buf));
+    fill(w);
+    const char *out = w.finish();
+    HOST_CHECK(out);
+    return out;
+}
+
+static void test_escaping()
+{
+    struct {
+        const char *in;
+        const char *want;
+    } strings[] = {
+        {"plain", "\"plain\""},
+        {"q\"b\\s", "\"q\\\"b\\\\s\""},
+        {"\b\f\n\r\t", "\"\\b\\f\\n\\r\\t\""},
+        {"\x01\x1f ", "\"\\u0001\\u001f \""},
+        {"\x7f/caf\xc3\xa9", "\"\x7f/caf\xc3\xa9\""},
+        {"", "\"\""},
+    };
+    for (auto &t : strings) {
+        char buf[128];
+        AD2JsonWriter w(buf, sizeof(buf));
+        w.object().add(t.in, t.in);
+        std::string want = std::string("{") + t.want + ":" + t.want + "}";
+        HOST_CHECK(want == w.finish());
+        // and cJSON agrees.
+        cJSON *root = cJSON_CreateObject();
+        cJSON_AddStringToObject(root, t.in, t.in);
+        char *text = cJSON_PrintUnformatted(root);
+        HOST_CHECK(want == text);
+        cJSON_free(text);
+        cJSON_Delete(root);
+    }
+
+    // counted strings keep NUL and stop at the length.
+    HOST_CHECK(write_json([](AD2JsonWriter & w) {
+        w.array().add(nullptr, "a\0b", 3).add(nullptr, "abc", 2).add(nullptr, (const char *)nullptr);
+        w.add(nullptr, std::string("x\0y", 3));
+    }) == "[\"a\\u0000b\",\"ab\",null,\"x\\u0000y\"]");
+
+    HOST_CHECK(write_json([](AD2JsonWriter & w) {
+        w.array().add(nullptr, INT64_MIN).add(nullptr, INT64_MAX).add(nullptr, UINT64_MAX);
+        w.add(nullptr, 0).add(nullptr, -1).add(nullptr, (uint8_t)255).add(nullptr, (int8_t)-128);
+        w.add(nullptr, true).add(nullptr, false);
+    }) == "[-9223372036854775808,9223372036854775807,18446744073709551615,0,-1,255,-128,true,false]");
+
+    // nesting, raw values and spliced members.
+    HOST_CHECK(write_json([](AD2JsonWriter & w) {
+        w.object().object("a").array("b").object().end().array().end().end().end();
+        w.add_raw("raw", "{\"x\":1}", 7).members("\"m\":2,\"n\":3", 11).members("", 0);
+        w.add("last", 4);
+    }) == "{\"a\":{\"b\":[{},[]]},\"raw\":{\"x\":1},\"m\":2,\"n\":3,\"last\":4}");
+    // finish() closes what is still open.
+    HOST_CHECK(write_json([](AD2JsonWriter & w) {
+        w.object().array("a").object().add("b", 1);
+    }) == "{\"a\":[{\"b\":1}]}");
+}
+
+/**
+ * @brief {"k":"<len x>"}, 8 + len bytes.
+ */
+static void fill_len(AD2JsonWriter &w, size_t len)
+{
+    std::string v(len, 'x');
+    w.object().add("k", v).end();
+}
+
+static bool collect(const char *data, size_t len, void *arg)
+{
+    std::string *out = (std::string *)arg;
+    // give up after 40 bytes if asked to.
+    if (out->size() && (*out)[0] == '!' && out->size() > 40) {
+        return false;
+    }
+    out->append(data, len);
+    return true;
+}
+
+static void test_buffer()
+{
+    // fits on the stack. One pass and the stack copy is used.
+    AD2JsonBuffer<64> small;
+    int fills = 0;
+    const char *out = small.render([&](AD2JsonWriter & w) {
+        fills++;
+        fill_len(w, 63 - 8);
+    });
+    HOST_CHECK(fills == 1 && out && strlen(out) == 63 && small.length() == 63);
+    HOST_CHECK(out >= (const char *)&small && out < (const char *)(&small + 1));
+
+    // one byte more does not fit with the NUL. It is measured then written
+    // to the heap.
+    fills = 0;
+    out = small.render([&](AD2JsonWriter & w) {
+        fills++;
+        fill_len(w, 64 - 8);
+    });
+    HOST_CHECK(fills == 2 && out && strlen(out) == 64 && small.length() == 64);
+    HOST_CHECK(!(out >= (const char *)&small && out < (const char *)(&small + 1)));
+    HOST_CHECK(out == "{\"k\":\"" + std::string(56, 'x') + "\"}");
+
+    // much larger documents as well, and a later small one uses the stack.
+    out = small.render([&](AD2JsonWriter & w) {
+        fill_len(w, 5000);
+    });
+    HOST_CHECK(out && strlen(out) == 5008 && small.length() == 5008);
+    out = small.render([&](AD2JsonWriter & w) {
+        fill_len(w, 1);
+    });
+    HOST_CHECK(out >= (const char *)&small && out < (const char *)(&small + 1) && !strcmp(out, "{\"k\":\"x\"}"));
+
+    // the same in CBOR.
+    AD2JsonBuffer<16> cbor(AD2_JSON_FORMAT_CBOR);
+    out = cbor.render([&](AD2JsonWriter & w) {
+        fill_len(w, 100);
+    });
+    HOST_CHECK(out && cbor.length() == 1 + 2 + 2 + 100 + 1);
+
+    // a writer with no room left counts what it needed.
+    char buf[16];
+    AD2JsonWriter w(buf, sizeof(buf));
+    fill_len(w, 100);
+    HOST_CHECK(!w.finish() && !w.ok() && w.length() == 108);
+    AD2JsonWriter none(nullptr, 0);
+    none.object().end();
+    HOST_CHECK(!none.finish() && none.length() == 2);
+
+    // a sink streams any size through a small buffer.
+    std::string streamed;
+    AD2JsonWriter ws(buf, 7, collect, &streamed);
+    fill_len(ws, 1000);
+    HOST_CHECK(ws.finish() && streamed.size() == 1008 && ws.length() == 1008);
+    HOST_CHECK(streamed == "{\"k\":\"" + std::string(1000, 'x') + "\"}");
+    // and stops when the sink fails.
+    streamed = "!";
+    AD2JsonWriter wf(buf, 7, collect, &streamed);
+    fill_len(wf, 1000);
+    HOST_CHECK(!wf.finish() && streamed.size() < 60);
+}
+
+static std::string cbor_of(void (*fill)(AD2JsonWriter &w))
+{
+    char buf[256];
+    AD2JsonWriter w(buf, sizeof(buf), nullptr, nullptr, AD2_JSON_FORMAT_CBOR);
+    w.array();
+    fill(w);
+    w.end();
+    HOST_CHECK(w.finish());
+    return std::string(buf, w.length());
+}
+
+static void test_cbor()
+{
+    // RFC 8949 shortest form integer heads.
+    HOST_CHECK(cbor_of([](AD2JsonWriter & w) {
+        w.add(nullptr, 0).add(nullptr, 23).add(nullptr, 24).add(nullptr, 255).add(nullptr, 256);
+    }) == std::string("\x9f\x00\x17\x18\x18\x18\xff\x19\x01\x00\xff", 11));
+    HOST_CHECK(cbor_of([](AD2JsonWriter & w) {
+        w.add(nullptr, 65535).add(nullptr, 65536).add(nullptr, 4294967296ULL);
+    }) == std::string("\x9f\x19\xff\xff\x1a\x00\x01\x00\x00\x1b\x00\x00\x00\x01\x00\x00\x00\x00\xff", 19));
+    HOST_CHECK(cbor_of([](AD2JsonWriter & w) {
+        w.add(nullptr, -1).add(nullptr, -24).add(nullptr, -25).add(nullptr, INT64_MIN);
+    }) == std::string("\x9f\x20\x37\x38\x18\x3b\x7f\xff\xff\xff\xff\xff\xff\xff\xff", 15));
+    HOST_CHECK(cbor_of([](AD2JsonWriter & w) {
+        w.add(nullptr, true).add(nullptr, false).add(nullptr, (const char *)nullptr);
+        w.add(nullptr, "").add(nullptr, "a\"\n", 3);
+    }) == std::string("\x9f\xf5\xf4\xf6\x60\x63" "a\"\n" "\xff", 10));
+    std::string text24(24, 'z');
+    std::string long_text = cbor_of([](AD2JsonWriter & w) {
+        w.add(nullptr, std::string(24, 'z'));
+    });
+    HOST_CHECK(long_text == std::string("\x9f\x78\x18", 3) + text24 + "\xff");
+    // maps with text keys and nested containers.
+    HOST_CHECK(cbor_of([](AD2JsonWriter & w) {
+        w.object().add("a", 1).array("b").end().object("c").end().end();
+    }) == std::string("\x9f\xbf\x61" "a" "\x01\x61" "b" "\x9f\xff\x61" "c" "\xbf\xff\xff\xff", 15));
+
+    // the partition document. Smaller than the JSON and every key is there.
+    AD2PartitionState *s = partition();
+    char buf[2048];
+    AD2JsonWriter w(buf, sizeof(buf), nullptr, nullptr, AD2_JSON_FORMAT_CBOR);
+    writer_document(w, s);
+    HOST_CHECK(w.finish());
+    std::string doc(buf, w.length());
+    HOST_CHECK((uint8_t)doc.front() == 0xbf && (uint8_t)doc.back() == 0xff);
+    HOST_CHECK(doc.size() < writer_text(s).size());
+    for (auto &f : AD2_PARTITION_STATE_SCHEMA) {
+        std::string key = std::string(1, (char)(0x60 + strlen(f.key))) + f.key;
+        if (strlen(f.key) >= 24) {
+            key = std::string("\x78", 1) + (char)strlen(f.key) + f.key;
+        }
+        HOST_CHECK(doc.find(key) != std::string::npos);
+    }
+}
+
+/**
+ * @brief Time the partition document built with cJSON and printed against
+ * the writer into a stack buffer.
+ */
+static void bench()
+{
+    using clock = std::chrono::steady_clock;
+    const int docs = 20000;
+    AD2PartitionState *s = partition();
+    std::string want = cjson_document(s);
+    size_t cjson_allocs = host_cjson_allocs;
+    size_t heap_allocs = host_heap_allocs;
+
+    clock::time_point start = clock::now();
+    size_t bytes = 0;
+    for (int n = 0; n < docs; n++) {
+        cJSON *root = cjson_partition_state(s);
+        cJSON_AddNumberToObject(root, "partition", s->partition);
+        cJSON_AddNumberToObject(root, "zone", s->zone);
+        cJSON_AddItemToObject(root, "zone_alerts", cjson_zone_alerts(s));
+        char *text = cJSON_PrintUnformatted(root);
+        bytes += strlen(text);
+        cJSON_free(text);
+        cJSON_Delete(root);
+    }
+    double cjson_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / docs;
+    double allocs = (double)(host_cjson_allocs - cjson_allocs) / docs;
+    HOST_CHECK(bytes == want.size() * docs);
+
+    heap_allocs = host_heap_allocs;
+    cjson_allocs = host_cjson_allocs;
+    start = clock::now();
+    bytes = 0;
+    for (int n = 0; n < docs; n++) {
+        char buf[1024];
+        AD2JsonWriter w(buf, sizeof(buf));
+        writer_document(w, s);
+        HOST_CHECK(w.finish());
+        bytes += w.length();
+    }
+    double writer_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / docs;
+    HOST_CHECK(bytes == want.size() * docs);
+    // zone names are read into a std::string, nothing else allocates.
+    size_t names = 0;
+    for (auto &e : s->zone_states) {
+        names += e.second.state() != AD2_STATE_CLOSED;
+    }
+    HOST_CHECK(host_cjson_allocs == cjson_allocs);
+    HOST_CHECK(host_heap_allocs - heap_allocs <= names * docs);
+
+    printf("partition document %zu bytes JSON\n", want.size());
+    printf("  cJSON  %8.1f ns %6.1f mallocs per document\n", cjson_ns, allocs);
+    printf("  writer %8.1f ns %6.1f mallocs per document\n", writer_ns,
+           (double)(host_heap_allocs - heap_allocs) / docs);
+}
+
+int main()
+{
+    ad2_init_json_snapshots();
+    test_matches_cjson();
+    test_escaping();
+    test_buffer();
+    test_cbor();
+    bench();
+    puts("json writer OK");
+    return 0;
+}
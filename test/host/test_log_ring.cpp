@@ -0,0 +1,408 @@
+/**
+ *  @file    test_log_ring.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Binary log ring packing, wrap around and torn reads.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// the ring reader copies slots with memcpy(). Lets a test write to a slot
+// right after it was copied as another core could.
+#include <cstring>
+static void (*copied_hook)(const void *src) = nullptr;
+static void *copy_hooked(void *dst, const void *src, size_t size)
+{
+    memcpy(dst, src, size);
+    if (copied_hook) {
+        copied_hook(src);
+    }
+    return dst;
+}
+#define memcpy copy_hooked
+
+// module under test
+#include "ad2_log.cpp"
+#undef memcpy
+
+// host includes
+#include "host.h"
+#include <thread>
+
+#define ARGS_MAX (AD2_LOG_RECORD_MAX - sizeof(ad2_log_record))
+
+/// Strings copied here are in RAM. Everything else counts as flash.
+static char ram[1024];
+
+static bool in_drom(const void *p)
+{
+    return p < (const void *)ram || p >= (const void *)(ram + sizeof(ram));
+}
+
+static const char *in_ram(const char *text, size_t at = 0)
+{
+    strlcpy(ram + at, text, sizeof(ram) - at);
+    return ram + at;
+}
+
+static void capture(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    ad2_capture_log_vprintf(fmt, args);
+    va_end(args);
+}
+
+/**
+ * @brief Read the newest record in the ring.
+ *
+ * @return uint32_t ring index of its first slot.
+ */
+static uint32_t newest(uint8_t *rec, ad2_log_record &hdr, int *nslots = nullptr)
+{
+    uint32_t end = _ad2_log_next.load();
+    for (uint32_t idx = end - 1; idx + AD2_LOG_SLOTS >= end; idx--) {
+        int n = _ad2_log_read(idx, rec, hdr);
+        if (n > 0) {
+            HOST_CHECK(idx + n == end);
+            if (nslots) {
+                *nslots = n;
+            }
+            return idx;
+        }
+    }
+    HOST_CHECK(!"no record");
+    return 0;
+}
+
+static std::string newest_text()
+{
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    newest(rec, hdr);
+    char text[AD2_LOG_LINE_SIZE];
+    _ad2_log_format(rec, hdr, text, sizeof(text));
+    return text;
+}
+
+static std::vector<std::string> recent(size_t limit = SIZE_MAX)
+{
+    std::vector<std::string> texts;
+    _ad2_log_for_each_recent(limit, [&](const ad2_log_record & hdr, const char *text) {
+        texts.push_back(text);
+    });
+    return texts;
+}
+
+/// Log a call and check it reads back as printf would have formatted it.
+#define CHECK_FORMAT(fmt, ...) do { \
+    char want[AD2_LOG_LINE_SIZE]; \
+    snprintf(want, sizeof(want), fmt, __VA_ARGS__); \
+    capture(fmt, __VA_ARGS__); \
+    HOST_CHECK(newest_text() == want); \
+} while (0)
+
+static void test_formats()
+{
+    CHECK_FORMAT("%d %i %u %x %X %o", -5, 6, 7u, 255, 254, 8);
+    CHECK_FORMAT("%ld %lu %lld %llx", -1L, 2UL, 1LL << 40, 0xfedcba9876ULL);
+    CHECK_FORMAT("%zu %hhd %hd %c", (size_t)12345, 300, 70000, 'z');
+    CHECK_FORMAT("%5.2f|%e|%g", 3.14159, -2.5e10, 0.125);
+    CHECK_FORMAT("%-6s|%6s|%.2s", "ab", "cd", "efgh");
+    CHECK_FORMAT("%*d|%-*d|%.*s|%*.*f", 6, 42, 4, 7, 3, "abcdef", 8, 2, 1.5);
+    CHECK_FORMAT("%p 100%% %s", (void *)0x1234, "done");
+    // %n is never written through.
+    int n = 0;
+    capture("ab%n", &n);
+    HOST_CHECK(newest_text() == "ab" && n == 0);
+}
+
+static void test_strings()
+{
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    const uint8_t *args = rec + sizeof(hdr);
+
+    // a flash string is kept as a pointer.
+    capture("%s=%d", "flash", 1);
+    newest(rec, hdr);
+    HOST_CHECK(hdr.fmt && args[0] == AD2_LOG_STR_PTR);
+    HOST_CHECK(hdr.length == sizeof(hdr) + 1 + sizeof(char *) + 4);
+    HOST_CHECK(newest_text() == "flash=1");
+
+    // a RAM string is copied and survives the buffer changing.
+    capture("%s=%d", in_ram("ram"), 2);
+    newest(rec, hdr);
+    HOST_CHECK(args[0] == AD2_LOG_STR_INLINE && !strcmp((const char *)args + 1, "ram"));
+    HOST_CHECK(hdr.length == sizeof(hdr) + 5 + 4);
+    in_ram("XYZ");
+    HOST_CHECK(newest_text() == "ram=2");
+
+    const char *none = nullptr;
+    capture("[%s]", none);
+    HOST_CHECK(newest_text() == "[(null)]");
+
+    // a RAM format string is formatted at once and stored as text.
+    capture(in_ram("ram fmt %d %s", 100), 3, in_ram("arg"));
+    newest(rec, hdr);
+    HOST_CHECK(!hdr.fmt && !strcmp((const char *)args, "ram fmt 3 arg"));
+    in_ram("XYZ %d", 100);
+    HOST_CHECK(newest_text() == "ram fmt 3 arg");
+
+    // lines end at the first CR/LF.
+    ad2_capture_log_line("line one\r\nline two");
+    HOST_CHECK(newest_text() == "line one");
+    capture("%s|%d\n", in_ram("two\nlines"), 4);
+    HOST_CHECK(newest_text() == "two");
+}
+
+static void test_truncation()
+{
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    int nslots;
+
+    // a long RAM string fills the record. The sizing and writing passes
+    // agree and the arguments that no longer fit print as missing.
+    std::string longest(400, 'x');
+    capture("%s %d %s", in_ram(longest.c_str()), 5, "flash");
+    newest(rec, hdr, &nslots);
+    HOST_CHECK(hdr.length == AD2_LOG_RECORD_MAX && nslots == 8);
+    char text[AD2_LOG_RECORD_MAX * 2];
+    _ad2_log_format(rec, hdr, text, sizeof(text));
+    HOST_CHECK(text == std::string(ARGS_MAX - 2, 'x') + " ? ?");
+    // and the line is cut to the line size.
+    HOST_CHECK(newest_text() == std::string(text, AD2_LOG_LINE_SIZE - 1));
+
+    // a string that fits after other arguments is cut to what is left.
+    capture("%lld %s|%d", 1LL, in_ram(longest.c_str()), 6);
+    newest(rec, hdr, &nslots);
+    HOST_CHECK(hdr.length == AD2_LOG_RECORD_MAX);
+    _ad2_log_format(rec, hdr, text, sizeof(text));
+    HOST_CHECK(text == "1 " + std::string(ARGS_MAX - 8 - 2, 'x') + "|?");
+
+    // a pointer needs its whole size, so it is dropped rather than cut.
+    capture("%s %s", in_ram(std::string(ARGS_MAX - 4, 'y').c_str()), "flash");
+    newest(rec, hdr);
+    _ad2_log_format(rec, hdr, text, sizeof(text));
+    HOST_CHECK(text == std::string(ARGS_MAX - 4, 'y') + " ?");
+
+    // a text record keeps what fits.
+    capture(in_ram("%s", 600), in_ram(longest.c_str()));
+    newest(rec, hdr, &nslots);
+    HOST_CHECK(!hdr.fmt && hdr.length == AD2_LOG_RECORD_MAX && nslots == 8);
+    HOST_CHECK(strlen((const char *)rec + sizeof(hdr)) == ARGS_MAX - 1);
+    ad2_capture_log_line(longest.c_str());
+    newest(rec, hdr);
+    HOST_CHECK(hdr.length == AD2_LOG_RECORD_MAX);
+}
+
+/**
+ * @brief Record n of the wrap test. Sizes of 1, 2, 3 and 3 slots so
+ * records straddle the end of the ring.
+ */
+static void log_record(int n)
+{
+    switch (n % 4) {
+    case 0:
+        ad2_capture_log_line(std::to_string(n).substr(0, 1).c_str());
+        break;
+    case 1:
+        capture("rec %d", n);
+        break;
+    default:
+        capture("rec %d %s", n, in_ram("a RAM string that takes a third slot"));
+        break;
+    }
+}
+
+static std::string record_text(int n)
+{
+    switch (n % 4) {
+    case 0:
+        return std::to_string(n).substr(0, 1);
+    case 1:
+        return "rec " + std::to_string(n);
+    default:
+        return "rec " + std::to_string(n) + " a RAM string that takes a third slot";
+    }
+}
+
+static void test_wrap()
+{
+    // the ring is reused many times over. Only records with every slot
+    // in the last AD2_LOG_SLOTS are left.
+    std::vector<uint32_t> first;
+    const int records = AD2_LOG_SLOTS * 5 + 1;
+    for (int n = 0; n < records; n++) {
+        first.push_back(_ad2_log_next.load());
+        log_record(n);
+    }
+    uint32_t end = _ad2_log_next.load();
+    HOST_CHECK(end - first[0] == (uint32_t)records / 4 * 9 + 1);
+    int oldest = 0;
+    while (first[oldest] < end - AD2_LOG_SLOTS) {
+        oldest++;
+    }
+    // the slot before the oldest record is the tail of one overwritten
+    // at its head.
+    HOST_CHECK(first[oldest] != end - AD2_LOG_SLOTS);
+
+    std::vector<std::string> texts = recent();
+    HOST_CHECK((int)texts.size() == records - oldest);
+    for (size_t n = 0; n < texts.size(); n++) {
+        HOST_CHECK(texts[n] == record_text(oldest + n));
+    }
+    texts = recent(10);
+    HOST_CHECK(texts.size() == 10 && texts.back() == record_text(records - 1));
+    HOST_CHECK(texts.front() == record_text(records - 10));
+}
+
+static void test_torn()
+{
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    int nslots;
+
+    capture("before %d", 1);
+    capture("torn %d %s", 2, in_ram("a RAM string that takes a third slot"));
+    uint32_t idx = newest(rec, hdr, &nslots);
+    HOST_CHECK(nslots == 3);
+    HOST_CHECK(recent(1).back() == "torn 2 a RAM string that takes a third slot");
+
+    // a writer part way through any slot. The reader tries again later.
+    for (int n = 0; n < nslots; n++) {
+        ad2_log_slot &slot = _ad2_log_ring[(idx + n) % AD2_LOG_SLOTS];
+        uint32_t seq = slot.seq.exchange(0);
+        HOST_CHECK(_ad2_log_read(idx, rec, hdr) == -1);
+        HOST_CHECK(recent(1).back() == "before 1");
+        slot.seq = seq;
+    }
+    HOST_CHECK(_ad2_log_read(idx, rec, hdr) == nslots);
+
+    // a slot the writer has not reached yet still holds the last lap.
+    ad2_log_slot &tail = _ad2_log_ring[(idx + 2) % AD2_LOG_SLOTS];
+    tail.seq -= AD2_LOG_SLOTS;
+    HOST_CHECK(_ad2_log_read(idx, rec, hdr) == -1);
+    // a slot taken by a newer record. The record is gone.
+    tail.seq += 2 * AD2_LOG_SLOTS;
+    HOST_CHECK(_ad2_log_read(idx, rec, hdr) == 0);
+    HOST_CHECK(recent(1).back() == "before 1");
+    tail.seq -= AD2_LOG_SLOTS;
+
+    // a record header that does not match its slots is rejected.
+    ad2_log_slot &head = _ad2_log_ring[idx % AD2_LOG_SLOTS];
+    uint16_t length;
+    memcpy(&length, head.data + offsetof(ad2_log_record, length), sizeof(length));
+    uint16_t bad = nslots * AD2_LOG_SLOT_DATA + 1;
+    memcpy(head.data + offsetof(ad2_log_record, length), &bad, sizeof(bad));
+    HOST_CHECK(_ad2_log_read(idx, rec, hdr) == 0);
+    memcpy(head.data + offsetof(ad2_log_record, length), &length, sizeof(length));
+    HOST_CHECK(_ad2_log_read(idx, rec, hdr) == nslots);
+
+    // a writer starts on a slot after the reader checked and copied it.
+    // Only the check after the copy sees it.
+    static uint32_t torn_slot;
+    for (torn_slot = idx; torn_slot < idx + nslots; torn_slot++) {
+        copied_hook = [](const void *src) {
+            ad2_log_slot &slot = _ad2_log_ring[torn_slot % AD2_LOG_SLOTS];
+            if (src == slot.data) {
+                slot.seq = 0;
+                memset(slot.data, '#', sizeof(slot.data));
+            }
+        };
+        ad2_log_slot saved;
+        ad2_log_slot &slot = _ad2_log_ring[torn_slot % AD2_LOG_SLOTS];
+        memcpy(saved.data, slot.data, sizeof(saved.data));
+        HOST_CHECK(_ad2_log_read(idx, rec, hdr) == 0);
+        copied_hook = nullptr;
+        HOST_CHECK(_ad2_log_read(idx, rec, hdr) == -1);
+        memcpy(slot.data, saved.data, sizeof(saved.data));
+        slot.seq = torn_slot + 1;
+        HOST_CHECK(_ad2_log_read(idx, rec, hdr) == nslots);
+    }
+    HOST_CHECK(recent(1).back() == "torn 2 a RAM string that takes a third slot");
+}
+
+/**
+ * @brief Line n of the race test. The filler is a function of n so a
+ * record mixed from two writes is seen.
+ */
+static std::string race_line(int n)
+{
+    return "n " + std::to_string(n) + " " + std::string(n % 150 + 1, 'a' + n % 26);
+}
+
+static void check_race_line(const char *text)
+{
+    int n;
+    HOST_CHECK(sscanf(text, "n %d", &n) == 1);
+    HOST_CHECK(text == race_line(n));
+}
+
+static void test_race()
+{
+    // a writer laps the ring over and over while the records it is about
+    // to overwrite are read. Every record read back must be whole.
+    const int lines = 500000;
+    for (int n = 0; n < AD2_LOG_SLOTS; n++) {
+        ad2_capture_log_line(race_line(n).c_str());
+    }
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int n = AD2_LOG_SLOTS; n < lines; n++) {
+            ad2_capture_log_line(race_line(n).c_str());
+        }
+        done = true;
+    });
+    uint8_t rec[AD2_LOG_RECORD_MAX];
+    ad2_log_record hdr;
+    char text[AD2_LOG_RECORD_MAX];
+    int whole = 0, torn = 0, busy = 0;
+    while (!done) {
+        uint32_t end = _ad2_log_next.load();
+        for (uint32_t idx = end - AD2_LOG_SLOTS; idx < end - AD2_LOG_SLOTS + 16; idx++) {
+            int n = _ad2_log_read(idx, rec, hdr);
+            if (n > 0) {
+                _ad2_log_format(rec, hdr, text, sizeof(text));
+                check_race_line(text);
+                whole++;
+            } else {
+                (n ? busy : torn)++;
+            }
+        }
+    }
+    writer.join();
+    for (auto &line : recent()) {
+        check_race_line(line.c_str());
+    }
+    HOST_CHECK(whole > 0);
+    printf("race: %d whole, %d gone, %d being written\n", whole, torn, busy);
+}
+
+int main()
+{
+    host_ptr_in_drom = in_drom;
+
+    test_formats();
+    test_strings();
+    test_truncation();
+    test_wrap();
+    test_torn();
+    test_race();
+    puts("log ring OK");
+    return 0;
+}
@@ -0,0 +1,554 @@
+/**
+ *  @file    test_log_sd.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief uSD log group commit writer, segments, codec and range queries.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// wall clock the test controls. Renames the ad2_utils.h declaration too.
+#define ad2_wall_clock_ms host_wall_clock_ms
+
+// module under test
+#include "ad2_log.cpp"
+
+// host includes
+#include "host.h"
+#include <functional>
+#include <memory>
+#include <random>
+
+#define WALL_BASE_MS 1700000000000LL
+
+/// The wall clock is only set for the segment tests.
+static bool wall_set = false;
+
+int64_t host_wall_clock_ms()
+{
+    return wall_set ? WALL_BASE_MS + (int64_t)(host_uptime_us / 1000) : 0;
+}
+
+/// Run by the uSD log task as it wakes with the turn number.
+static std::function<void(int)> on_wake;
+static int wake_turn = 0;
+
+static void wake_hook()
+{
+    if (on_wake) {
+        on_wake(wake_turn);
+    }
+    wake_turn++;
+}
+
+/**
+ * @brief Run the uSD log task for wakes turns calling fn before each one.
+ */
+static void run_writer(int wakes, std::function<void(int)> fn)
+{
+    on_wake = fn;
+    wake_turn = 0;
+    host_run_task(host_task("AD2 SD log"), wakes);
+    on_wake = nullptr;
+}
+
+static ad2_sd_log_stats_t stats()
+{
+    ad2_sd_log_stats_t s;
+    ad2_get_sd_logging_stats(&s);
+    return s;
+}
+
+/// Text and uptime of every line given to the log that should reach the
+/// card.
+static std::vector<std::string> logged;
+static std::vector<int64_t> logged_ms;
+
+static void log_line(const std::string &text, bool kept = true)
+{
+    ad2_capture_log_line(text.c_str());
+    if (kept) {
+        logged.push_back(text);
+        logged_ms.push_back(host_uptime_us / 1000);
+    }
+}
+
+static bool collect(const char *line, size_t len, void *arg)
+{
+    ((std::vector<std::string> *)arg)->push_back(std::string(line, len));
+    return true;
+}
+
+/**
+ * @brief Lines on the card in an uptime range with their "[<uptime> ms] "
+ * prefix removed.
+ */
+static std::vector<std::string> card_lines(int64_t from_ms = 0, int64_t to_ms = INT64_MAX)
+{
+    std::vector<std::string> lines;
+    size_t count = ad2_sd_log_query(from_ms, to_ms, false, collect, &lines);
+    HOST_CHECK(count == lines.size());
+    for (auto &line : lines) {
+        size_t end = line.find(" ms] ");
+        HOST_CHECK(line[0] == '[' && end != std::string::npos);
+        line.erase(0, end + 5);
+    }
+    return lines;
+}
+
+/**
+ * @brief Logged lines in an uptime range.
+ */
+static std::vector<std::string> logged_lines(int64_t from_ms, int64_t to_ms)
+{
+    std::vector<std::string> lines;
+    for (size_t n = 0; n < logged.size(); n++) {
+        if (logged_ms[n] >= from_ms && logged_ms[n] <= to_ms) {
+            lines.push_back(logged[n]);
+        }
+    }
+    return lines;
+}
+
+static void clear_card()
+{
+    DIR *dir = opendir(AD2_SD_LOG_DIR);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                remove((std::string(AD2_SD_LOG_DIR) + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+}
+
+static void test_time_flush()
+{
+    // lines wait in the staging buffer until the oldest is old enough.
+    ad2_sd_log_stats_t before = stats();
+    run_writer(4, [&](int turn) {
+        if (turn == 0) {
+            for (int n = 0; n < 50; n++) {
+                log_line("time " + std::to_string(n));
+            }
+        } else if (turn == 1) {
+            HOST_CHECK(stats().writes == before.writes && _ad2_sd_log_staged_lines == 50);
+            host_advance_ms(AD2_SD_LOG_FLUSH_MS - 1);
+        } else if (turn == 2) {
+            HOST_CHECK(stats().writes == before.writes);
+            host_advance_ms(1);
+        } else {
+            // one write for all of them.
+            ad2_sd_log_stats_t now = stats();
+            HOST_CHECK(now.writes == before.writes + 1 && now.lines == before.lines + 50);
+            HOST_CHECK(_ad2_sd_log_staged == 0);
+        }
+    });
+}
+
+static void test_size_flush()
+{
+    // a full staging buffer is written at once. Every write but the last
+    // is close to the staging size.
+    ad2_sd_log_stats_t before = stats();
+    size_t text_bytes = 0;
+    int lines = 0;
+    run_writer(6, [&](int turn) {
+        if (turn < 5) {
+            for (int n = 0; n < 150; n++, lines++) {
+                std::string text = "size " + std::to_string(lines) + " abcdefghijklmnop";
+                text_bytes += text.size();
+                log_line(text);
+            }
+        } else {
+            host_advance_ms(AD2_SD_LOG_FLUSH_MS);
+        }
+    });
+    ad2_sd_log_stats_t now = stats();
+    uint32_t writes = now.writes - before.writes;
+    uint32_t raw = now.raw_bytes - before.raw_bytes;
+    HOST_CHECK(now.lines - before.lines == (uint32_t)lines && raw > text_bytes);
+    HOST_CHECK(writes >= raw / AD2_SD_LOG_STAGE_SIZE + 1);
+    HOST_CHECK(writes <= raw / (AD2_SD_LOG_STAGE_SIZE - AD2_LOG_LINE_SIZE - 32) + 1);
+}
+
+static void test_error_flush()
+{
+    // an error level line is written right away with what was staged.
+    ad2_sd_log_stats_t before = stats();
+    run_writer(2, [&](int turn) {
+        if (turn == 0) {
+            for (int n = 0; n < 10; n++) {
+                log_line("before error " + std::to_string(n));
+            }
+            log_line("\033[0;31mE (1234) TEST: failed\033[0m");
+        } else {
+            ad2_sd_log_stats_t now = stats();
+            HOST_CHECK(now.writes == before.writes + 1 && now.lines == before.lines + 11);
+        }
+    });
+    // a warning is not urgent.
+    run_writer(2, [&](int turn) {
+        if (turn == 0) {
+            log_line("W (1235) TEST: careful");
+        } else {
+            HOST_CHECK(stats().writes == before.writes + 1);
+            host_advance_ms(AD2_SD_LOG_FLUSH_MS);
+        }
+    });
+    HOST_CHECK(stats().writes == before.writes + 2);
+}
+
+static void test_overrun()
+{
+    // more than the ring holds between wakes. The oldest are counted as
+    // dropped and the rest are written.
+    uint32_t dropped;
+    ad2_get_sd_logging_status(nullptr, nullptr, &dropped, nullptr);
+    const int lines = AD2_LOG_SLOTS;
+    run_writer(2, [&](int turn) {
+        if (turn == 0) {
+            for (int n = 0; n < lines; n++) {
+                // two slots each.
+                log_line("overrun " + std::to_string(n), n >= lines / 2);
+            }
+        } else {
+            host_advance_ms(AD2_SD_LOG_FLUSH_MS);
+        }
+    });
+    uint32_t now;
+    ad2_get_sd_logging_status(nullptr, nullptr, &now, nullptr);
+    HOST_CHECK(now - dropped == (uint32_t)lines * 2 - AD2_LOG_SLOTS);
+}
+
+static void test_unmounted()
+{
+    // with no card the open segment is closed and lines are skipped.
+    ad2_sd_log_stats_t before = stats();
+    run_writer(3, [&](int turn) {
+        if (turn == 0) {
+            log_line("staged then unmounted", false);
+        } else if (turn == 1) {
+            g_uSD_mounted = false;
+            log_line("while unmounted", false);
+            host_advance_ms(AD2_SD_LOG_FLUSH_MS);
+        } else {
+            HOST_CHECK(!_ad2_sd_seg.file && !_ad2_sd_log_staged);
+            g_uSD_mounted = true;
+        }
+    });
+    HOST_CHECK(stats().lines == before.lines);
+}
+
+static std::mt19937 rng(33);
+
+static std::vector<uint8_t> random_bytes(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    for (auto &b : bytes) {
+        b = rng();
+    }
+    return bytes;
+}
+
+static std::vector<uint8_t> log_text(size_t size)
+{
+    std::string text;
+    for (int n = 0; text.size() < size; n++) {
+        text += "[" + std::to_string(1000 + n * 37) + " ms] I (" + std::to_string(n) +
+                ") AD2UTIL: zone " + std::to_string(rng() % 48) + " state change\r\n";
+    }
+    return std::vector<uint8_t>(text.begin(), text.begin() + size);
+}
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t> &raw)
+{
+    // all literals is the worst case.
+    std::vector<uint8_t> comp(raw.size() + raw.size() / 255 + 2);
+    size_t size = _ad2_lz_compress(raw.data(), raw.size(), comp.data(), comp.size());
+    HOST_CHECK(size > 0);
+    comp.resize(size);
+    return comp;
+}
+
+/**
+ * @brief Decompress from and into heap blocks of exactly the given sizes
+ * so the address sanitizer sees any access past either end.
+ */
+static int decompress(const uint8_t *src, size_t src_size, size_t dst_size, std::vector<uint8_t> *out = nullptr)
+{
+    std::unique_ptr<uint8_t[]> in(new uint8_t[src_size ? src_size : 1]);
+    std::unique_ptr<uint8_t[]> dst(new uint8_t[dst_size ? dst_size : 1]);
+    memcpy(in.get(), src, src_size);
+    int size = _ad2_lz_decompress(in.get(), src_size, dst.get(), dst_size);
+    if (out && size >= 0) {
+        out->assign(dst.get(), dst.get() + size);
+    }
+    return size;
+}
+
+static void test_codec_round_trip()
+{
+    const size_t sizes[] = {0, 1, 4, 12, 13, 17, 100, 255, 270, 1000, AD2_SD_LOG_STAGE_SIZE - 1, AD2_SD_LOG_STAGE_SIZE};
+    for (size_t size : sizes) {
+        std::vector<std::vector<uint8_t>> inputs = {
+            random_bytes(size), std::vector<uint8_t>(size, 0), log_text(size)
+        };
+        std::vector<uint8_t> pattern(size);
+        for (size_t n = 0; n < size; n++) {
+            pattern[n] = "abc"[n % 3];
+        }
+        inputs.push_back(pattern);
+        for (auto &raw : inputs) {
+            std::vector<uint8_t> comp = compress(raw), out;
+            HOST_CHECK(decompress(comp.data(), comp.size(), raw.size(), &out) == (int)raw.size());
+            HOST_CHECK(out == raw);
+        }
+    }
+
+    // repetitive input shrinks a lot, log text well and random input not
+    // at all, so the writer stores it as is.
+    const size_t stage = AD2_SD_LOG_STAGE_SIZE;
+    HOST_CHECK(compress(std::vector<uint8_t>(stage, 0)).size() < stage / 50);
+    HOST_CHECK(compress(log_text(stage)).size() < stage / 2);
+    std::vector<uint8_t> noise = random_bytes(stage), comp(stage - 1);
+    HOST_CHECK(_ad2_lz_compress(noise.data(), stage, comp.data(), comp.size()) == 0);
+
+    // far matches. The hash table only keeps 16 bit positions.
+    std::vector<uint8_t> far = random_bytes(70000);
+    std::copy(far.begin(), far.begin() + 1000, far.end() - 1000);
+    std::vector<uint8_t> out;
+    comp = compress(far);
+    HOST_CHECK(decompress(comp.data(), comp.size(), far.size(), &out) == (int)far.size() && out == far);
+}
+
+static void test_codec_corrupt()
+{
+    std::vector<uint8_t> raw = log_text(AD2_SD_LOG_STAGE_SIZE);
+    std::vector<uint8_t> comp = compress(raw);
+
+    // a truncated block never decodes to the whole block.
+    for (size_t size = 0; size < comp.size(); size++) {
+        HOST_CHECK(decompress(comp.data(), size, raw.size()) < (int)raw.size());
+    }
+    // nor does one larger than the room given.
+    HOST_CHECK(decompress(comp.data(), comp.size(), raw.size() - 1) == -1);
+
+    // random damage is rejected or decodes to something that fits.
+    for (int n = 0; n < 5000; n++) {
+        std::vector<uint8_t> bad = comp;
+        for (int hits = 1 + rng() % 4; hits > 0; hits--) {
+            bad[rng() % bad.size()] ^= 1 << (rng() % 8);
+        }
+        HOST_CHECK(decompress(bad.data(), bad.size(), raw.size()) <= (int)raw.size());
+    }
+    for (int n = 0; n < 1000; n++) {
+        std::vector<uint8_t> bad = random_bytes(1 + rng() % 64);
+        HOST_CHECK(decompress(bad.data(), bad.size(), 256) <= 256);
+    }
+
+    // hand made sequences.
+    const std::vector<std::vector<uint8_t>> rejected = {
+        {0x10, 'a', 0x00, 0x00},              // match offset 0.
+        {0x10, 'a', 0x02, 0x00},              // offset before the start.
+        {0x10, 'a', 0x01},                    // offset cut short.
+        {0x50, 'a', 'b'},                     // literals past the end.
+        {0xf0, 0xff},                         // literal length cut short.
+        {0x1f, 'a', 0x01, 0x00, 0xff},        // match length cut short.
+        {0x1f, 'a', 0x01, 0x00, 0xff, 0x00},  // match past the output.
+    };
+    for (auto &bad : rejected) {
+        HOST_CHECK(decompress(bad.data(), bad.size(), 64) == -1);
+    }
+    // an overlapping match repeats the last bytes.
+    std::vector<uint8_t> run = {0x21, 'a', 'b', 0x02, 0x00}, out;
+    HOST_CHECK(decompress(run.data(), run.size(), 64, &out) == 7);
+    HOST_CHECK(std::string(out.begin(), out.end()) == "abababa");
+}
+
+/**
+ * @brief Segment headers on the card oldest first.
+ */
+static std::vector<std::pair<uint32_t, ad2_log_seg_hdr>> card_segments()
+{
+    std::vector<std::pair<uint32_t, uint32_t>> list;
+    _ad2_sd_log_list_segments(list);
+    std::vector<std::pair<uint32_t, ad2_log_seg_hdr>> segments;
+    for (auto &segment : list) {
+        FILE *file = fopen(_ad2_sd_log_segment_path(segment.first).c_str(), "rb");
+        HOST_CHECK(file);
+        ad2_log_seg_hdr hdr;
+        HOST_CHECK(fread(&hdr, 1, sizeof(hdr), file) == sizeof(hdr) && hdr.magic == AD2_LOG_SEG_MAGIC);
+        fclose(file);
+        segments.push_back(std::make_pair(segment.first, hdr));
+    }
+    return segments;
+}
+
+static void test_retention()
+{
+    // log far more than the budget with the wall clock set. Lines are 1
+    // ms apart with random text so segments fill quickly.
+    wall_set = true;
+    _ad2_sd_log_retention_bytes = 6 * AD2_SD_LOG_SEGMENT_BYTES;
+    size_t first_line = logged.size();
+    run_writer(200, [&](int turn) {
+        for (int n = 0; n < AD2_LOG_SLOTS / 2; n++) {
+            char text[AD2_LOG_SLOT_DATA * 2 - sizeof(ad2_log_record)];
+            snprintf(text, sizeof(text), "seg %06d %08x%08x", turn * 1000 + n,
+                     (unsigned)rng(), (unsigned)rng());
+            log_line(text);
+            host_advance_ms(1);
+        }
+    });
+    run_writer(1, [&](int turn) {
+        host_advance_ms(AD2_SD_LOG_FLUSH_MS);
+    });
+
+    // the oldest segments were deleted when the open one was started. The
+    // closed ones left fit the budget and the newest ones are all there.
+    auto segments = card_segments();
+    uint64_t total = 0;
+    for (size_t n = 0; n < segments.size(); n++) {
+        total += _ad2_sd_log_segments[n].second;
+        HOST_CHECK(segments[n].first == _ad2_sd_log_segments[n].first);
+        HOST_CHECK(n == 0 || segments[n].first == segments[n - 1].first + 1);
+        HOST_CHECK(segments[n].second.boot_seq == _ad2_sd_seg.boot_seq);
+    }
+    HOST_CHECK(segments.size() > 2 && segments.back().first > segments.size() + 2);
+    uint64_t closed = total - _ad2_sd_seg.size;
+    HOST_CHECK(closed <= _ad2_sd_log_retention_bytes);
+    HOST_CHECK(closed + AD2_SD_LOG_SEGMENT_BYTES > _ad2_sd_log_retention_bytes);
+    ad2_sd_log_stats_t s = stats();
+    HOST_CHECK(s.segments == segments.size() && s.stored_bytes == total);
+
+    // the card holds a suffix of what was logged.
+    std::vector<std::string> lines = card_lines();
+    HOST_CHECK(lines.size() > 0 && logged.size() - lines.size() > first_line);
+    HOST_CHECK(std::equal(lines.begin(), lines.end(), logged.end() - lines.size()));
+    HOST_CHECK(lines.front() == logged[logged.size() - lines.size()]);
+    HOST_CHECK(card_lines(0, segments.front().second.first_ms - 1).empty());
+}
+
+static void test_range_query()
+{
+    // ranges that cross from one closed segment into the next.
+    auto segments = card_segments();
+    for (size_t n = 0; n + 2 < segments.size(); n++) {
+        const ad2_log_seg_hdr &a = segments[n].second, &b = segments[n + 1].second;
+        HOST_CHECK(a.last_ms && a.first_ms <= a.last_ms && a.last_ms < b.first_ms);
+        int64_t from = a.last_ms - 20, to = b.first_ms + 20;
+        std::vector<std::string> lines = card_lines(from, to);
+        HOST_CHECK(lines == logged_lines(from, to) && lines.size() > 40);
+
+        // the same range in wall clock time.
+        HOST_CHECK(a.wall_last_ms == WALL_BASE_MS + (int64_t)a.last_ms);
+        std::vector<std::string> wall;
+        ad2_sd_log_query(WALL_BASE_MS + from, WALL_BASE_MS + to, true, collect, &wall);
+        HOST_CHECK(wall.size() == lines.size());
+        for (size_t l = 0; l < wall.size(); l++) {
+            // "YYYY-MM-DD HH:MM:SS [<uptime> ms] text"
+            HOST_CHECK(wall[l].size() > 20 && wall[l][4] == '-' && wall[l][19] == ' ');
+            HOST_CHECK(wall[l].compare(wall[l].size() - lines[l].size(), lines[l].size(), lines[l]) == 0);
+        }
+    }
+    // a range inside one segment and a callback that stops early.
+    const ad2_log_seg_hdr &mid = segments[segments.size() / 2].second;
+    HOST_CHECK(card_lines(mid.first_ms + 10, mid.first_ms + 19) == logged_lines(mid.first_ms + 10, mid.first_ms + 19));
+    int calls = 0;
+    ad2_sd_log_query(0, INT64_MAX, false, [](const char *line, size_t len, void *arg) {
+        return ++*(int *)arg < 5;
+    }, &calls);
+    HOST_CHECK(calls == 5);
+    // segments from another boot only match wall clock queries.
+    uint32_t boot_seq = _ad2_sd_seg.boot_seq;
+    _ad2_sd_seg.boot_seq = boot_seq + 1000;
+    HOST_CHECK(card_lines().empty());
+    _ad2_sd_seg.boot_seq = boot_seq;
+}
+
+static void test_damaged_segments()
+{
+    // a bad block ends its segment. The other segments still read.
+    std::vector<std::string> before = card_lines();
+    auto segments = card_segments();
+    HOST_CHECK(segments.size() > 3);
+    FILE *file = fopen(_ad2_sd_log_segment_path(segments[1].first).c_str(), "r+b");
+    HOST_CHECK(file);
+    ad2_log_blk_hdr blk;
+    fseek(file, sizeof(ad2_log_seg_hdr), SEEK_SET);
+    HOST_CHECK(fread(&blk, 1, sizeof(blk), file) == sizeof(blk) && blk.magic == AD2_LOG_BLK_MAGIC);
+    // damage the middle of the first block.
+    long at = sizeof(ad2_log_seg_hdr) + sizeof(blk) + blk.comp_len / 2;
+    fseek(file, at, SEEK_SET);
+    uint8_t junk[16];
+    memset(junk, 0xff, sizeof(junk));
+    fwrite(junk, 1, sizeof(junk), file);
+    fclose(file);
+
+    // a segment cut off part way through a block, as after power loss.
+    std::string cut = _ad2_sd_log_segment_path(segments[2].first);
+    struct stat info;
+    HOST_CHECK(stat(cut.c_str(), &info) == 0);
+    HOST_CHECK(truncate(cut.c_str(), info.st_size - 100) == 0);
+
+    std::vector<std::string> after = card_lines();
+    HOST_CHECK(after.size() < before.size() && after.front() == before.front() && after.back() == before.back());
+    // what is left is in order and nothing else.
+    size_t pos = 0;
+    for (auto &line : after) {
+        while (pos < before.size() && before[pos] != line) {
+            pos++;
+        }
+        HOST_CHECK(pos < before.size());
+    }
+    // segments after the damaged ones are whole.
+    const ad2_log_seg_hdr &next = segments[3].second;
+    HOST_CHECK(card_lines(next.first_ms, next.last_ms) == logged_lines(next.first_ms, next.last_ms));
+}
+
+int main()
+{
+    g_uSD_mounted = true;
+    clear_card();
+    host_notify_hook = wake_hook;
+    HOST_CHECK(ad2_set_sd_logging_enabled(true));
+    HOST_CHECK(host_task("AD2 SD log"));
+
+    test_time_flush();
+    test_size_flush();
+    test_error_flush();
+    test_overrun();
+    test_unmounted();
+
+    // everything kept reached the card once and in order.
+    HOST_CHECK(card_lines() == logged);
+
+    test_codec_round_trip();
+    test_codec_corrupt();
+    test_retention();
+    test_range_query();
+    test_damaged_segments();
+
+    ad2_sd_log_stats_t s = stats();
+    printf("%u writes, %u lines, %u bytes per write, %u of %u bytes stored\n",
+           (unsigned)s.writes, (unsigned)s.lines, (unsigned)(s.bytes / s.writes),
+           (unsigned)s.bytes, (unsigned)s.raw_bytes);
+    puts("uSD log OK");
+    return 0;
+}
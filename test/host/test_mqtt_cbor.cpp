@@ -0,0 +1,191 @@
+/**
+ *  @file    test_mqtt_cbor.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief CBOR copies of the MQTT state and event topics.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+#define READY     "00000001000000000A--"
+#define NOT_READY "00000000000000000A--"
+
+/**
+ * @brief Decode one CBOR item and write it again as JSON. Covers what
+ * AD2JsonWriter writes: unsigned and negative integers, text, booleans
+ * and indefinite length maps and arrays.
+ *
+ * @param [in]w AD2JsonWriter & JSON output.
+ * @param [in]key const char * member name or nullptr.
+ * @param [in]b const std::string & CBOR.
+ * @param [in]i size_t & read position.
+ */
+static void cbor_to_json(AD2JsonWriter &w, const char *key, const std::string &b, size_t &i)
+{
+    HOST_CHECK(i < b.length());
+    uint8_t ib = b[i++];
+    uint8_t major = ib >> 5, ai = ib & 31;
+    if (ai == 31) {
+        HOST_CHECK(major == 4 || major == 5);
+        major == 4 ? w.array(key) : w.object(key);
+        while (i < b.length() && (uint8_t)b[i] != 0xff) {
+            std::string name;
+            if (major == 5) {
+                HOST_CHECK(((uint8_t)b[i] >> 5) == 3);
+                size_t start = i;
+                AD2JsonBuffer<256> tmp;
+                const char *text = tmp.render([&](AD2JsonWriter &kw) {
+                    cbor_to_json(kw, nullptr, b, i);
+                });
+                // the key was written as a JSON string. Strip its quotes.
+                name = std::string(text + 1, tmp.length() - 2);
+                HOST_CHECK(i > start);
+            }
+            cbor_to_json(w, major == 5 ? name.c_str() : nullptr, b, i);
+        }
+        HOST_CHECK(i < b.length());
+        i++;
+        w.end();
+        return;
+    }
+    if (major == 7) {
+        HOST_CHECK(ai == 20 || ai == 21);
+        w.add(key, ai == 21);
+        return;
+    }
+    uint64_t arg = ai;
+    if (ai >= 24) {
+        HOST_CHECK(ai <= 27);
+        int n = 1 << (ai - 24);
+        HOST_CHECK(i + n <= b.length());
+        arg = 0;
+        for (int k = 0; k < n; k++) {
+            arg = (arg << 8) | (uint8_t)b[i++];
+        }
+    }
+    switch (major) {
+    case 0:
+        w.add_uint(key, arg);
+        break;
+    case 1:
+        w.add_int(key, -1 - (int64_t)arg);
+        break;
+    case 3:
+        HOST_CHECK(i + arg <= b.length());
+        w.add(key, b.data() + i, (size_t)arg);
+        i += arg;
+        break;
+    default:
+        HOST_CHECK(!"unexpected CBOR major type");
+    }
+}
+
+static std::string cbor_as_json(const std::string &b)
+{
+    size_t i = 0;
+    AD2JsonBuffer<2048> json;
+    std::string out = json.render([&](AD2JsonWriter &w) {
+        cbor_to_json(w, nullptr, b, i);
+    });
+    HOST_CHECK(i == b.length());
+    return out;
+}
+
+static void test_copies()
+{
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    host_mqtt_ack_all();
+    size_t from = host_mqtt_publishes.size();
+    host_feed(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+    host_feed(host_keypad(NOT_READY, "002", "FAULT 02"));
+    host_feed(host_keypad(NOT_READY, "005", "FAULT 05"));
+    host_feed("!LRR:008,1,CID_1406,ff");
+    host_feed(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+    host_mqtt_ack_all();
+
+    // every CBOR copy decodes to its JSON copy, in publish order.
+    std::map<std::string, std::vector<std::string>> json, cbor;
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        const host_mqtt_publish &p = host_mqtt_publishes[i];
+        size_t at = p.topic.find("/" MQTT_CBOR_TOPIC "/");
+        if (at == std::string::npos) {
+            json[p.topic].push_back(p.data);
+        } else {
+            cbor[p.topic.substr(0, at) + p.topic.substr(at + strlen(MQTT_CBOR_TOPIC) + 1)].push_back(p.data);
+        }
+    }
+    size_t copies = 0;
+    bool partition = false, zone = false, cid = false;
+    for (auto &c : cbor) {
+        std::vector<std::string> &src = json[c.first];
+        HOST_CHECK(src.size() == c.second.size());
+        for (size_t k = 0; k < src.size(); k++) {
+            HOST_CHECK(c.second[k].length() < src[k].length());
+            HOST_CHECK(cbor_as_json(c.second[k]) == src[k]);
+            copies++;
+        }
+        partition |= c.first.find("/partitions/") != std::string::npos;
+        zone |= c.first.find("/zones/") != std::string::npos;
+        cid |= c.first.find("/cid") != std::string::npos;
+    }
+    HOST_CHECK(partition && zone && cid);
+    HOST_CHECK(host_mqtt_stats().cbor_sent == copies);
+}
+
+static void test_info()
+{
+    // the info document names the CBOR root and families.
+    std::string info;
+    for (auto &p : host_mqtt_publishes) {
+        if (p.topic.length() > 5 && p.topic.compare(p.topic.length() - 5, 5, "/info") == 0) {
+            info = p.data;
+        }
+    }
+    HOST_CHECK(info.find("\"cbor\":{\"topic\":\"") != std::string::npos);
+    HOST_CHECK(info.find("\"families\":[\"partitions\",\"zones\",\"cid\"]") != std::string::npos);
+}
+
+static void test_off()
+{
+    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_CBOR_SUBCMD, "");
+    _mqtt_load_cbor_settings();
+    _mqtt_build_topics();
+    size_t from = host_mqtt_publishes.size();
+    host_feed(host_keypad(NOT_READY, "002", "FAULT 02"));
+    host_feed("!LRR:009,1,CID_1406,ff");
+    HOST_CHECK(host_mqtt_publishes.size() > from);
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        HOST_CHECK(host_mqtt_publishes[i].topic.find("/" MQTT_CBOR_TOPIC "/") == std::string::npos);
+    }
+}
+
+int main()
+{
+    host_mqtt_setup({ { MQTT_CBOR_SUBCMD, "partitions zones cid" } });
+
+    test_copies();
+    test_info();
+    test_off();
+    puts("mqtt cbor OK");
+    return 0;
+}
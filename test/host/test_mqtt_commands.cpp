@@ -0,0 +1,230 @@
+/**
+ *  @file    test_mqtt_commands.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Commands topic parsing, rate limit and routing to the AD2.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+static std::string topic;
+
+static const char *disarm = "{\"partition\":1,\"action\":\"DISARM\",\"code\":\"1234\"}";
+static const char *fire = "{\"partition\":1,\"action\":\"FIRE_ALARM\"}";
+static const char *raw = "{\"action\":\"SEND_RAW\",\"arg\":\"K1812341\"}";
+
+static bool read_command(const char *json, int32_t *part, char *code, char *arg)
+{
+    char action[16];
+    ad2_json_member_t m[] = {
+        { "partition", AD2_JSON_MEMBER_INT, nullptr, 0, part, false },
+        { "code", AD2_JSON_MEMBER_STRING, code, 16, nullptr, false },
+        { "action", AD2_JSON_MEMBER_STRING, action, sizeof(action), nullptr, false },
+        { "arg", AD2_JSON_MEMBER_STRING, arg, 16, nullptr, false },
+    };
+    return ad2_json_read_members(json, strlen(json), m, ARRAY_SIZE(m));
+}
+
+static void test_reader()
+{
+    int32_t p = 1;
+    char c[16] = "", a[16] = "";
+    HOST_CHECK(read_command("{\"partition\":2,\"code\":\"1234\",\"action\":\"X\"}", &p, c, a));
+    HOST_CHECK(p == 2 && !strcmp(c, "1234"));
+    p = 1;
+    HOST_CHECK(read_command(" { \"x\" : [1,{\"y\":[true,false,null,-1.5e3]}], \"partition\" : 3.9 , "
+                            "\"arg\":\"a\\\"\\u00e9\\ud83d\\ude00\\n\" } ", &p, c, a));
+    HOST_CHECK(p == 3 && !strcmp(a, "a\"\xc3\xa9\xf0\x9f\x98\x80\n"));
+    // a member of the wrong type is skipped.
+    p = 7;
+    HOST_CHECK(read_command("{\"partition\":\"2\"}", &p, c, a) && p == 7);
+    // the first of a repeated member wins.
+    HOST_CHECK(read_command("{\"code\":\"1\",\"code\":\"2\"}", &p, c, a) && !strcmp(c, "1"));
+    HOST_CHECK(read_command("{}", &p, c, a));
+    HOST_CHECK(read_command("{\"a\":[[[[[[[1]]]]]]]}", &p, c, a));
+
+    const char *bad[] = {
+        "", "[]", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "{\"a\":01}", "{\"a\":tru}",
+        "{\"a\":1} x", "{\"a\":\"\\x\"}", "{\"a\":\"\\u0000\"}", "{\"a\":\"\\ud800\"}",
+        "{\"code\":\"0123456789abcdef\"}", "{\"a\":\"\x01\"}",
+        "{\"a\":[[[[[[[[[1]]]]]]]]]}"
+    };
+    for (const char *b : bad) {
+        if (read_command(b, &p, c, a)) {
+            fprintf(stderr, "accepted '%s'\n", b);
+            HOST_CHECK(false);
+        }
+    }
+}
+
+static void test_routing()
+{
+    host_advance_ms(100000);
+    const char *ok[] = {
+        disarm,
+        "{\"partition\":1,\"action\":\"ARM_AWAY\",\"code\":\"1234\"}",
+        "{\"action\":\"BYPASS\",\"code\":\"1234\",\"arg\":\"03\"}",
+        raw,
+    };
+    mqtt_stats_t s0 = host_mqtt_stats();
+    host_uart.clear();
+    for (const char *c : ok) {
+        host_advance_ms(1000);
+        host_mqtt_data(topic, c);
+    }
+    mqtt_stats_t s1 = host_mqtt_stats();
+    HOST_CHECK(s1.commands_queued - s0.commands_queued == ARRAY_SIZE(ok));
+    HOST_CHECK(host_uart.size() == ARRAY_SIZE(ok));
+    HOST_CHECK(host_uart[0] == "K1812341" && host_uart[1] == "K1812342");
+    HOST_CHECK(host_uart[2] == "K181234603*");
+    HOST_CHECK(host_uart[3] == "K1812341");
+
+    // a partition without state is accepted but not sent.
+    s0 = s1;
+    host_mqtt_data(topic, "{\"partition\":2,\"action\":\"FIRE_ALARM\"}");
+    s1 = host_mqtt_stats();
+    HOST_CHECK(s1.commands_dropped - s0.commands_dropped == 1 && host_uart.size() == ARRAY_SIZE(ok));
+}
+
+static void test_rejects()
+{
+    mqtt_stats_t s0 = host_mqtt_stats();
+    host_uart.clear();
+    host_advance_ms(10000);
+    host_mqtt_data(topic, disarm, true);
+    host_mqtt_data(topic, "");
+    host_mqtt_data(topic, std::string(300, ' '));
+    host_mqtt_data(topic, "{\"action\":\"DISARM\",\"code\":");
+    host_mqtt_data(topic, "{\"action\":\"REBOOT\"}");
+    host_mqtt_data(topic, "{\"partition\":1}");
+    host_mqtt_data(topic, "{\"action\":\"DISARM\",\"code\":\"12345678901234567890\"}");
+    mqtt_stats_t s1 = host_mqtt_stats();
+    HOST_CHECK(host_uart.empty());
+    HOST_CHECK(s1.commands - s0.commands == 7 && s1.commands_queued == s0.commands_queued);
+    HOST_CHECK(s1.commands_retained - s0.commands_retained == 1);
+    HOST_CHECK(s1.commands_bad_size - s0.commands_bad_size == 2);
+    HOST_CHECK(s1.commands_bad_json - s0.commands_bad_json == 2);
+    HOST_CHECK(s1.commands_bad_action - s0.commands_bad_action == 2);
+}
+
+static void test_flood()
+{
+    // 1000 commands in 1 s. FIRE_ALARM is every 5th and never limited.
+    // The rest get the burst plus 900 ms of refill.
+    const char *mix[] = { disarm, raw, fire, disarm, raw };
+    host_advance_ms(10000);
+    host_uart.clear();
+    mqtt_stats_t s0 = host_mqtt_stats();
+    for (int n = 0; n < 1000; n++) {
+        if (n % 100 == 0) {
+            host_advance_ms(100);
+        }
+        host_mqtt_data(topic, mix[n % 5]);
+    }
+    mqtt_stats_t s1 = host_mqtt_stats();
+    int burst = MQTT_COMMAND_BURST + 900 / MQTT_COMMAND_RATE_MS;
+    HOST_CHECK(s1.commands_queued - s0.commands_queued == 200 + burst);
+    HOST_CHECK(s1.commands_rate_limited - s0.commands_rate_limited == 800 - burst);
+    HOST_CHECK(host_uart.size() == (size_t)(200 + burst));
+
+    // panic and aux go through while the bucket is empty.
+    s0 = s1;
+    host_mqtt_data(topic, disarm);
+    host_mqtt_data(topic, "{\"partition\":1,\"action\":\"PANIC_ALARM\"}");
+    host_mqtt_data(topic, "{\"partition\":1,\"action\":\"AUX_ALARM\"}");
+    s1 = host_mqtt_stats();
+    HOST_CHECK(s1.commands_rate_limited - s0.commands_rate_limited == 1);
+    HOST_CHECK(s1.commands_queued - s0.commands_queued == 2);
+
+    // a steady rate at the limit is never refused.
+    host_advance_ms(10000);
+    s0 = host_mqtt_stats();
+    for (int n = 0; n < 100; n++) {
+        host_advance_ms(MQTT_COMMAND_RATE_MS);
+        host_mqtt_data(topic, disarm);
+    }
+    s1 = host_mqtt_stats();
+    HOST_CHECK(s1.commands_queued - s0.commands_queued == 100);
+}
+
+static void test_reject_allocs()
+{
+    std::string unknown = "{\"action\":\"REBOOT\",\"code\":\"1234\"}";
+    size_t allocs = host_heap_allocs;
+    for (int n = 0; n < 100; n++) {
+        host_mqtt_data(topic, unknown);
+    }
+    HOST_CHECK(host_heap_allocs == allocs);
+}
+
+static void test_queue_full()
+{
+    // the AD2 writer task is not running. Fill the MQTT queue.
+    ad2_init_cmd_sendQ();
+    HOST_CHECK(host_task("AD2 cmdQ"));
+    for (int n = 0; n < AD2_CMD_SENDQ_DEPTH; n++) {
+        std::string cmd = "K1812341";
+        HOST_CHECK(ad2_send(cmd, AD2_SEND_SRC_MQTT));
+    }
+
+    // counted as dropped, not queued. Alarms too.
+    host_advance_ms(10000);
+    mqtt_stats_t s0 = host_mqtt_stats();
+    host_mqtt_data(topic, fire);
+    host_mqtt_data(topic, raw);
+    mqtt_stats_t s1 = host_mqtt_stats();
+    HOST_CHECK(s1.commands - s0.commands == 2);
+    HOST_CHECK(s1.commands_dropped - s0.commands_dropped == 2 && s1.commands_queued == s0.commands_queued);
+
+    // the writer catches up and commands are taken again.
+    host_uart.clear();
+    host_run_task(host_task("AD2 cmdQ"), 1);
+    HOST_CHECK(host_uart.size() == AD2_CMD_SENDQ_DEPTH);
+    host_mqtt_data(topic, raw);
+    HOST_CHECK(host_mqtt_stats().commands_queued == s1.commands_queued + 1);
+}
+
+int main()
+{
+    test_reader();
+
+    // the AD2 is on a UART.
+    g_ad2_client_handle = 1;
+    g_ad2_mode = 'C';
+    host_mqtt_setup({ { MQTT_CMDEN_SUBCMD, "true" } }, true);
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    host_mqtt_ack_all();
+    host_task_inline = false;
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    topic = t->get(t->commands);
+    HOST_CHECK(std::find(host_mqtt_subscriptions.begin(), host_mqtt_subscriptions.end(), topic) !=
+               host_mqtt_subscriptions.end());
+
+    test_routing();
+    test_rejects();
+    test_flood();
+    test_reject_allocs();
+    test_queue_full();
+    puts("mqtt commands OK");
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ *  @file    test_mqtt_compact.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Compact Home Assistant discovery configs.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+typedef std::map<std::string, std::string> configs_t;
+
+/**
+ * @brief Acknowledge everything and collect the discovery configs sent
+ * since from by topic.
+ */
+static configs_t configs_since(size_t from)
+{
+    host_mqtt_ack_all();
+    configs_t out;
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        const host_mqtt_publish &p = host_mqtt_publishes[i];
+        if (p.topic.find("/config") != std::string::npos) {
+            out[p.topic] = p.data;
+        }
+    }
+    return out;
+}
+
+static size_t payload_bytes(const configs_t &configs)
+{
+    size_t n = 0;
+    for (auto &c : configs) {
+        n += c.second.length();
+    }
+    return n;
+}
+
+static void replace_all(std::string &s, const std::string &from, const std::string &to)
+{
+    for (size_t pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + to.length())) {
+        s.replace(pos, from.length(), to);
+    }
+}
+
+/**
+ * @brief Expand a compact config the way Home Assistant does.
+ */
+static std::string expand(std::string json)
+{
+    static const std::string base_key = "{\"~\":\"";
+    if (json.compare(0, base_key.length(), base_key) == 0) {
+        size_t end = json.find('"', base_key.length());
+        std::string base = json.substr(base_key.length(), end - base_key.length());
+        json.erase(1, end + 2 - 1);
+        replace_all(json, "\"~/", "\"" + base + "/");
+    }
+    for (auto &k : mqtt_discovery_keys) {
+        replace_all(json, std::string("\"") + k.abbr + "\":", std::string("\"") + k.key + "\":");
+    }
+    return json;
+}
+
+static void command(const char *cmd)
+{
+    _cli_cmd_mqtt_command_router(cmd);
+}
+
+int main()
+{
+    for (int zn = 1; zn <= 128; zn++) {
+        AD2Parse.setZoneType(zn, "door");
+        AD2Parse.setZoneString(zn, ad2_string_printf("ZONE %03d FRONT DOOR SENSOR", zn).c_str());
+    }
+    host_mqtt_setup({ { MQTT_TPREFIX_SUBCMD, "homeassistant" }, { MQTT_DPREFIX_SUBCMD, "homeassistant" } }, true);
+
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    configs_t full = configs_since(0);
+    HOST_CHECK(full.size() > 128);
+
+    // every config changes form and is sent again.
+    size_t from = host_mqtt_publishes.size();
+    command(MQTT_COMMAND " " MQTT_COMPACT_SUBCMD " Y");
+    configs_t compact = configs_since(from);
+    HOST_CHECK(compact.size() == full.size());
+    for (auto &c : compact) {
+        HOST_CHECK(full.count(c.first));
+        HOST_CHECK(c.second.find("\"state_topic\"") == std::string::npos);
+        HOST_CHECK(c.second.length() < full[c.first].length());
+        HOST_CHECK(expand(c.second) == full[c.first]);
+    }
+    printf("discovery payloads %zu B, compact %zu B\n", payload_bytes(full), payload_bytes(compact));
+    HOST_CHECK(payload_bytes(compact) * 100 < payload_bytes(full) * 85);
+
+    // and back.
+    from = host_mqtt_publishes.size();
+    command(MQTT_COMMAND " " MQTT_COMPACT_SUBCMD " N");
+    HOST_CHECK(configs_since(from) == full);
+    puts("mqtt compact discovery OK");
+    return 0;
+}
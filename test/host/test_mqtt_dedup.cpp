@@ -0,0 +1,230 @@
+/**
+ *  @file    test_mqtt_dedup.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Unchanged retained MQTT state publishes are suppressed.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+#define READY "00000001000000000A--"
+#define NOT_READY "00000000000000000A--"
+#define NOT_READY_BEEP "00000000000000010A--"
+#define READY_LOW_BATTERY "00000001000010000A--"
+
+static void set(const char *key, const char *value)
+{
+    ad2_set_config_key_string(MQTT_CONFIG_SECTION, key, value, -1, nullptr, value == nullptr);
+}
+
+/**
+ * @brief Ready, a fault cycling zones 02 and 05 with a chime beep then
+ * ready again.
+ */
+static void fault_cycle(int rounds)
+{
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < 4; i++) {
+            host_feed(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+        }
+        for (int i = 0; i < 6; i++) {
+            host_feed(host_keypad(i == 0 ? NOT_READY_BEEP : NOT_READY, "002", "FAULT 02"));
+            host_feed(host_keypad(NOT_READY, "005", "FAULT 05"));
+        }
+        for (int i = 0; i < 4; i++) {
+            host_feed(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+        }
+    }
+}
+
+/**
+ * @brief Low battery trouble with the display cycling ready and LO BAT.
+ */
+static void low_battery_cycle(int rounds)
+{
+    for (int r = 0; r < rounds; r++) {
+        host_feed(host_keypad(READY_LOW_BATTERY, "008", "DISARMED CHIME   Ready to Arm"));
+        host_feed(host_keypad(READY_LOW_BATTERY, "000", "SYSTEM LO BAT"));
+    }
+}
+
+struct counts {
+    int partition;
+    int alpha;
+};
+
+static counts count(size_t from)
+{
+    counts c = {};
+    for (size_t n = from; n < host_mqtt_publishes.size(); n++) {
+        const std::string &topic = host_mqtt_publishes[n].topic;
+        if (topic.find("/alpha") != std::string::npos) {
+            c.alpha++;
+        } else if (topic.find("/partitions/") != std::string::npos) {
+            c.partition++;
+        }
+    }
+    return c;
+}
+
+/**
+ * @brief Publishes for 50 fault cycles with the given settings.
+ */
+static counts run(const char *dedup, const char *alpha, const char *ignore, uint32_t *suppressed)
+{
+    set(MQTT_DEDUP_SUBCMD, dedup);
+    set(MQTT_ALPHA_SUBCMD, alpha);
+    set(MQTT_IGNORE_SUBCMD, ignore);
+    _mqtt_load_dedup_settings();
+    // the first cycle publishes everything once.
+    fault_cycle(1);
+    uint32_t before = host_mqtt_stats().suppressed;
+    size_t from = host_mqtt_publishes.size();
+    fault_cycle(50);
+    *suppressed = host_mqtt_stats().suppressed - before;
+    host_mqtt_ack_all();
+    return count(from);
+}
+
+static uint32_t members_hash(const char *json, std::vector<std::string> *skip)
+{
+    return ad2_json_hash_members(json, strlen(json), skip);
+}
+
+static void test_hash()
+{
+    const char *a = "{\"ready\":true,\"last_alpha_message\":\"DISARMED, \\\"x\\\" }\",\"mask\":1,\"event\":\"READY\"}";
+    const char *b = "{\"ready\":true,\"last_alpha_message\":\"FAULT 02\",\"mask\":1,\"event\":\"READY\"}";
+    const char *c = "{\"ready\":false,\"last_alpha_message\":\"FAULT 02\",\"mask\":1,\"event\":\"READY\"}";
+    const char *d = "{\"ready\":true,\"last_alpha_message\":\"FAULT 02\",\"mask\":1,\"event\":\"CHIME\"}";
+    const char *z1 = "{\"zone\":1,\"zone_alerts\":[{\"zone\":2,\"name\":\"a,b\"}]}";
+    const char *z2 = "{\"zone\":1,\"zone_alerts\":[{\"zone\":3,\"name\":\"a,b\"}]}";
+    std::vector<std::string> alpha = { "last_alpha_message" };
+    std::vector<std::string> both = { "last_alpha_message", "event" };
+    std::vector<std::string> zone = { "zone" };
+    HOST_CHECK(members_hash(a, nullptr) != members_hash(b, nullptr));
+    HOST_CHECK(members_hash(a, &alpha) == members_hash(b, &alpha));
+    HOST_CHECK(members_hash(b, &alpha) != members_hash(c, &alpha));
+    HOST_CHECK(members_hash(b, &alpha) != members_hash(d, &alpha));
+    HOST_CHECK(members_hash(b, &both) == members_hash(d, &both));
+    // only top level keys are skipped.
+    HOST_CHECK(members_hash(z1, &zone) != members_hash(z2, &zone));
+    HOST_CHECK(members_hash("{}", &zone) == 0);
+}
+
+static void test_suppress()
+{
+    uint32_t suppressed;
+    counts off = run("false", nullptr, nullptr, &suppressed);
+    HOST_CHECK(off.partition > 0 && off.alpha == 0 && suppressed == 0);
+
+    // every ready change has a new event so nothing is the same.
+    counts on = run(nullptr, nullptr, nullptr, &suppressed);
+    HOST_CHECK(on.partition == off.partition && suppressed == 0);
+
+    // without the event the fault round trips repeat the same state.
+    counts ignore = run(nullptr, nullptr, "event", &suppressed);
+    HOST_CHECK(ignore.partition < off.partition);
+    HOST_CHECK((int)suppressed == off.partition - ignore.partition);
+
+    // the keypad text moves to its own topic and out of the partition
+    // state.
+    counts alpha = run(nullptr, "true", "event", &suppressed);
+    HOST_CHECK(alpha.partition == ignore.partition && alpha.alpha > 0);
+
+    // low battery display cycling is one partition publish.
+    size_t from = host_mqtt_publishes.size();
+    low_battery_cycle(100);
+    counts lobat = count(from);
+    HOST_CHECK(lobat.partition == 1);
+    // every text change but the first, which repeats the last text.
+    HOST_CHECK(lobat.alpha == 199);
+
+    // without the alpha topic the text alone is not a state change.
+    set(MQTT_ALPHA_SUBCMD, nullptr);
+    _mqtt_load_dedup_settings();
+    from = host_mqtt_publishes.size();
+    low_battery_cycle(100);
+    HOST_CHECK(count(from).partition == 0 && count(from).alpha == 0);
+    host_mqtt_ack_all();
+}
+
+static void test_reconnect()
+{
+    AD2PartitionState *s = ad2_get_partition_state(1);
+    HOST_CHECK(s);
+    mqtt_on_state_change(nullptr, s, (void *)ON_READY_CHANGE);
+    size_t from = host_mqtt_publishes.size();
+    uint32_t suppressed = host_mqtt_stats().suppressed;
+    mqtt_on_state_change(nullptr, s, (void *)ON_READY_CHANGE);
+    HOST_CHECK(count(from).partition == 0 && host_mqtt_stats().suppressed == suppressed + 1);
+
+    // a new session sends the same state once again.
+    host_mqtt_event(MQTT_EVENT_DISCONNECTED);
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    host_mqtt_ack_all();
+    HOST_CHECK(host_mqtt_stats().topics == 0);
+    from = host_mqtt_publishes.size();
+    mqtt_on_state_change(nullptr, s, (void *)ON_READY_CHANGE);
+    mqtt_on_state_change(nullptr, s, (void *)ON_READY_CHANGE);
+    HOST_CHECK(count(from).partition == 1);
+    host_mqtt_ack_all();
+}
+
+static void test_restart()
+{
+    // a config reload destroys the client. Nothing is published on it
+    // once it is taken away.
+    AD2PartitionState *s = ad2_get_partition_state(1);
+    HOST_CHECK(s);
+    mqtt_free();
+    HOST_CHECK(mqtt_client == nullptr && mqtt_client_users == 0);
+    size_t from = host_mqtt_publishes.size();
+    HOST_CHECK(_mqtt_enqueue("t", "x", 1, 1, 0) == -1);
+    mqtt_on_state_change(nullptr, s, (void *)ON_READY_CHANGE);
+    HOST_CHECK(host_mqtt_publishes.size() == from);
+
+    // the new client takes over.
+    _mqtt_client_restart();
+    HOST_CHECK(mqtt_client != nullptr);
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    host_mqtt_ack_all();
+    from = host_mqtt_publishes.size();
+    mqtt_on_state_change(nullptr, s, (void *)ON_READY_CHANGE);
+    HOST_CHECK(count(from).partition == 1);
+    host_mqtt_ack_all();
+}
+
+int main()
+{
+    host_mqtt_setup();
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    host_mqtt_ack_all();
+
+    test_hash();
+    test_suppress();
+    test_reconnect();
+    test_restart();
+    puts("mqtt dedup OK");
+    return 0;
+}
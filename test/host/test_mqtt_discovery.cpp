@@ -0,0 +1,162 @@
+/**
+ *  @file    test_mqtt_discovery.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Paced Home Assistant discovery that skips configs the broker has.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+#define ZONES 128
+
+static bool is_config(const host_mqtt_publish &p)
+{
+    return p.topic.find("/config") != std::string::npos;
+}
+
+static int configs_since(size_t from)
+{
+    int n = 0;
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        n += is_config(host_mqtt_publishes[i]);
+    }
+    return n;
+}
+
+/**
+ * @brief Acknowledge publishes oldest first as a broker would. Checks the
+ * discovery window on every step.
+ *
+ * @param [in]limit int acknowledgements before stopping.
+ */
+static void drain(int limit = -1)
+{
+    while (!host_mqtt_outbox.empty() && limit--) {
+        int inflight = 0;
+        for (auto &p : host_mqtt_outbox) {
+            inflight += is_config(p.second);
+        }
+        HOST_CHECK(inflight <= MQTT_DISCOVERY_WINDOW);
+        host_advance_ms(10);
+        host_mqtt_ack(host_mqtt_outbox.begin()->first);
+    }
+}
+
+static void name_zones(const char *where)
+{
+    for (int zn = 1; zn <= ZONES; zn++) {
+        AD2Parse.setZoneString(zn, ad2_string_printf("ZONE %03d %s DOOR SENSOR", zn, where).c_str());
+    }
+}
+
+static void test_connect()
+{
+    size_t from = host_mqtt_publishes.size();
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    // only the first window goes out before any PUBACK.
+    HOST_CHECK(configs_since(from) == MQTT_DISCOVERY_WINDOW);
+    HOST_CHECK(host_mqtt_stats().discovery_walking);
+    drain();
+    mqtt_stats_t st = host_mqtt_stats();
+    HOST_CHECK(!st.discovery_walking && st.discovery_inflight == 0);
+    HOST_CHECK(configs_since(from) > ZONES && (uint32_t)configs_since(from) == st.discovery_sent);
+
+    // the broker has every config. A reconnect sends none of them.
+    from = host_mqtt_publishes.size();
+    host_mqtt_event(MQTT_EVENT_DISCONNECTED);
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    drain();
+    HOST_CHECK(configs_since(from) == 0 && host_mqtt_stats().discovery_unchanged == st.discovery_sent);
+}
+
+static void test_birth()
+{
+    // Home Assistant restarted and may have lost them.
+    size_t from = host_mqtt_publishes.size();
+    uint32_t sent = host_mqtt_stats().discovery_sent;
+    host_mqtt_data("homeassistant/status", "offline");
+    HOST_CHECK(configs_since(from) == 0);
+    host_mqtt_data("homeassistant/status", "online");
+    drain();
+    HOST_CHECK((uint32_t)configs_since(from) == sent);
+}
+
+static void test_changed()
+{
+    // renamed zones while the connection flaps. Only the changed configs
+    // are sent and each one only once.
+    name_zones("BACK");
+    size_t from = host_mqtt_publishes.size();
+    for (int i = 0; i < 2; i++) {
+        host_mqtt_event(MQTT_EVENT_CONNECTED);
+        drain(20);
+        host_mqtt_event(MQTT_EVENT_DISCONNECTED);
+    }
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    drain();
+    int changed = 0;
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        const host_mqtt_publish &p = host_mqtt_publishes[i];
+        changed += is_config(p) && p.data.find("BACK DOOR") != std::string::npos;
+    }
+    HOST_CHECK(changed == ZONES && configs_since(from) == ZONES);
+    HOST_CHECK(!host_mqtt_stats().discovery_walking);
+}
+
+static void test_lost_puback()
+{
+    for (int zn = 1; zn <= 4; zn++) {
+        AD2Parse.setZoneString(zn, ad2_string_printf("ZONE %03d X", zn).c_str());
+    }
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    // the broker never acknowledges the newest one.
+    host_mqtt_outbox.erase(host_mqtt_outbox.rbegin()->first);
+    drain();
+    mqtt_stats_t st = host_mqtt_stats();
+    HOST_CHECK(st.discovery_walking && st.discovery_inflight == 1);
+
+    // it is given up on and sent again after the timeout.
+    host_advance_ms(MQTT_DISCOVERY_ACK_TIMEOUT_MS);
+    size_t from = host_mqtt_publishes.size();
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    drain();
+    st = host_mqtt_stats();
+    HOST_CHECK(!st.discovery_walking && st.discovery_inflight == 0);
+    HOST_CHECK(configs_since(from) == 1);
+}
+
+int main()
+{
+    for (int zn = 1; zn <= ZONES; zn++) {
+        AD2Parse.setZoneType(zn, "door");
+    }
+    name_zones("FRONT");
+    host_mqtt_setup({ { MQTT_DPREFIX_SUBCMD, "homeassistant" } }, true);
+
+    test_connect();
+    test_birth();
+    test_changed();
+    test_lost_puback();
+    puts("mqtt discovery OK");
+    return 0;
+}
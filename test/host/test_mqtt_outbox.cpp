@@ -0,0 +1,189 @@
+/**
+ *  @file    test_mqtt_outbox.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief uSD outbox replay across broker outages and restarts.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+#define READY     "00000001000000000A--"
+#define NOT_READY "00000000000000000A--"
+
+static int lrr_n = 0;
+
+/**
+ * @brief Fault and restore two zones. Every 10th round also reports a
+ * contact id event that must never be collapsed.
+ *
+ * @param [in]rounds int.
+ */
+static void cycle(int rounds)
+{
+    for (int r = 0; r < rounds; r++) {
+        host_feed(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+        for (int i = 0; i < 3; i++) {
+            host_feed(host_keypad(NOT_READY, "002", "FAULT 02"));
+            host_feed(host_keypad(NOT_READY, "005", "FAULT 05"));
+        }
+        host_feed(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+        if (r % 10 == 0) {
+            host_feed(ad2_string_printf("!LRR:%03d,1,CID_1406,ff", ++lrr_n));
+        }
+    }
+}
+
+static std::vector<std::string> cids_since(size_t from)
+{
+    std::vector<std::string> cids;
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        if (host_mqtt_publishes[i].topic.find("/cid") != std::string::npos) {
+            cids.push_back(host_mqtt_publishes[i].data);
+        }
+    }
+    return cids;
+}
+
+/**
+ * @brief Acknowledge publishes oldest first. Checks the replay window on
+ * every step.
+ */
+static void drain()
+{
+    while (!host_mqtt_outbox.empty()) {
+        HOST_CHECK(host_mqtt_stats().outbox_inflight <= MQTT_OUTBOX_WINDOW);
+        host_mqtt_ack(host_mqtt_outbox.begin()->first);
+    }
+}
+
+static void test_outage()
+{
+    // the broker stops. States collapse to the latest, events are kept.
+    host_mqtt_event(MQTT_EVENT_DISCONNECTED);
+    lrr_n = 0;
+    cycle(100);
+    mqtt_stats_t st = host_mqtt_stats();
+    HOST_CHECK(st.outbox_depth == 11 && st.outbox_collapsed > 0);
+
+    // restart. The ring is read back from the card.
+    uint32_t depth = mqtt_outbox.depth;
+    fclose(mqtt_outbox.file);
+    free(mqtt_outbox.rec);
+    mqtt_outbox = {};
+    _mqtt_outbox_open();
+    HOST_CHECK(mqtt_outbox.depth == depth);
+    // a restart loses the client outbox.
+    host_mqtt_outbox.clear();
+
+    // the broker is back. Replay in order a window at a time.
+    size_t from = host_mqtt_publishes.size();
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    drain();
+    st = host_mqtt_stats();
+    std::vector<std::string> cids = cids_since(from);
+    HOST_CHECK(st.outbox_depth == 0 && st.outbox_session == depth);
+    HOST_CHECK(cids.size() == 10);
+    for (int i = 0; i < 10; i++) {
+        HOST_CHECK(cids[i].find(ad2_string_printf("%03d", i + 1)) != std::string::npos);
+    }
+
+    // new publishes go straight to the client again.
+    from = host_mqtt_publishes.size();
+    cycle(1);
+    HOST_CHECK(host_mqtt_publishes.size() > from && mqtt_outbox.depth == 0);
+    drain();
+}
+
+static void test_full()
+{
+    // a long outage. Holes left by collapsed states are used again.
+    host_mqtt_event(MQTT_EVENT_DISCONNECTED);
+    lrr_n = 0;
+    cycle(2000);
+    mqtt_stats_t st = host_mqtt_stats();
+    HOST_CHECK(st.outbox_depth == 201 && st.outbox_dropped == 0);
+
+    // more events than records. The oldest are dropped.
+    cycle(1000);
+    st = host_mqtt_stats();
+    uint32_t dropped = 300 - (MQTT_OUTBOX_RECORDS - 1);
+    HOST_CHECK(st.outbox_depth == MQTT_OUTBOX_RECORDS && st.outbox_dropped == dropped);
+
+    size_t from = host_mqtt_publishes.size();
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    drain();
+    std::vector<std::string> cids = cids_since(from);
+    HOST_CHECK(cids.size() == MQTT_OUTBOX_RECORDS - 1);
+    HOST_CHECK(cids[0].find(ad2_string_printf("%03d", dropped + 1)) != std::string::npos);
+}
+
+static void test_expired()
+{
+    host_mqtt_event(MQTT_EVENT_DISCONNECTED);
+    lrr_n = 0;
+    cycle(1);
+    HOST_CHECK(mqtt_outbox.depth > 0);
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    HOST_CHECK(!host_mqtt_outbox.empty());
+
+    // the client gives up on a replay. It is sent again from the card
+    // and only once.
+    int msg_id = 0;
+    for (auto &m : mqtt_outbox.meta) {
+        if (m.seq && m.msg_id) {
+            msg_id = m.msg_id;
+            break;
+        }
+    }
+    HOST_CHECK(host_mqtt_outbox.count(msg_id));
+    host_mqtt_publish lost = host_mqtt_outbox[msg_id];
+    host_mqtt_outbox.erase(msg_id);
+    size_t from = host_mqtt_publishes.size();
+    host_mqtt_event(MQTT_EVENT_DELETED, msg_id);
+    int resent = 0;
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        resent += host_mqtt_publishes[i].topic == lost.topic && host_mqtt_publishes[i].data == lost.data;
+    }
+    HOST_CHECK(resent == 1);
+    host_mqtt_event(MQTT_EVENT_DELETED, msg_id);
+    HOST_CHECK(host_mqtt_publishes.size() == from + 1);
+    drain();
+    HOST_CHECK(host_mqtt_stats().outbox_depth == 0);
+}
+
+int main()
+{
+    unlink(MQTT_OUTBOX_PATH);
+    g_uSD_mounted = true;
+    host_mqtt_setup({ { MQTT_OUTBOX_SUBCMD, "true" } });
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    drain();
+    cycle(1);
+    drain();
+
+    test_outage();
+    test_full();
+    test_expired();
+    puts("mqtt outbox OK");
+    return 0;
+}
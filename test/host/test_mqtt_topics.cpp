@@ -0,0 +1,137 @@
+/**
+ *  @file    test_mqtt_topics.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Interned MQTT topics and allocation free state publishes.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+#define ZONES 128
+#define PUBLISHES 1000
+
+/**
+ * @brief Allocations the fake client makes for one QoS 1 enqueue of a
+ * topic and payload too long for the small string buffer.
+ */
+static size_t fake_enqueue_allocs()
+{
+    size_t allocs = host_heap_allocs;
+    for (int n = 0; n < PUBLISHES; n++) {
+        esp_mqtt_client_enqueue((esp_mqtt_client_handle_t)1, "homeassistant/ad2iot/zones/1",
+                                "{\"state\":\"OPEN\",\"partition\":1}", 0, 1, 0, true);
+    }
+    size_t total = host_heap_allocs - allocs;
+    HOST_CHECK(total % PUBLISHES == 0);
+    host_mqtt_outbox.clear();
+    host_mqtt_publishes.clear();
+    return total / PUBLISHES;
+}
+
+/**
+ * @brief Allocations made by ad2mqtt itself over PUBLISHES calls of fn
+ * after a first call that may render a snapshot. The fake client's own
+ * allocations are taken out.
+ */
+template <typename F> static size_t firmware_allocs(size_t enqueue, F fn)
+{
+    fn(0);
+    host_mqtt_ack_all();
+    host_mqtt_publishes.clear();
+    size_t allocs = host_heap_allocs;
+    for (int n = 0; n < PUBLISHES; n++) {
+        fn(n);
+    }
+    HOST_CHECK(host_mqtt_publishes.size() >= PUBLISHES);
+    size_t total = host_heap_allocs - allocs - enqueue * host_mqtt_publishes.size();
+    host_mqtt_ack_all();
+    host_mqtt_publishes.clear();
+    return total;
+}
+
+static void test_publish_allocs()
+{
+    AD2PartitionState *s = ad2_get_partition_state(1);
+    HOST_CHECK(s);
+    // the fake's record keeps its capacity between rounds.
+    host_mqtt_publishes.reserve(4 * PUBLISHES);
+    size_t enqueue = fake_enqueue_allocs();
+
+    size_t zone = firmware_allocs(enqueue, [&](int n) {
+        s->zone = 1 + n % ZONES;
+        mqtt_on_zone_change(nullptr, s, (void *)ON_ZONE_CHANGE);
+    });
+    size_t partition = firmware_allocs(enqueue, [&](int n) {
+        mqtt_on_state_change(nullptr, s, (void *)ON_READY_CHANGE);
+    });
+    printf("allocations over %d publishes: zone %zu, partition %zu\n", PUBLISHES, zone, partition);
+    HOST_CHECK(zone == 0 && partition == 0);
+}
+
+static void test_table()
+{
+    mqtt_topics_ptr t = _mqtt_get_topics();
+    HOST_CHECK(t);
+    std::string root = t->get(t->root);
+    HOST_CHECK(root == "homeassistant/ad2iot/" + mqttclient_UUID);
+    HOST_CHECK(std::string(t->get(t->partition[1])) == root + "/partitions/1");
+    HOST_CHECK(std::string(t->get(t->ha_status)) == "homeassistant/status");
+    for (int zn = 1; zn <= ZONES; zn++) {
+        HOST_CHECK(t->zone[zn] && std::string(t->get(t->zone[zn])) == root + "/zones/" + std::to_string(zn));
+    }
+    // zones that are not configured are formatted on the stack.
+    char buf[MQTT_TOPIC_MAX];
+    HOST_CHECK(!t->zone[ZONES + 1]);
+    HOST_CHECK(std::string(t->entity(t->zone, ZONES + 1, "zones", buf)) == root + "/zones/129");
+    printf("arena %zu B, table %zu B\n", t->arena.size(), sizeof(mqtt_topics_t));
+
+    // a reload swaps the table. A publisher holding the old one can
+    // still read it.
+    const char *old_status = t->get(t->status);
+    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_TPREFIX_SUBCMD, "other");
+    _mqtt_load_settings();
+    mqtt_topics_ptr n = _mqtt_get_topics();
+    HOST_CHECK(n != t);
+    HOST_CHECK(std::string(old_status) == root + "/status");
+    HOST_CHECK(std::string(n->get(n->status)) == "other/ad2iot/" + mqttclient_UUID + "/status");
+}
+
+int main()
+{
+    for (int zn = 1; zn <= ZONES; zn++) {
+        AD2Parse.setZoneType(zn, "door");
+        AD2Parse.setZoneString(zn, "Z");
+    }
+    host_mqtt_setup({
+        { MQTT_TPREFIX_SUBCMD, "homeassistant" },
+        { MQTT_DPREFIX_SUBCMD, "homeassistant" },
+        { MQTT_DEDUP_SUBCMD, "false" }
+    }, true);
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    host_mqtt_ack_all();
+
+    test_publish_allocs();
+    test_table();
+    puts("mqtt topics OK");
+    return 0;
+}
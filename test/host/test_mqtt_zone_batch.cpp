@@ -0,0 +1,182 @@
+/**
+ *  @file    test_mqtt_zone_batch.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Zone change batching into partition deltas.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "ad2mqtt.cpp"
+
+// host includes
+#include "host.h"
+#include "mqtt_host.h"
+
+#define READY     "10000001100000000A--"
+#define NOT_READY "00000001100000000A--"
+// one keypad message a second.
+#define MSG_MS 1000
+#define ROUNDS 60
+
+static const char *zones[] = { "002", "005", "007", "009", "012" };
+
+struct counts {
+    int zone;
+    int delta;
+};
+
+static void feed_at(const std::string &msg)
+{
+    host_advance_ms(MSG_MS);
+    host_feed(msg);
+}
+
+/**
+ * @brief The panel rotates through the faulted zones a few times. READY
+ * then closes every open zone in one parser read.
+ */
+static void round_trip()
+{
+    for (int i = 0; i < 3; i++) {
+        for (const char *z : zones) {
+            feed_at(host_keypad(NOT_READY, z, (std::string("FAULT ") + (z + 1)).c_str()));
+        }
+    }
+    feed_at(host_keypad(READY, "008", "DISARMED CHIME   Ready to Arm"));
+    host_advance_ms(3 * MSG_MS);
+}
+
+static bool is_delta(const std::string &t)
+{
+    size_t n = strlen("/" MQTT_ZONE_DELTA_TOPIC);
+    return t.length() > n && t.compare(t.length() - n, n, "/" MQTT_ZONE_DELTA_TOPIC) == 0;
+}
+
+static counts classify(size_t from)
+{
+    counts c = {};
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        const std::string &t = host_mqtt_publishes[i].topic;
+        c.zone += t.find("/zones/") != std::string::npos;
+        c.delta += is_delta(t);
+    }
+    return c;
+}
+
+static std::string last_zone_state(int zn)
+{
+    std::string want = "/zones/" + std::to_string(zn);
+    for (size_t i = host_mqtt_publishes.size(); i-- > 0;) {
+        const host_mqtt_publish &p = host_mqtt_publishes[i];
+        if (p.topic.length() >= want.length() &&
+                p.topic.compare(p.topic.length() - want.length(), want.length(), want) == 0) {
+            size_t at = p.data.find("\"state\":\"");
+            HOST_CHECK(at != std::string::npos);
+            return p.data.substr(at + 9, p.data.find('"', at + 9) - at - 9);
+        }
+    }
+    return "";
+}
+
+static void set_zone_batch(const char *setting)
+{
+    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_ZONEBATCH_SUBCMD, setting);
+    _mqtt_load_zone_batch_settings();
+    _mqtt_build_topics();
+}
+
+/**
+ * @brief Replay ROUNDS of fault cycling and count the zone publishes.
+ *
+ * @param [in]setting const char * [mqtt] zonebatch.
+ */
+static counts run(const char *setting)
+{
+    set_zone_batch(setting);
+    round_trip();
+    size_t from = host_mqtt_publishes.size();
+    for (int r = 0; r < ROUNDS; r++) {
+        round_trip();
+    }
+    // flush the tail and let the zone topics catch up on the next read.
+    host_advance_ms(60000);
+    feed_at("");
+    counts n = classify(from);
+    printf("zonebatch '%s': %d zone, %d delta publishes\n", setting, n.zone, n.delta);
+    // whatever the setting, the zone topics end up right.
+    for (const char *z : zones) {
+        HOST_CHECK(last_zone_state(atoi(z)) == "CLOSE");
+    }
+    host_mqtt_ack_all();
+    return n;
+}
+
+static void test_rates()
+{
+    counts off = run("");
+    counts parser = run("0");
+    counts w2 = run("2000");
+    counts w5 = run("5000");
+    counts slow = run("2000 60000");
+
+    HOST_CHECK(off.delta == 0 && off.zone > 0);
+    // a delta per parser read with a change. The zone topics lag behind.
+    HOST_CHECK(parser.delta > 0 && parser.zone < off.zone);
+    // longer windows gather more changes per delta.
+    HOST_CHECK(w2.delta < parser.delta && w5.delta < w2.delta);
+    HOST_CHECK(w2.zone + w2.delta < off.zone);
+    // the zone topics only catch up once a minute.
+    HOST_CHECK(slow.delta == w2.delta && slow.zone < w2.zone);
+}
+
+static void test_close_delta()
+{
+    // the READY close is one delta with every zone in it.
+    set_zone_batch("0");
+    size_t from = host_mqtt_publishes.size();
+    round_trip();
+    feed_at("");
+    std::string close;
+    int deltas = 0;
+    for (size_t i = from; i < host_mqtt_publishes.size(); i++) {
+        const host_mqtt_publish &p = host_mqtt_publishes[i];
+        if (is_delta(p.topic)) {
+            deltas++;
+            HOST_CHECK(p.retain == 0 && p.qos == 1);
+            if (p.data.find("CLOSE") != std::string::npos) {
+                close = p.data;
+            }
+        }
+    }
+    HOST_CHECK(deltas == 6);
+    for (const char *z : zones) {
+        HOST_CHECK(close.find(ad2_string_printf("\"zone\":%d,", atoi(z))) != std::string::npos);
+    }
+}
+
+int main()
+{
+    host_mqtt_setup();
+    host_mqtt_event(MQTT_EVENT_CONNECTED);
+    host_mqtt_ack_all();
+
+    test_rates();
+    test_close_delta();
+    puts("mqtt zone batch OK");
+    return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ *  @file    test_twilio_render.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/19/2026
+ *
+ *  @brief Twilio and SendGrid notify slot pre-rendering and request
+ *  bodies.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// module under test
+#include "twilio.cpp"
+
+// host includes
+#include "host.h"
+#include "http_host.h"
+
+/**
+ * @brief The URL encoding the firmware used before bodies were rendered
+ * in one pass.
+ */
+static std::string urlencode_reference(const std::string &str)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string encoded;
+    for (unsigned char c : str) {
+        if (c == ' ') {
+            encoded += '+';
+        } else if (isalnum(c)) {
+            encoded += (char)c;
+        } else {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 0xf];
+        }
+    }
+    return encoded;
+}
+
+static void set(uint8_t slot, const char *key, const char *value)
+{
+    ad2_set_config_key_string(TWILIO_CONFIG_SECTION, key, value, slot);
+}
+
+static std::string render(uint8_t slot, const std::string &message, size_t *allocs = nullptr)
+{
+    tw_request_message r;
+    r.slot = _get_slot(slot);
+    r.message = message;
+    size_t before = host_heap_allocs;
+    _render_post(&r);
+    if (allocs) {
+        *allocs = host_heap_allocs - before;
+    }
+    return r.post;
+}
+
+static void test_urlencode()
+{
+    // every byte value encodes the same as before.
+    std::string all;
+    for (int c = 1; c < 256; c++) {
+        all += (char)c;
+    }
+    HOST_CHECK(ad2_urlencode(all) == urlencode_reference(all));
+    std::string out = "x=";
+    ad2_urlencode_append(out, "a b&c", 5);
+    HOST_CHECK(out == "x=a+b%26c");
+}
+
+static void test_sms()
+{
+    set(1, TWILIO_TYPE_SUBCMD, "Message");
+    set(1, TWILIO_SID_SUBCMD, "AC123");
+    set(1, TWILIO_TOKEN_SUBCMD, "secret");
+    set(1, TWILIO_FROM_SUBCMD, "+15550001");
+    set(1, TWILIO_TO_SUBCMD, "+15550002");
+    tw_slot_ptr slot = _get_slot(1);
+    HOST_CHECK(slot->url == "https://api.twilio.com/2010-04-01/Accounts/AC123/Messages.json");
+    HOST_CHECK(slot->auth_header == "Basic " + ad2_make_basic_auth_string("AC123", "secret"));
+    HOST_CHECK(slot->auth_header == "Basic QUMxMjM6c2VjcmV0");
+    HOST_CHECK(_get_slot(1) == slot);
+
+    std::string message = "FIRE zone 1 & 2 = 100%";
+    size_t allocs;
+    std::string post = render(1, message, &allocs);
+    HOST_CHECK(post == "To=" + urlencode_reference("+15550002") + "&From=" + urlencode_reference("+15550001") +
+               "&Body=" + urlencode_reference(message));
+    // the reserved buffer is the only allocation.
+    HOST_CHECK(allocs == 1);
+}
+
+static void test_call()
+{
+    set(2, TWILIO_TYPE_SUBCMD, "Call");
+    set(2, TWILIO_SID_SUBCMD, "AC123");
+    set(2, TWILIO_TOKEN_SUBCMD, "secret");
+    set(2, TWILIO_FROM_SUBCMD, "+15550001");
+    set(2, TWILIO_TO_SUBCMD, "+15550003");
+    set(2, TWILIO_FORMAT_SUBCMD, "<Response><Say>{}</Say></Response>");
+    HOST_CHECK(_get_slot(2)->url == "https://api.twilio.com/2010-04-01/Accounts/AC123/Calls.json");
+    std::string post = render(2, "FIRE <kitchen>");
+    HOST_CHECK(post == "To=%2B15550003&From=%2B15550001&Twiml=" +
+               urlencode_reference("<Response><Say>FIRE <kitchen></Say></Response>"));
+}
+
+static void test_email()
+{
+    set(3, TWILIO_TYPE_SUBCMD, "Email");
+    set(3, TWILIO_TOKEN_SUBCMD, "SG.key");
+    set(3, TWILIO_FROM_SUBCMD, "panel@example.com");
+    set(3, TWILIO_TO_SUBCMD, "a@example.com, b\"q@example.com");
+    tw_slot_ptr slot = _get_slot(3);
+    HOST_CHECK(slot->url == SENDGRID_URL && slot->auth_header == "Bearer SG.key");
+    std::string post = render(3, "Zone 5 \"open\"\n\tbell\x01\\");
+    const char *want =
+        "{\"personalizations\":[{\"to\":[{\"email\":\"a@example.com\"}]},"
+        "{\"to\":[{\"email\":\"b\\\"q@example.com\"}]}],"
+        "\"from\":{\"email\":\"panel@example.com\"},"
+        "\"subject\":\"AD2 ALERT 'Zone 5 \\\"open\\\"\\n\\tbell\\u0001\\\\'\","
+        "\"content\":[{\"type\":\"text/plain\",\"value\":\"Zone 5 \\\"open\\\"\\n\\tbell\\u0001\\\\\"}]}";
+    HOST_CHECK(post == want);
+}
+
+static void test_reload()
+{
+    // a request keeps the slot it was rendered with across a reload.
+    tw_slot_ptr held = _get_slot(1);
+    set(1, TWILIO_TO_SUBCMD, "+15550009");
+    _clear_slots();
+    HOST_CHECK(_get_slot(1) != held);
+    HOST_CHECK(held->head.find("%2B15550002") != std::string::npos);
+    HOST_CHECK(_get_slot(1)->head.find("%2B15550009") != std::string::npos);
+    set(4, TWILIO_TYPE_SUBCMD, "Message");
+    set(4, TWILIO_DISABLE_SUBCMD, "true");
+    HOST_CHECK(_get_slot(4)->disabled);
+}
+
+static void test_sendq()
+{
+    // the rendered body and headers reach the wire.
+    ad2_init_http_sendQ();
+    HOST_CHECK(_queue_request(3, "Front door", AD2_HTTP_PRIO_INFO, 0));
+    HOST_CHECK(_queue_request(1, "Front door", AD2_HTTP_PRIO_INFO, 0));
+    host_run_task(host_task("AD2 sendQ"), 0);
+    HOST_CHECK(host_http_requests.size() == 2);
+    host_http_request &email = host_http_requests[0];
+    HOST_CHECK(email.url == SENDGRID_URL && email.method == HTTP_METHOD_POST);
+    HOST_CHECK(email.headers["Authorization"] == "Bearer SG.key");
+    HOST_CHECK(email.headers["Content-Type"] == "application/json; charset=utf-8");
+    HOST_CHECK(email.post == render(3, "Front door"));
+    host_http_request &sms = host_http_requests[1];
+    HOST_CHECK(sms.headers["Authorization"] == _get_slot(1)->auth_header);
+    HOST_CHECK(sms.headers.count("Content-Type") == 0);
+    HOST_CHECK(sms.post == render(1, "Front door"));
+}
+
+int main()
+{
+    _tw_slots_mutex = xSemaphoreCreateMutex();
+    test_urlencode();
+    test_sms();
+    test_call();
+    test_email();
+    test_reload();
+    test_sendq();
+    puts("twilio render OK");
+    return 0;
+}